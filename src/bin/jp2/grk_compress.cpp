@@ -420,6 +420,13 @@ static void encode_help_display(void) {
 	fprintf(stdout, "    Path to T1 plugin.\n");
 	fprintf(stdout, "[-H|-num_threads] <number of threads>\n");
 	fprintf(stdout, "    Number of threads to use for T1.\n");
+	fprintf(stdout, "[-j|-TilesInFlight] <number of tiles>\n");
+	fprintf(stdout,
+			"    Maximum number of tiles compressed concurrently. Default is 1 (serial).\n");
+	fprintf(stdout, "[-X|-EarlyTermination]\n");
+	fprintf(stdout,
+			"    Stop coding passes that rate control is estimated to discard,\n"
+			"    for Part-1 encodes with compression ratios specified for every layer.\n");
 	fprintf(stdout, "[-G|-DeviceId] <device ID>\n");
 	fprintf(stdout,
 			"    (GPU) Specify which GPU accelerator to run codec on.\n");
@@ -600,6 +607,11 @@ static int parse_cmdline_encoder_ex(int argc, char **argv,
 				"", "string", cmd);
 		ValueArg<uint32_t> numThreadsArg("H", "num_threads",
 				"Number of threads", false, 0, "unsigned integer", cmd);
+		ValueArg<uint32_t> tilesInFlightArg("j", "TilesInFlight",
+				"Maximum number of tiles compressed concurrently", false, 0,
+				"unsigned integer", cmd);
+		SwitchArg earlyTerminationArg("X", "EarlyTermination",
+				"Early termination of coding passes", cmd);
 
 		ValueArg<int32_t> deviceIdArg("G", "DeviceId", "Device ID", false, 0,
 				"integer", cmd);
@@ -714,6 +726,11 @@ static int parse_cmdline_encoder_ex(int argc, char **argv,
 		if (numThreadsArg.isSet())
 			parameters->numThreads = numThreadsArg.getValue();
 
+		if (tilesInFlightArg.isSet())
+			parameters->max_tiles_in_flight = tilesInFlightArg.getValue();
+
+		parameters->early_termination = earlyTerminationArg.isSet();
+
 		if (deviceIdArg.isSet())
 			parameters->deviceId = deviceIdArg.getValue();
 
@@ -2186,6 +2203,18 @@ static bool plugin_compress_callback(
 		bSuccess = false;
 		goto cleanup;
 	}
+	if (parameters->verbose) {
+		uint32_t num_threads = 0;
+		if (grk_get_t1_encode_stats(codec, nullptr, &num_threads)) {
+			std::vector<grk_t1_thread_stats> stats(num_threads);
+			grk_get_t1_encode_stats(codec, stats.data(), &num_threads);
+			for (uint32_t i = 0; i < num_threads; ++i) {
+				spdlog::info("T1 thread {}: {} blocks, {} passes, {} bytes, {} ms",
+						i, stats[i].blocks, stats[i].passes, stats[i].bytes,
+						(double) stats[i].time_ns / 1000000.0);
+			}
+		}
+	}
 	if (info->compressBuffer) {
 		auto fp = fopen(outfile, "wb");
 		if (!fp) {
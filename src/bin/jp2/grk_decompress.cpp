@@ -207,6 +207,10 @@ static void decode_help_display(void) {
 			"    Path to T1 plugin.\n");
 	fprintf(stdout, "  [-H | -num_threads] <number of threads>\n"
 			"    Number of threads used by T1 decompress.\n");
+	fprintf(stdout, "  [-j | -TilesInFlight] <number of tiles>\n"
+			"    Maximum number of tiles decompressed concurrently. Default is 1 (serial).\n"
+			"    With 2 or more, packets of the next tile are parsed while code blocks\n"
+			"    of the previous tiles are decoded.\n");
 	fprintf(stdout,	"  [-c|-Compression] <compression method>\n"
 					"    Compress output image data. Currently, this option is only applicable when output "
 					"    format is set to TIF. Possible values are \n"
@@ -239,6 +243,11 @@ static void decode_help_display(void) {
 					"    If 'C' is specified (default), values are clipped.\n"
 					"    If 'S' is specified, values are scaled.\n"
 					"    A 0 value can be specified (meaning original bit depth).\n");
+	fprintf(stdout,
+			"  [-T | -TruncatePrecision]\n"
+					"    With -p, when all precisions are scaled ('S'), skip decoding bit planes\n"
+					"    that are too small to change the scaled samples. Much faster for\n"
+					"    low precision previews; samples may occasionally differ by one.\n");
 	fprintf(stdout,
 			"  [-f | -force-rgb]\n"
 					"    Force output image colorspace to RGB\n"
@@ -489,6 +498,9 @@ int parse_cmdline_decoder(int argc, char **argv,
 				"", "string", cmd);
 		ValueArg<uint32_t> numThreadsArg("H", "num_threads",
 				"Number of threads", false, 0, "unsigned integer", cmd);
+		ValueArg<uint32_t> tilesInFlightArg("j", "TilesInFlight",
+				"Maximum number of tiles decompressed concurrently", false, 0,
+				"unsigned integer", cmd);
 		ValueArg<string> inputFileArg("i", "InputFile", "Input file", false, "",
 				"string", cmd);
 		ValueArg<string> outputFileArg("o", "OutputFile", "Output file", false,
@@ -499,6 +511,8 @@ int parse_cmdline_decoder(int argc, char **argv,
 				"unsigned integer", cmd);
 		ValueArg<uint32_t> tileArg("t", "TileIndex", "Input tile index", false,
 				0, "unsigned integer", cmd);
+		SwitchArg truncatePrecisionArg("T", "TruncatePrecision",
+				"Skip bit planes below scaled precision", cmd);
 		ValueArg<string> precisionArg("p", "Precision", "Force precision",
 				false, "", "string", cmd);
 		ValueArg<string> decodeRegionArg("d", "DecodeRegion", "Decode Region",
@@ -713,9 +727,29 @@ int parse_cmdline_decoder(int argc, char **argv,
 			if (!parse_precision(precisionArg.getValue().c_str(), parameters))
 				return 1;
 		}
+		if (truncatePrecisionArg.isSet()) {
+			// library skips bit planes below the highest scaled precision,
+			// which is only safe if every component is scaled
+			uint32_t output_precision = 0;
+			for (uint32_t i = 0; i < parameters->nb_precision; ++i) {
+				auto prec = parameters->precision + i;
+				if (prec->mode != GRK_PREC_MODE_SCALE || prec->prec == 0) {
+					output_precision = 0;
+					break;
+				}
+				output_precision = std::max<uint32_t>(output_precision, prec->prec);
+			}
+			if (output_precision)
+				parameters->core.output_precision = output_precision;
+			else
+				spdlog::warn("-T requires -p with scaled precisions only; ignoring");
+		}
 		if (numThreadsArg.isSet()) {
 			parameters->numThreads = numThreadsArg.getValue();
 		}
+		if (tilesInFlightArg.isSet()) {
+			parameters->core.max_tiles_in_flight = tilesInFlightArg.getValue();
+		}
 
 		if (decodeRegionArg.isSet()) {
 			size_t size_optarg = (size_t) strlen(
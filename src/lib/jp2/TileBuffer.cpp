@@ -41,6 +41,10 @@ int32_t* TileBuffer::get_ptr(uint32_t resno,
 			+ offsety * (uint64_t) (dims.x1 - dims.x0);
 }
 
+int16_t* TileBuffer::get_ptr16(uint32_t resno,
+		uint32_t bandno, uint32_t offsetx, uint32_t offsety) {
+	return (int16_t*) data + (get_ptr(resno, bandno, offsetx, offsety) - data);
+}
 
 bool TileBuffer::alloc_component_data_encode() {
 	if ((data == nullptr)
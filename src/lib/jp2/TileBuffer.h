@@ -43,6 +43,8 @@ struct TileBuffer {
 	~TileBuffer();
 
 	int32_t* get_ptr(uint32_t resno,uint32_t bandno, uint32_t offsetx, uint32_t offsety);
+	/* same as get_ptr, for 16 bit coefficients */
+	int16_t* get_ptr16(uint32_t resno,uint32_t bandno, uint32_t offsetx, uint32_t offsety);
 	bool alloc_component_data_encode();
 	bool alloc_component_data_decode();
 
@@ -54,6 +56,17 @@ struct TileBuffer {
 	uint64_t data_size; /* size of the data of the component */
 	bool owns_data; /* true if tile buffer manages its data array, false otherwise */
 
+	/* true if wavelet coefficients are stored as int16_t,
+	 in the first half of data and with the same stride: T1 and the
+	 wavelet transform then move half as many bytes. Samples before the
+	 forward transform and after the inverse transform are int32_t, so
+	 data keeps its 32 bit size: this saves bandwidth, not memory. */
+	bool coeff16 = false;
+	/* irreversible wavelet coefficients are stored as 16 bit fixed
+	 point, with this many fractional bits. Samples after the inverse
+	 transform are float. */
+	uint32_t coeff16_frac_bits = 0;
+
 	// unreduced coordinates of region
 	grk_rect unreduced_region_dim;
 
@@ -463,8 +463,11 @@ bool TileComponent::init(bool isEncoder,
 						code_block->y1 = std::min<uint32_t>(cblkyend,
 								current_precinct->y1);
 
-						if (!current_plugin_tile
-								|| (state & GRK_PLUGIN_STATE_DEBUG)) {
+						// strip compression allocates data once the code block's
+						// samples are available
+						bool strips = cp->m_coding_param.m_enc.m_strip_read_fn != nullptr;
+						if ((!current_plugin_tile
+								|| (state & GRK_PLUGIN_STATE_DEBUG)) && !strips) {
 							if (!code_block->alloc_data(
 									nominalBlockSize)) {
 								return false;
@@ -59,6 +59,8 @@
 #include "Tier1.h"
 #include <memory>
 #include "WaveletForward.h"
+#include "WaveletStrip.h"
+#include "T1StripEncoder.h"
 #include <algorithm>
 #include <exception>
 using namespace std;
@@ -73,7 +75,7 @@ TileProcessor::TileProcessor(bool isDecoder) :
 				nullptr), cur_totnum_tp(0), cur_pino(0), tile(nullptr), image(
 				nullptr), current_plugin_tile(nullptr), whole_tile_decoding(
 				true), m_marker_scratch(nullptr), m_marker_scratch_size(0), plt_markers(
-				nullptr), m_cp(nullptr), m_tcp(nullptr), m_tileno(0) {
+				nullptr), m_cp(nullptr), m_tcp(nullptr), m_tileno(0), m_stop_slope(0), m_rate_control_slope(0) {
 	if (isDecoder) {
 		m_marker_scratch = (uint8_t*) grk_calloc(1, default_header_size);
 		if (!m_marker_scratch)
@@ -451,6 +453,7 @@ bool TileProcessor::pcrd_bisect_feasible(uint64_t *p_data_written,
 			delete t2;
 
 			makelayer_feasible(layno, (uint16_t) goodthresh, true);
+			m_rate_control_slope = RateControl::slopeFromLog((uint16_t) goodthresh);
 			cumdisto[layno] =
 					(layno == 0) ?
 							tile->distolayer[0] :
@@ -612,6 +615,7 @@ bool TileProcessor::pcrd_bisect_simple(uint64_t *p_data_written, uint64_t len) {
 			delete t2;
 
 			make_layer_simple(layno, goodthresh, true);
+			m_rate_control_slope = goodthresh;
 			cumdisto[layno] =
 					(layno == 0) ?
 							tile->distolayer[0] :
@@ -873,7 +877,9 @@ inline bool TileProcessor::init_tile(uint16_t tile_no, grk_image *output_image,
 		/*fprintf(stderr, "compno = %d/%d\n", compno, tile->numcomps);*/
 		if (image_comp->dx == 0 || image_comp->dy == 0)
 			return false;
-		image_comp->resno_decoded = 0;
+		// encoder image is shared by tiles compressed concurrently
+		if (!isEncoder)
+			image_comp->resno_decoded = 0;
 
 		auto tilec = tile->comps + compno;
 		if (!tilec->init(isEncoder, whole_tile_decoding, output_image, m_cp,
@@ -931,6 +937,11 @@ bool TileProcessor::compress_tile(uint16_t tile_no, BufferedStream *stream,
 	if (m_current_tile_part_number == 0) {
 		m_tileno = tile_no;
 		m_tcp = &m_cp->tcps[tile_no];
+		// slopes of the previous tile must not leak into this one:
+		// a zero rate control slope codes all passes again,
+		// should rate control not reach a slope for this tile
+		m_stop_slope = 0;
+		m_rate_control_slope = 0;
 		if (p_cstr_info) {
 			uint32_t num_packs = 0;
 			uint32_t i;
@@ -965,10 +976,18 @@ bool TileProcessor::compress_tile(uint16_t tile_no, BufferedStream *stream,
 		// This way, both Grok and plugin start with same inputs for context formation and MQ coding.
 		bool debugEncode = state & GRK_PLUGIN_STATE_DEBUG;
 		bool debugMCT = (state & GRK_PLUGIN_STATE_MCT_ONLY) ? true : false;
+		// transcoded tiles are already wavelet coefficients
+		bool transcode = m_cp->m_coding_param.m_enc.m_transcode;
+
+		// statistics of this tile's final T1 pass
+		T1EncodeStats tile_stats;
+		auto stats = m_cp->m_coding_param.m_enc.m_t1_stats ? &tile_stats : nullptr;
+		if (m_cp->m_coding_param.m_enc.m_strip_read_fn) {
+			if (!strip_encode())
+				return false;
+		} else if (!current_plugin_tile || debugEncode) {
 
-		if (!current_plugin_tile || debugEncode) {
-
-			if (!debugEncode) {
+			if (!debugEncode && !transcode) {
 				if (!dc_level_shift_encode()) {
 					return false;
 				}
@@ -976,18 +995,35 @@ bool TileProcessor::compress_tile(uint16_t tile_no, BufferedStream *stream,
 					return false;
 				}
 			}
-			if (!debugEncode || debugMCT) {
+			if ((!debugEncode || debugMCT) && !transcode) {
 				if (!dwt_encode()) {
 					return false;
 				}
 			}
-			if (!t1_encode()) {
+			if (!t1_encode(
+					current_plugin_tile ? 0 : early_termination_length(max_length),
+					stats)) {
 				return false;
 			}
 		}
 		if (!rate_allocate_encode(max_length, p_cstr_info)) {
 			return false;
 		}
+		// rate control reached down to slopes where code blocks stopped
+		// coding, so it may have wanted passes that were not coded:
+		// code all passes, and allocate again
+		if (m_stop_slope > 0 && m_rate_control_slope < m_stop_slope) {
+			GROK_INFO("Tile %u: rate control needs skipped coding passes, "
+					"coding all passes", m_tileno + 1);
+			// blocks are coded again: only count them once
+			tile_stats.clear();
+			if (!t1_encode(0, stats))
+				return false;
+			if (!rate_allocate_encode(max_length, p_cstr_info))
+				return false;
+		}
+		if (stats)
+			m_cp->m_coding_param.m_enc.m_t1_stats->add(tile_stats);
 		m_packetTracker.clear();
 	}
 	if (p_cstr_info) {
@@ -1030,6 +1066,10 @@ bool TileProcessor::is_whole_tilecomp_decoding(uint32_t compno) {
 }
 
 bool TileProcessor::decompress_tile(ChunkBuffer *src_buf, uint16_t tile_no) {
+	return decompress_tile_t2(src_buf, tile_no) && decompress_tile_t1();
+}
+
+bool TileProcessor::decompress_tile_t2(ChunkBuffer *src_buf, uint16_t tile_no) {
 	m_tcp = m_cp->tcps + tile_no;
 
 	// optimization for regions that are close to largest decoded resolution
@@ -1079,10 +1119,6 @@ bool TileProcessor::decompress_tile(ChunkBuffer *src_buf, uint16_t tile_no) {
 
 	bool doT2 = !current_plugin_tile
 			|| (current_plugin_tile->decode_flags & GRK_DECODE_T2);
-	bool doT1 = !current_plugin_tile
-			|| (current_plugin_tile->decode_flags & GRK_DECODE_T1);
-	bool doPostT1 = !current_plugin_tile
-			|| (current_plugin_tile->decode_flags & GRK_DECODE_POST_T1);
 
 	if (doT2) {
 		uint64_t l_data_read = 0;
@@ -1092,7 +1128,24 @@ bool TileProcessor::decompress_tile(ChunkBuffer *src_buf, uint16_t tile_no) {
 		decode_synch_plugin_with_host(this);
 	}
 
+	return true;
+}
+
+bool TileProcessor::decompress_tile_t1(void) {
+	bool doT1 = !current_plugin_tile
+			|| (current_plugin_tile->decode_flags & GRK_DECODE_T1);
+	// transcoded tiles are kept as wavelet coefficients
+	bool doPostT1 = (!current_plugin_tile
+			|| (current_plugin_tile->decode_flags & GRK_DECODE_POST_T1))
+			&& !m_cp->m_coding_param.m_dec.m_transcoder;
+
 	if (doT1) {
+		std::vector<decodeBlockInfo*> blocks;
+		std::vector< std::function<bool(const resolution_wait_fn&)> > wavelets;
+		auto t1_wrap = std::unique_ptr<Tier1>(new Tier1());
+		t1_wrap->setCodeblockCache(m_cp->m_coding_param.m_dec.m_codeblock_cache,
+				(uint32_t) (m_tcp - m_cp->tcps), m_tcp->num_layers_to_decode);
+		t1_wrap->setCancel(m_cp->m_coding_param.m_dec.m_cancel);
 		for (uint32_t compno = 0; compno < tile->numcomps; ++compno) {
 			auto tilec = tile->comps + compno;
 			auto img_comp = image->comps + compno;
@@ -1102,28 +1155,58 @@ bool TileProcessor::decompress_tile(ChunkBuffer *src_buf, uint16_t tile_no) {
 				try {
 					tilec->alloc_sparse_array(img_comp->resno_decoded + 1);
 				} catch (runtime_error &ex) {
+					for (auto &block : blocks)
+						delete block;
 					return false;
 				}
 			}
-			std::vector<decodeBlockInfo*> blocks;
-			auto t1_wrap = std::unique_ptr<Tier1>(new Tier1());
-			if (!t1_wrap->prepareDecodeCodeblocks(tilec, tccp, &blocks))
-				return false;
-			// !!! assume that code block dimensions do not change over components
-			if (!t1_wrap->decodeCodeblocks(m_tcp,
-					(uint16_t) m_tcp->tccps->cblkw,
-					(uint16_t) m_tcp->tccps->cblkh, &blocks))
+			// bits below the requested output precision are discarded
+			uint32_t output_precision = m_cp->m_coding_param.m_dec.m_output_precision;
+			uint32_t discarded_bits = (output_precision
+					&& img_comp->prec > output_precision) ?
+							img_comp->prec - output_precision : 0;
+			tilec->buf->coeff16 = false;
+			if (doPostT1 && whole_tile_decoding
+					&& !m_cp->m_coding_param.m_dec.m_blocked_dwt) {
+				if (tccp->qmfbid == 1) {
+					// coefficients of partially decoded layers are not bounded
+					tilec->buf->coeff16 = !discarded_bits
+							&& m_tcp->num_layers_to_decode == m_tcp->numlayers
+							&& fits_coeff16(compno);
+				} else if (fits_fix16_97(compno)) {
+					tilec->buf->coeff16 = true;
+					tilec->buf->coeff16_frac_bits =
+							dwt_utils::fix16_97_frac_bits(img_comp->prec);
+				}
+			}
+			if (!t1_wrap->prepareDecodeCodeblocks(compno, tilec, tccp,
+					img_comp->prec, discarded_bits, m_tcp->mct != 0, &blocks)) {
+				for (auto &block : blocks)
+					delete block;
 				return false;
-
-			if (doPostT1)
-				if (!Wavelet::decompress(this, tilec,
-						img_comp->resno_decoded + 1, tccp->qmfbid))
-					return false;
-
-			tilec->release_mem();
+			}
+			if (doPostT1) {
+				wavelets.push_back(
+						[this, tilec, img_comp, tccp](const resolution_wait_fn &wait) {
+							return Wavelet::decompress(this, tilec,
+									img_comp->resno_decoded + 1, tccp->qmfbid, wait);
+						});
+			}
 		}
+		// code blocks of all components are decoded in one batch, and
+		// the inverse wavelets of all components run alongside,
+		// each waiting on its own resolutions in turn.
+		// !!! assume that code block dimensions do not change over components
+		if (!t1_wrap->decodeCodeblocks(m_tcp,
+				(uint16_t) m_tcp->tccps->cblkw,
+				(uint16_t) m_tcp->tccps->cblkh, &blocks, wavelets))
+			return false;
+
+		for (uint32_t compno = 0; compno < tile->numcomps; ++compno)
+			(tile->comps + compno)->release_mem();
 	}
 
+	// MCT needs all components to be fully decoded
 	if (doPostT1) {
 		if (!mct_decode())
 			return false;
@@ -1391,70 +1474,65 @@ uint64_t TileProcessor::get_tile_size(bool reduced) {
 bool TileProcessor::dc_level_shift_encode() {
 	for (uint32_t compno = 0; compno < tile->numcomps; compno++) {
 		auto tile_comp = tile->comps + compno;
-		auto tccp = m_tcp->tccps + compno;
-		auto current_ptr = tile_comp->buf->get_ptr(0, 0, 0, 0);
-		uint64_t nb_elem = tile_comp->area();
-
-		if (tccp->qmfbid == 1) {
-			if (tccp->m_dc_level_shift == 0)
-				continue;
-			for (uint64_t i = 0; i < nb_elem; ++i) {
-				*current_ptr -= tccp->m_dc_level_shift;
-				++current_ptr;
-			}
-		} else {
-			for (uint64_t i = 0; i < nb_elem; ++i) {
-				*current_ptr = (*current_ptr - tccp->m_dc_level_shift)
-						* (1 << 11);
-				++current_ptr;
-			}
-		}
+		dc_level_shift_encode(compno, tile_comp->buf->get_ptr(0, 0, 0, 0),
+				tile_comp->area());
 	}
 
 	return true;
 }
 
+void TileProcessor::dc_level_shift_encode(uint32_t compno, int32_t *data,
+		uint64_t nb_elem) {
+	auto tccp = m_tcp->tccps + compno;
+	auto current_ptr = data;
+	if (tccp->qmfbid == 1) {
+		if (tccp->m_dc_level_shift == 0)
+			return;
+		for (uint64_t i = 0; i < nb_elem; ++i) {
+			*current_ptr -= tccp->m_dc_level_shift;
+			++current_ptr;
+		}
+	} else {
+		for (uint64_t i = 0; i < nb_elem; ++i) {
+			*current_ptr = (*current_ptr - tccp->m_dc_level_shift)
+					* (1 << 11);
+			++current_ptr;
+		}
+	}
+}
+
 bool TileProcessor::mct_encode() {
-	auto tile_comp = tile->comps;
-	uint64_t samples = tile_comp->area();
-	uint32_t i;
+	if (!m_tcp->mct)
+		return true;
+	std::vector<int32_t*> data(tile->numcomps);
+	for (uint32_t i = 0; i < tile->numcomps; ++i)
+		data[i] = tile->comps[i].buf->get_ptr(0, 0, 0, 0);
+
+	return mct_encode(data.data(), tile->comps->area());
+}
 
+bool TileProcessor::mct_encode(int32_t **data, uint64_t samples) {
 	if (!m_tcp->mct)
 		return true;
 	if (m_tcp->mct == 2) {
 		if (!m_tcp->m_mct_coding_matrix)
 			return true;
-		auto data = (uint8_t**) grk_malloc(tile->numcomps * sizeof(uint8_t*));
-		if (!data)
-			return false;
-		for (i = 0; i < tile->numcomps; ++i) {
-			data[i] = (uint8_t*) tile_comp->buf->get_ptr(0, 0, 0, 0);
-			++tile_comp;
-		}
-
 		if (!mct::encode_custom(/* MCT data */
 		(uint8_t*) m_tcp->m_mct_coding_matrix,
 		/* size of components */
 		samples,
 		/* components */
-		data,
+		(uint8_t**) data,
 		/* nb of components (i.e. size of pData) */
 		tile->numcomps,
 		/* tells if the data is signed */
 		image->comps->sgnd)) {
-			grok_free(data);
 			return false;
 		}
-
-		grok_free(data);
 	} else if (m_tcp->tccps->qmfbid == 0) {
-		mct::encode_irrev(tile->comps[0].buf->get_ptr(0, 0, 0, 0),
-				tile->comps[1].buf->get_ptr(0, 0, 0, 0),
-				tile->comps[2].buf->get_ptr(0, 0, 0, 0), samples);
+		mct::encode_irrev(data[0], data[1], data[2], samples);
 	} else {
-		mct::encode_rev(tile->comps[0].buf->get_ptr(0, 0, 0, 0),
-				tile->comps[1].buf->get_ptr(0, 0, 0, 0),
-				tile->comps[2].buf->get_ptr(0, 0, 0, 0), samples);
+		mct::encode_rev(data[0], data[1], data[2], samples);
 	}
 
 	return true;
@@ -1466,6 +1544,7 @@ bool TileProcessor::dwt_encode() {
 	for (compno = 0; compno < (int64_t) tile->numcomps; ++compno) {
 		auto tile_comp = tile->comps + compno;
 		auto tccp = m_tcp->tccps + compno;
+		tile_comp->buf->coeff16 = fits_coeff16(compno);
 		if (!Wavelet::compress(tile_comp, tccp->qmfbid)) {
 			rc = false;
 			continue;
@@ -1475,28 +1554,140 @@ bool TileProcessor::dwt_encode() {
 	return rc;
 }
 
-bool TileProcessor::t1_encode() {
-	const double *l_mct_norms;
-	uint32_t l_mct_numcomps = 0U;
-	auto l_tcp = m_tcp;
+bool TileProcessor::fits_coeff16(uint32_t compno) {
+	if (current_plugin_tile || m_tcp->tccps[compno].qmfbid != 1
+			|| m_tcp->mct > 1)
+		return false;
+	auto tilec = tile->comps + compno;
+	// RCT adds one bit to the chroma components
+	uint32_t bits = image->comps[compno].prec
+			+ ((m_tcp->mct == 1 && compno > 0 && compno < 3) ? 1 : 0);
+
+	return dwt_utils::fits_int16_53(bits, tilec->numresolutions);
+}
+
+bool TileProcessor::fits_fix16_97(uint32_t compno) {
+	// fixed point is only accurate enough for samples
+	// that are scaled down to 8 bits or less, and the irreversible
+	// colour transform would add up the errors of three components
+	uint32_t output_precision = m_cp->m_coding_param.m_dec.m_output_precision;
+	if (!output_precision || output_precision > 8 || current_plugin_tile
+			|| m_tcp->tccps[compno].qmfbid != 0 || m_tcp->mct != 0)
+		return false;
+	uint32_t prec = image->comps[compno].prec;
+
+	return prec && prec <= 13;
+}
+
+uint64_t TileProcessor::early_termination_length(uint64_t max_length) {
+	auto enc_params = &m_cp->m_coding_param.m_enc;
+	if (!enc_params->m_early_termination || !enc_params->m_disto_alloc
+			|| enc_params->m_fixed_quality || m_tcp->isHT)
+		return 0;
+	// a layer without target rate keeps all passes
+	for (uint32_t layno = 0; layno < m_tcp->numlayers; ++layno) {
+		if (!layer_needs_rate_control(layno))
+			return 0;
+	}
+
+	return std::min<uint64_t>(
+			(uint64_t) ceil(m_tcp->rates[m_tcp->numlayers - 1]), max_length);
+}
 
-	if (l_tcp->mct == 1) {
-		l_mct_numcomps = 3U;
+void TileProcessor::get_mct_norms(const double **mct_norms,
+		uint32_t *mct_numcomps) {
+	if (m_tcp->mct == 1) {
+		*mct_numcomps = 3U;
 		/* irreversible encoding */
-		if (l_tcp->tccps->qmfbid == 0) {
-			l_mct_norms = mct::get_norms_irrev();
+		if (m_tcp->tccps->qmfbid == 0) {
+			*mct_norms = mct::get_norms_irrev();
 		} else {
-			l_mct_norms = mct::get_norms_rev();
+			*mct_norms = mct::get_norms_rev();
 		}
 	} else {
-		l_mct_numcomps = image->numcomps;
-		l_mct_norms = (const double*) (l_tcp->mct_norms);
+		*mct_numcomps = image->numcomps;
+		*mct_norms = (const double*) (m_tcp->mct_norms);
 	}
+}
+
+bool TileProcessor::t1_encode(uint64_t target_length, T1EncodeStats *stats) {
+	const double *l_mct_norms;
+	uint32_t l_mct_numcomps = 0U;
+	get_mct_norms(&l_mct_norms, &l_mct_numcomps);
 
 	auto t1_wrap = std::unique_ptr<Tier1>(new Tier1());
 
-	return t1_wrap->encodeCodeblocks(l_tcp, tile, l_mct_norms, l_mct_numcomps,
-			needs_rate_control());
+	return t1_wrap->encodeCodeblocks(m_tcp, tile, l_mct_norms, l_mct_numcomps,
+			needs_rate_control(), target_length, &m_stop_slope, stats);
+}
+
+// number of image rows read from the strip read callback at a time
+const uint32_t strip_read_rows = 64;
+
+bool TileProcessor::strip_encode(void) {
+	auto enc = &m_cp->m_coding_param.m_enc;
+	const double *l_mct_norms;
+	uint32_t l_mct_numcomps = 0U;
+	get_mct_norms(&l_mct_norms, &l_mct_numcomps);
+	T1StripEncoder t1(m_tcp, tile, l_mct_norms, l_mct_numcomps,
+			needs_rate_control(), enc->m_t1_stats);
+	if (!t1.init())
+		return false;
+	// all passes are coded
+	m_stop_slope = 0;
+
+	std::vector<std::unique_ptr<WaveletStrip>> wavelets;
+	for (uint32_t compno = 0; compno < tile->numcomps; ++compno) {
+		auto wavelet = WaveletStrip::create(tile->comps + compno,
+				m_tcp->tccps[compno].qmfbid,
+				[&t1, compno](uint32_t resno, uint32_t band_index, uint32_t row,
+						const int32_t *data) {
+					return t1.push(compno, resno, band_index, row, data);
+				});
+		if (!wavelet) {
+			GROK_ERROR("Failed to create line based wavelet transform");
+			return false;
+		}
+		wavelets.emplace_back(wavelet);
+	}
+
+	uint32_t width = tile->comps->width();
+	uint32_t height = tile->comps->height();
+	// MCT needs aligned samples
+	std::vector<int32_t*> comp_rows(tile->numcomps);
+	bool rc = true;
+	for (uint32_t compno = 0; compno < tile->numcomps; ++compno) {
+		comp_rows[compno] = (int32_t*) grk_aligned_malloc(
+				(size_t) width * strip_read_rows * sizeof(int32_t));
+		if (!comp_rows[compno]) {
+			GROK_ERROR("Out of memory allocating strip");
+			rc = false;
+		}
+	}
+	for (uint32_t y = 0; y < height && rc; y += strip_read_rows) {
+		uint32_t num_rows = std::min<uint32_t>(strip_read_rows, height - y);
+		uint64_t samples = (uint64_t) width * num_rows;
+		if (!enc->m_strip_read_fn(y, num_rows, comp_rows.data(),
+				enc->m_strip_user_data)) {
+			GROK_ERROR("Failed to read strip at row %u", y);
+			rc = false;
+			break;
+		}
+		for (uint32_t compno = 0; compno < tile->numcomps; ++compno)
+			dc_level_shift_encode(compno, comp_rows[compno], samples);
+		if (!mct_encode(comp_rows.data(), samples)) {
+			rc = false;
+			break;
+		}
+		for (uint32_t k = 0; k < num_rows && rc; ++k) {
+			for (uint32_t compno = 0; compno < tile->numcomps && rc; ++compno)
+				rc = wavelets[compno]->push(comp_rows[compno] + (size_t) k * width);
+		}
+	}
+	for (auto &r : comp_rows)
+		grk_aligned_free(r);
+
+	return rc && t1.finish();
 }
 
 bool TileProcessor::t2_encode(BufferedStream *stream, uint64_t *p_data_written,
@@ -1657,9 +1848,6 @@ bool TileProcessor::copy_decompressed_tile_to_output_image(uint8_t *p_data,
 			}
 		}
 
-		/* Copy info from decoded comp image to output image */
-		img_comp_dest->resno_decoded = img_comp_src->resno_decoded;
-
 		/*-----*/
 		/* Compute the precision of the output buffer */
 		uint32_t size_comp = (img_comp_src->prec + 7) >> 3;
@@ -2061,6 +2249,22 @@ bool grk_tcd_cblk_enc::alloc_data(size_t nominalBlockSize) {
 	return true;
 }
 
+void grk_tcd_cblk_enc::compact() {
+	if (!owns_data || !actualData)
+		return;
+	uint32_t len = 0;
+	for (uint32_t i = 0; i < num_passes_encoded; ++i)
+		len = std::max<uint32_t>(len, passes[i].rate);
+	if (len >= data_size)
+		return;
+	auto new_data = new uint8_t[len + cblk_compressed_data_pad_left];
+	memcpy(new_data, actualData, len + cblk_compressed_data_pad_left);
+	delete[] actualData;
+	actualData = new_data;
+	data = actualData + cblk_compressed_data_pad_left;
+	data_size = len;
+}
+
 void grk_tcd_cblk_enc::cleanup() {
 	if (owns_data && actualData) {
 		delete[] actualData;
@@ -2133,6 +2337,8 @@ void grk_tcd_cblk_dec::cleanup() {
 	seg_buffers.cleanup();
 	delete[] segs;
 	segs = nullptr;
+	numSegments = 0;
+	numSegmentsAllocated = 0;
 #ifdef DEBUG_LOSSLESS_T2
 	delete packet_length_info;
 	packet_length_info = nullptr;
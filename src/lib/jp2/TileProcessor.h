@@ -136,6 +136,10 @@ struct grk_tcd_cblk_enc {
 	~grk_tcd_cblk_enc();
 	bool alloc();
 	bool alloc_data(size_t nominalBlockSize);
+	/**
+	 * Shrink data buffer to the compressed length of the encoded passes
+	 */
+	void compact();
 	void cleanup();
 	uint8_t *actualData;
 	uint8_t *data; /* data buffer*/
@@ -394,6 +398,23 @@ struct TileProcessor {
 	 */
 	bool decompress_tile(ChunkBuffer *src_buf, uint16_t tileno);
 
+	/**
+	 First stage of decompress_tile: set up the window of interest
+	 and parse the packets (T2) of a tile from a buffer
+	 @param src_buf Source buffer
+	 @param tileno Number that identifies one of the tiles to be decoded
+	 @return true if successful
+	 */
+	bool decompress_tile_t2(ChunkBuffer *src_buf, uint16_t tileno);
+
+	/**
+	 Second stage of decompress_tile: decode code blocks (T1),
+	 then apply inverse wavelet, inverse MCT and DC level shift.
+	 Must follow decompress_tile_t2 for the same tile.
+	 @return true if successful
+	 */
+	bool decompress_tile_t1(void);
+
 	/**
 	 * Copies tile data from the system onto the given memory block.
 	 */
@@ -492,6 +513,10 @@ private:
 	grk_tcp *m_tcp;
 	/** current encoded tile (not used for decompress) */
 	uint16_t m_tileno;
+	/** slope below which code blocks stopped coding, or zero if all passes were coded */
+	double m_stop_slope;
+	/** smallest slope threshold chosen by rate control */
+	double m_rate_control_slope;
 	/**
 	 * Initializes tile coding/decoding
 	 */
@@ -509,11 +534,63 @@ private:
 
 	 bool dc_level_shift_encode();
 
+	 /**
+	  * DC level shift samples of a component
+	  */
+	 void dc_level_shift_encode(uint32_t compno, int32_t *data,
+			 uint64_t nb_elem);
+
 	 bool mct_encode();
 
+	 /**
+	  * Forward MCT on samples of all components
+	  *
+	  * @param data		component samples
+	  * @param samples	number of samples per component
+	  */
+	 bool mct_encode(int32_t **data, uint64_t samples);
+
 	 bool dwt_encode();
 
-	 bool t1_encode();
+	 /**
+	  * Check if the reversible wavelet coefficients of a component
+	  * can be stored as 16 bit integers (see TileBuffer::coeff16)
+	  */
+	 bool fits_coeff16(uint32_t compno);
+
+	 /**
+	  * Check if the irreversible wavelet coefficients of a component
+	  * can be decoded as 16 bit fixed point (see dwt_utils::fix16_97_frac_bits)
+	  */
+	 bool fits_fix16_97(uint32_t compno);
+
+	 /**
+	  * Get MCT norms for code block distortion
+	  */
+	 void get_mct_norms(const double **mct_norms, uint32_t *mct_numcomps);
+
+	 /**
+	  * Read tile in strips from the strip read callback, and apply
+	  * DC level shift, MCT, DWT and T1 one strip at a time
+	  */
+	 bool strip_encode(void);
+
+	 /**
+	  * Encode code blocks
+	  *
+	  * @param target_length	if > 0, then coding passes that rate control is
+	  * 						estimated to discard, for a tile of this many bytes,
+	  * 						are not coded
+	  * @param stats			if not null, then code block statistics are added
+	  * 						to it
+	  */
+	 bool t1_encode(uint64_t target_length, T1EncodeStats *stats);
+
+	 /**
+	  * Get tile length for early termination of code blocks, or zero if
+	  * code blocks must be coded to the last pass
+	  */
+	 uint64_t early_termination_length(uint64_t max_length);
 
 	 bool t2_encode(BufferedStream *stream,
 			uint64_t *p_data_written, uint64_t max_dest_size,
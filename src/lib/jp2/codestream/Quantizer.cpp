@@ -104,6 +104,44 @@ void Quantizer::setBandStepSizeAndBps(grk_tcp *tcp,
 	}
 }
 
+uint32_t Quantizer::getSkippedBitplanes(grk_tccp *tccp,
+							grk_tcd_band *band,
+							uint32_t resno,
+							uint8_t bandno,
+							uint32_t numres,
+							uint32_t image_precision,
+							uint32_t discarded_bits,
+							bool mct){
+	// ROI shifted background is coded in the lowest bit planes
+	if (!discarded_bits || tccp->roishift)
+		return 0;
+	bool reversible = tccp->qmfbid == 1;
+	uint32_t gain = 0;
+	if (reversible) {
+		if (band->bandno == 0)
+			gain = 0;
+		else if (band->bandno < 3)
+			gain = 1;
+		else
+			gain = 2;
+	}
+	auto offset = (resno == 0) ? 0 : 3*resno - 2;
+	auto step_size = tccp->stepsizes + offset + bandno;
+	double stepsize = (1.0 + step_size->mant / 2048.0)
+			* pow(2.0, (int32_t) (image_precision + gain) - (int32_t)step_size->expn);
+	uint32_t level = numres - 1 - resno;
+	double norm = reversible ? dwt_utils::getnorm_53(level, band->bandno) :
+								dwt_utils::getnorm_97(level, band->bandno);
+
+	// skipping n bit planes leaves an error below 2^n steps in each coefficient
+	double budget = ldexp(1.0, (int32_t)discarded_bits - 2) / sqrt((double)(3 * numres - 2));
+	if (mct)
+		budget /= 2;
+	double planes = floor(log2(budget / (stepsize * norm)));
+
+	return planes > 0 ? (uint32_t)planes : 0;
+}
+
 void Quantizer::apply_quant(grk_tccp *src, grk_tccp *dest){
 	if (!src || !dest)
 		return;
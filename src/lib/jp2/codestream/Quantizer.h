@@ -98,6 +98,33 @@ public:
 								uint32_t image_precision,
 								float fraction);
 
+	/**
+	 * Get the number of least significant bit planes of a band's quantization
+	 * indices that are too small to change decompressed samples, once the
+	 * samples are scaled down by a number of bits.
+	 *
+	 * The error from skipping these bit planes, amplified by the inverse
+	 * wavelet, stays within a quarter of the lowest remaining sample bit,
+	 * shared evenly over all bands.
+	 *
+	 * @param tccp				tile component coding parameters
+	 * @param band				band
+	 * @param resno				resolution number
+	 * @param bandno			band number within resolution
+	 * @param numres			number of resolutions decompressed
+	 * @param image_precision	component precision
+	 * @param discarded_bits	number of least significant sample bits discarded
+	 * @param mct				true if a multiple component transform is applied
+	 */
+	static uint32_t getSkippedBitplanes(grk_tccp *tccp,
+								grk_tcd_band *band,
+								uint32_t resno,
+								uint8_t bandno,
+								uint32_t numres,
+								uint32_t image_precision,
+								uint32_t discarded_bits,
+								bool mct);
+
 
 	uint32_t get_SQcd_SQcc_size(grk_j2k *p_j2k, uint16_t tile_no,
 			uint32_t comp_no);
@@ -140,6 +140,8 @@ void j2k_destroy(grk_j2k *p_j2k) {
 
 	delete p_j2k->m_tileProcessor;
 
+	if (!p_j2k->m_is_decoder)
+		delete p_j2k->m_cp.m_coding_param.m_enc.m_t1_stats;
 	p_j2k->m_cp.destroy();
 	memset(&(p_j2k->m_cp), 0, sizeof(grk_coding_parameters));
 
@@ -386,6 +388,13 @@ void j2k_init_decompressor(void *j2k_void, grk_dparameters *parameters) {
 	if (j2k && parameters) {
 		j2k->m_cp.m_coding_param.m_dec.m_layer = parameters->cp_layer;
 		j2k->m_cp.m_coding_param.m_dec.m_reduce = parameters->cp_reduce;
+		j2k->m_cp.m_coding_param.m_dec.m_max_tiles_in_flight =
+				parameters->max_tiles_in_flight;
+		j2k->m_cp.m_coding_param.m_dec.m_output_precision =
+				parameters->output_precision;
+		j2k->m_cp.m_coding_param.m_dec.m_codeblock_cache =
+				(CodeblockCache*) parameters->codeblock_cache;
+		j2k->m_cp.m_coding_param.m_dec.m_blocked_dwt = parameters->blocked_dwt;
 	}
 }
 
@@ -979,6 +988,64 @@ bool j2k_read_tile_header(grk_j2k *p_j2k, uint16_t *tile_index,
 	return true;
 }
 
+static bool j2k_end_decompress_tile(grk_j2k *p_j2k, BufferedStream *stream) {
+	p_j2k->m_specific_param.m_decoder.ready_to_decode_tile_part_data = 0;
+	p_j2k->m_specific_param.m_decoder.m_state &=
+			(uint32_t) (~J2K_DEC_STATE_DATA);
+
+	// if there is no EOC marker and there is also no data left, then simply return true
+	if (stream->get_number_byte_left() == 0
+			&& p_j2k->m_specific_param.m_decoder.m_state
+					== J2K_DEC_STATE_NEOC) {
+		return true;
+	}
+	// if EOC marker has not been read yet, then try to read the next marker (should be EOC or SOT)
+	if (p_j2k->m_specific_param.m_decoder.m_state != J2K_DEC_STATE_EOC) {
+
+		uint8_t data[2];
+		// not enough data for another marker
+		if (stream->read(data, 2) != 2) {
+			GROK_WARN(
+					"j2k_decompress_tile: Not enough data to read another marker. Tile may be truncated.");
+			return true;
+		}
+
+		uint32_t current_marker = 0;
+		// read marker
+		grk_read<uint32_t>(data, &current_marker, 2);
+
+		switch (current_marker) {
+		// we found the EOC marker - set state accordingly and return true;
+		// we can ignore all data after EOC
+		case J2K_MS_EOC:
+			p_j2k->m_tileProcessor->m_current_tile_number = 0;
+			p_j2k->m_specific_param.m_decoder.m_state = J2K_DEC_STATE_EOC;
+			return true;
+			break;
+			// start of another tile
+		case J2K_MS_SOT:
+			return true;
+			break;
+		default: {
+			auto bytesLeft = stream->get_number_byte_left();
+			// no bytes left - file ends without EOC marker
+			if (bytesLeft == 0) {
+				p_j2k->m_specific_param.m_decoder.m_state =
+						J2K_DEC_STATE_NEOC;
+				GROK_WARN("Stream does not end with EOC");
+				return true;
+			}
+			GROK_WARN("Decode tile: expected EOC or SOT "
+					"but found unknown \"marker\" %x. ", current_marker);
+			throw DecodeUnknownMarkerAtEndOfTileException();
+		}
+			break;
+		}
+	}
+
+	return true;
+}
+
 bool j2k_decompress_tile(grk_j2k *p_j2k, uint16_t tile_index, uint8_t *p_data,
 		uint64_t data_size, BufferedStream *stream) {
 	assert(stream != nullptr);
@@ -1002,6 +1069,19 @@ bool j2k_decompress_tile(grk_j2k *p_j2k, uint16_t tile_index, uint8_t *p_data,
 		return false;
 	}
 
+	auto transcoder = p_j2k->m_cp.m_coding_param.m_dec.m_transcoder;
+	if (transcoder) {
+		if (!j2k_transcode_tile(transcoder, p_j2k, tile_index,
+				p_j2k->m_cp.m_coding_param.m_dec.m_transcode_stream)) {
+			p_j2k->m_specific_param.m_decoder.m_state |= J2K_DEC_STATE_ERR;
+			return false;
+		}
+		delete tcp->m_tile_data;
+		tcp->m_tile_data = nullptr;
+
+		return j2k_end_decompress_tile(p_j2k, stream);
+	}
+
 	if (!p_j2k->m_tileProcessor->current_plugin_tile
 			|| (p_j2k->m_tileProcessor->current_plugin_tile->decode_flags
 					& GRK_DECODE_POST_T1)) {
@@ -1035,59 +1115,7 @@ bool j2k_decompress_tile(grk_j2k *p_j2k, uint16_t tile_index, uint8_t *p_data,
 		delete tcp->m_tile_data;
 		tcp->m_tile_data = nullptr;
 
-		p_j2k->m_specific_param.m_decoder.ready_to_decode_tile_part_data = 0;
-		p_j2k->m_specific_param.m_decoder.m_state &=
-				(uint32_t) (~J2K_DEC_STATE_DATA);
-
-		// if there is no EOC marker and there is also no data left, then simply return true
-		if (stream->get_number_byte_left() == 0
-				&& p_j2k->m_specific_param.m_decoder.m_state
-						== J2K_DEC_STATE_NEOC) {
-			return true;
-		}
-		// if EOC marker has not been read yet, then try to read the next marker (should be EOC or SOT)
-		if (p_j2k->m_specific_param.m_decoder.m_state != J2K_DEC_STATE_EOC) {
-
-			uint8_t data[2];
-			// not enough data for another marker
-			if (stream->read(data, 2) != 2) {
-				GROK_WARN(
-						"j2k_decompress_tile: Not enough data to read another marker. Tile may be truncated.");
-				return true;
-			}
-
-			uint32_t current_marker = 0;
-			// read marker
-			grk_read<uint32_t>(data, &current_marker, 2);
-
-			switch (current_marker) {
-			// we found the EOC marker - set state accordingly and return true;
-			// we can ignore all data after EOC
-			case J2K_MS_EOC:
-				p_j2k->m_tileProcessor->m_current_tile_number = 0;
-				p_j2k->m_specific_param.m_decoder.m_state = J2K_DEC_STATE_EOC;
-				return true;
-				break;
-				// start of another tile
-			case J2K_MS_SOT:
-				return true;
-				break;
-			default: {
-				auto bytesLeft = stream->get_number_byte_left();
-				// no bytes left - file ends without EOC marker
-				if (bytesLeft == 0) {
-					p_j2k->m_specific_param.m_decoder.m_state =
-							J2K_DEC_STATE_NEOC;
-					GROK_WARN("Stream does not end with EOC");
-					return true;
-				}
-				GROK_WARN("Decode tile: expected EOC or SOT "
-						"but found unknown \"marker\" %x. ", current_marker);
-				throw DecodeUnknownMarkerAtEndOfTileException();
-			}
-				break;
-			}
-		}
+		return j2k_end_decompress_tile(p_j2k, stream);
 	}
 
 	return true;
@@ -1099,6 +1127,14 @@ bool j2k_set_decompress_area(grk_j2k *p_j2k, grk_image *output_image,
 			start_y, end_x, end_y);
 }
 
+void j2k_set_decompress_callback(grk_j2k *p_j2k,
+		grk_decompress_callback callback, void *user_data,
+		const std::atomic<bool> *cancel) {
+	p_j2k->m_tile_callback = callback;
+	p_j2k->m_tile_callback_data = user_data;
+	p_j2k->m_cp.m_coding_param.m_dec.m_cancel = cancel;
+}
+
 grk_j2k* j2k_create_decompress(void) {
 	grk_j2k *j2k = (grk_j2k*) grk_calloc(1, sizeof(grk_j2k));
 	if (!j2k) {
@@ -1136,6 +1172,330 @@ grk_j2k* j2k_create_decompress(void) {
 	return j2k;
 }
 
+/**
+ * Tile decompressed concurrently with other tiles.
+ * Owns its tile processor, a private image header (so that
+ * resno_decoded is tracked per tile) and its tile data.
+ */
+struct j2k_tile_job {
+	j2k_tile_job() :
+			tileProcessor(nullptr), tile_image(nullptr), tile_data(nullptr),
+			data(nullptr), data_size(0), tile_no(0) {
+	}
+	~j2k_tile_job() {
+		release();
+		grk_image_destroy(tile_image);
+	}
+	// release everything but the tile image header
+	void release(void) {
+		delete tileProcessor;
+		tileProcessor = nullptr;
+		delete tile_data;
+		tile_data = nullptr;
+		grok_free(data);
+		data = nullptr;
+	}
+	TileProcessor *tileProcessor;
+	grk_image *tile_image;
+	ChunkBuffer *tile_data;
+	uint8_t *data;
+	uint64_t data_size;
+	uint16_t tile_no;
+	std::future<bool> result;
+};
+
+static void j2k_copy_resno_decoded(grk_image *src, grk_image *dest) {
+	for (uint32_t compno = 0; compno < dest->numcomps; ++compno)
+		dest->comps[compno].resno_decoded = src->comps[compno].resno_decoded;
+}
+
+static bool j2k_decompress_cancelled(grk_j2k *p_j2k) {
+	auto cancel = p_j2k->m_cp.m_coding_param.m_dec.m_cancel;
+	if (cancel && *cancel) {
+		GROK_WARN("Decompression cancelled");
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Create an image holding the region of the output image covered by a tile:
+ * the tile bounds clipped to the output image, with a copy of the samples
+ * of that region
+ */
+static grk_image* j2k_create_tile_image(grk_j2k *p_j2k, uint16_t tile_no) {
+	auto cp = &p_j2k->m_cp;
+	auto output_image = p_j2k->m_output_image;
+	uint32_t reduce = cp->m_coding_param.m_dec.m_reduce;
+	uint32_t p = tile_no % cp->t_grid_width;
+	uint32_t q = tile_no / cp->t_grid_width;
+	uint32_t tx0 = cp->tx0 + p * cp->t_width;
+	uint32_t ty0 = cp->ty0 + q * cp->t_height;
+	uint32_t x0 = std::max<uint32_t>(tx0, output_image->x0);
+	uint32_t y0 = std::max<uint32_t>(ty0, output_image->y0);
+	uint32_t x1 = std::min<uint32_t>(uint_adds(tx0, cp->t_width),
+			output_image->x1);
+	uint32_t y1 = std::min<uint32_t>(uint_adds(ty0, cp->t_height),
+			output_image->y1);
+	if (x1 <= x0 || y1 <= y0)
+		return nullptr;
+	auto image = grk_image_create0();
+	if (!image)
+		return nullptr;
+	grk_copy_image_header(output_image, image);
+	if (!image->comps) {
+		grk_image_destroy(image);
+		return nullptr;
+	}
+	image->x0 = x0;
+	image->y0 = y0;
+	image->x1 = x1;
+	image->y1 = y1;
+	for (uint32_t compno = 0; compno < image->numcomps; ++compno) {
+		auto src = output_image->comps + compno;
+		auto dest = image->comps + compno;
+		dest->owns_data = false;
+		// bounds of the output component and of the tile region,
+		// at the decoded resolution
+		uint32_t src_x0 = uint_ceildivpow2(src->x0, reduce);
+		uint32_t src_y0 = uint_ceildivpow2(src->y0, reduce);
+		dest->x0 = ceildiv<uint32_t>(x0, dest->dx);
+		dest->y0 = ceildiv<uint32_t>(y0, dest->dy);
+		uint32_t dest_x0 = std::max<uint32_t>(
+				uint_ceildivpow2(dest->x0, reduce), src_x0);
+		uint32_t dest_y0 = std::max<uint32_t>(
+				uint_ceildivpow2(dest->y0, reduce), src_y0);
+		uint32_t dest_x1 = std::min<uint32_t>(
+				uint_ceildivpow2(ceildiv<uint32_t>(x1, dest->dx), reduce),
+				src_x0 + src->w);
+		uint32_t dest_y1 = std::min<uint32_t>(
+				uint_ceildivpow2(ceildiv<uint32_t>(y1, dest->dy), reduce),
+				src_y0 + src->h);
+		dest->w = dest_x1 > dest_x0 ? dest_x1 - dest_x0 : 0;
+		dest->h = dest_y1 > dest_y0 ? dest_y1 - dest_y0 : 0;
+		if (!src->data || !dest->w || !dest->h)
+			continue;
+		if (!grk_image_single_component_data_alloc(dest)) {
+			grk_image_destroy(image);
+			return nullptr;
+		}
+		auto src_ptr = src->data + (size_t) (dest_y0 - src_y0) * src->w
+				+ (dest_x0 - src_x0);
+		auto dest_ptr = dest->data;
+		for (uint32_t j = 0; j < dest->h; ++j) {
+			memcpy(dest_ptr, src_ptr, dest->w * sizeof(int32_t));
+			src_ptr += src->w;
+			dest_ptr += dest->w;
+		}
+	}
+
+	return image;
+}
+
+static void j2k_tile_decompressed(grk_j2k *p_j2k, uint16_t tile_no) {
+	if (!p_j2k->m_tile_callback)
+		return;
+	auto image = j2k_create_tile_image(p_j2k, tile_no);
+	if (!image) {
+		GROK_WARN("Unable to create image of tile %d", tile_no + 1);
+		return;
+	}
+	p_j2k->m_tile_callback(tile_no, image, p_j2k->m_tile_callback_data);
+	grk_image_destroy(image);
+}
+
+/**
+ * Copy the tile part header parsing state, and the decompress window mode,
+ * from one tile processor to another
+ */
+static void j2k_copy_tile_header_state(TileProcessor *src,
+		TileProcessor *dest) {
+	dest->m_tile_ind_to_dec = src->m_tile_ind_to_dec;
+	dest->m_current_tile_number = src->m_current_tile_number;
+	dest->m_nb_tile_parts_correction_checked =
+			src->m_nb_tile_parts_correction_checked;
+	dest->m_nb_tile_parts_correction = src->m_nb_tile_parts_correction;
+	dest->tile_part_data_length = src->tile_part_data_length;
+	dest->whole_tile_decoding = src->whole_tile_decoding;
+}
+
+static bool j2k_decompress_tile_job(j2k_tile_job *job,
+		grk_image *output_image) {
+	auto tileProcessor = job->tileProcessor;
+	bool rc = tileProcessor->decompress_tile_t1()
+			&& tileProcessor->update_tile_data(job->data, job->data_size)
+			&& tileProcessor->copy_decompressed_tile_to_output_image(job->data,
+					output_image, true);
+	// free tile memory as soon as possible
+	job->release();
+
+	return rc;
+}
+
+/**
+ * Read the tiles, and decompress up to max_tiles_in_flight tiles concurrently.
+ *
+ * Tile headers and packets (T2) are parsed serially on the calling thread,
+ * each tile into its own TileProcessor. Code blocks of the tile are then
+ * decoded (T1), inverse transformed and copied into the output image
+ * on the thread pool, so that T2 of the next tile overlaps T1 of the
+ * tiles in flight. Tiles are retired in code stream order,
+ * so the output is identical to the serial path.
+ */
+static bool j2k_decompress_tiles_concurrent(grk_j2k *p_j2k,
+		BufferedStream *stream, uint32_t max_tiles_in_flight) {
+	uint32_t num_tiles_to_decode = p_j2k->m_cp.t_grid_height * p_j2k->m_cp.t_grid_width;
+	auto output_image = p_j2k->m_output_image;
+	auto header_processor = p_j2k->m_tileProcessor;
+
+	// allocate output image up front, so tiles can be copied concurrently
+	for (uint32_t compno = 0; compno < output_image->numcomps; ++compno) {
+		auto comp = output_image->comps + compno;
+		if (comp->data || comp->w * comp->h == 0)
+			continue;
+		if (!grk_image_single_component_data_alloc(comp)) {
+			GROK_ERROR("Not enough memory to decompress tiles");
+			return false;
+		}
+		memset(comp->data, 0, (size_t)comp->w * comp->h * sizeof(int32_t));
+	}
+
+	std::deque<j2k_tile_job*> jobs;
+	bool success = true;
+	uint32_t num_tiles_decoded = 0;
+	auto retire = [&jobs, &success, &num_tiles_decoded, p_j2k, output_image,
+				   num_tiles_to_decode]() {
+		auto job = jobs.front();
+		jobs.pop_front();
+		// may run inside a pool task, so help out while waiting
+		ThreadPool::get()->wait(job->result);
+		if (job->result.get()) {
+			j2k_copy_resno_decoded(job->tile_image, output_image);
+			num_tiles_decoded++;
+			j2k_tile_decompressed(p_j2k, job->tile_no);
+		} else {
+			p_j2k->m_specific_param.m_decoder.m_state |= J2K_DEC_STATE_ERR;
+			if (!j2k_decompress_cancelled(p_j2k))
+				GROK_ERROR("Failed to decompress tile %d/%d", job->tile_no + 1,
+						num_tiles_to_decode);
+			success = false;
+		}
+		delete job;
+	};
+
+	for (uint32_t nr_tiles = 0; nr_tiles < num_tiles_to_decode && success;
+			nr_tiles++) {
+		if (j2k_decompress_cancelled(p_j2k)) {
+			success = false;
+			break;
+		}
+		// bound memory by retiring the oldest tile
+		if (jobs.size() == max_tiles_in_flight) {
+			retire();
+			if (!success)
+				break;
+		}
+		auto job = new j2k_tile_job();
+		job->tile_image = grk_image_create0();
+		if (!job->tile_image) {
+			delete job;
+			success = false;
+			break;
+		}
+		grk_copy_image_header(p_j2k->m_private_image, job->tile_image);
+		job->tileProcessor = new TileProcessor(true);
+		if (!job->tileProcessor->init(job->tile_image, &p_j2k->m_cp)) {
+			delete job;
+			success = false;
+			break;
+		}
+		j2k_copy_tile_header_state(header_processor, job->tileProcessor);
+
+		// parse tile part headers into this tile's processor
+		p_j2k->m_tileProcessor = job->tileProcessor;
+		uint32_t tile_x0 = 0, tile_y0 = 0, tile_x1 = 0, tile_y1 = 0;
+		uint32_t nb_comps = 0;
+		uint16_t tile_no = 0;
+		uint64_t data_size = 0;
+		bool go_on = true;
+		if (!j2k_read_tile_header(p_j2k, &tile_no, &data_size, &tile_x0,
+				&tile_y0, &tile_x1, &tile_y1, &nb_comps, &go_on, stream)) {
+			success = false;
+		} else if (go_on) {
+			auto tcp = p_j2k->m_cp.tcps + tile_no;
+			if (!tcp->m_tile_data) {
+				j2k_tcp_destroy(tcp);
+				success = false;
+			} else {
+				// take ownership of tile data
+				job->tile_data = tcp->m_tile_data;
+				tcp->m_tile_data = nullptr;
+				job->tile_no = tile_no;
+				job->data_size = data_size;
+				job->data = (uint8_t*) grk_malloc(data_size ? data_size : 1);
+				if (!job->data) {
+					GROK_ERROR("Not enough memory to decompress tile %d/%d",
+							tile_no + 1, num_tiles_to_decode);
+					success = false;
+				}
+			}
+			if (success) {
+				try {
+					if (!j2k_end_decompress_tile(p_j2k, stream))
+						success = false;
+				} catch (DecodeUnknownMarkerAtEndOfTileException &e) {
+					// only worry about exception if we have more tiles to decompress
+					if (nr_tiles < num_tiles_to_decode - 1) {
+						GROK_ERROR("Stream too short, expected SOT");
+						success = false;
+					}
+				}
+			}
+		}
+		j2k_copy_tile_header_state(job->tileProcessor, header_processor);
+		p_j2k->m_tileProcessor = header_processor;
+		if (!success || !go_on) {
+			delete job;
+			break;
+		}
+
+		// parse this tile's packets while the pool decodes code blocks
+		// of the tiles already in flight
+		if (!job->tileProcessor->decompress_tile_t2(job->tile_data,
+				job->tile_no)) {
+			p_j2k->m_specific_param.m_decoder.m_state |= J2K_DEC_STATE_ERR;
+			GROK_ERROR("Failed to decompress tile %d/%d", job->tile_no + 1,
+					num_tiles_to_decode);
+			delete job;
+			success = false;
+			break;
+		}
+		job->result = ThreadPool::get()->enqueue([job, output_image] {
+			return j2k_decompress_tile_job(job, output_image);
+		});
+		jobs.push_back(job);
+
+		if (stream->get_number_byte_left() == 0
+				&& p_j2k->m_specific_param.m_decoder.m_state
+						== J2K_DEC_STATE_NEOC)
+			break;
+	}
+	while (!jobs.empty())
+		retire();
+	if (!success)
+		return false;
+
+	if (num_tiles_decoded == 0) {
+		GROK_ERROR("No tiles were decoded. Exiting");
+		return false;
+	} else if (num_tiles_decoded < num_tiles_to_decode) {
+		GROK_WARN("Only %d out of %d tiles were decoded", num_tiles_decoded,
+				num_tiles_to_decode);
+		return true;
+	}
+	return true;
+}
+
 static bool j2k_decompress_tiles(grk_j2k *p_j2k, BufferedStream *stream) {
 	bool go_on = true;
 	uint16_t current_tile_no = 0;
@@ -1145,8 +1505,16 @@ static bool j2k_decompress_tiles(grk_j2k *p_j2k, BufferedStream *stream) {
 	uint32_t nr_tiles = 0;
 	uint32_t num_tiles_to_decode = p_j2k->m_cp.t_grid_height * p_j2k->m_cp.t_grid_width;
 	bool clearOutputOnInit = false;
+	uint32_t max_tiles_in_flight =
+			p_j2k->m_cp.m_coding_param.m_dec.m_max_tiles_in_flight;
+	// transcoded tiles are compressed as they are decoded, in order
+	bool transcode = p_j2k->m_cp.m_coding_param.m_dec.m_transcoder != nullptr;
+	if (num_tiles_to_decode > 1 && max_tiles_in_flight > 1
+			&& !p_j2k->m_tileProcessor->current_plugin_tile && !transcode)
+		return j2k_decompress_tiles_concurrent(p_j2k, stream,
+				max_tiles_in_flight);
 	// if number of tiles is greater than 1, then we need to copy tile data
-	if (num_tiles_to_decode > 1) {
+	if (num_tiles_to_decode > 1 && !transcode) {
 		current_data = (uint8_t*) grk_malloc(1);
 		if (!current_data) {
 			GROK_ERROR("Not enough memory to decompress tiles");
@@ -1158,6 +1526,11 @@ static bool j2k_decompress_tiles(grk_j2k *p_j2k, BufferedStream *stream) {
 	uint32_t num_tiles_decoded = 0;
 
 	for (nr_tiles = 0; nr_tiles < num_tiles_to_decode; nr_tiles++) {
+		if (j2k_decompress_cancelled(p_j2k)) {
+			if (current_data)
+				grok_free(current_data);
+			return false;
+		}
 		uint32_t tile_x0, tile_y0, tile_x1, tile_y1;
 		tile_x0 = tile_y0 = tile_x1 = tile_y1 = 0;
 		if (!j2k_read_tile_header(p_j2k, &current_tile_no, &data_size, &tile_x0,
@@ -1189,8 +1562,9 @@ static bool j2k_decompress_tiles(grk_j2k *p_j2k, BufferedStream *stream) {
 					data_size, stream)) {
 				if (current_data)
 					grok_free(current_data);
-				GROK_ERROR("Failed to decompress tile %d/%d", current_tile_no + 1,
-						num_tiles_to_decode);
+				if (!j2k_decompress_cancelled(p_j2k))
+					GROK_ERROR("Failed to decompress tile %d/%d",
+							current_tile_no + 1, num_tiles_to_decode);
 				return false;
 			}
 		} catch (DecodeUnknownMarkerAtEndOfTileException &e) {
@@ -1213,10 +1587,13 @@ static bool j2k_decompress_tiles(grk_j2k *p_j2k, BufferedStream *stream) {
 				grok_free(current_data);
 				return false;
 			}
+			j2k_copy_resno_decoded(p_j2k->m_tileProcessor->image,
+					p_j2k->m_output_image);
 			// event_msg( EVT_INFO, "Image data has been updated with tile %d.\n", current_tile_no + 1);
 		}
 
 		num_tiles_decoded++;
+		j2k_tile_decompressed(p_j2k, current_tile_no);
 
 		if (stream->get_number_byte_left() == 0
 				&& p_j2k->m_specific_param.m_decoder.m_state
@@ -1297,6 +1674,11 @@ static bool j2k_decompress_tile(grk_j2k *p_j2k, BufferedStream *stream) {
 		}
 
 	for (;;) {
+		if (j2k_decompress_cancelled(p_j2k)) {
+			if (current_data)
+				grok_free(current_data);
+			return false;
+		}
 		if (!j2k_read_tile_header(p_j2k, &current_tile_no, &data_size, &tile_x0,
 				&tile_y0, &tile_x1, &tile_y1, &nb_comps, &go_on, stream)) {
 			if (current_data)
@@ -1340,9 +1722,12 @@ static bool j2k_decompress_tile(grk_j2k *p_j2k, BufferedStream *stream) {
 				grok_free(current_data);
 				return false;
 			}
+			j2k_copy_resno_decoded(p_j2k->m_tileProcessor->image,
+					p_j2k->m_output_image);
 		}
 		//event_msg( EVT_INFO, "Image data has been updated with tile %d.\n", current_tile_no+1);
 		if (current_tile_no == tile_no_to_dec) {
+			j2k_tile_decompressed(p_j2k, current_tile_no);
 			/* move into the code stream to the first SOT (FIXME or not move?)*/
 			if (!(stream->seek(p_j2k->cstr_index->main_head_end + 2))) {
 				GROK_ERROR("Problem with seek function");
@@ -1404,6 +1789,112 @@ bool j2k_decompress(grk_j2k *p_j2k, grk_plugin_tile *tile, BufferedStream *strea
 	return true;
 }
 
+static bool j2k_transcode_style_equals(const grk_tccp *tccp0,
+		const grk_tccp *tccp1) {
+	if (tccp0->numresolutions != tccp1->numresolutions
+			|| tccp0->cblkw != tccp1->cblkw || tccp0->cblkh != tccp1->cblkh
+			|| tccp0->qmfbid != tccp1->qmfbid
+			|| tccp0->roishift != tccp1->roishift
+			|| (tccp0->csty & J2K_CCP_CSTY_PRT)
+					!= (tccp1->csty & J2K_CCP_CSTY_PRT))
+		return false;
+	if (tccp0->csty & J2K_CCP_CSTY_PRT) {
+		for (uint32_t resno = 0; resno < tccp0->numresolutions; ++resno) {
+			if (tccp0->prcw[resno] != tccp1->prcw[resno]
+					|| tccp0->prch[resno] != tccp1->prch[resno])
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool j2k_init_transcode(grk_j2k *p_j2k, grk_cparameters *parameters) {
+	auto cp = &p_j2k->m_cp;
+	auto image = p_j2k->m_private_image;
+	auto tcp = p_j2k->m_specific_param.m_decoder.m_default_tcp;
+	if (!image || !tcp) {
+		GROK_ERROR("Main header must be read before transcoding");
+		return false;
+	}
+	auto tccp0 = tcp->tccps;
+	if (tcp->mct == 2) {
+		GROK_ERROR("Custom multiple component transforms cannot be transcoded");
+		return false;
+	}
+	for (uint32_t compno = 0; compno < image->numcomps; ++compno) {
+		auto tccp = tcp->tccps + compno;
+		if (tccp->qmfbid != 1) {
+			GROK_ERROR("Only lossless code streams can be transcoded");
+			return false;
+		}
+		if (tccp->cblk_sty & GRK_CBLKSTY_HT) {
+			GROK_ERROR("Code stream is already HTJ2K");
+			return false;
+		}
+		if (tccp->roishift) {
+			GROK_ERROR("Code streams with a region of interest cannot be transcoded");
+			return false;
+		}
+		if (!j2k_transcode_style_equals(tccp0, tccp)) {
+			GROK_ERROR("Components with different coding styles cannot be transcoded");
+			return false;
+		}
+	}
+
+	// the tile grid, the number of resolutions and MCT determine the
+	// wavelet coefficients; the other settings are carried over as they are
+	parameters->tile_size_on = true;
+	parameters->tx0 = cp->tx0;
+	parameters->ty0 = cp->ty0;
+	parameters->t_width = cp->t_width;
+	parameters->t_height = cp->t_height;
+	parameters->numresolution = tccp0->numresolutions;
+	parameters->cblockw_init = 1U << tccp0->cblkw;
+	parameters->cblockh_init = 1U << tccp0->cblkh;
+	parameters->csty = (uint8_t) tcp->csty;
+	if (tccp0->csty & J2K_CCP_CSTY_PRT) {
+		parameters->res_spec = tccp0->numresolutions;
+		for (uint32_t p = 0; p < tccp0->numresolutions; ++p) {
+			uint32_t resno = tccp0->numresolutions - 1 - p;
+			parameters->prcw_init[p] = 1U << tccp0->prcw[resno];
+			parameters->prch_init[p] = 1U << tccp0->prch[resno];
+		}
+	}
+	parameters->prog_order = tcp->prg;
+	parameters->tcp_mct = (uint8_t) tcp->mct;
+	parameters->irreversible = false;
+	parameters->cblk_sty = GRK_CBLKSTY_HT;
+	parameters->isHT = true;
+
+	return true;
+}
+
+bool j2k_transcode(grk_j2k *p_j2k, BufferedStream *stream, grk_image *p_image,
+		grk_j2k *dest, BufferedStream *dest_stream) {
+	auto dec = &p_j2k->m_cp.m_coding_param.m_dec;
+	if (dec->m_reduce || dec->m_layer || dec->m_output_precision) {
+		GROK_ERROR("All resolutions, layers and bit planes must be decoded for transcoding");
+		return false;
+	}
+	dec->m_transcoder = dest;
+	dec->m_transcode_stream = dest_stream;
+	dest->m_cp.m_coding_param.m_enc.m_transcode = true;
+	bool rc = j2k_decompress(p_j2k, nullptr, stream, p_image);
+	dec->m_transcoder = nullptr;
+	dec->m_transcode_stream = nullptr;
+	if (!rc)
+		return false;
+	uint32_t num_tiles = dest->m_cp.t_grid_width * dest->m_cp.t_grid_height;
+	if (dest->m_tileProcessor->m_current_tile_number != num_tiles) {
+		GROK_ERROR("Only %d out of %d tiles were transcoded",
+				dest->m_tileProcessor->m_current_tile_number, num_tiles);
+		return false;
+	}
+
+	return true;
+}
+
 bool j2k_get_tile(grk_j2k *p_j2k, BufferedStream *stream, grk_image *p_image,
 		uint16_t tile_index) {
 	uint32_t compno;
@@ -1780,6 +2271,12 @@ bool j2k_init_compress(grk_j2k *p_j2k, grk_cparameters *parameters,
 			& 1u;
 	cp->m_coding_param.m_enc.rateControlAlgorithm =
 			parameters->rateControlAlgorithm;
+	cp->m_coding_param.m_enc.m_max_tiles_in_flight =
+			parameters->max_tiles_in_flight;
+	cp->m_coding_param.m_enc.m_early_termination =
+			parameters->early_termination;
+	if (!cp->m_coding_param.m_enc.m_t1_stats)
+		cp->m_coding_param.m_enc.m_t1_stats = new T1EncodeStats();
 
 	/* tiles */
 	cp->t_width = parameters->t_width;
@@ -2102,6 +2599,11 @@ bool j2k_compress(grk_j2k *p_j2k, grk_plugin_tile *tile,
 				"allowed by the standard.", nb_tiles, max_num_tiles);
 		return false;
 	}
+	uint32_t max_tiles_in_flight =
+			p_j2k->m_cp.m_coding_param.m_enc.m_max_tiles_in_flight;
+	if (nb_tiles > 1 && max_tiles_in_flight > 1 && !tile)
+		return j2k_compress_tiles_concurrent(p_j2k, stream,
+				max_tiles_in_flight);
 	if (nb_tiles == 1) {
 		transfer_image_to_tile = true;
 #ifdef __SSE__
@@ -2114,7 +2616,7 @@ bool j2k_compress(grk_j2k *p_j2k, grk_plugin_tile *tile,
 #endif
 	}
 	for (i = 0; i < nb_tiles; ++i) {
-		if (!j2k_pre_write_tile(p_j2k, i)) {
+		if (!j2k_pre_write_tile(p_j2k, p_tcd, i)) {
 			return false;
 		}
 
@@ -2134,12 +2636,172 @@ bool j2k_compress(grk_j2k *p_j2k, grk_plugin_tile *tile,
 		}
 		if (!transfer_image_to_tile)
 			p_j2k->m_tileProcessor->copy_image_to_tile();
-		if (!j2k_post_write_tile(p_j2k, stream))
+		if (!j2k_post_write_tile(p_j2k, p_tcd, stream))
 			return false;
 	}
 	return true;
 }
 
+bool j2k_compress_strips(grk_j2k *p_j2k, grk_strip_read_fn fn,
+		void *user_data, BufferedStream *stream) {
+	assert(p_j2k != nullptr);
+	assert(stream != nullptr);
+
+	auto p_tcd = p_j2k->m_tileProcessor;
+	auto image = p_tcd->image;
+	auto enc = &p_j2k->m_cp.m_coding_param.m_enc;
+	if (p_j2k->m_cp.t_grid_width * p_j2k->m_cp.t_grid_height != 1) {
+		GROK_ERROR("Strip compression needs an image with a single tile");
+		return false;
+	}
+	if (enc->m_transcode) {
+		GROK_ERROR("Strip compression can not be combined with transcoding");
+		return false;
+	}
+	for (uint32_t compno = 1; compno < image->numcomps; ++compno) {
+		auto comp = image->comps + compno;
+		if (comp->w != image->comps->w || comp->h != image->comps->h) {
+			GROK_ERROR("Strip compression needs components of equal dimensions");
+			return false;
+		}
+	}
+	p_tcd->current_plugin_tile = nullptr;
+	enc->m_strip_read_fn = fn;
+	enc->m_strip_user_data = user_data;
+	bool rc = j2k_pre_write_tile(p_j2k, p_tcd, 0)
+			&& j2k_post_write_tile(p_j2k, p_tcd, stream);
+	enc->m_strip_read_fn = nullptr;
+	enc->m_strip_user_data = nullptr;
+
+	return rc;
+}
+
+/**
+ * Tile compressed concurrently with other tiles.
+ * Owns its tile processor, and a memory stream holding
+ * the tile's compressed tile parts.
+ */
+struct j2k_compress_job {
+	j2k_compress_job() :
+			tileProcessor(nullptr), stream(nullptr), tile_no(0) {
+	}
+	~j2k_compress_job() {
+		release();
+		delete stream;
+	}
+	// release everything but the compressed tile parts
+	void release(void) {
+		delete tileProcessor;
+		tileProcessor = nullptr;
+	}
+	TileProcessor *tileProcessor;
+	BufferedStream *stream;
+	uint16_t tile_no;
+	std::future<bool> result;
+};
+
+static bool j2k_compress_tile_job(grk_j2k *p_j2k, j2k_compress_job *job) {
+	auto tileProcessor = job->tileProcessor;
+	bool rc = j2k_pre_write_tile(p_j2k, tileProcessor, job->tile_no);
+	for (uint32_t j = 0; rc && j < tileProcessor->image->numcomps; ++j) {
+		auto tilec = tileProcessor->tile->comps + j;
+		if (!tilec->buf->alloc_component_data_encode()) {
+			GROK_ERROR("Error allocating tile component data.");
+			rc = false;
+		}
+	}
+	if (rc) {
+		tileProcessor->copy_image_to_tile();
+		rc = j2k_post_write_tile(p_j2k, tileProcessor, job->stream);
+	}
+	// free tile memory as soon as possible
+	job->release();
+
+	return rc;
+}
+
+/**
+ * Compress up to max_tiles_in_flight tiles concurrently.
+ *
+ * Each tile is compressed on the thread pool by its own TileProcessor,
+ * and its tile parts are written to a memory stream. Tiles are retired
+ * in tile order by appending their tile parts to the code stream,
+ * so the code stream is identical to the serial path.
+ */
+static bool j2k_compress_tiles_concurrent(grk_j2k *p_j2k,
+		BufferedStream *stream, uint32_t max_tiles_in_flight) {
+	auto cp = &p_j2k->m_cp;
+	uint32_t nb_tiles = cp->t_grid_height * cp->t_grid_width;
+	auto header_processor = p_j2k->m_tileProcessor;
+	// TLM entries are written in tile order, so each tile can
+	// fill in its own slice of the TLM buffer
+	auto tlm_current = header_processor->m_tlm_sot_offsets_current;
+
+	std::deque<j2k_compress_job*> jobs;
+	bool success = true;
+	auto retire = [&jobs, &success, stream, nb_tiles]() {
+		auto job = jobs.front();
+		jobs.pop_front();
+		if (job->result.get()) {
+			size_t len = 0;
+			auto data = get_growable_mem_stream_data((grk_stream*) job->stream,
+					&len);
+			if (success && (!data || stream->write_bytes(data, len) != len))
+				success = false;
+		} else {
+			GROK_ERROR("Failed to compress tile %d/%d", job->tile_no + 1,
+					nb_tiles);
+			success = false;
+		}
+		delete job;
+	};
+
+	for (uint32_t i = 0; i < nb_tiles && success; ++i) {
+		// bound memory by retiring the oldest tile
+		if (jobs.size() == max_tiles_in_flight) {
+			retire();
+			if (!success)
+				break;
+		}
+		auto job = new j2k_compress_job();
+		job->tile_no = (uint16_t) i;
+		job->stream = (BufferedStream*) create_growable_mem_stream();
+		job->tileProcessor = new TileProcessor(false);
+		if (!job->stream
+				|| !job->tileProcessor->init(p_j2k->m_private_image, cp)) {
+			delete job;
+			success = false;
+			break;
+		}
+		job->tileProcessor->m_current_tile_number = job->tile_no;
+		// lay out tile parts exactly as the serial path does
+		job->tileProcessor->tp_pos = header_processor->tp_pos;
+		job->tileProcessor->m_tlm_sot_offsets_current = tlm_current;
+		if (tlm_current)
+			tlm_current += tlm_len_per_tile_part * cp->tcps[i].m_nb_tile_parts;
+
+		job->result = ThreadPool::get()->enqueue([p_j2k, job] {
+			return j2k_compress_tile_job(p_j2k, job);
+		});
+		jobs.push_back(job);
+	}
+	while (!jobs.empty())
+		retire();
+	header_processor->m_current_tile_number = (uint16_t) nb_tiles;
+	header_processor->m_tlm_sot_offsets_current = tlm_current;
+
+	return success;
+}
+
+uint32_t j2k_get_t1_encode_stats(grk_j2k *p_j2k, grk_t1_thread_stats *stats,
+		uint32_t num_threads) {
+	auto t1_stats = p_j2k->m_cp.m_coding_param.m_enc.m_t1_stats;
+	if (!t1_stats)
+		return 0;
+
+	return t1_stats->get(stats, num_threads);
+}
+
 bool j2k_end_compress(grk_j2k *p_j2k, BufferedStream *stream) {
 	/* customization of the encoding */
 	if (!j2k_init_end_compress(p_j2k)) {
@@ -2180,27 +2842,31 @@ bool j2k_start_compress(grk_j2k *p_j2k, BufferedStream *stream) {
 	return true;
 }
 
-static bool j2k_pre_write_tile(grk_j2k *p_j2k, uint16_t tile_index) {
-	if (tile_index != p_j2k->m_tileProcessor->m_current_tile_number) {
+static bool j2k_pre_write_tile(grk_j2k *p_j2k, TileProcessor *tileProcessor,
+		uint16_t tile_index) {
+	if (tile_index != tileProcessor->m_current_tile_number) {
 		GROK_ERROR("The given tile index does not match.");
 		return false;
 	}
-	//event_msg( EVT_INFO, "tile number %d / %d", p_j2k->m_tileProcessor->m_current_tile_number + 1, p_j2k->m_cp.tw * p_j2k->m_cp.t_grid_height);
-	p_j2k->m_tileProcessor->m_current_tile_part_number = 0;
-	p_j2k->m_tileProcessor->cur_totnum_tp =
+	//event_msg( EVT_INFO, "tile number %d / %d", tileProcessor->m_current_tile_number + 1, p_j2k->m_cp.tw * p_j2k->m_cp.t_grid_height);
+	tileProcessor->m_current_tile_part_number = 0;
+	tileProcessor->cur_totnum_tp =
 			p_j2k->m_cp.tcps[tile_index].m_nb_tile_parts;
-	p_j2k->m_tileProcessor->m_current_poc_tile_part_number = 0;
+	tileProcessor->m_current_poc_tile_part_number = 0;
 
 	/* initialisation before tile encoding  */
-	if (!p_j2k->m_tileProcessor->init_compress_tile(
-			p_j2k->m_tileProcessor->m_current_tile_number)) {
+	if (!tileProcessor->init_compress_tile(
+			tileProcessor->m_current_tile_number)) {
 		return false;
 	}
 
 	return true;
 }
 
-static bool j2k_post_write_tile(grk_j2k *p_j2k, BufferedStream *stream) {
+/**
+ * Get the number of bytes available to rate control for a single tile.
+ */
+static uint64_t j2k_get_tile_compress_budget(grk_j2k *p_j2k) {
 	auto cp = &(p_j2k->m_cp);
 	auto image = p_j2k->m_private_image;
 	auto img_comp = image->comps;
@@ -2225,19 +2891,24 @@ static bool j2k_post_write_tile(grk_j2k *p_j2k, BufferedStream *stream) {
 	if (tile_size < 1024 * image->numcomps)
 		tile_size = 1024 * image->numcomps;
 
-	uint64_t available_data = tile_size;
+	return tile_size;
+}
+
+static bool j2k_post_write_tile(grk_j2k *p_j2k, TileProcessor *tileProcessor,
+		BufferedStream *stream) {
+	uint64_t available_data = j2k_get_tile_compress_budget(p_j2k);
 	uint64_t nb_bytes_written = 0;
-	if (!j2k_write_first_tile_part(p_j2k, &nb_bytes_written, available_data,
-			stream)) {
+	if (!j2k_write_first_tile_part(p_j2k, tileProcessor, &nb_bytes_written,
+			available_data, stream)) {
 		return false;
 	}
 	available_data -= nb_bytes_written;
 	nb_bytes_written = 0;
-	if (!j2k_write_all_tile_parts(p_j2k, &nb_bytes_written, available_data,
-			stream)) {
+	if (!j2k_write_all_tile_parts(p_j2k, tileProcessor, &nb_bytes_written,
+			available_data, stream)) {
 		return false;
 	}
-	++p_j2k->m_tileProcessor->m_current_tile_number;
+	++tileProcessor->m_current_tile_number;
 	return true;
 }
 
@@ -2383,24 +3054,25 @@ static bool j2k_init_header_writing(grk_j2k *p_j2k) {
 	return true;
 }
 
-static bool j2k_write_first_tile_part(grk_j2k *p_j2k, uint64_t *p_data_written,
+static bool j2k_write_first_tile_part(grk_j2k *p_j2k,
+		TileProcessor *tileProcessor, uint64_t *p_data_written,
 		uint64_t total_data_size, BufferedStream *stream) {
 	uint64_t nb_bytes_written = 0;
 	uint64_t current_nb_bytes_written;
-	auto tcd = p_j2k->m_tileProcessor;
+	auto tcd = tileProcessor;
 	auto cp = &(p_j2k->m_cp);
 
 	tcd->cur_pino = 0;
 
 	/*Get number of tile parts*/
-	p_j2k->m_tileProcessor->m_current_poc_tile_part_number = 0;
+	tileProcessor->m_current_poc_tile_part_number = 0;
 
 	/* INDEX >> */
 	/* << INDEX */
 
 	current_nb_bytes_written = 0;
 	uint64_t psot_location = 0;
-	if (!j2k_write_sot(p_j2k, stream, &psot_location,
+	if (!j2k_write_sot(p_j2k, tileProcessor, stream, &psot_location,
 			&current_nb_bytes_written)) {
 		return false;
 	}
@@ -2408,9 +3080,10 @@ static bool j2k_write_first_tile_part(grk_j2k *p_j2k, uint64_t *p_data_written,
 	total_data_size -= current_nb_bytes_written;
 
 	if (!GRK_IS_CINEMA(cp->rsiz)) {
-		if (cp->tcps[p_j2k->m_tileProcessor->m_current_tile_number].numpocs) {
+		if (cp->tcps[tileProcessor->m_current_tile_number].numpocs) {
 			current_nb_bytes_written = 0;
-			if (!j2k_write_poc_in_memory(p_j2k, stream,
+			if (!j2k_write_poc_in_memory(p_j2k,
+					tileProcessor->m_current_tile_number, stream,
 					&current_nb_bytes_written))
 				return false;
 			nb_bytes_written += current_nb_bytes_written;
@@ -2419,8 +3092,8 @@ static bool j2k_write_first_tile_part(grk_j2k *p_j2k, uint64_t *p_data_written,
 	}
 
 	current_nb_bytes_written = 0;
-	if (!j2k_write_sod(p_j2k, &current_nb_bytes_written, total_data_size,
-			stream)) {
+	if (!j2k_write_sod(p_j2k, tileProcessor, &current_nb_bytes_written,
+			total_data_size, stream)) {
 		return false;
 	}
 	nb_bytes_written += current_nb_bytes_written;
@@ -2437,12 +3110,13 @@ static bool j2k_write_first_tile_part(grk_j2k *p_j2k, uint64_t *p_data_written,
 	stream->seek(currentLocation);
 	if (GRK_IS_CINEMA(
 			cp->rsiz) || GRK_IS_BROADCAST(cp->rsiz) | GRK_IS_IMF(cp->rsiz)) {
-		j2k_update_tlm(p_j2k, (uint32_t) nb_bytes_written);
+		j2k_update_tlm(tileProcessor, (uint32_t) nb_bytes_written);
 	}
 	return true;
 }
 
-static bool j2k_write_all_tile_parts(grk_j2k *p_j2k, uint64_t *p_data_written,
+static bool j2k_write_all_tile_parts(grk_j2k *p_j2k,
+		TileProcessor *tileProcessor, uint64_t *p_data_written,
 		uint64_t total_data_size, BufferedStream *stream) {
 	uint8_t tilepartno = 0;
 	uint64_t nb_bytes_written = 0;
@@ -2451,29 +3125,29 @@ static bool j2k_write_all_tile_parts(grk_j2k *p_j2k, uint64_t *p_data_written,
 	uint32_t tot_num_tp;
 	uint32_t pino;
 
-	auto tcd = p_j2k->m_tileProcessor;
+	auto tcd = tileProcessor;
 	auto cp = &(p_j2k->m_cp);
-	auto tcp = cp->tcps + p_j2k->m_tileProcessor->m_current_tile_number;
+	auto tcp = cp->tcps + tileProcessor->m_current_tile_number;
 
 	/*Get number of tile parts*/
 	tot_num_tp = j2k_get_num_tp(cp, 0,
-			p_j2k->m_tileProcessor->m_current_tile_number);
+			tileProcessor->m_current_tile_number);
 	if (tot_num_tp > 255) {
 		GROK_ERROR(
 				"Tile %d contains more than 255 tile parts, which is not permitted by the JPEG 2000 standard.",
-				p_j2k->m_tileProcessor->m_current_tile_number);
+				tileProcessor->m_current_tile_number);
 		return false;
 	}
 
 	/* start writing remaining tile parts */
-	++p_j2k->m_tileProcessor->m_current_tile_part_number;
+	++tileProcessor->m_current_tile_part_number;
 	for (tilepartno = 1; tilepartno < tot_num_tp; ++tilepartno) {
-		p_j2k->m_tileProcessor->m_current_poc_tile_part_number = tilepartno;
+		tileProcessor->m_current_poc_tile_part_number = tilepartno;
 		current_nb_bytes_written = 0;
 		part_tile_size = 0;
 
 		uint64_t psot_location = 0;
-		if (!j2k_write_sot(p_j2k, stream, &psot_location,
+		if (!j2k_write_sot(p_j2k, tileProcessor, stream, &psot_location,
 				&current_nb_bytes_written)) {
 			return false;
 		}
@@ -2482,8 +3156,8 @@ static bool j2k_write_all_tile_parts(grk_j2k *p_j2k, uint64_t *p_data_written,
 		part_tile_size += (uint32_t) current_nb_bytes_written;
 
 		current_nb_bytes_written = 0;
-		if (!j2k_write_sod(p_j2k, &current_nb_bytes_written, total_data_size,
-				stream)) {
+		if (!j2k_write_sod(p_j2k, tileProcessor, &current_nb_bytes_written,
+				total_data_size, stream)) {
 			return false;
 		}
 		nb_bytes_written += current_nb_bytes_written;
@@ -2500,10 +3174,10 @@ static bool j2k_write_all_tile_parts(grk_j2k *p_j2k, uint64_t *p_data_written,
 		stream->seek(currentLocation);
 		if (GRK_IS_CINEMA(
 				cp->rsiz) || GRK_IS_BROADCAST(cp->rsiz) || GRK_IS_IMF(cp->rsiz)) {
-			j2k_update_tlm(p_j2k, part_tile_size);
+			j2k_update_tlm(tileProcessor, part_tile_size);
 		}
 
-		++p_j2k->m_tileProcessor->m_current_tile_part_number;
+		++tileProcessor->m_current_tile_part_number;
 	}
 
 	for (pino = 1; pino <= tcp->numpocs; ++pino) {
@@ -2511,20 +3185,20 @@ static bool j2k_write_all_tile_parts(grk_j2k *p_j2k, uint64_t *p_data_written,
 
 		/*Get number of tile parts*/
 		tot_num_tp = j2k_get_num_tp(cp, pino,
-				p_j2k->m_tileProcessor->m_current_tile_number);
+				tileProcessor->m_current_tile_number);
 		if (tot_num_tp > 255) {
 			GROK_ERROR(
 					"Tile %d contains more than 255 tile parts, which is not permitted by the JPEG 2000 standard.",
-					p_j2k->m_tileProcessor->m_current_tile_number);
+					tileProcessor->m_current_tile_number);
 			return false;
 		}
 
 		for (tilepartno = 0; tilepartno < tot_num_tp; ++tilepartno) {
-			p_j2k->m_tileProcessor->m_current_poc_tile_part_number = tilepartno;
+			tileProcessor->m_current_poc_tile_part_number = tilepartno;
 			current_nb_bytes_written = 0;
 			part_tile_size = 0;
 			uint64_t psot_location = 0;
-			if (!j2k_write_sot(p_j2k, stream, &psot_location,
+			if (!j2k_write_sot(p_j2k, tileProcessor, stream, &psot_location,
 					&current_nb_bytes_written)) {
 				return false;
 			}
@@ -2534,7 +3208,7 @@ static bool j2k_write_all_tile_parts(grk_j2k *p_j2k, uint64_t *p_data_written,
 			part_tile_size += (uint32_t) current_nb_bytes_written;
 
 			current_nb_bytes_written = 0;
-			if (!j2k_write_sod(p_j2k, &current_nb_bytes_written,
+			if (!j2k_write_sod(p_j2k, tileProcessor, &current_nb_bytes_written,
 					total_data_size, stream)) {
 				return false;
 			}
@@ -2554,9 +3228,9 @@ static bool j2k_write_all_tile_parts(grk_j2k *p_j2k, uint64_t *p_data_written,
 
 			if (GRK_IS_CINEMA(
 					cp->rsiz) || GRK_IS_BROADCAST(cp->rsiz) || GRK_IS_IMF(cp->rsiz))
-				j2k_update_tlm(p_j2k, part_tile_size);
+				j2k_update_tlm(tileProcessor, part_tile_size);
 
-			++p_j2k->m_tileProcessor->m_current_tile_part_number;
+			++tileProcessor->m_current_tile_part_number;
 		}
 	}
 	*p_data_written = nb_bytes_written;
@@ -2773,7 +3447,7 @@ static bool j2k_init_info(grk_j2k *p_j2k, BufferedStream *stream) {
 
 bool j2k_compress_tile(grk_j2k *p_j2k, uint16_t tile_index, uint8_t *p_data,
 		uint64_t data_size, BufferedStream *stream) {
-	if (!j2k_pre_write_tile(p_j2k, tile_index)) {
+	if (!j2k_pre_write_tile(p_j2k, p_j2k->m_tileProcessor, tile_index)) {
 		GROK_ERROR("Error while j2k_pre_write_tile with tile index = %d",
 				tile_index);
 		return false;
@@ -2795,7 +3469,7 @@ bool j2k_compress_tile(grk_j2k *p_j2k, uint16_t tile_index, uint8_t *p_data,
 			GROK_ERROR("Size mismatch between tile data and sent data.");
 			return false;
 		}
-		if (!j2k_post_write_tile(p_j2k, stream)) {
+		if (!j2k_post_write_tile(p_j2k, p_j2k->m_tileProcessor, stream)) {
 			GROK_ERROR("Error while j2k_post_write_tile with tile index = %d",
 					tile_index);
 			return false;
@@ -2805,6 +3479,62 @@ bool j2k_compress_tile(grk_j2k *p_j2k, uint16_t tile_index, uint8_t *p_data,
 	return true;
 }
 
+static bool j2k_transcode_tile(grk_j2k *p_j2k, grk_j2k *src,
+		uint16_t tile_index, BufferedStream *stream) {
+	auto tileProcessor = p_j2k->m_tileProcessor;
+	auto src_processor = src->m_tileProcessor;
+	if (tile_index != tileProcessor->m_current_tile_number) {
+		GROK_ERROR("Tile %d is out of order: tiles must be stored in order "
+				"to be transcoded", tile_index);
+		return false;
+	}
+	if (!src_processor->whole_tile_decoding) {
+		GROK_ERROR("Whole tiles must be decoded for transcoding");
+		return false;
+	}
+	// the main header has already been written, so tiles
+	// must keep the coding style of the main header
+	auto tcp = p_j2k->m_cp.tcps + tile_index;
+	auto src_tcp = src->m_cp.tcps + tile_index;
+	bool equals = tcp->mct == src_tcp->mct;
+	for (uint32_t compno = 0; compno < tileProcessor->image->numcomps; ++compno)
+		equals = equals && j2k_transcode_style_equals(tcp->tccps + compno,
+						src_tcp->tccps + compno);
+	if (!equals) {
+		GROK_ERROR("Tile %d: coding style differs from main header, "
+				"which cannot be transcoded", tile_index);
+		return false;
+	}
+	if (!j2k_pre_write_tile(p_j2k, tileProcessor, tile_index))
+		return false;
+	for (uint32_t compno = 0; compno < tileProcessor->image->numcomps; ++compno) {
+		auto tilec = tileProcessor->tile->comps + compno;
+		auto src_tilec = src_processor->tile->comps + compno;
+		if (!tilec->buf->alloc_component_data_encode()) {
+			GROK_ERROR("Error allocating tile component data.");
+			return false;
+		}
+		// decoded tile component holds its sub-bands in the
+		// same layout as the forward DWT leaves them
+		uint32_t width = tilec->width();
+		uint32_t height = tilec->height();
+		if (width != src_tilec->width() || height != src_tilec->height()) {
+			GROK_ERROR("Tile %d: component %d dimensions differ from code stream",
+					tile_index, compno);
+			return false;
+		}
+		auto src_ptr = src_tilec->buf->get_ptr(0, 0, 0, 0);
+		auto dest_ptr = tilec->buf->data;
+		for (uint32_t j = 0; j < height; ++j) {
+			memcpy(dest_ptr, src_ptr, width * sizeof(int32_t));
+			src_ptr += width;
+			dest_ptr += width;
+		}
+	}
+
+	return j2k_post_write_tile(p_j2k, tileProcessor, stream);
+}
+
 static bool j2k_update_rates(grk_j2k *p_j2k, BufferedStream *stream) {
 	uint32_t i, j, k;
 	double *rates = 0;
@@ -4222,14 +4952,15 @@ static bool j2k_write_poc(grk_j2k *p_j2k, BufferedStream *stream) {
 	assert(stream != nullptr);
 
 	uint64_t data_written = 0;
-	return j2k_write_poc_in_memory(p_j2k, stream, &data_written);
+	return j2k_write_poc_in_memory(p_j2k,
+			p_j2k->m_tileProcessor->m_current_tile_number, stream, &data_written);
 }
 
-static bool j2k_write_poc_in_memory(grk_j2k *p_j2k, BufferedStream *stream,
-		uint64_t *p_data_written) {
+static bool j2k_write_poc_in_memory(grk_j2k *p_j2k, uint16_t tile_no,
+		BufferedStream *stream, uint64_t *p_data_written) {
 	assert(p_j2k != nullptr);
 
-	auto tcp = &p_j2k->m_cp.tcps[p_j2k->m_tileProcessor->m_current_tile_number];
+	auto tcp = &p_j2k->m_cp.tcps[tile_no];
 	auto tccp = &tcp->tccps[0];
 	auto image = p_j2k->m_private_image;
 	uint32_t nb_comp = image->numcomps;
@@ -4985,8 +5716,9 @@ static bool j2k_write_tlm(grk_j2k *p_j2k, BufferedStream *stream) {
 					p_j2k->m_specific_param.m_encoder.m_total_tile_parts));
 }
 
-static bool j2k_write_sot(grk_j2k *p_j2k, BufferedStream *stream,
-		uint64_t *psot_location, uint64_t *p_data_written) {
+static bool j2k_write_sot(grk_j2k *p_j2k, TileProcessor *tileProcessor,
+		BufferedStream *stream, uint64_t *psot_location,
+		uint64_t *p_data_written) {
 	assert(p_j2k != nullptr);
 
 	/* SOT */
@@ -4998,7 +5730,7 @@ static bool j2k_write_sot(grk_j2k *p_j2k, BufferedStream *stream,
 		return false;
 	/* Isot */
 	if (!stream->write_short(
-			(uint16_t) p_j2k->m_tileProcessor->m_current_tile_number))
+			(uint16_t) tileProcessor->m_current_tile_number))
 		return false;
 
 	/* Psot  */
@@ -5008,12 +5740,12 @@ static bool j2k_write_sot(grk_j2k *p_j2k, BufferedStream *stream,
 
 	/* TPsot */
 	if (!stream->write_byte(
-			p_j2k->m_tileProcessor->m_current_tile_part_number))
+			tileProcessor->m_current_tile_part_number))
 		return false;
 
 	/* TNsot */
 	if (!stream->write_byte(
-			p_j2k->m_cp.tcps[p_j2k->m_tileProcessor->m_current_tile_number].m_nb_tile_parts))
+			p_j2k->m_cp.tcps[tileProcessor->m_current_tile_number].m_nb_tile_parts))
 		return false;
 
 	*p_data_written += sot_marker_segment_len;
@@ -5272,14 +6004,15 @@ static bool j2k_read_sot(grk_j2k *p_j2k, uint8_t *p_header_data,
 	return true;
 }
 
-static bool j2k_write_sod(grk_j2k *p_j2k, uint64_t *p_data_written,
-		uint64_t total_data_size, BufferedStream *stream) {
+static bool j2k_write_sod(grk_j2k *p_j2k, TileProcessor *tileProcessor,
+		uint64_t *p_data_written, uint64_t total_data_size,
+		BufferedStream *stream) {
+	(void) p_j2k;
 	grk_codestream_info *cstr_info = nullptr;
 	uint64_t remaining_data;
 
 	assert(p_j2k != nullptr);
 	assert(stream != nullptr);
-	TileProcessor *p_tile_coder = p_j2k->m_tileProcessor;
 
 	/* SOD */
 	if (!stream->write_short(J2K_MS_SOD)) {
@@ -5292,14 +6025,14 @@ static bool j2k_write_sod(grk_j2k *p_j2k, uint64_t *p_data_written,
 	remaining_data = total_data_size - 4;
 
 	/* set packno to zero when writing the first tile part */
-	if (p_j2k->m_tileProcessor->m_current_tile_part_number == 0) {
-		p_tile_coder->tile->packno = 0;
+	if (tileProcessor->m_current_tile_part_number == 0) {
+		tileProcessor->tile->packno = 0;
 		if (cstr_info) {
 			cstr_info->packno = 0;
 		}
 	}
-	if (!p_tile_coder->compress_tile(
-			p_j2k->m_tileProcessor->m_current_tile_number, stream,
+	if (!tileProcessor->compress_tile(
+			tileProcessor->m_current_tile_number, stream,
 			p_data_written, remaining_data, cstr_info)) {
 		GROK_ERROR("Cannot compress tile");
 		return false;
@@ -5368,14 +6101,17 @@ static bool j2k_read_sod(grk_j2k *p_j2k, BufferedStream *stream) {
 
 		auto len = p_j2k->m_tileProcessor->tile_part_data_length;
 		uint8_t *buff = nullptr;
-		auto zeroCopy = stream->supportsZeroCopy();
+		// zero copy chunk must be followed by enough stream bytes to pad it
+		auto zeroCopy = stream->supportsZeroCopy()
+				&& stream->get_number_byte_left() >= (uint64_t)len + GRK_CHUNK_PAD_BYTES;
 		if (!zeroCopy) {
 			try {
-				buff = new uint8_t[len];
+				buff = new uint8_t[len + GRK_CHUNK_PAD_BYTES];
 			} catch (std::bad_alloc &ex) {
 				GROK_ERROR("Not enough memory to allocate segment");
 				return false;
 			}
+			memset(buff + len, 0, GRK_CHUNK_PAD_BYTES);
 		} else {
 			buff = stream->getCurrentPtr();
 		}
@@ -6503,16 +7239,17 @@ static bool j2k_add_mhmarker(grk_codestream_index *cstr_index, uint32_t type,
 	return true;
 }
 
-static void j2k_update_tlm(grk_j2k *p_j2k, uint32_t tile_part_size) {
+static void j2k_update_tlm(TileProcessor *tileProcessor,
+		uint32_t tile_part_size) {
 	/* PSOT */
-	grk_write<uint32_t>(p_j2k->m_tileProcessor->m_tlm_sot_offsets_current,
-			p_j2k->m_tileProcessor->m_current_tile_number, 1);
-	++p_j2k->m_tileProcessor->m_tlm_sot_offsets_current;
+	grk_write<uint32_t>(tileProcessor->m_tlm_sot_offsets_current,
+			tileProcessor->m_current_tile_number, 1);
+	++tileProcessor->m_tlm_sot_offsets_current;
 
 	/* PSOT */
-	grk_write<uint32_t>(p_j2k->m_tileProcessor->m_tlm_sot_offsets_current,
+	grk_write<uint32_t>(tileProcessor->m_tlm_sot_offsets_current,
 			tile_part_size, 4);
-	p_j2k->m_tileProcessor->m_tlm_sot_offsets_current += 4;
+	tileProcessor->m_tlm_sot_offsets_current += 4;
 }
 
 static bool j2k_add_tlmarker(uint16_t tileno, grk_codestream_index *cstr_index,
@@ -331,6 +331,8 @@ struct grk_tcp {
 	param_qcd qcd;
 };
 
+class T1EncodeStats;
+
 struct grk_encoding_param {
 	/** Maximum rate for each component.
 	 * If == 0, component size limitation is not considered */
@@ -347,13 +349,46 @@ struct grk_encoding_param {
 	uint32_t m_tp_on :1;
 	/* rate control algorithm */
 	uint32_t rateControlAlgorithm;
+	/** if > 1, then up to this many tiles are compressed concurrently; otherwise tiles are compressed one at a time */
+	uint32_t m_max_tiles_in_flight;
+	/** if true, then coding passes that rate control is estimated to discard are not coded */
+	bool m_early_termination;
+	/** tier 1 statistics of all tiles */
+	T1EncodeStats *m_t1_stats;
+	/** if true, then tiles are given as quantized wavelet coefficients, and
+	 * DC level shift, MCT and DWT are skipped */
+	bool m_transcode;
+	/** if not null, then the single tile is read in strips from this callback,
+	 * and compressed with bounded memory */
+	grk_strip_read_fn m_strip_read_fn;
+	/** user data passed to m_strip_read_fn */
+	void *m_strip_user_data;
 };
 
+class CodeblockCache;
+struct grk_j2k;
+
 struct grk_decoding_param {
 	/** if != 0, then original dimension divided by 2^(reduce); if == 0 or not used, image is decoded to the full resolution */
 	uint32_t m_reduce;
 	/** if != 0, then only the first "layer" layers are decoded; if == 0 or not used, all the quality layers are decoded */
 	uint32_t m_layer;
+	/** if > 1, then up to this many tiles are decoded concurrently; otherwise tiles are decoded one at a time */
+	uint32_t m_max_tiles_in_flight;
+	/** if > 0, then bit planes too small to change samples scaled to this precision are not decoded,
+	 * and if <= 8, then the inverse 9-7 transform runs in 16 bit fixed point */
+	uint32_t m_output_precision;
+	/** if not null, then decoded code blocks are cached here */
+	CodeblockCache *m_codeblock_cache;
+	/** if true, then whole tiles are inverse transformed in cache sized stripes of rows */
+	bool m_blocked_dwt;
+	/** if not null, then tiles are decoded to quantized wavelet coefficients,
+	 * and compressed by this compressor, instead of being copied to the output image */
+	grk_j2k *m_transcoder;
+	/** stream written by m_transcoder */
+	BufferedStream *m_transcode_stream;
+	/** when set, no further tiles or code blocks are decompressed */
+	const std::atomic<bool> *m_cancel;
 };
 
 /**
@@ -512,6 +547,10 @@ struct grk_j2k {
 	/** the current tile coder/decoder **/
 	TileProcessor *m_tileProcessor;
 
+	/** called once a tile has been copied to the output image */
+	grk_decompress_callback m_tile_callback;
+	void *m_tile_callback_data;
+
 };
 
 /** @name Exported functions */
@@ -619,6 +658,19 @@ bool j2k_read_tile_header(grk_j2k *p_j2k, uint16_t *tile_index,
 bool j2k_set_decompress_area(grk_j2k *p_j2k, grk_image *image, uint32_t start_x,
 		uint32_t start_y, uint32_t end_x, uint32_t end_y);
 
+/**
+ * Set the callback invoked for each decompressed tile, and the flag
+ * that cancels decompression.
+ *
+ * @param	p_j2k		JPEG 2000 codec
+ * @param	callback	tile completion callback, or nullptr
+ * @param	user_data	user data passed to callback
+ * @param	cancel		cancellation flag, or nullptr
+ */
+void j2k_set_decompress_callback(grk_j2k *p_j2k,
+		grk_decompress_callback callback, void *user_data,
+		const std::atomic<bool> *cancel);
+
 /**
  * Creates a J2K decompression structure.
  *
@@ -639,6 +691,53 @@ bool j2k_decompress(grk_j2k *j2k, grk_plugin_tile *tile, BufferedStream *stream,
 
 bool j2k_get_tile(grk_j2k *p_j2k, BufferedStream *stream, grk_image *p_image, uint16_t tile_index);
 
+/**
+ * Set compression parameters for transcoding a code stream to HTJ2K.
+ * The main header of the code stream must have been read.
+ *
+ * @param	p_j2k		J2K decompressor
+ * @param	parameters	compression parameters, set to their defaults
+ *
+ * @return true if the code stream is lossless, and its coding style
+ * can be carried over to HTJ2K
+ */
+bool j2k_init_transcode(grk_j2k *p_j2k, grk_cparameters *parameters);
+
+/**
+ * Transcode a code stream to HTJ2K: code blocks are decoded to quantized wavelet
+ * coefficients, which are compressed again with the HT block coder.
+ * DWT, MCT and DC level shift are skipped.
+ *
+ * @param	p_j2k		J2K decompressor, whose main header has been read
+ * @param	stream		stream of decompressor
+ * @param	p_image		image returned when reading main header
+ * @param	dest		J2K compressor, initialized with parameters from
+ * 						j2k_init_transcode, whose main header has been written
+ * @param	dest_stream	stream of compressor
+ *
+ * @return true if all tiles were transcoded
+ */
+bool j2k_transcode(grk_j2k *p_j2k, BufferedStream *stream, grk_image *p_image,
+		grk_j2k *dest, BufferedStream *dest_stream);
+
+
+/**
+ * Compress an image with a single tile, reading the image in strips.
+ *
+ * Only a window of rows of each resolution level and code block rows of
+ * each band are kept in memory: code blocks are compressed as soon as
+ * their rows have been transformed, and only their compressed data
+ * is kept until the tile is written.
+ *
+ * @param	p_j2k		J2K compressor, whose main header has been written
+ * @param	fn			callback that reads image strips
+ * @param	user_data	user data passed to callback
+ * @param	stream		stream to write to
+ *
+ * @return true if the tile was compressed
+ */
+bool j2k_compress_strips(grk_j2k *p_j2k, grk_strip_read_fn fn,
+		void *user_data, BufferedStream *stream);
 
 /**
  * Writes a tile.
@@ -671,6 +770,18 @@ bool j2k_start_compress(grk_j2k *p_j2k, BufferedStream *stream);
  */
 bool j2k_end_compress(grk_j2k *p_j2k, BufferedStream *stream);
 
+/**
+ * Get tier 1 encode statistics, per thread
+ *
+ * @param	p_j2k		J2K codec
+ * @param	stats		array of at least num_threads entries, or nullptr
+ * @param	num_threads	number of entries in stats
+ *
+ * @return number of threads with statistics
+ */
+uint32_t j2k_get_t1_encode_stats(grk_j2k *p_j2k, grk_t1_thread_stats *stats,
+		uint32_t num_threads);
+
 bool j2k_init_mct_encoding(grk_tcp *p_tcp, grk_image *p_image);
 
 }
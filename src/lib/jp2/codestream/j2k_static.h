@@ -291,7 +291,8 @@ static bool j2k_write_SQcd_SQcc(grk_j2k *p_j2k, uint16_t tile_no,
 /**
  * Updates the Tile Length Marker.
  */
-static void j2k_update_tlm(grk_j2k *p_j2k, uint32_t tile_part_size);
+static void j2k_update_tlm(TileProcessor *tileProcessor,
+		uint32_t tile_part_size);
 
 /**
  * Reads a SQcd or SQcc element, i.e. the quantization values of a band in the QCD or QCC.
@@ -319,9 +320,55 @@ static void j2k_copy_tile_component_parameters(grk_j2k *p_j2k);
  */
 static bool j2k_decompress_tiles(grk_j2k *p_j2k, BufferedStream *stream);
 
-static bool j2k_pre_write_tile(grk_j2k *p_j2k, uint16_t tile_index);
+static bool j2k_decompress_tiles_concurrent(grk_j2k *p_j2k,
+		BufferedStream *stream, uint32_t max_tiles_in_flight);
 
-static bool j2k_post_write_tile(grk_j2k *p_j2k, BufferedStream *stream);
+/**
+ * Finish decompressing a tile: reset the tile part state and
+ * read the next marker (EOC or SOT).
+ */
+static bool j2k_end_decompress_tile(grk_j2k *p_j2k, BufferedStream *stream);
+
+static void j2k_copy_resno_decoded(grk_image *src, grk_image *dest);
+
+/**
+ * Check whether decompression has been cancelled
+ */
+static bool j2k_decompress_cancelled(grk_j2k *p_j2k);
+
+/**
+ * Notify the user that a tile has been copied to the output image
+ */
+static void j2k_tile_decompressed(grk_j2k *p_j2k, uint16_t tile_no);
+
+static bool j2k_pre_write_tile(grk_j2k *p_j2k, TileProcessor *tileProcessor,
+		uint16_t tile_index);
+
+static bool j2k_post_write_tile(grk_j2k *p_j2k, TileProcessor *tileProcessor,
+		BufferedStream *stream);
+
+static uint64_t j2k_get_tile_compress_budget(grk_j2k *p_j2k);
+
+static bool j2k_compress_tiles_concurrent(grk_j2k *p_j2k,
+		BufferedStream *stream, uint32_t max_tiles_in_flight);
+
+/**
+ * Compress a tile that a decompressor has decoded to quantized wavelet coefficients
+ *
+ * @param	p_j2k		J2K compressor
+ * @param	src			J2K decompressor holding the decoded tile
+ * @param	tile_index	index of tile
+ * @param	stream		stream of compressor
+ */
+static bool j2k_transcode_tile(grk_j2k *p_j2k, grk_j2k *src,
+		uint16_t tile_index, BufferedStream *stream);
+
+/**
+ * Check whether two tile components share the coding style that
+ * transcoding carries over from a code stream
+ */
+static bool j2k_transcode_style_equals(const grk_tccp *tccp0,
+		const grk_tccp *tccp1);
 
 /**
  * Set up the procedures to do on writing header.
@@ -329,10 +376,12 @@ static bool j2k_post_write_tile(grk_j2k *p_j2k, BufferedStream *stream);
  */
 static bool j2k_init_header_writing(grk_j2k *p_j2k);
 
-static bool j2k_write_first_tile_part(grk_j2k *p_j2k, uint64_t *p_data_written,
+static bool j2k_write_first_tile_part(grk_j2k *p_j2k,
+		TileProcessor *tileProcessor, uint64_t *p_data_written,
 		uint64_t total_data_size, BufferedStream *stream);
 
-static bool j2k_write_all_tile_parts(grk_j2k *p_j2k, uint64_t *p_data_written,
+static bool j2k_write_all_tile_parts(grk_j2k *p_j2k,
+		TileProcessor *tileProcessor, uint64_t *p_data_written,
 		uint64_t total_data_size, BufferedStream *stream);
 
 /**
@@ -580,12 +629,13 @@ static bool j2k_write_poc(grk_j2k *p_j2k, BufferedStream *stream);
  * Writes the POC marker (Progression Order Change)
  *
  * @param       p_j2k          J2K codec.
+ * @param       tile_no        tile whose progression order changes are written
  * @param       stream       the stream to write data to.
  * @param       p_data_written number of bytes written
 
  */
-static bool j2k_write_poc_in_memory(grk_j2k *p_j2k, BufferedStream *stream,
-		uint64_t *p_data_written);
+static bool j2k_write_poc_in_memory(grk_j2k *p_j2k, uint16_t tile_no,
+		BufferedStream *stream, uint64_t *p_data_written);
 /**
  * Gets the maximum size taken by the writing of a POC.
  */
@@ -717,13 +767,15 @@ static bool j2k_write_tlm(grk_j2k *p_j2k, BufferedStream *stream);
  * Writes the SOT marker (Start of tile-part)
  *
  * @param       p_j2k            J2K codec.
+ * @param       tileProcessor    tile processor for current tile
  * @param       stream         the stream to write data to.
  * @param       psot_location    PSOT location
  * @param       p_data_written   number of bytes written
 
  */
-static bool j2k_write_sot(grk_j2k *p_j2k, BufferedStream *stream,
-		uint64_t *psot_location, uint64_t *p_data_written);
+static bool j2k_write_sot(grk_j2k *p_j2k, TileProcessor *tileProcessor,
+		BufferedStream *stream, uint64_t *psot_location,
+		uint64_t *p_data_written);
 
 /**
  * Reads values from a SOT marker (Start of tile-part)
@@ -755,12 +807,13 @@ static bool j2k_read_sot(grk_j2k *p_j2k, uint8_t *p_header_data,
  * Writes the SOD marker (Start of data)
  *
  * @param       p_j2k               J2K codec.
+ * @param       tileProcessor       tile processor for current tile
  * @param       p_data_written      number of bytes written
  * @param       total_data_size     total data size
  * @param       stream            the stream to write data to.
 
  */
-static bool j2k_write_sod(grk_j2k *p_j2k,
+static bool j2k_write_sod(grk_j2k *p_j2k, TileProcessor *tileProcessor,
 		uint64_t *p_data_written, uint64_t total_data_size,
 		BufferedStream *stream);
 
@@ -773,7 +826,8 @@ static bool j2k_write_sod(grk_j2k *p_j2k,
  */
 static bool j2k_read_sod(grk_j2k *p_j2k, BufferedStream *stream);
 
-static void j2k_update_tlm(grk_j2k *p_j2k, uint32_t tile_part_size) ;
+static void j2k_update_tlm(TileProcessor *tileProcessor,
+		uint32_t tile_part_size);
 
 /**
  * Writes the RGN marker (Region Of Interest)
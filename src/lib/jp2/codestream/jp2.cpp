@@ -2407,6 +2407,11 @@ bool jp2_end_decompress(grk_jp2 *jp2, BufferedStream *stream) {
 	return j2k_end_decompress(jp2->j2k, stream);
 }
 
+uint32_t jp2_get_t1_encode_stats(grk_jp2 *jp2, grk_t1_thread_stats *stats,
+		uint32_t num_threads) {
+	return j2k_get_t1_encode_stats(jp2->j2k, stats, num_threads);
+}
+
 bool jp2_end_compress(grk_jp2 *jp2, BufferedStream *stream) {
 
 	assert(jp2 != nullptr);
@@ -3150,6 +3155,12 @@ bool jp2_set_decompress_area(grk_jp2 *p_jp2, grk_image *p_image, uint32_t start_
 			end_y);
 }
 
+void jp2_set_decompress_callback(grk_jp2 *p_jp2,
+		grk_decompress_callback callback, void *user_data,
+		const std::atomic<bool> *cancel) {
+	j2k_set_decompress_callback(p_jp2->j2k, callback, user_data, cancel);
+}
+
 bool jp2_get_tile(grk_jp2 *p_jp2, BufferedStream *stream, grk_image *p_image,
 		uint16_t tile_index) {
 	if (!p_image)
@@ -298,6 +298,18 @@ bool jp2_start_compress(grk_jp2 *jp2, BufferedStream *stream);
  */
 bool jp2_end_compress(grk_jp2 *jp2, BufferedStream *stream);
 
+/**
+ * Get tier 1 encode statistics, per thread
+ *
+ * @param	jp2			JP2 codec
+ * @param	stats		array of at least num_threads entries, or nullptr
+ * @param	num_threads	number of entries in stats
+ *
+ * @return number of threads with statistics
+ */
+uint32_t jp2_get_t1_encode_stats(grk_jp2 *jp2, grk_t1_thread_stats *stats,
+		uint32_t num_threads);
+
 /* ----------------------------------------------------------------------- */
 
 /**
@@ -392,6 +404,19 @@ void jp2_destroy(grk_jp2 *jp2);
 bool jp2_set_decompress_area(grk_jp2 *p_jp2, grk_image *image, uint32_t start_x,
 		uint32_t start_y, uint32_t end_x, uint32_t end_y);
 
+/**
+ * Set the callback invoked for each decompressed tile, and the flag
+ * that cancels decompression.
+ *
+ * @param	p_jp2		JPEG 2000 codec
+ * @param	callback	tile completion callback, or nullptr
+ * @param	user_data	user data passed to callback
+ * @param	cancel		cancellation flag, or nullptr
+ */
+void jp2_set_decompress_callback(grk_jp2 *p_jp2,
+		grk_decompress_callback callback, void *user_data,
+		const std::atomic<bool> *cancel);
+
 /**
  *
  */
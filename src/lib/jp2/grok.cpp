@@ -63,6 +63,30 @@
 #include "grok_includes.h"
 using namespace grk;
 
+/**
+ * Thread pool that may be shared between codecs
+ */
+struct grk_thread_pool_private {
+	ThreadPool *pool;
+	/** creator reference, plus one reference per attached codec */
+	std::atomic<uint32_t> ref_count;
+};
+
+static void grk_thread_pool_release(grk_thread_pool_private *pool){
+	if (pool && --pool->ref_count == 0) {
+		ThreadPool::destroy(pool->pool);
+		delete pool;
+	}
+}
+
+/**
+ * State of an asynchronous decompression
+ */
+struct grk_codec_async {
+	std::future<bool> result;
+	std::atomic<bool> cancel;
+};
+
 /**
  * Main codec handler used for compression or decompression.
  */
@@ -111,6 +135,11 @@ struct grk_codec_private {
 					grk_image *p_image,
 					uint16_t tile_index);
 
+			/** Set tile completion callback and cancellation flag */
+			void (*set_decompress_callback)(void *p_codec,
+					grk_decompress_callback callback, void *user_data,
+					const std::atomic<bool> *cancel);
+
 		} m_decompression;
 
 		/**
@@ -131,10 +160,16 @@ struct grk_codec_private {
 
 			bool (*init_compress)(void *p_codec,  grk_cparameters  *p_param,
 					grk_image *p_image);
+
+			/** Get tier 1 encode statistics */
+			uint32_t (*get_t1_encode_stats)(void *p_codec,
+					grk_t1_thread_stats *stats, uint32_t num_threads);
 		} m_compression;
 	} m_codec_data;
 	/** FIXME DOC*/
 	void *m_codec;
+	/** code stream codec: m_codec itself, or the J2K codec wrapped by a JP2 codec */
+	grk_j2k *m_j2k;
 	 grk_stream  *m_stream;
 	/** Flag to indicate if the codec is used to decompress or compress*/
 	bool is_decompressor;
@@ -142,14 +177,33 @@ struct grk_codec_private {
 			FILE *output_stream);
 	 grk_codestream_info_v2  *  (*get_codec_info)(void *p_codec);
 	 grk_codestream_index  *  (*grk_get_codec_index)(void *p_codec);
+	/** thread pool for this codec's work, or nullptr for the library-wide pool */
+	grk_thread_pool_private *m_thread_pool;
+	/** maximum number of threads this codec's work is split over, or zero */
+	uint32_t m_max_concurrency;
+	/** asynchronous decompression, or nullptr if none was started */
+	grk_codec_async *m_async;
 };
 
+/**
+ * Thread pool for a codec's work; nullptr selects the library-wide pool
+ */
+static ThreadPool* grk_codec_thread_pool(grk_codec_private *codec){
+	return codec->m_thread_pool ? codec->m_thread_pool->pool : nullptr;
+}
+
 ThreadPool* ThreadPool::singleton = nullptr;
 std::mutex ThreadPool::singleton_mutex;
+thread_local ThreadPool* ThreadPool::tl_pool = nullptr;
+thread_local int ThreadPool::tl_thread_number = -1;
+thread_local ThreadPool* ThreadPool::tl_scope_pool = nullptr;
+thread_local uint32_t ThreadPool::tl_concurrency = 0;
 
 static bool is_plugin_initialized = false;
 bool GRK_CALLCONV grk_initialize(const char *plugin_path, uint32_t numthreads) {
 	ThreadPool::instance(numthreads);
+	// select SIMD kernels for this CPU
+	SIMDKernels::get();
 	if (!is_plugin_initialized) {
 		grk_plugin_load_info info;
 		info.plugin_path = plugin_path;
@@ -163,6 +217,14 @@ GRK_API void GRK_CALLCONV grk_deinitialize() {
 	ThreadPool::release();
 }
 
+uint64_t GRK_CALLCONV grk_trim_scratch(void) {
+	return ScratchArena::trim_all();
+}
+
+uint64_t GRK_CALLCONV grk_scratch_high_water(void) {
+	return ScratchArena::peak_held();
+}
+
 /* ---------------------------------------------------------------------- */
 /* Functions to set the message handlers */
 
@@ -289,12 +351,16 @@ const char* GRK_CALLCONV grk_version(void) {
 		l_codec->m_codec_data.m_decompression.get_decoded_tile = (bool (*)(
 				void *p_codec, BufferedStream *p_cio, grk_image *p_image, uint16_t tile_index)) j2k_get_tile;
 
+		l_codec->m_codec_data.m_decompression.set_decompress_callback = (void (*)(
+				void*, grk_decompress_callback, void*, const std::atomic<bool>*)) j2k_set_decompress_callback;
+
 		l_codec->m_codec = j2k_create_decompress();
 
 		if (!l_codec->m_codec) {
 			grok_free(l_codec);
 			return nullptr;
 		}
+		l_codec->m_j2k = (grk_j2k*) l_codec->m_codec;
 		break;
 	case GRK_CODEC_JP2:
 		/* get a JP2 decoder handle */
@@ -325,11 +391,14 @@ const char* GRK_CALLCONV grk_version(void) {
 
 		l_codec->m_codec_data.m_decompression.get_decoded_tile = (bool (*)(
 				void *p_codec, BufferedStream *p_cio, grk_image *p_image, uint16_t tile_index)) jp2_get_tile;
+		l_codec->m_codec_data.m_decompression.set_decompress_callback = (void (*)(
+				void*, grk_decompress_callback, void*, const std::atomic<bool>*)) jp2_set_decompress_callback;
 		l_codec->m_codec = jp2_create(true);
 		if (!l_codec->m_codec) {
 			grok_free(l_codec);
 			return nullptr;
 		}
+		l_codec->m_j2k = ((grk_jp2*) l_codec->m_codec)->j2k;
 		break;
 	case GRK_CODEC_UNKNOWN:
 	default:
@@ -364,6 +433,8 @@ bool GRK_CALLCONV grk_read_header(
 		grk_image **p_image) {
 	if (p_codec) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+				l_codec->m_max_concurrency);
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 		if (!l_codec->is_decompressor) {
 			GROK_ERROR(
@@ -381,6 +452,8 @@ bool GRK_CALLCONV grk_decompress( grk_codec  *p_codec, grk_plugin_tile *tile,
 		 grk_image *p_image) {
 	if (p_codec) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+				l_codec->m_max_concurrency);
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 		if (!l_codec->is_decompressor) {
 			return false;
@@ -410,6 +483,8 @@ bool GRK_CALLCONV grk_read_tile_header( grk_codec  *p_codec,
 		uint32_t *p_tile_y1, uint32_t *p_nb_comps, bool *p_should_go_on) {
 	if (p_codec && data_size && tile_index) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+				l_codec->m_max_concurrency);
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 		if (!l_codec->is_decompressor) {
 			return false;
@@ -425,6 +500,8 @@ bool GRK_CALLCONV grk_decompress_tile_to_buffer( grk_codec  *p_codec,
 		uint16_t tile_index, uint8_t *p_data, uint64_t data_size) {
 	if (p_codec && p_data) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+				l_codec->m_max_concurrency);
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 
 		if (!l_codec->is_decompressor) {
@@ -440,6 +517,8 @@ bool GRK_CALLCONV grk_decompress_tile( grk_codec  *p_codec,
 		 grk_image *p_image, uint16_t tile_index) {
 	if (p_codec) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+				l_codec->m_max_concurrency);
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 
 		if (!l_codec->is_decompressor) {
@@ -453,6 +532,96 @@ bool GRK_CALLCONV grk_decompress_tile( grk_codec  *p_codec,
 	return false;
 }
 
+/**
+ * Run a decompress function on the codec's thread pool
+ */
+static bool grk_decompress_start_async(grk_codec_private *l_codec,
+		grk_decompress_callback callback, void *user_data,
+		std::function<bool(void)> decompress) {
+	if (!l_codec->is_decompressor)
+		return false;
+	// a finished decompression that was never waited on may be replaced
+	if (l_codec->m_async && l_codec->m_async->result.valid()
+			&& l_codec->m_async->result.wait_for(std::chrono::seconds(0))
+					!= std::future_status::ready) {
+		GROK_ERROR("Asynchronous decompression already in progress");
+		return false;
+	}
+	if (!l_codec->m_async)
+		l_codec->m_async = new grk_codec_async();
+	auto async = l_codec->m_async;
+	async->cancel = false;
+	l_codec->m_codec_data.m_decompression.set_decompress_callback(
+			l_codec->m_codec, callback, user_data, &async->cancel);
+	ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+			l_codec->m_max_concurrency);
+	async->result = ThreadPool::get()->enqueue([l_codec, decompress] {
+		ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+				l_codec->m_max_concurrency);
+		bool rc = false;
+		try {
+			rc = decompress();
+		} catch (std::exception &ex) {
+			GROK_ERROR("Asynchronous decompression failed: %s", ex.what());
+		}
+		l_codec->m_codec_data.m_decompression.set_decompress_callback(
+				l_codec->m_codec, nullptr, nullptr, nullptr);
+		return rc;
+	});
+
+	return true;
+}
+bool GRK_CALLCONV grk_decompress_async( grk_codec  *p_codec,
+		grk_image *p_image, grk_decompress_callback callback, void *user_data) {
+	if (p_codec && p_image) {
+		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
+		return grk_decompress_start_async(l_codec, callback, user_data,
+				[l_codec, l_stream, p_image] {
+					return l_codec->m_codec_data.m_decompression.decompress(
+							l_codec->m_codec, nullptr, l_stream, p_image);
+				});
+	}
+	return false;
+}
+bool GRK_CALLCONV grk_decompress_tile_async( grk_codec  *p_codec,
+		grk_image *p_image, uint16_t tile_index,
+		grk_decompress_callback callback, void *user_data) {
+	if (p_codec && p_image) {
+		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
+		return grk_decompress_start_async(l_codec, callback, user_data,
+				[l_codec, l_stream, p_image, tile_index] {
+					return l_codec->m_codec_data.m_decompression.get_decoded_tile(
+							l_codec->m_codec, l_stream, p_image, tile_index);
+				});
+	}
+	return false;
+}
+void GRK_CALLCONV grk_decompress_cancel( grk_codec  *p_codec) {
+	if (p_codec) {
+		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		if (l_codec->m_async)
+			l_codec->m_async->cancel = true;
+	}
+}
+bool GRK_CALLCONV grk_decompress_wait( grk_codec  *p_codec) {
+	if (p_codec) {
+		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		if (!l_codec->m_async || !l_codec->m_async->result.valid())
+			return false;
+		ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+				l_codec->m_max_concurrency);
+		try {
+			ThreadPool::get()->wait(l_codec->m_async->result);
+			return l_codec->m_async->result.get();
+		} catch (std::exception &ex) {
+			GROK_ERROR("Asynchronous decompression failed: %s", ex.what());
+		}
+	}
+	return false;
+}
+
 /* ---------------------------------------------------------------------- */
 /* COMPRESSION FUNCTIONS*/
 
@@ -480,11 +649,14 @@ bool GRK_CALLCONV grk_decompress_tile( grk_codec  *p_codec,
 				(void (*)(void*)) j2k_destroy;
 		l_codec->m_codec_data.m_compression.init_compress =
 				(bool (*)(void*,  grk_cparameters  * , grk_image * )) j2k_init_compress;
+		l_codec->m_codec_data.m_compression.get_t1_encode_stats =
+				(uint32_t (*)(void*, grk_t1_thread_stats*, uint32_t)) j2k_get_t1_encode_stats;
 		l_codec->m_codec = j2k_create_compress();
 		if (!l_codec->m_codec) {
 			grok_free(l_codec);
 			return nullptr;
 		}
+		l_codec->m_j2k = (grk_j2k*) l_codec->m_codec;
 		break;
 	case GRK_CODEC_JP2:
 		/* get a JP2 decoder handle */
@@ -500,12 +672,15 @@ bool GRK_CALLCONV grk_decompress_tile( grk_codec  *p_codec,
 				(void (*)(void*)) jp2_destroy;
 		l_codec->m_codec_data.m_compression.init_compress =
 				(bool (*)(void*,  grk_cparameters  * , grk_image * )) jp2_init_compress;
+		l_codec->m_codec_data.m_compression.get_t1_encode_stats =
+				(uint32_t (*)(void*, grk_t1_thread_stats*, uint32_t)) jp2_get_t1_encode_stats;
 
 		l_codec->m_codec = jp2_create(false);
 		if (!l_codec->m_codec) {
 			grok_free(l_codec);
 			return nullptr;
 		}
+		l_codec->m_j2k = ((grk_jp2*) l_codec->m_codec)->j2k;
 		break;
 	case GRK_CODEC_UNKNOWN:
 	default:
@@ -555,6 +730,8 @@ bool GRK_CALLCONV grk_init_compress( grk_codec  *p_codec,
 bool GRK_CALLCONV grk_start_compress( grk_codec  *p_codec) {
 	if (p_codec) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+				l_codec->m_max_concurrency);
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 		if (!l_codec->is_decompressor) {
 			return l_codec->m_codec_data.m_compression.start_compress(
@@ -570,6 +747,8 @@ bool GRK_CALLCONV grk_compress_with_plugin( grk_codec  *p_info,
 		grk_plugin_tile *tile) {
 	if (p_info) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_info;
+		ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+				l_codec->m_max_concurrency);
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 		if (!l_codec->is_decompressor) {
 			return l_codec->m_codec_data.m_compression.compress(l_codec->m_codec,
@@ -578,9 +757,26 @@ bool GRK_CALLCONV grk_compress_with_plugin( grk_codec  *p_info,
 	}
 	return false;
 }
+bool GRK_CALLCONV grk_compress_strips(grk_codec *codec,
+		grk_strip_read_fn fn, void *user_data) {
+	if (!codec || !fn)
+		return false;
+	auto l_codec = (grk_codec_private*) codec;
+	if (l_codec->is_decompressor || !l_codec->m_j2k) {
+		GROK_ERROR("grk_compress_strips needs a compressor");
+		return false;
+	}
+	ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+			l_codec->m_max_concurrency);
+
+	return j2k_compress_strips(l_codec->m_j2k, fn, user_data,
+			(BufferedStream*) l_codec->m_stream);
+}
 bool GRK_CALLCONV grk_end_compress( grk_codec  *p_codec) {
 	if (p_codec) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+				l_codec->m_max_concurrency);
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 		if (!l_codec->is_decompressor) {
 			return l_codec->m_codec_data.m_compression.end_compress(
@@ -592,6 +788,8 @@ bool GRK_CALLCONV grk_end_compress( grk_codec  *p_codec) {
 bool GRK_CALLCONV grk_end_decompress( grk_codec  *p_codec) {
 	if (p_codec) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+				l_codec->m_max_concurrency);
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 		if (!l_codec->is_decompressor) {
 			return false;
@@ -631,6 +829,8 @@ bool GRK_CALLCONV grk_compress_tile( grk_codec  *p_codec, uint16_t tile_index,
 		uint8_t *p_data, uint64_t data_size) {
 	if (p_codec && p_data) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		ThreadPoolScope scope(grk_codec_thread_pool(l_codec),
+				l_codec->m_max_concurrency);
 		BufferedStream *l_stream = (BufferedStream*) l_codec->m_stream;
 		if (l_codec->is_decompressor) {
 			return false;
@@ -646,16 +846,115 @@ bool GRK_CALLCONV grk_compress_tile( grk_codec  *p_codec, uint16_t tile_index,
 void GRK_CALLCONV grk_destroy_codec( grk_codec  *p_codec) {
 	if (p_codec) {
 		grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+		if (l_codec->m_async) {
+			// stop and reap any decompression still in flight
+			grk_decompress_cancel(p_codec);
+			grk_decompress_wait(p_codec);
+			delete l_codec->m_async;
+		}
 		if (l_codec->is_decompressor) {
 			l_codec->m_codec_data.m_decompression.destroy(l_codec->m_codec);
 		} else {
 			l_codec->m_codec_data.m_compression.destroy(l_codec->m_codec);
 		}
 		l_codec->m_codec = nullptr;
+		grk_thread_pool_release(l_codec->m_thread_pool);
 		grok_free(l_codec);
 	}
 }
 
+grk_thread_pool* GRK_CALLCONV grk_thread_pool_create(uint32_t num_threads){
+	grk_thread_pool_private *pool = nullptr;
+	try {
+		pool = new grk_thread_pool_private();
+		pool->pool = new ThreadPool(num_threads ?
+				num_threads : ThreadPool::hardware_concurrency());
+	} catch (std::exception &ex){
+		GROK_ERROR("Unable to create thread pool: %s", ex.what());
+		delete pool;
+		return nullptr;
+	}
+	pool->ref_count = 1;
+	return (grk_thread_pool*) pool;
+}
+
+void GRK_CALLCONV grk_thread_pool_destroy(grk_thread_pool *pool){
+	grk_thread_pool_release((grk_thread_pool_private*) pool);
+}
+
+bool GRK_CALLCONV grk_transcode(grk_codec *decompressor, grk_image *image,
+		grk_codec *compressor) {
+	if (!decompressor || !image || !compressor)
+		return false;
+	auto src = (grk_codec_private*) decompressor;
+	auto dest = (grk_codec_private*) compressor;
+	if (!src->is_decompressor || dest->is_decompressor) {
+		GROK_ERROR("grk_transcode needs a decompressor and a compressor");
+		return false;
+	}
+	ThreadPoolScope scope(grk_codec_thread_pool(src), src->m_max_concurrency);
+	grk_cparameters parameters;
+	grk_set_default_compress_params(&parameters);
+	if (!j2k_init_transcode(src->m_j2k, &parameters))
+		return false;
+	auto dest_stream = (BufferedStream*) dest->m_stream;
+	if (!dest->m_codec_data.m_compression.init_compress(dest->m_codec,
+			&parameters, image))
+		return false;
+	if (!dest->m_codec_data.m_compression.start_compress(dest->m_codec,
+			dest_stream))
+		return false;
+	if (!j2k_transcode(src->m_j2k, (BufferedStream*) src->m_stream, image,
+			dest->m_j2k, dest_stream))
+		return false;
+
+	return dest->m_codec_data.m_compression.end_compress(dest->m_codec,
+			dest_stream);
+}
+
+bool GRK_CALLCONV grk_get_t1_encode_stats(grk_codec *codec,
+		grk_t1_thread_stats *stats, uint32_t *num_threads){
+	if (!codec || !num_threads)
+		return false;
+	grk_codec_private *l_codec = (grk_codec_private*) codec;
+	if (l_codec->is_decompressor) {
+		GROK_ERROR("Codec provided to the grk_get_t1_encode_stats function is not a compressor");
+		return false;
+	}
+	*num_threads = l_codec->m_codec_data.m_compression.get_t1_encode_stats(
+			l_codec->m_codec, stats, stats ? *num_threads : 0);
+
+	return true;
+}
+
+grk_codeblock_cache* GRK_CALLCONV grk_codeblock_cache_create(uint64_t max_bytes){
+	try {
+		return (grk_codeblock_cache*) new CodeblockCache(max_bytes);
+	} catch (std::exception &ex){
+		GROK_ERROR("Unable to create code block cache: %s", ex.what());
+		return nullptr;
+	}
+}
+
+void GRK_CALLCONV grk_codeblock_cache_destroy(grk_codeblock_cache *cache){
+	delete (CodeblockCache*) cache;
+}
+
+bool GRK_CALLCONV grk_set_thread_pool(grk_codec *p_codec, grk_thread_pool *pool,
+		uint32_t max_concurrency){
+	if (!p_codec)
+		return false;
+	grk_codec_private *l_codec = (grk_codec_private*) p_codec;
+	auto l_pool = (grk_thread_pool_private*) pool;
+	if (l_pool)
+		l_pool->ref_count++;
+	grk_thread_pool_release(l_codec->m_thread_pool);
+	l_codec->m_thread_pool = l_pool;
+	l_codec->m_max_concurrency = max_concurrency;
+
+	return true;
+}
+
 /* ---------------------------------------------------------------------- */
 
 void GRK_CALLCONV grk_dump_codec( grk_codec  *p_codec, int32_t info_flag,
@@ -577,6 +577,23 @@ typedef struct _grk_cparameters {
 	// 0: bisect with all truncation points,  1: bisect with only feasible truncation points
 	uint32_t rateControlAlgorithm;
 	uint32_t numThreads;
+	/**
+	 Maximum number of tiles compressed concurrently.
+	 Memory use grows with the number of tiles in flight.
+	 if > 1, then multi-tile images are compressed several tiles at a time,
+	 and the code stream is still written in tile order;
+	 if <= 1 or not used, tiles are compressed one at a time
+	 */
+	uint32_t max_tiles_in_flight;
+	/**
+	 Early termination of coding passes, for lossy encodes with target compression ratios.
+	 A sample of the code blocks is coded first, to estimate which coding passes
+	 rate control will discard; coding of the remaining code blocks stops well below
+	 this estimate. If rate control turns out to need more passes, the tile is coded again.
+	 if true, then Part-1 code blocks are terminated early when every layer has a target ratio;
+	 if false or not used, all coding passes are coded
+	 */
+	bool early_termination;
 	int32_t deviceId;
 	uint32_t duration; //seconds
 	uint32_t kernelBuildOptions;
@@ -706,6 +723,8 @@ typedef struct _grk_header_info {
 
 } grk_header_info;
 
+typedef void *grk_codeblock_cache;
+
 /**
  * Core decompress parameters
  * */
@@ -748,6 +767,44 @@ typedef struct _grk_dparameters {
 	/** Number of tiles to decompress */
 	uint32_t nb_tile_to_decode;
 	uint32_t flags;
+	/**
+	 Maximum number of tiles decompressed concurrently.
+	 Memory use grows with the number of tiles in flight.
+	 if > 1, then multi-tile images are decompressed several tiles at a time,
+	 and packet parsing (T2) of the next tile overlaps code block decoding (T1)
+	 of the tiles in flight;
+	 if <= 1 or not used, tiles are decompressed one at a time
+	 */
+	uint32_t max_tiles_in_flight;
+	/**
+	 Precision (bit depth) that the application will scale decompressed samples down to.
+	 Coding passes for bit planes that are too small to change a sample at this precision
+	 are not decoded, so scaled samples may occasionally differ by one from a full decompress.
+	 if > 0, then bit planes below the output precision are skipped for components
+	 with a higher precision, and if <= 8, then irreversible tiles without
+	 a colour transform are inverse transformed in 16 bit fixed point,
+	 with scaled samples within one of the floating point transform;
+	 if == 0 or not used, all coding passes are decoded
+	 */
+	uint32_t output_precision;
+	/**
+	 Cache of decoded code blocks, created with grk_codeblock_cache_create.
+	 Code blocks found in the cache are not decoded again, which speeds up
+	 repeated region decodes of the same image.
+	 if not null, the cache must only be shared by decompressors of the same code stream,
+	 and must not be destroyed before these decompressors;
+	 if null or not used, code blocks are not cached
+	 */
+	grk_codeblock_cache *codeblock_cache;
+	/**
+	 Inverse wavelet transform of whole tiles in cache sized stripes of rows,
+	 each stripe passing through all decomposition levels before the next one.
+	 The tile buffer is read and written once instead of twice per level,
+	 at the cost of a second buffer of the tile component's size. Output is identical.
+	 if true, then the stripe based inverse transform is used;
+	 if false or not used, each level is transformed over the whole tile in turn
+	 */
+	bool blocked_dwt;
 } grk_dparameters;
 
 /**
@@ -821,6 +878,22 @@ typedef struct _grk_decompress_params {
 
 typedef void *grk_codec;
 
+/**
+ * Tier 1 encode statistics of one thread
+ */
+typedef struct _grk_t1_thread_stats {
+	/** number of code blocks coded */
+	uint64_t blocks;
+	/** number of coding passes coded */
+	uint64_t passes;
+	/** number of bytes coded, before rate control */
+	uint64_t bytes;
+	/** time spent coding, in nanoseconds */
+	uint64_t time_ns;
+} grk_t1_thread_stats;
+
+typedef void *grk_thread_pool;
+
 /*
  ==========================================================
  I/O stream typedef definitions
@@ -950,6 +1023,28 @@ typedef struct _grk_image {
 	size_t xmp_len;
 } grk_image;
 
+/**
+ * Callback invoked by asynchronous decompression, once for each tile
+ * whose region of the decompressed image is complete.
+ *
+ * The callback runs on a library thread, with tiles reported in code
+ * stream order. The image is restricted to the tile: its bounds are those
+ * of the tile, clipped to the decompressed region, and its components hold
+ * a copy of the tile's samples, at the decompressed resolution.
+ * It is only valid for the duration of the callback.
+ * Apart from grk_decompress_cancel, codec functions must not be called
+ * from within the callback.
+ * For JP2 files, colour space, palette and channel definition processing
+ * happen after the last tile is decompressed, so the image holds the
+ * code stream samples.
+ *
+ * @param tile_index 	index of the completed tile
+ * @param image 		decompressed image
+ * @param user_data 	user data passed to the asynchronous decompress call
+ */
+typedef void (*grk_decompress_callback)(uint16_t tile_index, grk_image *image,
+		void *user_data);
+
 /**
  * Image component parameters
  * */
@@ -1318,6 +1413,10 @@ GRK_API const char* GRK_CALLCONV grk_version(void);
 /**
  * Initialize Grok library
  *
+ * SIMD kernels are selected here for the host CPU. To benchmark a lower
+ * level, set the GRK_SIMD environment variable to one of
+ * scalar, sse2, avx2 or avx512.
+ *
  * @param plugin_path 	path to plugin
  * @param numthreads 	number of threads to use for compress/decompress
  */
@@ -1329,6 +1428,23 @@ GRK_API bool GRK_CALLCONV grk_initialize(const char *plugin_path,
  */
 GRK_API void GRK_CALLCONV grk_deinitialize();
 
+/**
+ * Free the scratch memory that library threads keep between tiles
+ * for wavelet and T1 working buffers. Threads that are busy compressing
+ * or decompressing keep theirs.
+ *
+ * @return number of bytes freed
+ */
+GRK_API uint64_t GRK_CALLCONV grk_trim_scratch(void);
+
+/**
+ * Get the largest amount of scratch memory held at once,
+ * over all library threads
+ *
+ * @return number of bytes
+ */
+GRK_API uint64_t GRK_CALLCONV grk_scratch_high_water(void);
+
 /*
  ============================
  image functions definitions
@@ -1554,6 +1670,94 @@ GRK_API bool GRK_CALLCONV grk_set_error_handler(grk_msg_callback p_callback,
  */
 GRK_API void GRK_CALLCONV grk_destroy_codec(grk_codec *codec);
 
+/**
+ * Create thread pool, which may be attached to one or more codecs
+ *
+ * @param num_threads 	number of worker threads; zero selects
+ * 						the number of hardware threads
+ *
+ * @return a handle to the thread pool if successful, otherwise nullptr
+ */
+GRK_API grk_thread_pool* GRK_CALLCONV grk_thread_pool_create(
+		uint32_t num_threads);
+
+/**
+ * Destroy thread pool. The pool's threads are stopped once the last codec
+ * attached to the pool has been destroyed or attached to another pool.
+ *
+ * @param pool 			thread pool
+ */
+GRK_API void GRK_CALLCONV grk_thread_pool_destroy(grk_thread_pool *pool);
+
+/**
+ * Attach thread pool to codec. All compress and decompress work of the
+ * codec is run on this pool instead of the library-wide pool.
+ *
+ * @param codec 			JPEG 2000 codec
+ * @param pool 				thread pool, or nullptr for the library-wide pool
+ * @param max_concurrency 	maximum number of threads that the work of
+ * 							this codec is split over; zero for no limit
+ */
+GRK_API bool GRK_CALLCONV grk_set_thread_pool(grk_codec *codec,
+		grk_thread_pool *pool, uint32_t max_concurrency);
+
+/**
+ * Transcode a lossless Part-1 code stream to HTJ2K.
+ *
+ * Code blocks are decoded to quantized wavelet coefficients, which are
+ * compressed again with the HT block coder as a single lossless layer.
+ * Inverse and forward DWT, MCT and DC level shift are skipped, and the
+ * result decompresses to exactly the same image as the source.
+ * Tile grid, resolutions, code block and precinct sizes, progression order
+ * and MCT are carried over; tiles must be stored in order, and must
+ * share the coding style of the main header.
+ *
+ * @param decompressor 	decompressor, whose header has been read with
+ * 						grk_read_header, and which has not reduced resolutions,
+ * 						layers or precision, or set a decompress area
+ * @param image 		image returned by grk_read_header
+ * @param compressor 	compressor, created with grk_create_compress,
+ * 						and not yet initialized
+ *
+ * @return true if the code stream was transcoded and written to the
+ * compressor's stream
+ */
+GRK_API bool GRK_CALLCONV grk_transcode(grk_codec *decompressor,
+		grk_image *image, grk_codec *compressor);
+
+/**
+ * Get tier 1 encode statistics of compressor, per thread,
+ * accumulated over all tiles compressed so far
+ *
+ * @param codec 		JPEG 2000 compressor
+ * @param stats 		array of at least *num_threads entries,
+ * 						or nullptr to query the number of threads
+ * @param num_threads 	in: number of entries in stats;
+ * 						out: number of threads with statistics
+ */
+GRK_API bool GRK_CALLCONV grk_get_t1_encode_stats(grk_codec *codec,
+		grk_t1_thread_stats *stats, uint32_t *num_threads);
+
+/**
+ * Create cache of decoded code blocks, which may be attached to
+ * decompressors of the same code stream through their decompress parameters.
+ * Least recently used code blocks are evicted when the cache is full.
+ *
+ * @param max_bytes 	maximum number of bytes of cached code block samples
+ *
+ * @return a handle to the cache if successful, otherwise nullptr
+ */
+GRK_API grk_codeblock_cache* GRK_CALLCONV grk_codeblock_cache_create(
+		uint64_t max_bytes);
+
+/**
+ * Destroy cache of decoded code blocks
+ *
+ * @param cache 		code block cache
+ */
+GRK_API void GRK_CALLCONV grk_codeblock_cache_destroy(
+		grk_codeblock_cache *cache);
+
 /**
  * Create J2K/JP2 decompression structure
  *
@@ -1644,6 +1848,59 @@ GRK_API bool GRK_CALLCONV grk_decompress(grk_codec *p_decompressor,
 GRK_API bool GRK_CALLCONV grk_decompress_tile(grk_codec *codec,
 		grk_image *image, uint16_t tile_index);
 
+/**
+ * Start decompressing image on the codec's thread pool, and return
+ * immediately. The image must remain valid until grk_decompress_wait
+ * has returned. A finished decompression that was not waited on does not
+ * prevent a new one from starting: its result is discarded.
+ *
+ * @param	codec			JPEG 2000 codec
+ * @param	image			output image
+ * @param	callback		tile completion callback, or nullptr
+ * @param	user_data		user data passed to callback
+ *
+ * @return	true if decompression was started; false if the codec is
+ * 			not a decompressor, or an asynchronous decompression is
+ * 			already in progress
+ */
+GRK_API bool GRK_CALLCONV grk_decompress_async(grk_codec *codec,
+		grk_image *image, grk_decompress_callback callback, void *user_data);
+
+/**
+ * Start decompressing a specific tile on the codec's thread pool,
+ * and return immediately. See grk_decompress_async.
+ *
+ * @param	codec			JPEG 2000 codec
+ * @param	image			output image
+ * @param	tile_index		index of the tile to be decompressed
+ * @param	callback		tile completion callback, or nullptr
+ * @param	user_data		user data passed to callback
+ *
+ * @return	true if decompression was started
+ */
+GRK_API bool GRK_CALLCONV grk_decompress_tile_async(grk_codec *codec,
+		grk_image *image, uint16_t tile_index,
+		grk_decompress_callback callback, void *user_data);
+
+/**
+ * Request that an asynchronous decompression stop. No further tiles are
+ * started, and tiles being decompressed stop before their next code block.
+ * The decompression then fails, as reported by grk_decompress_wait.
+ *
+ * @param	codec			JPEG 2000 codec
+ */
+GRK_API void GRK_CALLCONV grk_decompress_cancel(grk_codec *codec);
+
+/**
+ * Wait for an asynchronous decompression to complete
+ *
+ * @param	codec			JPEG 2000 codec
+ *
+ * @return	true if the decompression succeeded; false if it failed,
+ * 			was cancelled, or no asynchronous decompression was started
+ */
+GRK_API bool GRK_CALLCONV grk_decompress_wait(grk_codec *codec);
+
 /**
  * Read tile header. This function allows one
  * to know the size of the tile that will be decoded.
@@ -1789,6 +2046,41 @@ GRK_API bool GRK_CALLCONV grk_compress_tile(grk_codec *codec,
 GRK_API bool GRK_CALLCONV grk_compress_with_plugin(grk_codec *codec,
 		grk_plugin_tile *tile);
 
+/*
+ * Callback function prototype for strip read function.
+ *
+ * Fills rows y up to y + num_rows of each component: comp_rows[compno]
+ * points to num_rows rows of the component's width, stored one after
+ * the other. Rows are relative to the top of the image.
+ */
+typedef bool (*grk_strip_read_fn)(uint32_t y, uint32_t num_rows,
+		int32_t **comp_rows, void *user_data);
+
+/**
+ * Encode an image into a JPEG 2000 code stream, reading image rows in
+ * strips from a callback, instead of from the image's component data.
+ * Call in place of grk_compress, between grk_start_compress and
+ * grk_end_compress.
+ *
+ * Memory used for uncompressed samples is bounded by a few hundred rows
+ * of the image, rather than by its full size, so that huge images can be
+ * compressed as a single tile. Only compressed code block data is kept for
+ * the whole image, so that rate control works as for grk_compress; output is
+ * identical to grk_compress, with early termination disabled.
+ *
+ * The image must have a single tile, and all components must have the same
+ * dimensions. Its component data is not used, and may be freed
+ * before grk_init_compress with grk_image_single_component_data_free.
+ *
+ * @param codec 		compressor handle
+ * @param fn			callback that reads image strips
+ * @param user_data		user data passed to callback
+ *
+ * @return 				true if successful, otherwise false
+ */
+GRK_API bool GRK_CALLCONV grk_compress_strips(grk_codec *codec,
+		grk_strip_read_fn fn, void *user_data);
+
 
 /**
  * End to compress the current image.
@@ -189,6 +189,7 @@ static inline long grok_lrintf(float f) {
 #include "util.h"
 #include "grok_exceptions.h"
 #include "ChunkBuffer.h"
+#include "ScratchArena.h"
 #include "BitIO.h"
 #include "BufferedStream.h"
 #include "image.h"
@@ -207,6 +208,7 @@ static inline long grok_lrintf(float f) {
 #include "TileComponent.h"
 #include "TileProcessor.h"
 #include <Wavelet.h>
+#include "SIMDKernels.h"
 #include "dwt_utils.h"
 #include "dwt.h"
 #include "sparse_array.h"
@@ -216,3 +218,5 @@ static inline long grok_lrintf(float f) {
 #include "plugin_bridge.h"
 #include "RateControl.h"
 #include "RateInfo.h"
+#include "CodeblockCache.h"
+#include "T1EncodeStats.h"
@@ -0,0 +1,136 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ RCT and ICT kernels over one chunk of samples. Compiled once per
+ instruction set: only include from SIMDKernelsImpl.h.
+ */
+
+namespace grk {
+namespace GRK_KERNEL_NS {
+
+/* Forward reversible MCT. */
+static void rct_encode(int32_t *c0, int32_t *c1, int32_t *c2, uint64_t n) {
+	uint64_t i = 0;
+#ifdef GRK_KERNEL_VREG
+	for (; i + VREG_INT_COUNT <= n; i += VREG_INT_COUNT) {
+		VREG r = LOADU(c0 + i);
+		VREG g = LOADU(c1 + i);
+		VREG b = LOADU(c2 + i);
+		VREG y = ADD(g, g);
+		y = ADD(y, b);
+		y = ADD(y, r);
+		y = SAR(y, 2);
+		STOREU(c0 + i, y);
+		STOREU(c1 + i, SUB(b, g));
+		STOREU(c2 + i, SUB(r, g));
+	}
+#endif
+	for (; i < n; ++i) {
+		int32_t r = c0[i];
+		int32_t g = c1[i];
+		int32_t b = c2[i];
+		c0[i] = (r + (g * 2) + b) >> 2;
+		c1[i] = b - g;
+		c2[i] = r - g;
+	}
+}
+
+/* Inverse reversible MCT. */
+static void rct_decode(int32_t *c0, int32_t *c1, int32_t *c2, uint64_t n) {
+	uint64_t i = 0;
+#ifdef GRK_KERNEL_VREG
+	for (; i + VREG_INT_COUNT <= n; i += VREG_INT_COUNT) {
+		VREG y = LOADU(c0 + i);
+		VREG u = LOADU(c1 + i);
+		VREG v = LOADU(c2 + i);
+		VREG g = SUB(y, SAR(ADD(u, v), 2));
+		STOREU(c0 + i, ADD(v, g));
+		STOREU(c1 + i, g);
+		STOREU(c2 + i, ADD(u, g));
+	}
+#endif
+	for (; i < n; ++i) {
+		int32_t y = c0[i];
+		int32_t u = c1[i];
+		int32_t v = c2[i];
+		int32_t g = y - ((u + v) >> 2);
+		c0[i] = v + g;
+		c1[i] = g;
+		c2[i] = u + g;
+	}
+}
+
+/* Forward irreversible MCT, in 13 bit fixed point. */
+static void ict_encode(int32_t *c0, int32_t *c1, int32_t *c2, uint64_t n) {
+	uint64_t i = 0;
+#ifdef GRK_KERNEL_VREG
+	for (; i + VREG_INT_COUNT <= n; i += VREG_INT_COUNT) {
+		VREG r = LOADU(c0 + i);
+		VREG g = LOADU(c1 + i);
+		VREG b = LOADU(c2 + i);
+		VREG y = ADD(ADD(fix_mul_v<2449>(r), fix_mul_v<4809>(g)),
+				fix_mul_v<934>(b));
+		VREG u = SUB(SUB(fix_mul_v<4096>(b), fix_mul_v<1382>(r)),
+				fix_mul_v<2714>(g));
+		VREG v = SUB(SUB(fix_mul_v<4096>(r), fix_mul_v<3430>(g)),
+				fix_mul_v<666>(b));
+		STOREU(c0 + i, y);
+		STOREU(c1 + i, u);
+		STOREU(c2 + i, v);
+	}
+#endif
+	for (; i < n; ++i) {
+		int32_t r = c0[i];
+		int32_t g = c1[i];
+		int32_t b = c2[i];
+		c0[i] = fix_mul(r, 2449) + fix_mul(g, 4809) + fix_mul(b, 934);
+		c1[i] = -fix_mul(r, 1382) - fix_mul(g, 2714) + fix_mul(b, 4096);
+		c2[i] = fix_mul(r, 4096) - fix_mul(g, 3430) - fix_mul(b, 666);
+	}
+}
+
+/* Inverse irreversible MCT. */
+static void ict_decode(float *c0, float *c1, float *c2, uint64_t n) {
+	uint64_t i = 0;
+#ifdef GRK_KERNEL_VREG
+	const VREGF vrv = LOAD_CST_F(1.402f);
+	const VREGF vgu = LOAD_CST_F(0.34413f);
+	const VREGF vgv = LOAD_CST_F(0.71414f);
+	const VREGF vbu = LOAD_CST_F(1.772f);
+	for (; i + VREG_INT_COUNT <= n; i += VREG_INT_COUNT) {
+		VREGF vy = LOADUF(c0 + i);
+		VREGF vu = LOADUF(c1 + i);
+		VREGF vv = LOADUF(c2 + i);
+		STOREUF(c0 + i, ADDF(vy, MULF(vv, vrv)));
+		STOREUF(c1 + i, SUBF(SUBF(vy, MULF(vu, vgu)), MULF(vv, vgv)));
+		STOREUF(c2 + i, ADDF(vy, MULF(vu, vbu)));
+	}
+#endif
+	for (; i < n; ++i) {
+		float y = c0[i];
+		float u = c1[i];
+		float v = c2[i];
+		c0[i] = y + (v * 1.402f);
+		c1[i] = y - (u * 0.34413f) - (v * 0.71414f);
+		c2[i] = y + (u * 1.772f);
+	}
+}
+
+}
+}
@@ -0,0 +1,68 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+#include "BlockQuantizer.h"
+#include "SIMDKernels.h"
+
+namespace grk {
+
+BlockQuantizer::BlockQuantizer(bool reversible, int32_t shift, float inv_step) :
+		m_reversible(reversible), m_shift(shift), m_inv_step(inv_step) {
+}
+
+BlockQuantizer BlockQuantizer::ht(bool reversible, int32_t shift, float inv_step) {
+	return BlockQuantizer(reversible, shift, inv_step);
+}
+
+uint32_t BlockQuantizer::quantize(const int32_t *src, uint32_t src_stride,
+		int32_t *dest, uint32_t w, uint32_t h) const {
+	auto quantize_ht = SIMDKernels::get()->quantize_ht[m_reversible];
+	uint32_t maximum = 0;
+	for (uint32_t j = 0; j < h; ++j) {
+		uint32_t row_max;
+		if (m_reversible)
+			row_max = quantize_ht(src, dest, w, (uint32_t) m_shift, 0, 0);
+		else
+			row_max = quantize_ht(src, dest, w, 0, m_inv_step,
+					(float) (1 << m_shift));
+		maximum = std::max(maximum, row_max);
+		src += src_stride;
+		dest += w;
+	}
+
+	return maximum;
+}
+
+uint32_t BlockQuantizer::quantize(const int16_t *src, uint32_t src_stride,
+		int32_t *dest, uint32_t w, uint32_t h) const {
+	assert(m_reversible);
+	auto widen16 = SIMDKernels::get()->widen16;
+	auto quantize_ht = SIMDKernels::get()->quantize_ht[1];
+	uint32_t maximum = 0;
+	for (uint32_t j = 0; j < h; ++j) {
+		widen16(src, dest, w);
+		maximum = std::max(maximum,
+				quantize_ht(dest, dest, w, (uint32_t) m_shift, 0, 0));
+		src += src_stride;
+		dest += w;
+	}
+
+	return maximum;
+}
+
+}
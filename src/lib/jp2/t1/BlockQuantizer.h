@@ -0,0 +1,63 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <cstdint>
+
+namespace grk {
+
+/**
+ * Converts wavelet coefficients into code block samples for the encoder.
+ *
+ * Inverse of Dequantizer: quantization and sign conversion are done in a
+ * single pass over the block.
+ */
+class BlockQuantizer {
+public:
+	/**
+	 * HT samples: sign-magnitude
+	 *
+	 * @param reversible true if coefficients are reversible
+	 * @param shift		alignment shift of magnitude (reversible), or
+	 * 					fixed point shift of quantized value (irreversible)
+	 * @param inv_step	inverse of quantization step size (irreversible only)
+	 */
+	static BlockQuantizer ht(bool reversible, int32_t shift, float inv_step);
+
+	/**
+	 * Quantize a block of samples from a strided source
+	 *
+	 * @return maximum of quantized samples, compared as unsigned
+	 */
+	uint32_t quantize(const int32_t *src, uint32_t src_stride, int32_t *dest,
+			uint32_t w, uint32_t h) const;
+
+	/**
+	 * Same as above, for reversible 16 bit samples
+	 */
+	uint32_t quantize(const int16_t *src, uint32_t src_stride, int32_t *dest,
+			uint32_t w, uint32_t h) const;
+
+private:
+	BlockQuantizer(bool reversible, int32_t shift, float inv_step);
+
+	bool m_reversible;
+	int32_t m_shift;
+	float m_inv_step;
+};
+
+}
@@ -0,0 +1,95 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "CodeblockCache.h"
+
+namespace grk {
+
+bool CodeblockKey::operator==(const CodeblockKey &rhs) const {
+	return tileno == rhs.tileno && compno == rhs.compno && resno == rhs.resno
+			&& bandno == rhs.bandno && x0 == rhs.x0 && y0 == rhs.y0
+			&& num_layers == rhs.num_layers
+			&& skipped_lsbs == rhs.skipped_lsbs
+			&& fix16_frac_bits == rhs.fix16_frac_bits;
+}
+
+size_t CodeblockKeyHash::operator()(const CodeblockKey &key) const {
+	uint64_t h = key.tileno;
+	h = h * 31 + key.compno;
+	h = h * 31 + key.resno;
+	h = h * 31 + key.bandno;
+	h = h * 1000003 + key.x0;
+	h = h * 1000003 + key.y0;
+	h = h * 31 + key.num_layers;
+	h = h * 31 + key.skipped_lsbs;
+	h = h * 31 + key.fix16_frac_bits;
+	return (size_t) (h ^ (h >> 32));
+}
+
+CodeblockCache::CodeblockCache(uint64_t max_bytes) :
+		m_max_bytes(max_bytes), m_bytes(0), m_hits(0), m_misses(0) {
+}
+
+CodeblockSamples CodeblockCache::get(const CodeblockKey &key) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_index.find(key);
+	if (it == m_index.end()) {
+		m_misses++;
+		return nullptr;
+	}
+	m_hits++;
+	m_lru.splice(m_lru.begin(), m_lru, it->second);
+
+	return it->second->second;
+}
+
+void CodeblockCache::put(const CodeblockKey &key,
+		std::vector<int32_t> &&samples) {
+	uint64_t bytes = samples.size() * sizeof(int32_t);
+	if (bytes > m_max_bytes)
+		return;
+	auto data = std::make_shared<const std::vector<int32_t> >(
+			std::move(samples));
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_index.find(key);
+	if (it != m_index.end()) {
+		m_bytes -= it->second->second->size() * sizeof(int32_t);
+		m_lru.erase(it->second);
+		m_index.erase(it);
+	}
+	while (m_bytes + bytes > m_max_bytes) {
+		auto &last = m_lru.back();
+		m_bytes -= last.second->size() * sizeof(int32_t);
+		m_index.erase(last.first);
+		m_lru.pop_back();
+	}
+	m_lru.emplace_front(key, data);
+	m_index[key] = m_lru.begin();
+	m_bytes += bytes;
+}
+
+uint64_t CodeblockCache::hits(void) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_hits;
+}
+
+uint64_t CodeblockCache::misses(void) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_misses;
+}
+
+}
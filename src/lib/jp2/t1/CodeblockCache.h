@@ -0,0 +1,101 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace grk {
+
+/**
+ * Identifies the decoded samples of a code block
+ */
+struct CodeblockKey {
+	uint32_t tileno;
+	uint32_t compno;
+	uint32_t resno;
+	uint32_t bandno;
+	/* code block origin, in band coordinates */
+	uint32_t x0;
+	uint32_t y0;
+	/* number of layers decoded */
+	uint32_t num_layers;
+	/* number of least significant bit planes that were not decoded */
+	uint32_t skipped_lsbs;
+	/* fractional bits of samples rounded to 16 bit fixed point,
+	 or zero if samples are exact */
+	uint32_t fix16_frac_bits;
+
+	bool operator==(const CodeblockKey &rhs) const;
+};
+
+struct CodeblockKeyHash {
+	size_t operator()(const CodeblockKey &key) const;
+};
+
+typedef std::shared_ptr<const std::vector<int32_t> > CodeblockSamples;
+
+/**
+ * Memory-bounded, least recently used cache of dequantized code block
+ * samples, shared by decompressors of the same code stream.
+ *
+ * Repeated region decodes of a large image mostly hit code blocks that
+ * were already decoded: these blocks are copied from the cache instead of
+ * being run through tier 1 again. The cache is thread safe.
+ */
+class CodeblockCache {
+public:
+	/**
+	 * @param max_bytes	maximum number of bytes of cached samples
+	 */
+	explicit CodeblockCache(uint64_t max_bytes);
+
+	/**
+	 * Look up code block samples, and mark them as most recently used
+	 *
+	 * @return samples, or nullptr if the code block is not cached
+	 */
+	CodeblockSamples get(const CodeblockKey &key);
+
+	/**
+	 * Add code block samples, evicting least recently used blocks
+	 * until the cache fits in its memory budget
+	 */
+	void put(const CodeblockKey &key, std::vector<int32_t> &&samples);
+
+	uint64_t hits(void) const;
+	uint64_t misses(void) const;
+
+private:
+	typedef std::pair<CodeblockKey, CodeblockSamples> Entry;
+
+	uint64_t m_max_bytes;
+	uint64_t m_bytes;
+	uint64_t m_hits;
+	uint64_t m_misses;
+	/* most recently used entries first */
+	std::list<Entry> m_lru;
+	std::unordered_map<CodeblockKey, std::list<Entry>::iterator,
+			CodeblockKeyHash> m_index;
+	mutable std::mutex m_mutex;
+};
+
+}
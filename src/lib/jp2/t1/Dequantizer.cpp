@@ -0,0 +1,84 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+#include "Dequantizer.h"
+#include "SIMDKernels.h"
+
+namespace grk {
+
+Dequantizer::Dequantizer(bool ht, uint32_t roishift, bool reversible,
+		uint32_t shift, float stepsize) :
+		m_ht(ht), m_roishift(roishift), m_reversible(reversible), m_shift(
+				shift), m_stepsize(stepsize) {
+}
+
+Dequantizer Dequantizer::part1(uint32_t roishift, bool reversible,
+		float stepsize) {
+	return Dequantizer(false, roishift, reversible, 0, stepsize);
+}
+
+Dequantizer Dequantizer::ht(uint32_t roishift, bool reversible,
+		uint32_t shift, float stepsize) {
+	// magnitude never reaches threshold of 2^31
+	return Dequantizer(true, roishift >= 31 ? 0 : roishift, reversible,
+			shift, stepsize);
+}
+
+void Dequantizer::operator()(const int32_t *src, int32_t *dest,
+		uint32_t len) const {
+	auto kernels = SIMDKernels::get();
+	if (m_ht) {
+		kernels->dequantize_ht[m_reversible][m_roishift != 0](src, dest, len,
+				m_roishift, m_shift, m_stepsize);
+	} else {
+		// ROI shift of 31 or more leaves nothing in the block
+		if (m_roishift >= 31) {
+			memset(dest, 0, len * sizeof(int32_t));
+			return;
+		}
+		kernels->dequantize_part1[m_reversible][m_roishift != 0](src, dest,
+				len, m_roishift, 0, m_stepsize);
+	}
+}
+
+void Dequantizer::dequantize(const int32_t *src, uint32_t src_stride,
+		int32_t *dest, uint32_t dest_stride, uint32_t w, uint32_t h) const {
+	for (uint32_t j = 0; j < h; ++j) {
+		(*this)(src, dest, w);
+		src += src_stride;
+		dest += dest_stride;
+	}
+}
+
+void Dequantizer::dequantize(int32_t *src, uint32_t src_stride, int16_t *dest,
+		uint32_t dest_stride, uint32_t w, uint32_t h,
+		uint32_t frac_bits) const {
+	auto kernels = SIMDKernels::get();
+	float scale = (float) (1U << frac_bits);
+	for (uint32_t j = 0; j < h; ++j) {
+		(*this)(src, src, w);
+		if (m_reversible)
+			kernels->narrow16(src, dest, w);
+		else
+			kernels->narrow_fix16((float*) src, dest, w, scale);
+		src += src_stride;
+		dest += dest_stride;
+	}
+}
+
+}
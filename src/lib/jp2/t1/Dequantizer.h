@@ -0,0 +1,87 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <cstdint>
+
+namespace grk {
+
+/**
+ * Converts decoded code block samples into wavelet coefficients.
+ *
+ * ROI shift, sign conversion and dequantization are done in a single
+ * pass over the block, writing directly into the destination buffer.
+ * Reversible coefficients are stored as int32_t, and irreversible
+ * coefficients as float, or both as int16_t when the tile buffer holds
+ * 16 bit coefficients.
+ */
+class Dequantizer {
+public:
+	/**
+	 * Part-1 samples: two's complement, with one fractional bit
+	 *
+	 * @param roishift	ROI shift
+	 * @param reversible true if coefficients are reversible
+	 * @param stepsize	quantization step size (irreversible only)
+	 */
+	static Dequantizer part1(uint32_t roishift, bool reversible, float stepsize);
+
+	/**
+	 * HT samples: sign-magnitude, with magnitude aligned to bit 30
+	 *
+	 * @param roishift	ROI shift
+	 * @param reversible true if coefficients are reversible
+	 * @param shift		alignment shift of magnitude (reversible only)
+	 * @param stepsize	quantization step size (irreversible only)
+	 */
+	static Dequantizer ht(uint32_t roishift, bool reversible, uint32_t shift,
+			float stepsize);
+
+	/**
+	 * Dequantize a run of samples. src and dest may be identical.
+	 */
+	void operator()(const int32_t *src, int32_t *dest, uint32_t len) const;
+
+	/**
+	 * Dequantize a block of samples into a strided destination
+	 */
+	void dequantize(const int32_t *src, uint32_t src_stride, int32_t *dest,
+			uint32_t dest_stride, uint32_t w, uint32_t h) const;
+
+	/**
+	 * Dequantize a block of samples into a strided 16 bit destination.
+	 * Samples are dequantized in place in src first.
+	 *
+	 * @param frac_bits	fractional bits of 16 bit fixed point
+	 * 					irreversible coefficients
+	 */
+	void dequantize(int32_t *src, uint32_t src_stride, int16_t *dest,
+			uint32_t dest_stride, uint32_t w, uint32_t h,
+			uint32_t frac_bits) const;
+
+private:
+	Dequantizer(bool ht, uint32_t roishift, bool reversible, uint32_t shift,
+			float stepsize);
+
+	bool m_ht;
+	uint32_t m_roishift;
+	bool m_reversible;
+	uint32_t m_shift;
+	float m_stepsize;
+};
+
+}
@@ -18,16 +18,21 @@
 #include "T1Factory.h"
 #include "T1Decoder.h"
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 namespace grk {
 
 T1Decoder::T1Decoder(grk_tcp *tcp,
 					uint16_t blockw,
-					uint16_t blockh) :
+					uint16_t blockh,
+					const std::atomic<bool> *cancel) :
 		codeblock_width((uint16_t) (blockw ? (uint32_t) 1 << blockw : 0)),
 		codeblock_height((uint16_t) (blockh ? (uint32_t) 1 << blockh : 0)),
+		pool(ThreadPool::get()),
+		cancel(cancel),
 		decodeBlocks(nullptr){
-	for (auto i = 0U; i < ThreadPool::get()->num_threads(); ++i) {
+	for (auto i = 0U; i < pool->num_threads(); ++i) {
 		threadStructs.push_back(
 				T1Factory::get_t1(false, tcp, codeblock_width,
 						codeblock_height));
@@ -48,41 +53,162 @@ bool T1Decoder::decompress(std::vector<decodeBlockInfo*> *blocks) {
 	for (uint64_t i = 0; i < maxBlocks; ++i) {
 		decodeBlocks[i] = blocks->operator[](i);
 	}
-	std::atomic<int> blockCount(-1);
 	success = true;
-    std::vector< std::future<int> > results;
-    for(size_t i = 0; i < ThreadPool::get()->num_threads(); ++i) {
-        results.emplace_back(
-            ThreadPool::get()->enqueue([this, maxBlocks, &blockCount] {
-                auto threadnum =  ThreadPool::get()->thread_number(std::this_thread::get_id());
-                assert(threadnum >= 0);
-                while (true) {
-                	uint64_t index = (uint64_t)++blockCount;
-                	if (index >= maxBlocks)
-                		break;
-					decodeBlockInfo *block = decodeBlocks[index];
-					if (!success){
-						delete block;
-						return 0;
-					}
-					auto impl = threadStructs[(size_t)threadnum];
-					if (!impl->decompress(block)) {
-						success = false;
-						delete block;
-						return 0;
-					}
-					impl->postDecode(block);
-					delete block;
-                }
-                return 0;
-            })
-        );
-    }
-    for(auto && result: results){
-        result.get();
-    }
+	pool->parallel_for(maxBlocks, [this](size_t index) {
+		auto threadnum =  pool->thread_number(std::this_thread::get_id());
+		assert(threadnum >= 0);
+		decompress_block((size_t)threadnum, decodeBlocks[index]);
+	});
 	delete[] decodeBlocks;
 	return success;
 }
 
+bool T1Decoder::decompress(std::vector<decodeBlockInfo*> *blocks,
+		const std::vector< std::function<bool(const resolution_wait_fn&)> > &wavelets) {
+	if (wavelets.empty())
+		return decompress(blocks);
+	if (!blocks)
+		return false;
+	// lower resolutions of all components go first,
+	// so that every component's wavelet can start early
+	std::stable_sort(blocks->begin(), blocks->end(),
+			[](const decodeBlockInfo *a, const decodeBlockInfo *b) {
+		return a->resno < b->resno;
+	});
+	auto maxBlocks = blocks->size();
+	uint32_t numcomps = (uint32_t)wavelets.size();
+	uint32_t numres = 0;
+	for (auto &block : *blocks) {
+		assert(block->compno < numcomps);
+		numres = max<uint32_t>(numres, block->resno + 1);
+	}
+	// number of blocks still to be decoded, per component and resolution
+	size_t num_remaining = (size_t)numcomps * numres;
+	std::unique_ptr<std::atomic<uint64_t>[]> remaining(
+			new std::atomic<uint64_t>[num_remaining]);
+	for (size_t i = 0; i < num_remaining; ++i)
+		remaining[i] = 0;
+	for (auto &block : *blocks)
+		remaining[block->compno * numres + block->resno]++;
+	std::atomic<size_t> next_block(0);
+	// signalled whenever the last block of a resolution is decoded
+	std::mutex done_mutex;
+	std::condition_variable done;
+	success = true;
+
+	// claim and decode the next block, if any are left
+	auto decode_next = [this, blocks, maxBlocks, numres, &remaining, &next_block,
+						&done_mutex, &done]() {
+		size_t index = next_block++;
+		if (index >= maxBlocks)
+			return false;
+		auto threadnum =  pool->thread_number(std::this_thread::get_id());
+		assert(threadnum >= 0);
+		auto block = blocks->operator[](index);
+		auto counter = block->compno * numres + block->resno;
+		decompress_block((size_t)threadnum, block);
+		if (--remaining[counter] == 0) {
+			std::unique_lock<std::mutex> lock(done_mutex);
+			done.notify_all();
+		}
+		return true;
+	};
+	std::vector<resolution_wait_fn> waits;
+	for (uint32_t compno = 0; compno < numcomps; ++compno) {
+		waits.push_back([compno, numres, &remaining, &decode_next,
+						 &done_mutex, &done](uint32_t resno) {
+			for (uint32_t r = 0; r <= resno && r < numres; ++r) {
+				auto &counter = remaining[compno * numres + r];
+				while (counter) {
+					if (decode_next())
+						continue;
+					// all blocks are claimed: sleep until the
+					// threads decoding this resolution are done
+					std::unique_lock<std::mutex> lock(done_mutex);
+					done.wait(lock, [&counter] { return counter == 0; });
+				}
+			}
+		});
+	}
+	std::atomic_bool wavelet_success(true);
+	// the first numcomps indices run the wavelets,
+	// all other indices decode blocks
+	pool->parallel_for(numcomps + maxBlocks,
+			[numcomps, &wavelets, &waits, &wavelet_success, &decode_next](size_t index) {
+		if (index < numcomps) {
+			if (!wavelets[index](waits[index]))
+				wavelet_success = false;
+		} else {
+			decode_next();
+		}
+	});
+
+	return success && wavelet_success;
+}
+
+bool T1Decoder::decompress_block(size_t threadnum, decodeBlockInfo *block){
+	if (cancel && *cancel)
+		success = false;
+	if (!success){
+		delete block;
+		return false;
+	}
+	auto impl = threadStructs[threadnum];
+	{
+		// T1 working buffers live until the block is dequantized
+		ScratchArena::Frame frame;
+		if (!impl->decompress(block)) {
+			success = false;
+			delete block;
+			return false;
+		}
+		impl->postDecode(block);
+	}
+	auto cblk = block->cblk;
+	if (block->cache && cblk->seg_buffers.get_len()) {
+		// read back the dequantized samples, before the wavelet transform
+		// overwrites them
+		uint32_t cblk_w = cblk->x1 - cblk->x0;
+		uint32_t cblk_h = cblk->y1 - cblk->y0;
+		auto tilec = block->tilec;
+		std::vector<int32_t> samples((size_t)cblk_w * cblk_h);
+		bool rc = true;
+		if (block->tiledp16) {
+			// cached irreversible samples are float, already rounded to
+			// fixed point: the cache key records the fractional bits
+			auto src = block->tiledp16;
+			auto dest = samples.data();
+			auto kernels = SIMDKernels::get();
+			float scale = 1.0f / (float)(1U << tilec->buf->coeff16_frac_bits);
+			for (uint32_t j = 0; j < cblk_h; ++j) {
+				if (block->qmfbid == 1)
+					kernels->widen16(src, dest, cblk_w);
+				else
+					kernels->widen_fix16(src, (float*)dest, cblk_w, scale);
+				src += tilec->width();
+				dest += cblk_w;
+			}
+		} else if (tilec->whole_tile_decoding) {
+			auto src = block->tiledp;
+			auto dest = samples.data();
+			for (uint32_t j = 0; j < cblk_h; ++j) {
+				memcpy(dest, src, cblk_w * sizeof(int32_t));
+				src += tilec->width();
+				dest += cblk_w;
+			}
+		} else {
+			rc = tilec->m_sa->read(block->x, block->y, block->x + cblk_w,
+					block->y + cblk_h, samples.data(), 1, cblk_w, false);
+		}
+		if (rc)
+			block->cache->put(block->cache_key, std::move(samples));
+	}
+	// compressed segments are no longer needed: release them now,
+	// rather than with the rest of the tile component
+	cblk->cleanup();
+	delete block;
+
+	return true;
+}
+
 }
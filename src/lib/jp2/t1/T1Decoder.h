@@ -27,14 +27,37 @@ class T1Interface;
 
 class T1Decoder {
 public:
-	T1Decoder(grk_tcp *tcp, uint16_t blockw, uint16_t blockh);
+	/**
+	 * @param cancel	if not null, then no further code blocks are decoded
+	 * 					once this is set, and decompression fails
+	 */
+	T1Decoder(grk_tcp *tcp, uint16_t blockw, uint16_t blockh,
+			const std::atomic<bool> *cancel);
 	~T1Decoder();
 	bool decompress(std::vector<decodeBlockInfo*> *blocks);
 
+	/**
+	 * Decode code blocks and run the inverse wavelets in the same batch.
+	 * Each wavelet waits per resolution, and helps decode the blocks
+	 * it is waiting for, instead of waiting for all blocks up front.
+	 * Once no block is left to claim, it sleeps until the blocks
+	 * of that resolution being decoded by other threads are done.
+	 *
+	 * @param blocks	code blocks of all components
+	 * @param wavelets	inverse wavelet of each component, taking a resolution wait
+	 */
+	bool decompress(std::vector<decodeBlockInfo*> *blocks,
+			const std::vector< std::function<bool(const resolution_wait_fn&)> > &wavelets);
+
 private:
+	bool decompress_block(size_t threadnum, decodeBlockInfo *block);
+
 	uint16_t codeblock_width, codeblock_height;  //nominal dimensions of block
+	// pool that runs the blocks: per-thread state is indexed by its thread numbers
+	ThreadPool *pool;
 	std::vector<T1Interface*> threadStructs;
 	std::atomic_bool success;
+	const std::atomic<bool> *cancel;
 
 	decodeBlockInfo** decodeBlocks;
 };
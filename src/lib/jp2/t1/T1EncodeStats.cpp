@@ -0,0 +1,71 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+
+namespace grk {
+
+T1ThreadStats::T1ThreadStats() :
+		distortion(0), blocks(0), passes(0), bytes(0), time_ns(0) {
+}
+
+void T1ThreadStats::add(const T1ThreadStats &rhs) {
+	distortion += rhs.distortion;
+	blocks += rhs.blocks;
+	passes += rhs.passes;
+	bytes += rhs.bytes;
+	time_ns += rhs.time_ns;
+}
+
+void T1EncodeStats::add(const std::vector<T1ThreadStats> &stats) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_stats.size() < stats.size())
+		m_stats.resize(stats.size());
+	for (size_t i = 0; i < stats.size(); ++i)
+		m_stats[i].add(stats[i]);
+}
+
+void T1EncodeStats::add(const T1EncodeStats &rhs) {
+	std::vector<T1ThreadStats> stats;
+	{
+		std::lock_guard<std::mutex> lock(rhs.m_mutex);
+		stats = rhs.m_stats;
+	}
+	add(stats);
+}
+
+void T1EncodeStats::clear(void) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.clear();
+}
+
+uint32_t T1EncodeStats::get(grk_t1_thread_stats *stats,
+		uint32_t num_threads) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (stats) {
+		for (uint32_t i = 0; i < num_threads && i < m_stats.size(); ++i) {
+			stats[i].blocks = m_stats[i].blocks;
+			stats[i].passes = m_stats[i].passes;
+			stats[i].bytes = m_stats[i].bytes;
+			stats[i].time_ns = m_stats[i].time_ns;
+		}
+	}
+
+	return (uint32_t) m_stats.size();
+}
+
+}
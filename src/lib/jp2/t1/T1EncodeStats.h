@@ -0,0 +1,79 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace grk {
+
+/**
+ * Code block encode totals of one thread.
+ * Aligned to a cache line, so that threads do not share lines.
+ */
+struct alignas(64) T1ThreadStats {
+	T1ThreadStats();
+	void add(const T1ThreadStats &rhs);
+
+	/* decrease in distortion, for rate control */
+	double distortion;
+	uint64_t blocks;
+	uint64_t passes;
+	uint64_t bytes;
+	uint64_t time_ns;
+};
+
+/**
+ * Tier 1 encode statistics of a compressor, per pool thread,
+ * accumulated over all tiles
+ */
+class T1EncodeStats {
+public:
+	/**
+	 * Add totals of one tile
+	 *
+	 * @param stats		totals, indexed by pool thread number
+	 */
+	void add(const std::vector<T1ThreadStats> &stats);
+
+	/**
+	 * Add statistics of another compressor or tile
+	 */
+	void add(const T1EncodeStats &rhs);
+
+	/**
+	 * Discard all statistics
+	 */
+	void clear(void);
+
+	/**
+	 * Get statistics
+	 *
+	 * @param stats		array of at least num_threads entries, or nullptr
+	 * @param num_threads	number of entries in stats
+	 *
+	 * @return number of threads with statistics
+	 */
+	uint32_t get(grk_t1_thread_stats *stats, uint32_t num_threads) const;
+
+private:
+	std::vector<T1ThreadStats> m_stats;
+	mutable std::mutex m_mutex;
+};
+
+}
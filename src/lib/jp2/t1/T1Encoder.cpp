@@ -18,17 +18,35 @@
 #include "grok_includes.h"
 #include "T1Factory.h"
 #include "T1Encoder.h"
+#include <chrono>
 
 namespace grk {
 
+// one in sampleStride code blocks is coded to the last pass,
+// to estimate the slope threshold of rate control
+const uint32_t sampleStride = 8;
+// minimum number of sampled code blocks for an estimate
+const uint32_t minSampledBlocks = 16;
+// coding stops this far below the estimated slope threshold
+const double stopSlopeMargin = 0.5;
+// blocks are handed out to threads in chunks of at most this many samples
+const uint64_t maxChunkArea = 4 * 64 * 64;
+// aim for at least this many chunks per thread, to balance the load
+const uint64_t minChunksPerThread = 8;
+
 T1Encoder::T1Encoder(grk_tcp *tcp, grk_tcd_tile *tile, uint32_t encodeMaxCblkW,
-		uint32_t encodeMaxCblkH, bool needsRateControl) :
+		uint32_t encodeMaxCblkH, bool needsRateControl, uint64_t targetLength,
+		T1EncodeStats *stats) :
 		tile(tile),
+		pool(ThreadPool::get()),
+		threadStats(pool->num_threads()),
+		stats(stats),
 		needsRateControl(needsRateControl),
-		encodeBlocks(nullptr),
-		blockCount(-1)
+		targetLength(needsRateControl ? targetLength : 0),
+		stopSlope(0),
+		encodeBlocks(nullptr)
 {
-	for (auto i = 0U; i < ThreadPool::get()->num_threads(); ++i) {
+	for (auto i = 0U; i < pool->num_threads(); ++i) {
 		threadStructs.push_back(
 				T1Factory::get_t1(true, tcp, encodeMaxCblkW, encodeMaxCblkH));
 	}
@@ -37,22 +55,64 @@ T1Encoder::~T1Encoder() {
 	for (auto &t : threadStructs)
 		delete t;
 }
-bool T1Encoder::compress(size_t threadId, uint64_t maxBlocks) {
+void T1Encoder::compress(size_t threadId, uint64_t index) {
 	auto impl = threadStructs[threadId];
-	uint64_t index = (uint64_t)++blockCount;
-	if (index >= maxBlocks)
-		return false;
+	auto &threadStat = threadStats[threadId];
 	encodeBlockInfo *block = encodeBlocks[index];
+	auto start = std::chrono::steady_clock::now();
 	uint32_t max = 0;
-	impl->preEncode(block, tile, max);
-	auto dist = impl->compress(block, tile, max, needsRateControl);
-	if (needsRateControl) {
-		std::unique_lock<std::mutex> lk(distortion_mutex);
-		tile->distotile += dist;
+	block->stop_slope = stopSlope;
+	double dist;
+	{
+		// T1 working buffers live until the block is coded
+		ScratchArena::Frame frame;
+		impl->preEncode(block, tile, max);
+		dist = impl->compress(block, tile, max, needsRateControl);
 	}
+	if (needsRateControl)
+		threadStat.distortion += dist;
+	auto cblk = block->cblk;
+	threadStat.blocks++;
+	threadStat.passes += cblk->num_passes_encoded;
+	if (cblk->num_passes_encoded)
+		threadStat.bytes += cblk->passes[cblk->num_passes_encoded - 1].rate;
+	threadStat.time_ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
 	delete block;
-	return true;
+}
 
+/*
+ Code blocks in chunks of roughly equal area, so that threads claim
+ work less often when code blocks are small
+ */
+void T1Encoder::compressBlocks(const std::vector<uint64_t> &indices) {
+	if (indices.empty())
+		return;
+	uint64_t totalArea = 0;
+	for (auto &i : indices) {
+		auto cblk = encodeBlocks[i]->cblk;
+		totalArea += (uint64_t) (cblk->x1 - cblk->x0) * (cblk->y1 - cblk->y0);
+	}
+	uint64_t chunkArea = std::min<uint64_t>(maxChunkArea,
+			totalArea / (minChunksPerThread * pool->concurrency()));
+	// chunk c holds indices[chunks[c]] up to indices[chunks[c+1]]
+	std::vector<size_t> chunks;
+	uint64_t area = chunkArea;
+	for (size_t i = 0; i < indices.size(); ++i) {
+		if (area >= chunkArea) {
+			chunks.push_back(i);
+			area = 0;
+		}
+		auto cblk = encodeBlocks[indices[i]]->cblk;
+		area += (uint64_t) (cblk->x1 - cblk->x0) * (cblk->y1 - cblk->y0);
+	}
+	chunks.push_back(indices.size());
+	pool->parallel_for(chunks.size() - 1, [this, &indices, &chunks](size_t c) {
+		auto threadnum =  pool->thread_number(std::this_thread::get_id());
+		assert(threadnum >= 0);
+		for (size_t i = chunks[c]; i < chunks[c + 1]; ++i)
+			compress((size_t)threadnum, indices[i]);
+	});
 }
 bool T1Encoder::compress(std::vector<encodeBlockInfo*> *blocks) {
 	if (!blocks || blocks->size() == 0)
@@ -63,23 +123,143 @@ bool T1Encoder::compress(std::vector<encodeBlockInfo*> *blocks) {
 	for (uint64_t i = 0; i < maxBlocks; ++i)
 		encodeBlocks[i] = blocks->operator[](i);
 	blocks->clear();
-    std::vector< std::future<int> > results;
-    for(size_t i = 0; i < ThreadPool::get()->num_threads(); ++i) {
-          results.emplace_back(
-            ThreadPool::get()->enqueue([this, maxBlocks] {
-                auto threadnum =  ThreadPool::get()->thread_number(std::this_thread::get_id());
-                while(compress((size_t)threadnum, maxBlocks)){
+	stopSlope = 0;
+	for (auto &s : threadStats)
+		s = T1ThreadStats();
+	if (targetLength && maxBlocks >= sampleStride * minSampledBlocks) {
+		// code a sample of the blocks to the last pass first
+		std::vector<grk_tcd_cblk_enc*> sampled;
+		std::vector<uint64_t> remaining;
+		std::vector<uint64_t> sampledIndices;
+		uint64_t sampledPixels = 0;
+		uint64_t totalPixels = 0;
+		for (uint64_t i = 0; i < maxBlocks; ++i) {
+			auto cblk = encodeBlocks[i]->cblk;
+			uint64_t numPix = (uint64_t) (cblk->x1 - cblk->x0)
+					* (cblk->y1 - cblk->y0);
+			totalPixels += numPix;
+			// scatter samples, so that they do not line up with block columns
+			if ((uint32_t) (i * 2654435761U) < UINT_MAX / sampleStride) {
+				sampled.push_back(cblk);
+				sampledIndices.push_back(i);
+				sampledPixels += numPix;
+			} else {
+				remaining.push_back(i);
+			}
+		}
+		compressBlocks(sampledIndices);
+		stopSlope = stopSlopeMargin * estimateSlopeThreshold(sampled,
+				(uint64_t) ((double) targetLength * (double) sampledPixels
+						/ (double) totalPixels));
+		compressBlocks(remaining);
+	} else {
+		std::vector<uint64_t> all(maxBlocks);
+		for (uint64_t i = 0; i < maxBlocks; ++i)
+			all[i] = i;
+		compressBlocks(all);
+	}
+	delete[] encodeBlocks;
+	encodeBlocks = nullptr;
+	finish();
+
+	return true;
+}
+bool T1Encoder::compressBatch(std::vector<encodeBlockInfo*> *blocks) {
+	if (!blocks || blocks->size() == 0)
+		return true;
 
-                }
-                return 0;
-            })
-        );
-    }
-    for(auto && result: results){
-        result.get();
-    }
+	auto maxBlocks = blocks->size();
+	encodeBlocks = new encodeBlockInfo*[maxBlocks];
+	std::vector<uint64_t> all(maxBlocks);
+	for (uint64_t i = 0; i < maxBlocks; ++i) {
+		encodeBlocks[i] = blocks->operator[](i);
+		all[i] = i;
+	}
+	blocks->clear();
+	compressBlocks(all);
 	delete[] encodeBlocks;
+	encodeBlocks = nullptr;
+
 	return true;
 }
+void T1Encoder::finish(void) {
+	if (needsRateControl) {
+		for (auto &s : threadStats)
+			tile->distotile += s.distortion;
+	}
+	if (stats)
+		stats->add(threadStats);
+}
+
+/*
+ Estimate the slope threshold that rate control will settle on, from code blocks
+ coded to the last pass: the smallest slope for which the passes of the sampled
+ blocks, selected as in TileProcessor::make_layer_simple, fit into sampledLength bytes.
+ Returns zero if all passes fit.
+ */
+double T1Encoder::estimateSlopeThreshold(
+		const std::vector<grk_tcd_cblk_enc*> &sampled,
+		uint64_t sampledLength) const {
+	double minSlope = DBL_MAX;
+	double maxSlope = 0;
+	for (auto &cblk : sampled) {
+		for (uint32_t passno = 0; passno < cblk->num_passes_encoded; ++passno) {
+			auto pass = cblk->passes + passno;
+			uint32_t dr = passno ? pass->rate - (pass - 1)->rate : pass->rate;
+			double dd =	passno ? pass->distortiondec - (pass - 1)->distortiondec :
+							pass->distortiondec;
+			if (!dr || dd <= 0)
+				continue;
+			minSlope = std::min<double>(minSlope, dd / dr);
+			maxSlope = std::max<double>(maxSlope, dd / dr);
+		}
+	}
+	if (maxSlope == 0)
+		return 0;
+	// number of bytes kept by rate control at a given threshold
+	auto length = [&sampled](double thresh) {
+		uint64_t len = 0;
+		for (auto &cblk : sampled) {
+			// slopes are taken from the last included pass
+			uint32_t included = 0;
+			for (uint32_t passno = 0; passno < cblk->num_passes_encoded;
+					++passno) {
+				auto pass = cblk->passes + passno;
+				auto last = included ? cblk->passes + included - 1 : nullptr;
+				uint32_t dr = last ? pass->rate - last->rate : pass->rate;
+				double dd =	last ? pass->distortiondec - last->distortiondec :
+								pass->distortiondec;
+				if (!dr) {
+					if (dd != 0)
+						included = passno + 1;
+					continue;
+				}
+				if (dd >= thresh * dr)
+					included = passno + 1;
+			}
+			if (included)
+				len += cblk->passes[included - 1].rate;
+		}
+		return len;
+	};
+	if (length(minSlope) <= sampledLength)
+		return 0;
+	// bisect in log domain
+	double lower = log(minSlope);
+	double upper = log(maxSlope);
+	for (uint32_t i = 0; i < 32; ++i) {
+		double mid = (lower + upper) / 2;
+		if (length(exp(mid)) > sampledLength)
+			lower = mid;
+		else
+			upper = mid;
+	}
+
+	return exp(upper);
+}
+
+double T1Encoder::getStopSlope(void) const {
+	return stopSlope;
+}
 
 }
@@ -23,21 +23,58 @@ namespace grk {
 
 class T1Encoder {
 public:
+	/**
+	 * @param tcp				tile coding parameters
+	 * @param tile				tile
+	 * @param encodeMaxCblkW	maximum code block width
+	 * @param encodeMaxCblkH	maximum code block height
+	 * @param needsRateControl	true if distortion is needed for rate control
+	 * @param targetLength		if > 0, then code blocks are terminated early,
+	 * 							for a tile coded to this number of bytes
+	 * @param stats				if not null, then per-thread statistics are added
+	 * 							to it
+	 */
 	T1Encoder(grk_tcp *tcp, grk_tcd_tile *tile, uint32_t encodeMaxCblkW,
-			uint32_t encodeMaxCblkH, bool needsRateControl);
+			uint32_t encodeMaxCblkH, bool needsRateControl,
+			uint64_t targetLength, T1EncodeStats *stats);
 	~T1Encoder();
 	bool compress(std::vector<encodeBlockInfo*> *blocks);
 
+	/**
+	 * Compress one batch of a tile's code blocks, coding all passes.
+	 * Distortion and statistics are accumulated over batches, until finish()
+	 * is called.
+	 */
+	bool compressBatch(std::vector<encodeBlockInfo*> *blocks);
+
+	/**
+	 * Add distortion of all batches to tile, and statistics to stats
+	 */
+	void finish(void);
+
+	/**
+	 * Get slope below which code blocks stopped coding, or zero
+	 * if all coding passes were coded
+	 */
+	double getStopSlope(void) const;
+
 private:
-	bool compress(size_t threadId, uint64_t maxBlocks);
+	void compress(size_t threadId, uint64_t index);
+	void compressBlocks(const std::vector<uint64_t> &indices);
+	double estimateSlopeThreshold(const std::vector<grk_tcd_cblk_enc*> &sampled,
+			uint64_t sampledLength) const;
 
 	grk_tcd_tile *tile;
+	// pool that runs the blocks: per-thread state is indexed by its thread numbers
+	ThreadPool *pool;
 	std::vector<T1Interface*> threadStructs;
-	mutable std::mutex distortion_mutex;
+	// per-thread totals, reduced once all blocks are coded
+	std::vector<T1ThreadStats> threadStats;
+	T1EncodeStats *stats;
 	bool needsRateControl;
-	mutable std::mutex block_mutex;
+	uint64_t targetLength;
+	double stopSlope;
 	encodeBlockInfo** encodeBlocks;
-	std::atomic<int64_t> blockCount;
 
 };
 
@@ -26,7 +26,9 @@ struct decodeBlockInfo {
 	decodeBlockInfo() :
 			tilec(nullptr),
 			tiledp(nullptr),
+			tiledp16(nullptr),
 			cblk(nullptr),
+			compno(0),
 			resno(0),
 			bandno(0),
 			stepsize(0),
@@ -35,11 +37,16 @@ struct decodeBlockInfo {
 			qmfbid(0),
 			x(0),
 			y(0),
-			k_msbs(0)
+			k_msbs(0),
+			skipped_lsbs(0),
+			cache(nullptr)
 	{	}
 	TileComponent *tilec;
 	int32_t *tiledp;
+	/* set instead of tiledp if the tile stores 16 bit coefficients */
+	int16_t *tiledp16;
 	grk_tcd_cblk_dec *cblk;
+	uint32_t compno;
 	uint32_t resno;
 	uint32_t bandno;
 	float stepsize;
@@ -50,10 +57,17 @@ struct decodeBlockInfo {
 	uint32_t x;
 	uint32_t y;
 	uint8_t k_msbs;
+	/* number of least significant bit planes that are not decoded */
+	uint32_t skipped_lsbs;
+	/* if not null, the decoded samples are added to this cache */
+	CodeblockCache *cache;
+	CodeblockKey cache_key;
 };
 
 struct encodeBlockInfo {
 	encodeBlockInfo() :	tiledp(nullptr),
+						tiledp16(nullptr),
+						stride(0),
 			            cblk(nullptr),
 						compno(0),
 						resno(0),
@@ -72,10 +86,15 @@ struct encodeBlockInfo {
 		unencodedData(nullptr),
 #endif
 					mct_numcomps(0),
-					k_msbs(0)
+					k_msbs(0),
+					stop_slope(0)
 	{
 	}
 	int32_t *tiledp;
+	/* set instead of tiledp if the tile stores 16 bit coefficients */
+	int16_t *tiledp16;
+	/* distance between rows of tiledp, in samples */
+	uint32_t stride;
 	grk_tcd_cblk_enc *cblk;
 	uint32_t compno;
 	uint32_t resno;
@@ -95,6 +114,9 @@ struct encodeBlockInfo {
 #endif
 	uint32_t mct_numcomps;
 	uint8_t k_msbs;
+	/* if > 0, then coding stops after the first bit plane
+	 * whose distortion-rate slope is below this value */
+	double stop_slope;
 };
 
 class T1Interface {
@@ -0,0 +1,200 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Tier1.h"
+#include "T1Encoder.h"
+#include "T1StripEncoder.h"
+#include <algorithm>
+
+namespace grk {
+
+T1StripEncoder::T1StripEncoder(grk_tcp *tcp, grk_tcd_tile *tile,
+		const double *mct_norms, uint32_t mct_numcomps, bool needsRateControl,
+		T1EncodeStats *stats) :
+		tcp(tcp),
+		tile(tile),
+		mct_norms(mct_norms),
+		mct_numcomps(mct_numcomps),
+		needsRateControl(needsRateControl),
+		stats(stats),
+		encoder(nullptr)
+{
+}
+T1StripEncoder::~T1StripEncoder() {
+	for (auto &s : strips)
+		grk_aligned_free(s.data);
+	delete encoder;
+}
+bool T1StripEncoder::init(void) {
+	uint32_t maxCblkW = 0;
+	uint32_t maxCblkH = 0;
+	for (uint32_t compno = 0; compno < tile->numcomps; ++compno) {
+		auto tccp = tcp->tccps + compno;
+		maxCblkW = std::max<uint32_t>(maxCblkW, (uint32_t) (1 << tccp->cblkw));
+		maxCblkH = std::max<uint32_t>(maxCblkH, (uint32_t) (1 << tccp->cblkh));
+	}
+	encoder = new T1Encoder(tcp, tile, maxCblkW, maxCblkH, needsRateControl,
+			0, stats);
+	tile->distotile = 0;
+	for (uint32_t compno = 0; compno < tile->numcomps; ++compno) {
+		auto tilec = tile->comps + compno;
+		auto tccp = tcp->tccps + compno;
+		compStrips.push_back(strips.size());
+		for (uint32_t resno = 0; resno < tilec->numresolutions; ++resno) {
+			auto res = tilec->resolutions + resno;
+			// same code block size as in TileComponent::init
+			uint32_t cbgwidthexpn = resno ? tccp->prcw[resno] - 1 : tccp->prcw[resno];
+			uint32_t cbgheightexpn = resno ? tccp->prch[resno] - 1 : tccp->prch[resno];
+			uint32_t cblkwidthexpn = std::min<uint32_t>(tccp->cblkw, cbgwidthexpn);
+			uint32_t cblkheightexpn = std::min<uint32_t>(tccp->cblkh, cbgheightexpn);
+			for (uint32_t bandno = 0; bandno < res->numbands; ++bandno) {
+				BandStrip strip;
+				strip.compno = compno;
+				strip.resno = resno;
+				strip.tilec = tilec;
+				strip.tccp = tccp;
+				strip.band = res->bands + bandno;
+				strip.width = strip.band->x1 - strip.band->x0;
+				strip.nominalBlockSize = (size_t) (1 << cblkwidthexpn)
+						* (1 << cblkheightexpn);
+				uint32_t max_height = 0;
+				for (uint64_t precno = 0; precno < (uint64_t) res->pw * res->ph;
+						++precno) {
+					auto prc = strip.band->precincts + precno;
+					for (uint64_t cblkno = 0; cblkno < (uint64_t) prc->cw * prc->ch;
+							++cblkno) {
+						auto cblk = prc->cblks.enc + cblkno;
+						strip.cblks.push_back(cblk);
+						max_height = std::max<uint32_t>(max_height,
+								cblk->y1 - cblk->y0);
+					}
+				}
+				std::sort(strip.cblks.begin(), strip.cblks.end(),
+						[](const grk_tcd_cblk_enc *a, const grk_tcd_cblk_enc *b) {
+							return a->y0 < b->y0 || (a->y0 == b->y0 && a->x0 < b->x0);
+						});
+				if (!strip.cblks.empty() && strip.band->isEmpty()) {
+					// no rows will arrive for code blocks of an empty band
+					strips.push_back(strip);
+					if (!encodeEmpty(&strips.back()))
+						return false;
+					continue;
+				}
+				if (!strip.cblks.empty()) {
+					auto first = strip.cblks.front();
+					strip.row_y0 = first->y0 - strip.band->y0;
+					strip.row_y1 = first->y1 - strip.band->y0;
+					strip.data = (int32_t*) grk_aligned_malloc(
+							(size_t) strip.width * max_height * sizeof(int32_t));
+					if (!strip.data) {
+						GROK_ERROR("Out of memory allocating band strip");
+						strips.push_back(strip);
+						return false;
+					}
+				}
+				strips.push_back(strip);
+			}
+		}
+	}
+
+	return true;
+}
+bool T1StripEncoder::push(uint32_t compno, uint32_t resno,
+		uint32_t band_index, uint32_t row, const int32_t *data) {
+	auto strip = &strips[compStrips[compno]
+			+ (resno ? 1 + (resno - 1) * 3 + band_index : 0)];
+	if (strip->next_cblk == strip->cblks.size() || row < strip->row_y0
+			|| row >= strip->row_y1) {
+		GROK_ERROR("Band row %u of component %u, resolution %u is out of order",
+				row, compno, resno);
+		return false;
+	}
+	memcpy(strip->data + (size_t) (row - strip->row_y0) * strip->width, data,
+			strip->width * sizeof(int32_t));
+	if (row + 1 == strip->row_y1)
+		return encodeRow(strip);
+
+	return true;
+}
+bool T1StripEncoder::encodeEmpty(BandStrip *strip) {
+	std::vector<encodeBlockInfo*> blocks;
+	for (auto &cblk : strip->cblks) {
+		if (!cblk->alloc_data(strip->nominalBlockSize)) {
+			for (auto &b : blocks)
+				delete b;
+			return false;
+		}
+		blocks.push_back(Tier1::createEncodeBlock(strip->tilec, strip->tccp,
+				strip->compno, strip->resno, strip->band, cblk, mct_norms,
+				mct_numcomps));
+	}
+	if (!encoder->compressBatch(&blocks))
+		return false;
+	for (auto &cblk : strip->cblks)
+		cblk->compact();
+	strip->next_cblk = strip->cblks.size();
+
+	return true;
+}
+bool T1StripEncoder::encodeRow(BandStrip *strip) {
+	auto band = strip->band;
+	std::vector<encodeBlockInfo*> blocks;
+	std::vector<grk_tcd_cblk_enc*> cblks;
+	size_t i = strip->next_cblk;
+	for (; i < strip->cblks.size(); ++i) {
+		auto cblk = strip->cblks[i];
+		if (cblk->y0 - band->y0 != strip->row_y0)
+			break;
+		if (!cblk->alloc_data(strip->nominalBlockSize)) {
+			for (auto &b : blocks)
+				delete b;
+			return false;
+		}
+		auto block = Tier1::createEncodeBlock(strip->tilec, strip->tccp,
+				strip->compno, strip->resno, band, cblk, mct_norms,
+				mct_numcomps);
+		block->tiledp = strip->data + (cblk->x0 - band->x0);
+		block->stride = strip->width;
+		blocks.push_back(block);
+		cblks.push_back(cblk);
+	}
+	if (!encoder->compressBatch(&blocks))
+		return false;
+	for (auto &cblk : cblks)
+		cblk->compact();
+	strip->next_cblk = i;
+	if (i < strip->cblks.size()) {
+		strip->row_y0 = strip->cblks[i]->y0 - band->y0;
+		strip->row_y1 = strip->cblks[i]->y1 - band->y0;
+	}
+
+	return true;
+}
+bool T1StripEncoder::finish(void) {
+	for (auto &s : strips) {
+		if (s.next_cblk != s.cblks.size()) {
+			GROK_ERROR("Code blocks of component %u, resolution %u were not encoded",
+					s.compno, s.resno);
+			return false;
+		}
+	}
+	encoder->finish();
+
+	return true;
+}
+
+}
@@ -0,0 +1,105 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "grok_includes.h"
+#include <vector>
+
+namespace grk {
+
+class T1Encoder;
+
+/**
+ Encodes the code blocks of a tile from sub-band rows, as they are produced
+ by a line based forward wavelet transform.
+
+ Each band buffers a single row of code blocks. Once the last row of a code
+ block row arrives, its code blocks are encoded, their compressed data
+ is shrunk to size, and the buffer is reused for the next code block row.
+ */
+class T1StripEncoder {
+public:
+	/**
+	 * @param tcp				tile coding parameters
+	 * @param tile				tile
+	 * @param mct_norms			MCT norms
+	 * @param mct_numcomps		number of MCT components
+	 * @param needsRateControl	true if distortion is needed for rate control
+	 * @param stats				if not null, then per-thread statistics are added
+	 * 							to it
+	 */
+	T1StripEncoder(grk_tcp *tcp, grk_tcd_tile *tile, const double *mct_norms,
+			uint32_t mct_numcomps, bool needsRateControl, T1EncodeStats *stats);
+	~T1StripEncoder();
+	bool init(void);
+
+	/**
+	 * Add a row of a sub-band
+	 *
+	 * @param compno		component number
+	 * @param resno			resolution number
+	 * @param band_index	index of band in resolution
+	 * @param row			row, relative to top of band
+	 * @param data			row samples
+	 */
+	bool push(uint32_t compno, uint32_t resno, uint32_t band_index,
+			uint32_t row, const int32_t *data);
+
+	/**
+	 * Add distortion to tile and statistics to stats, once all rows
+	 * have been pushed
+	 */
+	bool finish(void);
+
+private:
+	struct BandStrip {
+		BandStrip() : compno(0), resno(0), tilec(nullptr), tccp(nullptr),
+				band(nullptr), width(0), nominalBlockSize(0), next_cblk(0),
+				row_y0(0), row_y1(0), data(nullptr) {
+		}
+		uint32_t compno;
+		uint32_t resno;
+		TileComponent *tilec;
+		grk_tccp *tccp;
+		grk_tcd_band *band;
+		uint32_t width;
+		size_t nominalBlockSize;
+		// code blocks of band, sorted by rows
+		std::vector<grk_tcd_cblk_enc*> cblks;
+		// first code block of current code block row
+		size_t next_cblk;
+		// band rows of current code block row
+		uint32_t row_y0, row_y1;
+		int32_t *data;
+	};
+	bool encodeRow(BandStrip *strip);
+	bool encodeEmpty(BandStrip *strip);
+
+	grk_tcp *tcp;
+	grk_tcd_tile *tile;
+	const double *mct_norms;
+	uint32_t mct_numcomps;
+	bool needsRateControl;
+	T1EncodeStats *stats;
+	T1Encoder *encoder;
+	std::vector<BandStrip> strips;
+	// index of first strip of each component
+	std::vector<size_t> compStrips;
+};
+
+}
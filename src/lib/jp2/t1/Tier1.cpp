@@ -21,11 +21,62 @@
 
 namespace grk {
 
+Tier1::Tier1() : m_cache(nullptr), m_tileno(0), m_num_layers(0),
+		m_cancel(nullptr) {
+}
+
+void Tier1::setCodeblockCache(CodeblockCache *cache, uint32_t tileno,
+		uint32_t num_layers) {
+	m_cache = cache;
+	m_tileno = tileno;
+	m_num_layers = num_layers;
+}
+
+void Tier1::setCancel(const std::atomic<bool> *cancel) {
+	m_cancel = cancel;
+}
+
+encodeBlockInfo* Tier1::createEncodeBlock(TileComponent *tilec,
+		grk_tccp *tccp, uint32_t compno, uint32_t resno, grk_tcd_band *band,
+		grk_tcd_cblk_enc *cblk, const double *mct_norms,
+		uint32_t mct_numcomps) {
+	int32_t x = (int32_t)(cblk->x0 - band->x0);
+	int32_t y = (int32_t)(cblk->y0 - band->y0);
+	if (band->bandno & 1) {
+		grk_tcd_resolution *pres = &tilec->resolutions[resno - 1];
+		x += pres->x1 - pres->x0;
+	}
+	if (band->bandno & 2) {
+		grk_tcd_resolution *pres = &tilec->resolutions[resno - 1];
+		y += pres->y1 - pres->y0;
+	}
+	auto block = new encodeBlockInfo();
+	block->compno = compno;
+	block->bandno = band->bandno;
+	block->cblk = cblk;
+	block->cblk_sty = tccp->cblk_sty;
+	block->qmfbid = tccp->qmfbid;
+	block->resno = resno;
+	block->inv_step = (int32_t)band->inv_step;
+	block->inv_step_ht = 1.0f/band->stepsize;
+	block->stepsize = band->stepsize;
+	block->x = (uint32_t)x;
+	block->y = (uint32_t)y;
+	block->mct_norms = mct_norms;
+	block->mct_numcomps = mct_numcomps;
+	block->k_msbs = (uint8_t)(band->numbps - cblk->numbps);
+
+	return block;
+}
+
 bool Tier1::encodeCodeblocks(grk_tcp *tcp,
 							grk_tcd_tile *tile,
 							const double *mct_norms,
 							uint32_t mct_numcomps,
-							bool doRateControl) {
+							bool doRateControl,
+							uint64_t targetLength,
+							double *stopSlope,
+							T1EncodeStats *stats) {
 
 	uint32_t compno, resno, bandno, precno;
 	tile->distotile = 0;
@@ -44,46 +95,23 @@ bool Tier1::encodeCodeblocks(grk_tcp *tcp,
 				for (precno = 0; precno < res->pw * res->ph; ++precno) {
 					grk_tcd_precinct *prc = &band->precincts[precno];
 					int32_t cblkno;
-					int32_t bandOdd = band->bandno & 1;
-					int32_t bandModTwo = band->bandno & 2;
 
 					for (cblkno = 0; cblkno < (int32_t) (prc->cw * prc->ch);
 							++cblkno) {
-						grk_tcd_cblk_enc *cblk = prc->cblks.enc + cblkno;
-						int32_t x = (int32_t)(cblk->x0 - band->x0);
-						int32_t y = (int32_t)(cblk->y0 - band->y0);
-						if (bandOdd) {
-							grk_tcd_resolution *pres = &tilec->resolutions[resno
-									- 1];
-							x += pres->x1 - pres->x0;
-						}
-						if (bandModTwo) {
-							grk_tcd_resolution *pres = &tilec->resolutions[resno
-									- 1];
-							y += pres->y1 - pres->y0;
-						}
-
 						maxCblkW = std::max<uint32_t>(maxCblkW,
 								(uint32_t) (1 << tccp->cblkw));
 						maxCblkH = std::max<uint32_t>(maxCblkH,
 								(uint32_t) (1 << tccp->cblkh));
-						auto block = new encodeBlockInfo();
-						block->compno = compno;
-						block->bandno = band->bandno;
-						block->cblk = cblk;
-						block->cblk_sty = tccp->cblk_sty;
-						block->qmfbid = tccp->qmfbid;
-						block->resno = resno;
-						block->inv_step = (int32_t)band->inv_step;
-						block->inv_step_ht = 1.0f/band->stepsize;
-						block->stepsize = band->stepsize;
-						block->x = (uint32_t)x;
-						block->y = (uint32_t)y;
-						block->mct_norms = mct_norms;
-						block->mct_numcomps = mct_numcomps;
-						block->tiledp = tilec->buf->get_ptr( resno,
-								bandno, (uint32_t) x, (uint32_t) y);
-						block->k_msbs = (uint8_t)(band->numbps - cblk->numbps);
+						auto block = createEncodeBlock(tilec, tccp, compno,
+								resno, band, prc->cblks.enc + cblkno, mct_norms,
+								mct_numcomps);
+						if (tilec->buf->coeff16)
+							block->tiledp16 = tilec->buf->get_ptr16(resno,
+									bandno, block->x, block->y);
+						else
+							block->tiledp = tilec->buf->get_ptr( resno,
+									bandno, block->x, block->y);
+						block->stride = tilec->width();
 						blocks.push_back(block);
 
 					}
@@ -91,23 +119,36 @@ bool Tier1::encodeCodeblocks(grk_tcp *tcp,
 			}
 		}
 	}
-	T1Encoder encoder(tcp, tile, maxCblkW, maxCblkH, doRateControl);
-	return encoder.compress(&blocks);
+	T1Encoder encoder(tcp, tile, maxCblkW, maxCblkH, doRateControl,
+			targetLength, stats);
+	bool rc = encoder.compress(&blocks);
+	if (stopSlope)
+		*stopSlope = encoder.getStopSlope();
+
+	return rc;
 }
 
-bool Tier1::prepareDecodeCodeblocks(TileComponent *tilec, grk_tccp *tccp,
-		std::vector<decodeBlockInfo*> *blocks) {
+bool Tier1::prepareDecodeCodeblocks(uint32_t compno, TileComponent *tilec,
+		grk_tccp *tccp, uint32_t image_precision, uint32_t discarded_bits,
+		bool mct, std::vector<decodeBlockInfo*> *blocks) {
 	uint32_t resno, bandno, precno;
 	if (!tilec->buf->alloc_component_data_decode()) {
 		GROK_ERROR( "Not enough memory for tile data");
 		return false;
 	}
+	// irreversible samples stored as 16 bit fixed point are rounded,
+	// so they are cached apart from exact samples
+	uint32_t fix16_frac_bits = (tilec->buf->coeff16 && tccp->qmfbid != 1) ?
+			tilec->buf->coeff16_frac_bits : 0;
 
 	for (resno = 0; resno < tilec->minimum_num_resolutions; ++resno) {
 		grk_tcd_resolution *res = &tilec->resolutions[resno];
 
 		for (bandno = 0; bandno < res->numbands; ++bandno) {
 			grk_tcd_band *GRK_RESTRICT band = &res->bands[bandno];
+			uint32_t skipped_lsbs = Quantizer::getSkippedBitplanes(tccp, band,
+					resno, (uint8_t)bandno, tilec->minimum_num_resolutions,
+					image_precision, discarded_bits, mct);
 
 			for (precno = 0; precno < res->pw * res->ph; ++precno) {
 				grk_tcd_precinct *precinct = &band->precincts[precno];
@@ -153,10 +194,55 @@ bool Tier1::prepareDecodeCodeblocks(TileComponent *tilec, grk_tccp *tccp,
 						assert(x >= 0);
 						assert(y >= 0);
 
+						CodeblockKey key = { m_tileno, compno, resno,
+								band->bandno, cblk->x0 - band->x0,
+								cblk->y0 - band->y0, m_num_layers,
+								skipped_lsbs, fix16_frac_bits };
+						if (m_cache) {
+							auto samples = m_cache->get(key);
+							if (samples) {
+								uint32_t cblk_w = cblk->x1 - cblk->x0;
+								uint32_t cblk_h = cblk->y1 - cblk->y0;
+								assert(samples->size() == (size_t)cblk_w * cblk_h);
+								if (tilec->buf->coeff16) {
+									auto dest = tilec->buf->get_ptr16(resno, bandno,
+											(uint32_t) x, (uint32_t) y);
+									auto src = samples->data();
+									auto kernels = SIMDKernels::get();
+									float scale = (float)(1U << tilec->buf->coeff16_frac_bits);
+									for (uint32_t j = 0; j < cblk_h; ++j) {
+										if (tccp->qmfbid == 1)
+											kernels->narrow16(src, dest, cblk_w);
+										else
+											kernels->narrow_fix16((const float*)src,
+													dest, cblk_w, scale);
+										dest += tilec->width();
+										src += cblk_w;
+									}
+								} else if (tilec->whole_tile_decoding) {
+									auto dest = tilec->buf->get_ptr(resno, bandno,
+											(uint32_t) x, (uint32_t) y);
+									auto src = samples->data();
+									for (uint32_t j = 0; j < cblk_h; ++j) {
+										memcpy(dest, src, cblk_w * sizeof(int32_t));
+										dest += tilec->width();
+										src += cblk_w;
+									}
+								} else if (!tilec->m_sa->write((uint32_t) x,
+										(uint32_t) y, (uint32_t) x + cblk_w,
+										(uint32_t) y + cblk_h, samples->data(), 1,
+										cblk_w, true)) {
+									GROK_ERROR("Unable to write cached code block");
+									return false;
+								}
+								continue;
+							}
+						}
 
 						auto block = new decodeBlockInfo();
 						block->bandno = band->bandno;
 						block->cblk = cblk;
+						block->compno = compno;
 						block->cblk_sty = tccp->cblk_sty;
 						block->qmfbid = tccp->qmfbid;
 						block->resno = resno;
@@ -165,9 +251,16 @@ bool Tier1::prepareDecodeCodeblocks(TileComponent *tilec, grk_tccp *tccp,
 						block->tilec = tilec;
 						block->x = (uint32_t)x;
 						block->y = (uint32_t)y;
-						block->tiledp = tilec->buf->get_ptr( resno, bandno,
-								(uint32_t) x, (uint32_t) y);
+						if (tilec->buf->coeff16)
+							block->tiledp16 = tilec->buf->get_ptr16(resno, bandno,
+									(uint32_t) x, (uint32_t) y);
+						else
+							block->tiledp = tilec->buf->get_ptr( resno, bandno,
+									(uint32_t) x, (uint32_t) y);
 						block->k_msbs = (uint8_t)(band->numbps - cblk->numbps);
+						block->skipped_lsbs = skipped_lsbs;
+						block->cache = m_cache;
+						block->cache_key = key;
 						blocks->push_back(block);
 					}
 
@@ -182,8 +275,16 @@ bool Tier1::prepareDecodeCodeblocks(TileComponent *tilec, grk_tccp *tccp,
 bool Tier1::decodeCodeblocks(grk_tcp *tcp,
 		                    uint16_t blockw, uint16_t blockh,
 		                    std::vector<decodeBlockInfo*> *blocks) {
-	T1Decoder decoder(tcp, blockw, blockh);
+	T1Decoder decoder(tcp, blockw, blockh, m_cancel);
 	return decoder.decompress(blocks);
 }
 
+bool Tier1::decodeCodeblocks(grk_tcp *tcp,
+		                    uint16_t blockw, uint16_t blockh,
+		                    std::vector<decodeBlockInfo*> *blocks,
+		                    const std::vector< std::function<bool(const resolution_wait_fn&)> > &wavelets) {
+	T1Decoder decoder(tcp, blockw, blockh, m_cancel);
+	return decoder.decompress(blocks, wavelets);
+}
+
 }
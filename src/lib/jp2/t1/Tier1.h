@@ -25,20 +25,101 @@ namespace grk {
 
 class Tier1 {
 public:
+	Tier1();
 
+	/**
+	 * Cache decoded code blocks of a tile
+	 *
+	 * @param cache			code block cache, or nullptr to disable caching
+	 * @param tileno		tile number
+	 * @param num_layers	number of layers decoded
+	 */
+	void setCodeblockCache(CodeblockCache *cache, uint32_t tileno,
+			uint32_t num_layers);
+
+	/**
+	 * Stop decoding code blocks once a flag is set
+	 *
+	 * @param cancel		cancellation flag, or nullptr
+	 */
+	void setCancel(const std::atomic<bool> *cancel);
+
+	/**
+	 * Encode code blocks of a tile
+	 *
+	 * @param tcp				tile coding parameters
+	 * @param tile				tile
+	 * @param mct_norms			MCT norms
+	 * @param mct_numcomps		number of MCT components
+	 * @param doRateControl		true if rate control is needed
+	 * @param targetLength		if > 0, then coding passes that rate control is
+	 * 							estimated to discard, for a tile of this many bytes,
+	 * 							are not coded
+	 * @param stopSlope			set to the slope below which code blocks stopped
+	 * 							coding, or zero if all coding passes were coded
+	 * @param stats				if not null, then per-thread statistics are added
+	 * 							to it
+	 */
 	bool encodeCodeblocks(	grk_tcp *tcp,
 							grk_tcd_tile *tile,
 							const double *mct_norms,
-			uint32_t mct_numcomps, bool doRateControl);
+			uint32_t mct_numcomps, bool doRateControl,
+			uint64_t targetLength, double *stopSlope,
+			T1EncodeStats *stats);
 
-	bool prepareDecodeCodeblocks(TileComponent *tilec, grk_tccp *tccp,
-			std::vector<decodeBlockInfo*> *blocks);
+	/**
+	 * Create encode block for a code block. All fields are set,
+	 * except for the sample pointer tiledp and its stride.
+	 *
+	 * @param tilec			tile component
+	 * @param tccp			tile component coding parameters
+	 * @param compno		component number
+	 * @param resno			resolution number
+	 * @param band			band holding code block
+	 * @param cblk			code block
+	 * @param mct_norms		MCT norms
+	 * @param mct_numcomps	number of MCT components
+	 */
+	static encodeBlockInfo* createEncodeBlock(TileComponent *tilec,
+			grk_tccp *tccp, uint32_t compno, uint32_t resno, grk_tcd_band *band,
+			grk_tcd_cblk_enc *cblk, const double *mct_norms,
+			uint32_t mct_numcomps);
+
+	/**
+	 * Prepare code blocks of a tile component for decoding.
+	 * Code blocks found in the code block cache are copied
+	 * to the tile component, and are not decoded.
+	 *
+	 * @param compno			component number
+	 * @param tilec				tile component
+	 * @param tccp				tile component coding parameters
+	 * @param image_precision	component precision
+	 * @param discarded_bits	number of least significant sample bits that the
+	 * 							application discards: bit planes too small to
+	 * 							matter are not decoded
+	 * @param mct				true if a multiple component transform is applied
+	 * @param blocks			code blocks to decode
+	 */
+	bool prepareDecodeCodeblocks(uint32_t compno, TileComponent *tilec,
+			grk_tccp *tccp, uint32_t image_precision, uint32_t discarded_bits,
+			bool mct, std::vector<decodeBlockInfo*> *blocks);
 
 	bool decodeCodeblocks(	grk_tcp *tcp,
 							uint16_t blockw,
 							uint16_t blockh,
 							std::vector<decodeBlockInfo*> *blocks);
 
+	bool decodeCodeblocks(	grk_tcp *tcp,
+							uint16_t blockw,
+							uint16_t blockh,
+							std::vector<decodeBlockInfo*> *blocks,
+							const std::vector< std::function<bool(const resolution_wait_fn&)> > &wavelets);
+
+private:
+	CodeblockCache *m_cache;
+	uint32_t m_tileno;
+	uint32_t m_num_layers;
+	const std::atomic<bool> *m_cancel;
 };
 
 }
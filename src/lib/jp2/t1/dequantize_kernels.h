@@ -0,0 +1,117 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ Code block dequantization kernels used by Dequantizer. Compiled once per
+ instruction set: only include from SIMDKernelsImpl.h.
+ */
+
+namespace grk {
+namespace GRK_KERNEL_NS {
+
+/**
+ * Part-1 kernel: ROI shift on magnitude, then either drop the fractional bit
+ * (reversible) or scale by step size (irreversible)
+ */
+template<bool REV, bool ROI> static void dequantize_part1(const int32_t *src,
+		int32_t *dest, uint32_t len, uint32_t roishift, uint32_t shift,
+		float stepsize) {
+	(void) shift;
+	uint32_t i = 0;
+	const int32_t thresh = ROI ? (1 << roishift) : 0;
+#ifdef GRK_KERNEL_VINT
+	const vint vthresh = vset(thresh - 1);
+	const vfloat vstep = vsetf(stepsize);
+	for (; i + vlen <= len; i += vlen) {
+		vint v = vload(src + i);
+		if (ROI) {
+			vint mag = vabs(v);
+			vint mask = vcmpgt(mag, vthresh);
+			vint shifted = vsign(vsrl(mag, roishift), v);
+			v = vor(vand(mask, shifted), vandnot(mask, v));
+		}
+		if (REV)
+			vstore(dest + i, vsra(vadd(v, vsrl(v, 31)), 1));
+		else
+			vstore(dest + i, vcastf(vmulf(vcvt(v), vstep)));
+	}
+#endif
+	for (; i < len; ++i) {
+		int32_t v = src[i];
+		if (ROI) {
+			int32_t mag = v < 0 ? -v : v;
+			if (mag >= thresh) {
+				mag >>= roishift;
+				v = v < 0 ? -mag : mag;
+			}
+		}
+		if (REV)
+			dest[i] = v / 2;
+		else
+			((float*) dest)[i] = (float) v * stepsize;
+	}
+}
+
+/**
+ * HT kernel: ROI shift on magnitude, then either align magnitude (reversible)
+ * or scale by step size (irreversible), and apply sign
+ */
+template<bool REV, bool ROI> static void dequantize_ht(const int32_t *src,
+		int32_t *dest, uint32_t len, uint32_t roishift, uint32_t shift,
+		float stepsize) {
+	uint32_t i = 0;
+	const int32_t thresh = ROI ? (1 << roishift) : 0;
+#ifdef GRK_KERNEL_VINT
+	const vint vthresh = vset(thresh - 1);
+	const vint vmag_mask = vset(0x7FFFFFFF);
+	const vint vsign_mask = vset((int32_t) 0x80000000);
+	const vfloat vstep = vsetf(stepsize);
+	for (; i + vlen <= len; i += vlen) {
+		vint v = vload(src + i);
+		vint mag = vand(v, vmag_mask);
+		if (ROI) {
+			vint mask = vcmpgt(mag, vthresh);
+			mag = vor(vand(mask, vsrl(mag, roishift)), vandnot(mask, mag));
+		}
+		if (REV) {
+			vint val = vsrl(mag, shift);
+			vint neg = vsra(v, 31);
+			vstore(dest + i, vsub(vxor(val, neg), neg));
+		} else {
+			vint val = vcastf(vmulf(vcvt(mag), vstep));
+			vstore(dest + i, vxor(val, vand(v, vsign_mask)));
+		}
+	}
+#endif
+	for (; i < len; ++i) {
+		int32_t v = src[i];
+		int32_t mag = v & 0x7FFFFFFF;
+		if (ROI && mag >= thresh)
+			mag >>= roishift;
+		if (REV) {
+			int32_t val = mag >> shift;
+			dest[i] = (v & 0x80000000) ? -val : val;
+		} else {
+			float val = (float) mag * stepsize;
+			((float*) dest)[i] = (v & 0x80000000) ? -val : val;
+		}
+	}
+}
+
+}
+}
@@ -0,0 +1,80 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ Code block quantization kernels used by BlockQuantizer. Compiled once per
+ instruction set: only include from SIMDKernelsImpl.h.
+ */
+
+namespace grk {
+namespace GRK_KERNEL_NS {
+
+/**
+ * HT kernel: either align magnitude (reversible) or scale by inverse
+ * step size (irreversible), and move sign to bit 31
+ */
+template<bool REV> static uint32_t quantize_ht(const int32_t *src,
+		int32_t *dest, uint32_t len, uint32_t shift, float inv_step,
+		float scale) {
+	uint32_t i = 0;
+	uint32_t maximum = 0;
+#ifdef GRK_KERNEL_VINT
+	const vint vsign_mask = vset((int32_t) 0x80000000);
+	const vfloat vinv_step = vsetf(inv_step);
+	const vfloat vscale = vsetf(scale);
+	vint vmax = vset(0);
+	for (; i + vlen <= len; i += vlen) {
+		vint v = vload(src + i);
+		vint res;
+		if (REV) {
+			res = vor(vand(v, vsign_mask), vsll(vabs(v), shift));
+			vmax = vmaxu(vmax, res);
+		} else {
+			vint t = vcvttf(vmulf(vmulf(vcvt(v), vinv_step), vscale));
+			vint val = vabs(t);
+			vmax = vmaxu(vmax, val);
+			res = vor(vand(t, vsign_mask), val);
+		}
+		vstore(dest + i, res);
+	}
+	maximum = vhmaxu(vmax);
+#endif
+	for (; i < len; ++i) {
+		int32_t temp = src[i];
+		if (REV) {
+			int32_t val = temp >= 0 ? temp : -temp;
+			int32_t sign = (int32_t) ((temp >= 0) ? 0U : 0x80000000);
+			int32_t res = sign | (val << shift);
+			dest[i] = res;
+			if ((uint32_t) res > maximum)
+				maximum = (uint32_t) res;
+		} else {
+			int32_t t = (int32_t) ((float) temp * inv_step * scale);
+			int32_t val = t >= 0 ? t : -t;
+			if ((uint32_t) val > maximum)
+				maximum = (uint32_t) val;
+			int32_t sign = t >= 0 ? 0 : (int32_t) 0x80000000;
+			dest[i] = sign | val;
+		}
+	}
+
+	return maximum;
+}
+
+}
+}
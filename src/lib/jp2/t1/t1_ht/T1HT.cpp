@@ -25,6 +25,8 @@ using namespace ojph::local;
 
 #include "grok_includes.h"
 #include "T1HT.h"
+#include "Dequantizer.h"
+#include "BlockQuantizer.h"
 #include "testing.h"
 #include <algorithm>
 using namespace std;
@@ -33,23 +35,26 @@ using namespace std;
 namespace grk {
 namespace t1_ht {
 
+// the block coder works on whole quads, so it may touch
+// samples past the last row and column of the code block
+static size_t unencoded_len(size_t w, size_t h) {
+	return w * ((h + 3) & ~(size_t) 3) + 4;
+}
+
 T1HT::T1HT(bool isEncoder,
 			grk_tcp *tcp,
 			uint32_t maxCblkW,
 			uint32_t maxCblkH) :
-				coded_data_size(isEncoder ? 0 : (uint32_t)(maxCblkW*maxCblkH* sizeof(int32_t))),
-				coded_data(isEncoder ? nullptr : new uint8_t[coded_data_size]),
-				unencoded_data_size(maxCblkW*maxCblkH),
-				unencoded_data(new int32_t[unencoded_data_size]),
+				unencoded_data(nullptr),
 				allocator( new mem_fixed_allocator),
 				elastic_alloc(new mem_elastic_allocator(1048576))
 {
 	(void) isEncoder;
 	(void) tcp;
+	(void) maxCblkW;
+	(void) maxCblkH;
 }
 T1HT::~T1HT() {
-   delete[] coded_data;
-   delete[] unencoded_data;
    delete allocator;
    delete elastic_alloc;
 }
@@ -61,45 +66,23 @@ void T1HT::preEncode(encodeBlockInfo *block, grk_tcd_tile *tile,
 	auto cblk = block->cblk;
 	auto w = cblk->x1 - cblk->x0;
 	auto h = cblk->y1 - cblk->y0;
-	uint32_t tile_width = (tile->comps + block->compno)->width();
-	auto tileLineAdvance = tile_width - w;
-	uint32_t tileIndex = 0;
-	uint32_t cblk_index = 0;
-	maximum = 0;
+	uint32_t tile_width = block->stride;
 
 	//convert to sign-magnitude
-	if (block->qmfbid == 1) {
-		int32_t shift = 31 - (block->k_msbs + 1);
-		for (auto j = 0U; j < h; ++j) {
-			for (auto i = 0U; i < w; ++i) {
-				int32_t temp = block->tiledp[tileIndex];
-		        int32_t val = temp >= 0 ? temp : -temp;
-		        int32_t sign = (int32_t)((temp >= 0) ? 0U : 0x80000000);
-		        int32_t res = sign | (val << shift);
-		        unencoded_data[cblk_index] = res;
-				maximum = max(maximum, (uint32_t)res);
-				tileIndex++;
-				cblk_index++;
-			}
-			tileIndex += tileLineAdvance;
-		}
-	} else {
-		for (auto j = 0U; j < h; ++j) {
-			int32_t shift = 31 - (block->k_msbs + 1) - 11;
-			for (auto i = 0U; i < w; ++i) {
-				int32_t temp = block->tiledp[tileIndex];
-				int32_t t = (int32_t)((float)temp * block->inv_step_ht * (1<<shift));
-				int32_t val = t >= 0 ? t : -t;
-				maximum = max((uint32_t)val, maximum);
-				int32_t sign = t >= 0 ? 0 : 0x80000000;
-				int32_t res = sign | val;
-				unencoded_data[cblk_index] = res;
-				tileIndex++;
-				cblk_index++;
-			}
-			tileIndex += tileLineAdvance;
-		}
+	int32_t shift = 31 - (block->k_msbs + 1);
+	if (block->qmfbid != 1)
+		shift -= 11;
+	maximum = 0;
+	unencoded_data = ScratchArena::local()->alloc<int32_t>(unencoded_len(w, h));
+	if (!unencoded_data) {
+		GROK_ERROR("Out of memory");
+		return;
 	}
+	auto quantizer = BlockQuantizer::ht(block->qmfbid == 1, shift, block->inv_step_ht);
+	if (block->tiledp16)
+		maximum = quantizer.quantize(block->tiledp16, tile_width, unencoded_data, w, h);
+	else
+		maximum = quantizer.quantize(block->tiledp, tile_width, unencoded_data, w, h);
 }
 double T1HT::compress(encodeBlockInfo *block, grk_tcd_tile *tile, uint32_t maximum,
 		bool doRateControl) {
@@ -111,6 +94,9 @@ double T1HT::compress(encodeBlockInfo *block, grk_tcd_tile *tile, uint32_t maxim
 	int pass_length[2] = {0,0};
 	auto cblk = block->cblk;
 	cblk->numbps = 0;
+	cblk->num_passes_encoded = 0;
+	if (!unencoded_data)
+		return 0;
 	// optimization below was causing errors in encoding
 	//if (maximum >= (uint32_t)1<<(31 - (block->k_msbs+1)))
 	{
@@ -138,30 +124,57 @@ bool T1HT::decompress(decodeBlockInfo *block) {
 	auto cblk = block->cblk;
 	if (!cblk->seg_buffers.get_len())
 		return true;
+	auto arena = ScratchArena::local();
+	unencoded_data = arena->alloc<int32_t>(
+			unencoded_len(cblk->x1 - cblk->x0, cblk->y1 - cblk->y0));
+	if (!unencoded_data) {
+		GROK_ERROR("Out of memory");
+		return false;
+	}
 
 	auto min_buf_vec = &cblk->seg_buffers;
 	size_t total_seg_len = (min_buf_vec->get_len());
-	if (coded_data_size < total_seg_len) {
-		delete[] coded_data;
-		coded_data = new uint8_t[total_seg_len];
-		coded_data_size = (uint32_t)total_seg_len;
-	}
-	size_t offset = 0;
 	// note: min_buf_vec only contains segments of non-zero length
-	for (size_t i = 0; i < min_buf_vec->size(); ++i) {
+	auto first = (grk_buf*) min_buf_vec->get(0);
+	uint8_t *block_data = first->buf;
+	size_t offset = first->len;
+	for (size_t i = 1; i < min_buf_vec->size(); ++i) {
 		grk_buf *seg = (grk_buf*) min_buf_vec->get(i);
-		memcpy(coded_data + offset, seg->buf, seg->len);
+		if (seg->buf != block_data + offset) {
+			block_data = nullptr;
+			break;
+		}
 		offset += seg->len;
 	}
+	// segments that are contiguous in the tile data are decoded in place:
+	// the decoder only reads, and tile data chunks are padded
+	// with GRK_CHUNK_PAD_BYTES
+	if (!block_data) {
+		auto coded_data = arena->alloc<uint8_t>(total_seg_len + GRK_CHUNK_PAD_BYTES);
+		if (!coded_data) {
+			GROK_ERROR("Out of memory");
+			return false;
+		}
+		offset = 0;
+		for (size_t i = 0; i < min_buf_vec->size(); ++i) {
+			grk_buf *seg = (grk_buf*) min_buf_vec->get(i);
+			memcpy(coded_data + offset, seg->buf, seg->len);
+			offset += seg->len;
+		}
+		block_data = coded_data;
+	}
 
 	size_t num_passes = 0;
 	for (uint32_t i = 0; i < cblk->numSegments; ++i){
 		auto sgrk = cblk->segs + i;
 		num_passes += sgrk->numpasses;
 	}
+	// SigProp and MagRef passes only refine the lowest bit plane
+	if (block->skipped_lsbs && num_passes > 1)
+		num_passes = 1;
 
    if (num_passes)
-	   ojph_decode_codeblock(coded_data, unencoded_data,
+	   ojph_decode_codeblock(block_data, unencoded_data,
 									   block->k_msbs,
 									   (int)num_passes,
 									   (int)offset,
@@ -177,76 +190,40 @@ bool T1HT::decompress(decodeBlockInfo *block) {
 
 void T1HT::postDecode(decodeBlockInfo *block) {
 	auto cblk = block->cblk;
-	uint16_t cblk_w =  (uint16_t)(cblk->x1 - cblk->x0);
-	uint16_t cblk_h =  (uint16_t)(cblk->y1 - cblk->y0);
-
-	auto src = unencoded_data;
-	bool whole_tile_decoding = block->tilec->whole_tile_decoding;
+	if (!cblk->seg_buffers.get_len())
+		return;
+	uint32_t cblk_w =  cblk->x1 - cblk->x0;
+	uint32_t cblk_h =  cblk->y1 - cblk->y0;
 	auto tilec = block->tilec;
-
-	// ROI shift
-	if (block->roishift) {
-		int32_t threshold = 1 << block->roishift;
-		for (auto j = 0U; j < cblk_h; ++j) {
-			for (auto i = 0U; i < cblk_w; ++i) {
-				auto value = *src;
-				auto magnitude = abs(value);
-				if (magnitude >= threshold) {
-					magnitude >>= block->roishift;
-					// ((value > 0) - (value < 0)) == signum(value)
-					*src = ((value > 0) - (value < 0)) * magnitude;
-				}
-				src++;
-			}
-		}
-		//reset t1_data to start of buffer
-		src = unencoded_data;
-	}
-
-	uint32_t dest_width = tilec->width();
-	int32_t *dest = block->tiledp;
-	if (!whole_tile_decoding){
-       dest_width = cblk_w;
-       dest = src;
-	}
-
-	if (block->qmfbid == 1) {
-		int32_t shift = 31 - (block->k_msbs + 1);
-		int32_t *GRK_RESTRICT tile_data = dest;
-		for (auto j = 0U; j < cblk_h; ++j) {
-			int32_t *GRK_RESTRICT tile_row_data = tile_data;
-			for (auto i = 0U; i < cblk_w; ++i) {
-				int32_t temp = *src;
-				int32_t val = (temp & 0x7FFFFFFF) >> shift;
-				tile_row_data[i] = (int32_t)((temp & 0x80000000) ? -val : val);
-				src++;
-			}
-			tile_data += dest_width;
-		}
+	auto dequantizer = Dequantizer::ht(block->roishift,
+									block->qmfbid == 1,
+									31U - (block->k_msbs + 1U),
+									block->stepsize);
+	if (block->tiledp16) {
+		dequantizer.dequantize(unencoded_data,
+								cblk_w,
+								block->tiledp16,
+								tilec->width(),
+								cblk_w,
+								cblk_h,
+								tilec->buf->coeff16_frac_bits);
+	} else if (tilec->whole_tile_decoding) {
+		dequantizer.dequantize(unencoded_data,
+								cblk_w,
+								block->tiledp,
+								tilec->width(),
+								cblk_w,
+								cblk_h);
 	} else {
-		int32_t *GRK_RESTRICT tile_data = dest;
-		for (auto j = 0U; j < cblk_h; ++j) {
-			float *GRK_RESTRICT tile_row_data = (float*)tile_data;
-			for (auto i = 0U; i < cblk_w; ++i) {
-		       float val = (((*src & 0x7FFFFFFF) * block->stepsize));
-		       tile_row_data[i] = (*src & 0x80000000) ? -val : val;
-			   src++;
-			}
-			tile_data += dest_width;
-		}
-	}
-	if (!whole_tile_decoding){
 		// write directly from t1 to sparse array
-		if (!tilec->m_sa->write(block->x,
+		tilec->m_sa->write_transformed(block->x,
 							  block->y,
 							  block->x + cblk_w,
 							  block->y + cblk_h,
 							  unencoded_data,
-							  1,
 							  cblk_w,
-							  true)) {
-			  return;
-		}
+							  dequantizer,
+							  true);
 	}
 }
 
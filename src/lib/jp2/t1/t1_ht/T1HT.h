@@ -44,9 +44,9 @@ public:
 	void postDecode(decodeBlockInfo *block);
 
 private:
-	uint32_t coded_data_size;
-	uint8_t *coded_data;
-	uint32_t unencoded_data_size;
+	// drawn from the thread's scratch arena for each code block,
+	// so only valid between preEncode and compress,
+	// or decompress and postDecode
 	int32_t *unencoded_data;
 
     mem_fixed_allocator *allocator;
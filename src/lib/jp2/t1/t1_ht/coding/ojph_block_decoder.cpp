@@ -41,6 +41,7 @@
 #include "ojph_block_decoder.h"
 #include "ojph_arch.h"
 #include "ojph_message.h"
+#include "SIMDKernels.h"
 
 namespace ojph {
   namespace local {
@@ -684,10 +685,106 @@ namespace ojph {
     /////////////////////////////////////////////////////////////////////////
     //
     /////////////////////////////////////////////////////////////////////////
-    void ojph_decode_codeblock(ui8* coded_data, si32* decoded_data,
-                               int missing_msbs, int num_passes,
-                               int lengths1, int lengths2,
-                               int width, int height, int stride)
+    //MagSgn bits are unpacked, with bit-unstuffing, into a linear buffer of
+    // 32-bit words, so that the position of every sample in a quad pair can
+    // be computed with a prefix sum and all eight samples extracted at once
+    const int ms_linear_size = 4096 + 16; //enough for 4096 samples, 32 bits
+    struct ms_linear {
+      frwd_struct gen;  //unstuffs MagSgn bits into buf
+      ui32 *buf;        //unstuffed MagSgn bits
+      int count;        //number of words in buf
+      ui32 pos;         //bit position of next sample in buf
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    inline void ms_linear_init(ms_linear *msl, ui32 *buf,
+                               const ui8* data, int size)
+    {
+      frwd_init<0xFF>(&msl->gen, data, size);
+      msl->buf = buf;
+      msl->count = 0;
+      msl->pos = 0;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    //makes sure that 64 bits can be read starting at bit position end
+    inline bool ms_linear_fill(ms_linear *msl, ui32 end)
+    {
+      int needed = (int)(end >> 5) + 2;
+      if (needed > ms_linear_size)
+        return false;
+      while (msl->count < needed)
+      {
+        while (msl->gen.bits < 32)
+          frwd_read<0xFF>(&msl->gen);
+        msl->buf[msl->count++] = (ui32)msl->gen.tmp;
+        msl->gen.tmp >>= 32;
+        msl->gen.bits -= 32;
+      }
+      return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    //decodes MagSgn of the 8 samples of a quad pair, and updates line_state.
+    // Samples are numbered 0 to 3 for the first quad and 4 to 7 for the
+    // second; samples 0, 2, 4, 6 are in the top row, 1, 3, 5, 7 in the bottom.
+    // locs has a bit set for every sample inside the code block
+    inline bool decode_magsgn_pair(grk::ht_decode_magsgn_kernel kernel,
+                                   ms_linear *msl, const ui32 *qinf,
+                                   const int *U_p, int p, int locs,
+                                   si32 *sp, int stride, ui8 *lsp)
+    {
+      //m_n = U_q - e_k bits for every significant sample
+      ui32 total = 0;
+      for (int i = 0; i < 2; ++i)
+      {
+        ui32 sig = (qinf[i] >> 4) & 0xF;
+        total += (ui32)(population_count(sig) * U_p[i]
+                        - population_count(sig & (qinf[i] >> 12)));
+      }
+      if (!ms_linear_fill(msl, msl->pos + total))
+        return false;
+      ui32 v_n[8];
+      kernel(msl->buf, msl->pos, qinf, U_p, p, (ui32)locs, sp, (ui32)stride,
+             v_n);
+      msl->pos += total;
+
+      //update line_state: bit 7 (\sigma^N), and E^N for bottom samples;
+      // E-=2 is accounted for by using the exponent of v_n
+      if (qinf[0] & 0x20)
+      {
+        int t = lsp[0] & 0x7F, e = 32 - count_leading_zeros(v_n[1]);
+        lsp[0] = (ui8)(0x80 | (t > e ? t : e));
+      }
+      lsp[1] = 0;
+      if (qinf[0] & 0x80)
+        lsp[1] = (ui8)(0x80 | (32 - count_leading_zeros(v_n[3])));
+      if (qinf[1] & 0x20)
+      {
+        int t = lsp[1] & 0x7F, e = 32 - count_leading_zeros(v_n[5]);
+        lsp[1] = (ui8)(0x80 | (t > e ? t : e));
+      }
+      lsp[2] = 0;
+      if (qinf[1] & 0x80)
+        lsp[2] = (ui8)(0x80 | (32 - count_leading_zeros(v_n[7])));
+      return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    //
+    /////////////////////////////////////////////////////////////////////////
+    //LINEAR_MAGSGN selects decoding MagSgn a quad pair at a time from a
+    // linear buffer, with the SIMD kernel decode_magsgn; otherwise, samples
+    // are decoded one at a time.
+    //Returns false if the linear buffer cannot hold the MagSgn bits of a
+    // corrupt or truncated segment; the block is then partly decoded, and
+    // must be decoded again one sample at a time
+    template<bool LINEAR_MAGSGN>
+    static bool decode_codeblock(grk::ht_decode_magsgn_kernel decode_magsgn,
+                                 ui8* coded_data, si32* decoded_data,
+                                 int missing_msbs, int num_passes,
+                                 int lengths1, int lengths2,
+                                 int width, int height, int stride)
     {
       //sigma: each ui32 contains flags for 32 locations, stripe high;
       // that is, 4 rows by 8 columns.  For 1024 columns, we need 32 integers.
@@ -708,7 +805,7 @@ namespace ojph {
       lcup = lengths1;
       scup = (((int)coded_data[lcup-1]) << 4) + (coded_data[lcup-2] & 0xF);
       if (scup > lcup) //something is wrong
-        return;
+        return true;
 
       //init mel
       mel_struct mel;
@@ -717,6 +814,10 @@ namespace ojph {
       rev_init(&vlc, coded_data, lcup, scup);
       frwd_struct magsgn;
       frwd_init<0xFF>(&magsgn, coded_data, lcup - scup);
+      ms_linear msl;
+      ui32 ms_buf[LINEAR_MAGSGN ? ms_linear_size : 1];
+      if (LINEAR_MAGSGN)
+        ms_linear_init(&msl, ms_buf, coded_data, lcup - scup);
       frwd_struct sigprop;
       frwd_init<0>(&sigprop, coded_data + lengths1, lengths2);
       rev_struct magref;
@@ -809,6 +910,16 @@ namespace ojph {
         locs = 0xFF >> (locs > 0 ? (locs<<1) : 0);
         locs = height > 1 ? locs : (locs & 0x55);
 
+        if (LINEAR_MAGSGN)
+        {
+          if (!decode_magsgn_pair(decode_magsgn, &msl, qinf, U_p, p, locs,
+                                  sp, stride, lsp))
+            return false;
+          lsp += 2;
+          sp += 4;
+          continue;
+        }
+
         if (qinf[0] & 0x10) //sigma_n
         {
           ms_val = frwd_fetch<0xFF>(&magsgn);
@@ -818,7 +929,8 @@ namespace ojph {
           v_n = ms_val & ((1 << m_n) - 1);
           v_n |= ((qinf[0] & 0x100) >> 8) << m_n;
           v_n |= 1; //center of bin
-          sp[0] = val | ((v_n + 2) << (p - 1));
+          if (locs & 0x1) //inside the code block
+            sp[0] = val | ((v_n + 2) << (p - 1));
         }
         else if (locs & 0x1)
           sp[0] = 0;
@@ -832,7 +944,8 @@ namespace ojph {
           v_n = ms_val & ((1 << m_n) - 1);
           v_n |= ((qinf[0] & 0x200) >> 9) << m_n;
           v_n |= 1; //center of bin
-          sp[stride] = val | ((v_n + 2) << (p - 1));
+          if (locs & 0x2) //inside the code block
+            sp[stride] = val | ((v_n + 2) << (p - 1));
 
           //update line_state: bit 7 (\sigma^N), and E^N
           int s = (lsp[0] & 0x80) | 0x80; //\sigma^NW | \sigma^N
@@ -855,7 +968,8 @@ namespace ojph {
           v_n = ms_val & ((1 << m_n) - 1);
           v_n |= (((qinf[0] & 0x400) >> 10) << m_n);
           v_n |= 1; //center of bin
-          sp[0] = val | ((v_n + 2) << (p - 1));
+          if (locs & 0x4) //inside the code block
+            sp[0] = val | ((v_n + 2) << (p - 1));
         }
         else if (locs & 0x4)
           sp[0] = 0;
@@ -870,7 +984,8 @@ namespace ojph {
           v_n = ms_val & ((1 << m_n) - 1);
           v_n |= ((qinf[0] & 0x800) >> 11) << m_n;
           v_n |= 1; //center of bin
-          sp[stride] = val | ((v_n + 2) << (p - 1));
+          if (locs & 0x8) //inside the code block
+            sp[stride] = val | ((v_n + 2) << (p - 1));
 
           //update line_state: bit 7 (\sigma^NW), and E^NW for next quad
           lsp[0] = (ui8)(0x80 | (32 - count_leading_zeros(v_n)));//cause E-=2;
@@ -889,7 +1004,8 @@ namespace ojph {
           v_n = ms_val & ((1 << m_n) - 1);
           v_n |= (((qinf[1] & 0x100) >> 8) << m_n);
           v_n |= 1; //center of bin
-          sp[0] = val | ((v_n + 2) << (p - 1));
+          if (locs & 0x10) //inside the code block
+            sp[0] = val | ((v_n + 2) << (p - 1));
         }
         else if (locs & 0x10)
           sp[0] = 0;
@@ -903,7 +1019,8 @@ namespace ojph {
           v_n = ms_val & ((1 << m_n) - 1);
           v_n |= (((qinf[1] & 0x200) >> 9) << m_n);
           v_n |= 1; //center of bin
-          sp[stride] = val | ((v_n + 2) << (p - 1));
+          if (locs & 0x20) //inside the code block
+            sp[stride] = val | ((v_n + 2) << (p - 1));
 
           //update line_state: bit 7 (\sigma^N), and E^N
           int s = (lsp[0] & 0x80) | 0x80; //\sigma^NW | \sigma^N
@@ -926,7 +1043,8 @@ namespace ojph {
           v_n = ms_val & ((1 << m_n) - 1);
           v_n |= (((qinf[1] & 0x400) >> 10) << m_n);
           v_n |= 1; //center of bin
-          sp[0] = val | ((v_n + 2) << (p - 1));
+          if (locs & 0x40) //inside the code block
+            sp[0] = val | ((v_n + 2) << (p - 1));
         }
         else if (locs & 0x40)
           sp[0] = 0;
@@ -941,7 +1059,8 @@ namespace ojph {
           v_n = ms_val & ((1 << m_n) - 1);
           v_n |= (((qinf[1] & 0x800) >> 11) << m_n);
           v_n |= 1; //center of bin
-          sp[stride] = val | ((v_n + 2) << (p - 1));
+          if (locs & 0x80) //inside the code block
+            sp[stride] = val | ((v_n + 2) << (p - 1));
 
           //update line_state: bit 7 (\sigma^NW), and E^NW for next quad
           lsp[0] = (ui8)(0x80 | (32 - count_leading_zeros(v_n))); //cause E-=2;
@@ -1053,6 +1172,16 @@ namespace ojph {
           locs = 0xFF >> (locs > 0 ? (locs << 1) : 0);
           locs = y < height - 1 ? locs : (locs & 0x55);
 
+          if (LINEAR_MAGSGN)
+          {
+            if (!decode_magsgn_pair(decode_magsgn, &msl, qinf, U_p, p, locs,
+                                    sp, stride, lsp))
+              return false;
+            lsp += 2;
+            sp += 4;
+            continue;
+          }
+
           if (qinf[0] & 0x10) //sigma_n
           {
             ms_val = frwd_fetch<0xFF>(&magsgn);
@@ -1062,7 +1191,8 @@ namespace ojph {
             v_n = ms_val & ((1 << m_n) - 1);
             v_n |= ((qinf[0] & 0x100) >> 8) << m_n;
             v_n |= 1; //center of bin
-            sp[0] = val | ((v_n + 2) << (p - 1));
+            if (locs & 0x1) //inside the code block
+              sp[0] = val | ((v_n + 2) << (p - 1));
           }
           else if (locs & 0x1)
             sp[0] = 0;
@@ -1076,7 +1206,8 @@ namespace ojph {
             v_n = ms_val & ((1 << m_n) - 1);
             v_n |= ((qinf[0] & 0x200) >> 9) << m_n;
             v_n |= 1; //center of bin
-            sp[stride] = val | ((v_n + 2) << (p - 1));
+            if (locs & 0x2) //inside the code block
+              sp[stride] = val | ((v_n + 2) << (p - 1));
 
             //update line_state: bit 7 (\sigma^N), and E^N
             int s = (lsp[0] & 0x80) | 0x80; //\sigma^NW | \sigma^N
@@ -1099,7 +1230,8 @@ namespace ojph {
             v_n = ms_val & ((1 << m_n) - 1);
             v_n |= (((qinf[0] & 0x400) >> 10) << m_n);
             v_n |= 1; //center of bin
-            sp[0] = val | ((v_n + 2) << (p - 1));
+            if (locs & 0x4) //inside the code block
+              sp[0] = val | ((v_n + 2) << (p - 1));
           }
           else if (locs & 0x4)
             sp[0] = 0;
@@ -1114,7 +1246,8 @@ namespace ojph {
             v_n = ms_val & ((1 << m_n) - 1);
             v_n |= ((qinf[0] & 0x800) >> 11) << m_n;
             v_n |= 1; //center of bin
-            sp[stride] = val | ((v_n + 2) << (p - 1));
+            if (locs & 0x8) //inside the code block
+              sp[stride] = val | ((v_n + 2) << (p - 1));
 
             //update line_state: bit 7 (\sigma^NW), and E^NW for next quad
             lsp[0] = (ui8)(0x80 | (32 - count_leading_zeros(v_n)));//cause E-=2
@@ -1133,7 +1266,8 @@ namespace ojph {
             v_n = ms_val & ((1 << m_n) - 1);
             v_n |= (((qinf[1] & 0x100) >> 8) << m_n);
             v_n |= 1; //center of bin
-            sp[0] = val | ((v_n + 2) << (p - 1));
+            if (locs & 0x10) //inside the code block
+              sp[0] = val | ((v_n + 2) << (p - 1));
           }
           else if (locs & 0x10)
             sp[0] = 0;
@@ -1147,7 +1281,8 @@ namespace ojph {
             v_n = ms_val & ((1 << m_n) - 1);
             v_n |= (((qinf[1] & 0x200) >> 9) << m_n);
             v_n |= 1; //center of bin
-            sp[stride] = val | ((v_n + 2) << (p - 1));
+            if (locs & 0x20) //inside the code block
+              sp[stride] = val | ((v_n + 2) << (p - 1));
 
             //update line_state: bit 7 (\sigma^N), and E^N
             int s = (lsp[0] & 0x80) | 0x80; //\sigma^NW | \sigma^N
@@ -1170,7 +1305,8 @@ namespace ojph {
             v_n = ms_val & ((1 << m_n) - 1);
             v_n |= (((qinf[1] & 0x400) >> 10) << m_n);
             v_n |= 1; //center of bin
-            sp[0] = val | ((v_n + 2) << (p - 1));
+            if (locs & 0x40) //inside the code block
+              sp[0] = val | ((v_n + 2) << (p - 1));
           }
           else if (locs & 0x40)
             sp[0] = 0;
@@ -1185,7 +1321,8 @@ namespace ojph {
             v_n = ms_val & ((1 << m_n) - 1);
             v_n |= (((qinf[1] & 0x800) >> 11) << m_n);
             v_n |= 1; //center of bin
-            sp[stride] = val | ((v_n + 2) << (p - 1));
+            if (locs & 0x80) //inside the code block
+              sp[stride] = val | ((v_n + 2) << (p - 1));
 
             //update line_state: bit 7 (\sigma^NW), and E^NW for next quad
             lsp[0] = (ui8)(0x80 | (32 - count_leading_zeros(v_n)));//cause E-=2
@@ -1763,6 +1900,43 @@ namespace ojph {
           }
         }
       }
+      return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    void ojph_decode_codeblock(ui8* coded_data, si32* decoded_data,
+                               int missing_msbs, int num_passes,
+                               int lengths1, int lengths2,
+                               int width, int height, int stride)
+    {
+      ojph_decode_codeblock(grk::SIMDKernels::get()->ht_decode_magsgn,
+        coded_data, decoded_data, missing_msbs, num_passes, lengths1,
+        lengths2, width, height, stride);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    void ojph_decode_codeblock(grk::ht_decode_magsgn_kernel decode_magsgn,
+                               ui8* coded_data, si32* decoded_data,
+                               int missing_msbs, int num_passes,
+                               int lengths1, int lengths2,
+                               int width, int height, int stride)
+    {
+      if (!decode_magsgn || !decode_codeblock<true>(decode_magsgn,
+          coded_data, decoded_data, missing_msbs, num_passes, lengths1,
+          lengths2, width, height, stride))
+        decode_codeblock<false>(nullptr, coded_data, decoded_data,
+          missing_msbs, num_passes, lengths1, lengths2, width, height,
+          stride);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    void ojph_decode_codeblock_serial(ui8* coded_data, si32* decoded_data,
+                                      int missing_msbs, int num_passes,
+                                      int lengths1, int lengths2,
+                                      int width, int height, int stride)
+    {
+      ojph_decode_codeblock(nullptr, coded_data, decoded_data, missing_msbs,
+        num_passes, lengths1, lengths2, width, height, stride);
     }
   }
 }
@@ -40,6 +40,7 @@
 #define OJPH_BLOCK_DECODER_H
 
 #include "ojph_defs.h"
+#include "SIMDKernels.h"
 
 namespace ojph {
   namespace local {
@@ -51,6 +52,23 @@ namespace ojph {
       ojph_decode_codeblock(ui8* coded_data, si32* decoded_data,
         int missing_msbs, int num_passes, int lengths1, int lengths2,
         int width, int height, int stride);
+
+    //////////////////////////////////////////////////////////////////////////
+    //same as ojph_decode_codeblock, with the MagSgn kernel of a given SIMD
+    // level; a null kernel decodes MagSgn one sample at a time
+    void
+      ojph_decode_codeblock(grk::ht_decode_magsgn_kernel decode_magsgn,
+        ui8* coded_data, si32* decoded_data,
+        int missing_msbs, int num_passes, int lengths1, int lengths2,
+        int width, int height, int stride);
+
+    //////////////////////////////////////////////////////////////////////////
+    //same as ojph_decode_codeblock, but decodes MagSgn one sample at a time;
+    // serves as a reference for the quad pair decoder
+    void
+      ojph_decode_codeblock_serial(ui8* coded_data, si32* decoded_data,
+        int missing_msbs, int num_passes, int lengths1, int lengths2,
+        int width, int height, int stride);
   }
 }
 
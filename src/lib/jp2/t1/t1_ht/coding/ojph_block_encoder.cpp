@@ -44,6 +44,8 @@
 #include "ojph_arch.h"
 #include "ojph_block_encoder.h"
 #include "ojph_message.h"
+#include "SIMDKernels.h"
+#include "ScratchArena.h"
 
 namespace ojph {
   namespace local {
@@ -395,9 +397,9 @@ namespace ojph {
       int pos;      //position of next writing within buf
       int buf_size; //size of buffer, which we must not exceed
 
-      int max_bits;  //maximum number of bits that can be store in tmp
+      int max_bits;  //maximum number of bits that can be store in a byte
       int used_bits; //number of occupied bits in tmp
-      int tmp;       //temporary storage of coded bits
+      ui64 tmp;      //temporary storage of coded bits
     };
 
     //////////////////////////////////////////////////////////////////////////
@@ -414,24 +416,21 @@ namespace ojph {
 
     //////////////////////////////////////////////////////////////////////////
     static inline void
-    ms_encode(ms_struct* msp, int cwd, int cwd_len)
+    ms_encode(ms_struct* msp, ui32 cwd, int cwd_len)
     {
-      while (cwd_len > 0)
+      //cwd has no bits set beyond cwd_len; bytes are emitted from a 64-bit
+      // accumulator, with 7 bits only in the byte that follows 0xFF
+      msp->tmp |= (ui64)cwd << msp->used_bits;
+      msp->used_bits += cwd_len;
+      while (msp->used_bits >= msp->max_bits)
       {
         if (msp->pos >= msp->buf_size)
           OJPH_ERROR(0x00020005, "magnitude sign encoder's buffer is full");
-        int t = ojph_min(msp->max_bits - msp->used_bits, cwd_len);
-        msp->tmp |= (cwd & ((1 << t) - 1)) << msp->used_bits;
-        msp->used_bits += t;
-        cwd >>= t;
-        cwd_len -= t;
-        if (msp->used_bits >= msp->max_bits)
-        {
-          msp->buf[msp->pos++] = (ui8)msp->tmp;
-          msp->max_bits = (msp->tmp == 0xFF) ? 7 : 8;
-          msp->tmp = 0;
-          msp->used_bits = 0;
-        }
+        ui8 byte = (ui8)(msp->tmp & ((1U << msp->max_bits) - 1));
+        msp->buf[msp->pos++] = byte;
+        msp->tmp >>= msp->max_bits;
+        msp->used_bits -= msp->max_bits;
+        msp->max_bits = (byte == 0xFF) ? 7 : 8;
       }
     }
 
@@ -455,6 +454,25 @@ namespace ojph {
         msp->pos--;
     }
 
+    //////////////////////////////////////////////////////////////////////////
+    //encodes MagSgn of the 8 samples of a quad pair; a significant sample
+    // uses U_q bits, less one if its MSB is implied by the VLC codeword
+    static inline void
+    ms_encode_pair(ms_struct* msp, const grk::HTQuadPair* qp,
+                   const si32* U_q, const ui32* e_k,
+                   grk::ht_magsgn_kernel magsgn_codewords)
+    {
+      ui32 cwd[8];
+      si32 len[8];
+      magsgn_codewords(qp, U_q, e_k, cwd, len);
+      for (int i = 0; i < 8; ++i)
+        ms_encode(msp, cwd[i], len[i]);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    //number of quad pairs prepared at a time, 64 columns
+    const int quads_per_chunk = 16;
+
     //////////////////////////////////////////////////////////////////////////
     //
     //
@@ -462,17 +480,26 @@ namespace ojph {
     //
     //
     //////////////////////////////////////////////////////////////////////////
-    void ojph_encode_codeblock(si32* buf, int missing_msbs, int num_passes,
-                               int width, int height, int stride,
-                               int* lengths,
-                               ojph::mem_elastic_allocator *elastic,
-                               ojph::coded_lists *& coded)
+    //encodes a code block, a quad pair at a time, with the sample
+    // preparation and MagSgn kernels of kernels
+    static void encode_codeblock(si32* buf, int missing_msbs,
+                                 int width, int height, int stride,
+                                 int* lengths,
+                                 ojph::mem_elastic_allocator *elastic,
+                                 ojph::coded_lists *& coded,
+                                 const grk::SIMDKernels *kernels)
     {
-      assert(num_passes == 1);
+      auto prepare_quads = kernels->ht_prepare_quads;
+      auto magsgn_codewords = kernels->ht_magsgn_codewords;
+      //coder buffers are taken from the thread's scratch arena
+      grk::ScratchArena::Frame frame;
       const int ms_size = 16384;         //more than enough
-      ui8 ms_buf[ms_size];
       const int mel_vlc_size = 3072;     //more than enough
-      ui8 mel_vlc_buf[mel_vlc_size];
+      ui8 *ms_buf =
+        grk::ScratchArena::local()->alloc<ui8>(ms_size + mel_vlc_size);
+      if (!ms_buf)
+        OJPH_ERROR(0x00020007, "out of memory for block encoder's buffers");
+      ui8 *mel_vlc_buf = ms_buf + ms_size;
       const int mel_size = 128;
       ui8 *mel_buf = mel_vlc_buf;
       const int vlc_size = mel_vlc_size - mel_size;
@@ -502,79 +529,24 @@ namespace ojph {
       ui8* lcxp = cx_val;   lcxp[0] = 0;
 
       //initial row of quads
-      int e_qmax[2] = {0,0}, e_q[8] = {0,0,0,0,0,0,0,0};
-      int rho[2] = {0,0};
+      grk::HTQuadPair quads[quads_per_chunk];
       int c_q0 = 0;
-      ui32 s[8] = {0,0,0,0,0,0,0,0}, val, t;
       int y = 0;
-      si32 *sp = buf;
       for (int x = 0; x < width; x += 4)
       {
-        //prepare two quads
-        t = sp[0];
-        val = t + t; //multiply by 2 and get rid of sign
-        val >>= p; // 2 \mu_p + x
-        val &= ~1; // 2 \mu_p
-        if (val)
-        {
-          rho[0] = 1;
-          e_q[0] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-          e_qmax[0] = e_q[0];
-          s[0] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-        }
-
-        t = height > 1 ? sp[stride] : 0;
-        ++sp;
-        val = t + t; //multiply by 2 and get rid of sign
-        val >>= p; // 2 \mu_p + x
-        val &= ~1; // 2 \mu_p
-        if (val)
-        {
-          rho[0] += 2;
-          e_q[1] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-          e_qmax[0] = ojph_max(e_qmax[0], e_q[1]);
-          s[1] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-        }
-
-        if (x+1 < width)
-        {
-          t = sp[0];
-          val = t + t; //multiply by 2 and get rid of sign
-          val >>= p; // 2 \mu_p + x
-          val &= ~1; // 2 \mu_p
-          if (val)
-          {
-            rho[0] += 4;
-            e_q[2] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-            e_qmax[0] = ojph_max(e_qmax[0], e_q[2]);
-            s[2] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-          }
-
-          t = height > 1 ? sp[stride] : 0;
-          ++sp;
-          val = t + t; //multiply by 2 and get rid of sign
-          val >>= p; // 2 \mu_p + x
-          val &= ~1; // 2 \mu_p
-          if (val)
-          {
-            rho[0] += 8;
-            e_q[3] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-            e_qmax[0] = ojph_max(e_qmax[0], e_q[3]);
-            s[3] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-          }
-        }
-
-        int Uq0 = ojph_max(e_qmax[0], 1); //kappa_q = 1
+        //prepare quad pairs, a chunk at a time
+        int qx = (x >> 2) % quads_per_chunk;
+        if (qx == 0)
+          prepare_quads(buf + x, (ui32)stride,
+                        (ui32)ojph_min(width - x, 4 * quads_per_chunk),
+                        height > 1, (ui32)p, quads);
+        const grk::HTQuadPair *qp = quads + qx;
+        const si32 *rho = qp->rho, *e_q = qp->e_q;
+
+        int Uq0 = ojph_max(qp->e_qmax[0], 1); //kappa_q = 1
         int u_q0 = Uq0 - 1, u_q1 = 0; //kappa_q = 1
 
-        int eps0 = 0;
-        if (u_q0 > 0)
-        {
-          eps0 |= (e_q[0] == e_qmax[0]);
-          eps0 |= (e_q[1] == e_qmax[0]) << 1;
-          eps0 |= (e_q[2] == e_qmax[0]) << 2;
-          eps0 |= (e_q[3] == e_qmax[0]) << 3;
-        }
+        int eps0 = u_q0 > 0 ? (qp->eps & 0xF) : 0;
         lep[0] = ojph_max(lep[0], (ui8)e_q[1]); lep++;
         lep[0] = (ui8)e_q[3];
         lcxp[0] |= (ui8)((rho[0] & 2) >> 1); lcxp++;
@@ -586,82 +558,16 @@ namespace ojph {
         if (c_q0 == 0)
             mel_encode(&mel, rho[0] != 0);
 
-        int m = (rho[0] & 1) ? Uq0 - (tuple0 & 1) : 0;
-        ms_encode(&ms, s[0] & ((1<<m)-1), m);
-        m = (rho[0] & 2) ? Uq0 - ((tuple0 & 2) >> 1) : 0;
-        ms_encode(&ms, s[1] & ((1<<m)-1), m);
-        m = (rho[0] & 4) ? Uq0 - ((tuple0 & 4) >> 2) : 0;
-        ms_encode(&ms, s[2] & ((1<<m)-1), m);
-        m = (rho[0] & 8) ? Uq0 - ((tuple0 & 8) >> 3) : 0;
-        ms_encode(&ms, s[3] & ((1<<m)-1), m);
-
+        //the second quad is insignificant if it lies outside the block
+        si32 U_q[2] = { Uq0, 0 };
+        ui32 e_k[2] = { tuple0, 0 };
         if (x+2 < width)
         {
-          t = sp[0];
-          val = t + t; //multiply by 2 and get rid of sign
-          val >>= p; // 2 \mu_p + x
-          val &= ~1; // 2 \mu_p
-          if (val)
-          {
-            rho[1] = 1;
-            e_q[4] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-            e_qmax[1] = e_q[4];
-            s[4] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-          }
-
-          t = height > 1 ? sp[stride] : 0;
-          ++sp;
-          val = t + t; //multiply by 2 and get rid of sign
-          val >>= p; // 2 \mu_p + x
-          val &= ~1; // 2 \mu_p
-          if (val)
-          {
-            rho[1] += 2;
-            e_q[5] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-            e_qmax[1] = ojph_max(e_qmax[1], e_q[5]);
-            s[5] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-          }
-
-          if (x+3 < width)
-          {
-            t = sp[0];
-            val = t + t; //multiply by 2 and get rid of sign
-            val >>= p; // 2 \mu_p + x
-            val &= ~1; // 2 \mu_p
-            if (val)
-            {
-              rho[1] += 4;
-              e_q[6] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-              e_qmax[1] = ojph_max(e_qmax[1], e_q[6]);
-              s[6] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-            }
-
-            t = height > 1 ? sp[stride] : 0;
-            ++sp;
-            val = t + t; //multiply by 2 and get rid of sign
-            val >>= p; // 2 \mu_p + x
-            val &= ~1; // 2 \mu_p
-            if (val)
-            {
-              rho[1] += 8;
-              e_q[7] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-              e_qmax[1] = ojph_max(e_qmax[1], e_q[7]);
-              s[7] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-            }
-          }
-
           int c_q1 = (rho[0] >> 1) | (rho[0] & 1);
-          int Uq1 = ojph_max(e_qmax[1], 1); //kappa_q = 1
+          int Uq1 = ojph_max(qp->e_qmax[1], 1); //kappa_q = 1
           u_q1 = Uq1 - 1; //kappa_q = 1
 
-          int eps1 = 0;
-          if (u_q1 > 0)
-          {
-            eps1 |= (e_q[4] == e_qmax[1]);
-            eps1 |= (e_q[5] == e_qmax[1]) << 1;
-            eps1 |= (e_q[6] == e_qmax[1]) << 2;
-            eps1 |= (e_q[7] == e_qmax[1]) << 3;
-          }
+          int eps1 = u_q1 > 0 ? (qp->eps >> 4) : 0;
           lep[0] = ojph_max(lep[0], (ui8)e_q[5]); lep++;
           lep[0] = (ui8)e_q[7];
           lcxp[0] |= (ui8)((rho[1] & 2) >> 1); lcxp++;
@@ -672,15 +578,10 @@ namespace ojph {
           if (c_q1 == 0)
             mel_encode(&mel, rho[1] != 0);
 
-          int m = (rho[1] & 1) ? Uq1 - (tuple1 & 1) : 0;
-          ms_encode(&ms, s[4] & ((1<<m)-1), m);
-          m = (rho[1] & 2) ? Uq1 - ((tuple1 & 2) >> 1) : 0;
-          ms_encode(&ms, s[5] & ((1<<m)-1), m);
-          m = (rho[1] & 4) ? Uq1 - ((tuple1 & 4) >> 2) : 0;
-          ms_encode(&ms, s[6] & ((1<<m)-1), m);
-          m = (rho[1] & 8) ? Uq1 - ((tuple1 & 8) >> 3) : 0;
-          ms_encode(&ms, s[7] & ((1<<m)-1), m);
+          U_q[1] = Uq1;
+          e_k[1] = tuple1;
         }
+        ms_encode_pair(&ms, qp, U_q, e_k, magsgn_codewords);
 
         if (u_q0 > 0 && u_q1 > 0)
           mel_encode(&mel, ojph_min(u_q0, u_q1) > 2);
@@ -708,9 +609,6 @@ namespace ojph {
 
         //prepare for next iteration
         c_q0 = (rho[1] >> 1) | (rho[1] & 1);
-        s[0] = s[1] = s[2] = s[3] = s[4] = s[5] = s[6] = s[7] = 0;
-        e_q[0]=e_q[1]=e_q[2]=e_q[3]=e_q[4]=e_q[5]=e_q[6]=e_q[7]=0;
-        rho[0] = rho[1] = 0; e_qmax[0] = e_qmax[1] = 0;
       }
 
       lep[1] = 0;
@@ -724,75 +622,23 @@ namespace ojph {
         c_q0 = lcxp[0] + (lcxp[1] << 2);
         lcxp[0] = 0;
 
-        sp = buf + y * stride;
+        si32 *sp = buf + y * stride;
         for (int x = 0; x < width; x += 4)
         {
-          //prepare two quads
-          t = sp[0];
-          val = t + t; //multiply by 2 and get rid of sign
-          val >>= p; // 2 \mu_p + x
-          val &= ~1; // 2 \mu_p
-          if (val)
-          {
-            rho[0] = 1;
-            e_q[0] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-            e_qmax[0] = e_q[0];
-            s[0] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-          }
-
-          t = y + 1 < height ? sp[stride] : 0;
-          ++sp;
-          val = t + t; //multiply by 2 and get rid of sign
-          val >>= p; // 2 \mu_p + x
-          val &= ~1; // 2 \mu_p
-          if (val)
-          {
-            rho[0] += 2;
-            e_q[1] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-            e_qmax[0] = ojph_max(e_qmax[0], e_q[1]);
-            s[1] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-          }
-
-          if (x+1 < width)
-          {
-            t = sp[0];
-            val = t + t; //multiply by 2 and get rid of sign
-            val >>= p; // 2 \mu_p + x
-            val &= ~1; // 2 \mu_p
-            if (val)
-            {
-              rho[0] += 4;
-              e_q[2] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-              e_qmax[0] = ojph_max(e_qmax[0], e_q[2]);
-              s[2] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-            }
-
-            t = y + 1 < height ? sp[stride] : 0;
-            ++sp;
-            val = t + t; //multiply by 2 and get rid of sign
-            val >>= p; // 2 \mu_p + x
-            val &= ~1; // 2 \mu_p
-            if (val)
-            {
-              rho[0] += 8;
-              e_q[3] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-              e_qmax[0] = ojph_max(e_qmax[0], e_q[3]);
-              s[3] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-            }
-          }
+          //prepare quad pairs, a chunk at a time
+          int qx = (x >> 2) % quads_per_chunk;
+          if (qx == 0)
+            prepare_quads(sp + x, (ui32)stride,
+                          (ui32)ojph_min(width - x, 4 * quads_per_chunk),
+                          y + 1 < height, (ui32)p, quads);
+          const grk::HTQuadPair *qp = quads + qx;
+          const si32 *rho = qp->rho, *e_q = qp->e_q;
 
           int kappa = (rho[0] & (rho[0]-1)) ? ojph_max(1,max_e) : 1;
-          int Uq0 = ojph_max(e_qmax[0], kappa);
+          int Uq0 = ojph_max(qp->e_qmax[0], kappa);
           int u_q0 = Uq0 - kappa, u_q1 = 0;
 
-          int eps0 = 0;
-          if (u_q0 > 0)
-          {
-            eps0 |= (e_q[0] == e_qmax[0]);
-            eps0 |= (e_q[1] == e_qmax[0]) << 1;
-            eps0 |= (e_q[2] == e_qmax[0]) << 2;
-            eps0 |= (e_q[3] == e_qmax[0]) << 3;
-          }
+          int eps0 = u_q0 > 0 ? (qp->eps & 0xF) : 0;
           lep[0] = ojph_max(lep[0], (ui8)e_q[1]); lep++;
           max_e = ojph_max(lep[0], lep[1]) - 1;
           lep[0] = (ui8)e_q[3];
@@ -805,83 +651,16 @@ namespace ojph {
           if (c_q0 == 0)
               mel_encode(&mel, rho[0] != 0);
 
-          int m = (rho[0] & 1) ? Uq0 - (tuple0 & 1) : 0;
-          ms_encode(&ms, s[0] & ((1<<m)-1), m);
-          m = (rho[0] & 2) ? Uq0 - ((tuple0 & 2) >> 1) : 0;
-          ms_encode(&ms, s[1] & ((1<<m)-1), m);
-          m = (rho[0] & 4) ? Uq0 - ((tuple0 & 4) >> 2) : 0;
-          ms_encode(&ms, s[2] & ((1<<m)-1), m);
-          m = (rho[0] & 8) ? Uq0 - ((tuple0 & 8) >> 3) : 0;
-          ms_encode(&ms, s[3] & ((1<<m)-1), m);
-
+          si32 U_q[2] = { Uq0, 0 };
+          ui32 e_k[2] = { tuple0, 0 };
           if (x+2 < width)
           {
-            t = sp[0];
-            val = t + t; //multiply by 2 and get rid of sign
-            val >>= p; // 2 \mu_p + x
-            val &= ~1; // 2 \mu_p
-            if (val)
-            {
-              rho[1] = 1;
-              e_q[4] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-              e_qmax[1] = e_q[4];
-              s[4] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-            }
-
-            t = y + 1 < height ? sp[stride] : 0;
-            ++sp;
-            val = t + t; //multiply by 2 and get rid of sign
-            val >>= p; // 2 \mu_p + x
-            val &= ~1; // 2 \mu_p
-            if (val)
-            {
-              rho[1] += 2;
-              e_q[5] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-              e_qmax[1] = ojph_max(e_qmax[1], e_q[5]);
-              s[5] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-            }
-
-            if (x+3 < width)
-            {
-              t = sp[0];
-              val = t + t; //multiply by 2 and get rid of sign
-              val >>= p; // 2 \mu_p + x
-              val &= ~1; // 2 \mu_p
-              if (val)
-              {
-                rho[1] += 4;
-                e_q[6] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-                e_qmax[1] = ojph_max(e_qmax[1], e_q[6]);
-                s[6] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-              }
-
-              t = y + 1 < height ? sp[stride] : 0;
-              ++sp;
-              val = t + t; //multiply by 2 and get rid of sign
-              val >>= p; // 2 \mu_p + x
-              val &= ~1; // 2 \mu_p
-              if (val)
-              {
-                rho[1] += 8;
-                e_q[7] = 32 - count_leading_zeros(--val); //2\mu_p - 1
-                e_qmax[1] = ojph_max(e_qmax[1], e_q[7]);
-                s[7] = --val + (t >> 31); //v_n = 2(\mu_p-1) + s_n
-              }
-            }
-
             kappa = (rho[1] & (rho[1]-1)) ? ojph_max(1,max_e) : 1;
             c_q1 |= ((rho[0] & 4) >> 1) | ((rho[0] & 8) >> 2);
-            int Uq1 = ojph_max(e_qmax[1], kappa);
+            int Uq1 = ojph_max(qp->e_qmax[1], kappa);
             u_q1 = Uq1 - kappa;
 
-            int eps1 = 0;
-            if (u_q1 > 0)
-            {
-              eps1 |= (e_q[4] == e_qmax[1]);
-              eps1 |= (e_q[5] == e_qmax[1]) << 1;
-              eps1 |= (e_q[6] == e_qmax[1]) << 2;
-              eps1 |= (e_q[7] == e_qmax[1]) << 3;
-            }
+            int eps1 = u_q1 > 0 ? (qp->eps >> 4) : 0;
             lep[0] = ojph_max(lep[0], (ui8)e_q[5]); lep++;
             max_e = ojph_max(lep[0], lep[1]) - 1;
             lep[0] = (ui8)e_q[7];
@@ -894,15 +673,10 @@ namespace ojph {
             if (c_q1 == 0)
               mel_encode(&mel, rho[1] != 0);
 
-            int m = (rho[1] & 1) ? Uq1 - (tuple1 & 1) : 0;
-            ms_encode(&ms, s[4] & ((1<<m)-1), m);
-            m = (rho[1] & 2) ? Uq1 - ((tuple1 & 2) >> 1) : 0;
-            ms_encode(&ms, s[5] & ((1<<m)-1), m);
-            m = (rho[1] & 4) ? Uq1 - ((tuple1 & 4) >> 2) : 0;
-            ms_encode(&ms, s[6] & ((1<<m)-1), m);
-            m = (rho[1] & 8) ? Uq1 - ((tuple1 & 8) >> 3) : 0;
-            ms_encode(&ms, s[7] & ((1<<m)-1), m);
+            U_q[1] = Uq1;
+            e_k[1] = tuple1;
           }
+          ms_encode_pair(&ms, qp, U_q, e_k, magsgn_codewords);
 
           vlc_encode(&vlc, ulvc_cwd_pre[u_q0], ulvc_cwd_pre_len[u_q0]);
           vlc_encode(&vlc, ulvc_cwd_pre[u_q1], ulvc_cwd_pre_len[u_q1]);
@@ -911,9 +685,6 @@ namespace ojph {
 
           //prepare for next iteration
           c_q0 |= ((rho[1] & 4) >> 1) | ((rho[1] & 8) >> 2);
-          s[0] = s[1] = s[2] = s[3] = s[4] = s[5] = s[6] = s[7] = 0;
-          e_q[0]=e_q[1]=e_q[2]=e_q[3]=e_q[4]=e_q[5]=e_q[6]=e_q[7]=0;
-          rho[0] = rho[1] = 0; e_qmax[0] = e_qmax[1] = 0;
         }
       }
 
@@ -937,5 +708,43 @@ namespace ojph {
 
       coded->avail_size -= lengths[0];
     }
+
+    //////////////////////////////////////////////////////////////////////////
+    //kernels without explicit SIMD, the reference for all other levels
+    static const grk::SIMDKernels* scalar_kernels()
+    {
+      static grk::SIMDKernels kernels;
+      static bool selected =
+        grk::SIMDKernels::select(&kernels, grk::SIMD_SCALAR);
+      assert(selected);
+      (void)selected;
+      return &kernels;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    void ojph_encode_codeblock_serial(si32* buf, int missing_msbs,
+                                      int num_passes, int width, int height,
+                                      int stride, int* lengths,
+                                      ojph::mem_elastic_allocator *elastic,
+                                      ojph::coded_lists *& coded)
+    {
+      assert(num_passes == 1);
+      (void)num_passes;
+      encode_codeblock(buf, missing_msbs, width, height, stride, lengths,
+                       elastic, coded, scalar_kernels());
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    void ojph_encode_codeblock(si32* buf, int missing_msbs, int num_passes,
+                               int width, int height, int stride,
+                               int* lengths,
+                               ojph::mem_elastic_allocator *elastic,
+                               ojph::coded_lists *& coded)
+    {
+      assert(num_passes == 1);
+      (void)num_passes;
+      encode_codeblock(buf, missing_msbs, width, height, stride, lengths,
+                       elastic, coded, grk::SIMDKernels::get());
+    }
   }
 }
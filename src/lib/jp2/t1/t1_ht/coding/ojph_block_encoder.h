@@ -51,11 +51,22 @@ namespace ojph {
   namespace local {
 
     //////////////////////////////////////////////////////////////////////////
+    //samples are prepared by the SIMD kernels selected for the CPU
     void
       ojph_encode_codeblock(si32* buf, int missing_msbs, int num_passes,
                             int width, int height, int stride,
                             int* lengths, ojph::mem_elastic_allocator *elastic,
                             ojph::coded_lists *& coded);
+
+    //////////////////////////////////////////////////////////////////////////
+    //same as ojph_encode_codeblock, but always prepares samples with the
+    // scalar kernel; serves as a reference
+    void
+      ojph_encode_codeblock_serial(si32* buf, int missing_msbs,
+                                   int num_passes, int width, int height,
+                                   int stride, int* lengths,
+                                   ojph::mem_elastic_allocator *elastic,
+                                   ojph::coded_lists *& coded);
   }
 }
 
@@ -0,0 +1,180 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ MagSgn kernel of the HT block decoder. Compiled once per instruction set:
+ only include from SIMDKernelsImpl.h.
+ AVX-512 reuses the AVX2 kernel: a quad pair fills one AVX2 register.
+ The 128 bit kernel only needs SSE2, so that CPUs without SSE4.1 take it too.
+ The scalar level has no kernel: the block decoder then reads MagSgn bits
+ one sample at a time.
+ */
+
+namespace grk {
+namespace GRK_KERNEL_NS {
+
+#if defined(__AVX2__)
+#define GRK_HT_DECODE_MAGSGN
+static void ht_decode_magsgn(const uint32_t *ms_buf, uint32_t ms_pos,
+		const uint32_t *qinf, const int32_t *U_p, int32_t p, uint32_t locs,
+		int32_t *sp, uint32_t stride, uint32_t *v_n) {
+	//bit k of quad q is 4+k for sigma, 8+k for e_1 and 12+k for e_k
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i bit = _mm256_setr_epi32(1, 2, 4, 8, 1, 2, 4, 8);
+	__m256i q = _mm256_setr_epi32((int) qinf[0], (int) qinf[0], (int) qinf[0],
+			(int) qinf[0], (int) qinf[1], (int) qinf[1], (int) qinf[1],
+			(int) qinf[1]);
+	__m256i sig = _mm256_cmpeq_epi32(
+			_mm256_and_si256(q, _mm256_slli_epi32(bit, 4)), zero);
+	sig = _mm256_xor_si256(sig, _mm256_set1_epi32(-1)); //all ones if sig
+	__m256i e_1 = _mm256_min_epu32(
+			_mm256_and_si256(q, _mm256_slli_epi32(bit, 8)), one);
+	__m256i e_k = _mm256_min_epu32(
+			_mm256_and_si256(q, _mm256_slli_epi32(bit, 12)), one);
+	__m256i U = _mm256_setr_epi32(U_p[0], U_p[0], U_p[0], U_p[0], U_p[1],
+			U_p[1], U_p[1], U_p[1]);
+	__m256i m = _mm256_and_si256(_mm256_sub_epi32(U, e_k), sig);
+
+	//exclusive prefix sum of m gives the bit position of each sample
+	__m256i t = _mm256_add_epi32(m, _mm256_slli_si256(m, 4));
+	t = _mm256_add_epi32(t, _mm256_slli_si256(t, 8));
+	__m256i lo = _mm256_permutevar8x32_epi32(t, _mm256_set1_epi32(3));
+	t = _mm256_add_epi32(t, _mm256_blend_epi32(zero, lo, 0xF0));
+	__m256i pos = _mm256_add_epi32(_mm256_sub_epi32(t, m),
+			_mm256_set1_epi32((int) ms_pos));
+
+	//fetch 64 bits at the word holding each sample, and align them
+	__m256i idx = _mm256_srli_epi32(pos, 5);
+	__m256i sh = _mm256_and_si256(pos, _mm256_set1_epi32(0x1F));
+	const long long *base = (const long long*) ms_buf;
+	__m256i g0 = _mm256_i32gather_epi64(base, _mm256_castsi256_si128(idx), 4);
+	__m256i g1 = _mm256_i32gather_epi64(base, _mm256_extracti128_si256(idx, 1),
+			4);
+	g0 = _mm256_srlv_epi64(g0,
+			_mm256_cvtepu32_epi64(_mm256_castsi256_si128(sh)));
+	g1 = _mm256_srlv_epi64(g1,
+			_mm256_cvtepu32_epi64(_mm256_extracti128_si256(sh, 1)));
+	const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+	__m256i ms_val = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(g0, even),
+			_mm256_permutevar8x32_epi32(g1, even), 0xF0);
+
+	//v_n = (ms_val & ((1 << m_n) - 1)) | (e_1 << m_n) | 1
+	__m256i v = _mm256_and_si256(ms_val,
+			_mm256_sub_epi32(_mm256_sllv_epi32(one, m), one));
+	v = _mm256_or_si256(v, _mm256_sllv_epi32(e_1, m));
+	v = _mm256_or_si256(v, one);
+	__m256i val = _mm256_sll_epi32(_mm256_add_epi32(v, _mm256_set1_epi32(2)),
+			_mm_cvtsi32_si128(p - 1));
+	val = _mm256_or_si256(val, _mm256_slli_epi32(ms_val, 31));
+	val = _mm256_and_si256(val, sig);
+	_mm256_storeu_si256((__m256i*) v_n, v);
+	if (locs == 0xFF) {
+		//all samples are inside the code block; store rows directly
+		__m256i rows = _mm256_permutevar8x32_epi32(val,
+				_mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+		_mm_storeu_si128((__m128i*) sp, _mm256_castsi256_si128(rows));
+		_mm_storeu_si128((__m128i*) (sp + stride),
+				_mm256_extracti128_si256(rows, 1));
+	} else {
+		int32_t vals[8];
+		_mm256_storeu_si256((__m256i*) vals, val);
+		for (uint32_t i = 0; i < 8; ++i)
+			if ((locs >> i) & 1)
+				sp[(i >> 1) + (i & 1) * stride] = vals[i];
+	}
+}
+#elif defined(__SSE2__) && !defined(GRK_KERNEL_SCALAR)
+#define GRK_HT_DECODE_MAGSGN
+static void ht_decode_magsgn(const uint32_t *ms_buf, uint32_t ms_pos,
+		const uint32_t *qinf, const int32_t *U_p, int32_t p, uint32_t locs,
+		int32_t *sp, uint32_t stride, uint32_t *v_n) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i bit = _mm_setr_epi32(1, 2, 4, 8);
+	__m128i sig[2], e_1[2], m[2], t[2];
+	for (uint32_t i = 0; i < 2; ++i) {
+		__m128i q = _mm_set1_epi32((int) qinf[i]);
+		sig[i] = _mm_cmpeq_epi32(_mm_and_si128(q, _mm_slli_epi32(bit, 4)),
+				zero);
+		sig[i] = _mm_xor_si128(sig[i], _mm_set1_epi32(-1));
+		// all ones if e_1, and e_k is 0 or 1
+		e_1[i] = _mm_cmpeq_epi32(_mm_and_si128(q, _mm_slli_epi32(bit, 8)),
+				zero);
+		e_1[i] = _mm_xor_si128(e_1[i], _mm_set1_epi32(-1));
+		__m128i e_k = _mm_andnot_si128(
+				_mm_cmpeq_epi32(_mm_and_si128(q, _mm_slli_epi32(bit, 12)),
+						zero), one);
+		m[i] = _mm_and_si128(_mm_sub_epi32(_mm_set1_epi32(U_p[i]), e_k),
+				sig[i]);
+		t[i] = _mm_add_epi32(m[i], _mm_slli_si128(m[i], 4));
+		t[i] = _mm_add_epi32(t[i], _mm_slli_si128(t[i], 8));
+	}
+	//exclusive prefix sum of m gives the bit position of each sample
+	t[1] = _mm_add_epi32(t[1], _mm_shuffle_epi32(t[0], 0xFF));
+	uint32_t pos[8];
+	__m128i base = _mm_set1_epi32((int) ms_pos);
+	_mm_storeu_si128((__m128i*) pos,
+			_mm_add_epi32(_mm_sub_epi32(t[0], m[0]), base));
+	_mm_storeu_si128((__m128i*) (pos + 4),
+			_mm_add_epi32(_mm_sub_epi32(t[1], m[1]), base));
+
+	//64 bits at the word holding each sample, aligned
+	uint32_t ms[8];
+	for (uint32_t i = 0; i < 8; ++i) {
+		uint64_t w;
+		memcpy(&w, ms_buf + (pos[i] >> 5), sizeof(w));
+		ms[i] = (uint32_t) (w >> (pos[i] & 0x1F));
+	}
+
+	__m128i val[2];
+	const __m128i shift = _mm_cvtsi32_si128(p - 1);
+	for (uint32_t i = 0; i < 2; ++i) {
+		__m128i ms_val = _mm_loadu_si128((__m128i*) (ms + 4 * i));
+		//1 << m_n, computed as the float 2^m_n
+		__m128i pow2 = _mm_cvttps_epi32(
+				_mm_castsi128_ps(
+						_mm_slli_epi32(_mm_add_epi32(m[i], _mm_set1_epi32(127)),
+								23)));
+		__m128i v = _mm_and_si128(ms_val, _mm_sub_epi32(pow2, one));
+		v = _mm_or_si128(v, _mm_and_si128(e_1[i], pow2));
+		v = _mm_or_si128(v, one);
+		val[i] = _mm_sll_epi32(_mm_add_epi32(v, _mm_set1_epi32(2)), shift);
+		val[i] = _mm_or_si128(val[i], _mm_slli_epi32(ms_val, 31));
+		val[i] = _mm_and_si128(val[i], sig[i]);
+		_mm_storeu_si128((__m128i*) (v_n + 4 * i), v);
+	}
+	if (locs == 0xFF) {
+		//all samples are inside the code block; store rows directly
+		__m128 a = _mm_castsi128_ps(val[0]), b = _mm_castsi128_ps(val[1]);
+		_mm_storeu_ps((float*) sp, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps((float*) (sp + stride),
+				_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	} else {
+		int32_t vals[8];
+		_mm_storeu_si128((__m128i*) vals, val[0]);
+		_mm_storeu_si128((__m128i*) (vals + 4), val[1]);
+		for (uint32_t i = 0; i < 8; ++i)
+			if ((locs >> i) & 1)
+				sp[(i >> 1) + (i & 1) * stride] = vals[i];
+	}
+}
+#endif
+
+}
+}
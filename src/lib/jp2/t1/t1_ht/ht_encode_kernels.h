@@ -0,0 +1,214 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ Sample preparation and MagSgn kernels of the HT block encoder. Compiled
+ once per instruction set: only include from SIMDKernelsImpl.h.
+ AVX-512 reuses the AVX2 kernels: a quad pair fills one AVX2 register.
+ */
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace grk {
+namespace GRK_KERNEL_NS {
+
+#if defined(__AVX2__)
+/**
+ * Prepare one quad pair from up to 4 columns and 2 rows of samples:
+ * samples outside the code block are insignificant
+ */
+static inline void ht_prepare_quad_pair(const int32_t *sp, uint32_t stride,
+		uint32_t columns, bool two_rows, uint32_t p, HTQuadPair *qp) {
+	__m128i r0, r1;
+	if (columns >= 4) {
+		r0 = _mm_loadu_si128((const __m128i*) sp);
+		r1 = two_rows ?
+				_mm_loadu_si128((const __m128i*) (sp + stride)) :
+				_mm_setzero_si128();
+	} else {
+		int32_t t[8] = { 0 };
+		for (uint32_t i = 0; i < columns; ++i) {
+			t[i] = sp[i];
+			t[i + 4] = two_rows ? sp[i + stride] : 0;
+		}
+		r0 = _mm_loadu_si128((const __m128i*) t);
+		r1 = _mm_loadu_si128((const __m128i*) (t + 4));
+	}
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi32(1);
+	// interleave rows, so that lanes follow sample numbering
+	__m256i t = _mm256_set_m128i(_mm_unpackhi_epi32(r0, r1),
+			_mm_unpacklo_epi32(r0, r1));
+	// 2 \mu_p, without sign
+	__m256i val = _mm256_srl_epi32(_mm256_add_epi32(t, t),
+			_mm_cvtsi32_si128((int) p));
+	val = _mm256_andnot_si256(one, val);
+	__m256i sig = _mm256_xor_si256(_mm256_cmpeq_epi32(val, zero),
+			_mm256_set1_epi32(-1));
+	int rho = _mm256_movemask_ps(_mm256_castsi256_ps(sig));
+	qp->rho[0] = rho & 0xF;
+	qp->rho[1] = rho >> 4;
+
+	// exponent of 2\mu_p - 1, from the float exponent of its leading bit
+	__m256i x = _mm256_sub_epi32(val, one);
+	x = _mm256_or_si256(x, _mm256_srli_epi32(x, 1));
+	x = _mm256_or_si256(x, _mm256_srli_epi32(x, 2));
+	x = _mm256_or_si256(x, _mm256_srli_epi32(x, 4));
+	x = _mm256_or_si256(x, _mm256_srli_epi32(x, 8));
+	x = _mm256_or_si256(x, _mm256_srli_epi32(x, 16));
+	x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 1));
+	__m256i e = _mm256_castps_si256(_mm256_cvtepi32_ps(x));
+	e = _mm256_and_si256(_mm256_srli_epi32(e, 23), _mm256_set1_epi32(0xFF));
+	e = _mm256_and_si256(_mm256_sub_epi32(e, _mm256_set1_epi32(126)), sig);
+	_mm256_storeu_si256((__m256i*) qp->e_q, e);
+
+	__m256i e_max = _mm256_max_epi32(e, _mm256_shuffle_epi32(e, 0xB1));
+	e_max = _mm256_max_epi32(e_max, _mm256_shuffle_epi32(e_max, 0x4E));
+	qp->e_qmax[0] = _mm256_extract_epi32(e_max, 0);
+	qp->e_qmax[1] = _mm256_extract_epi32(e_max, 4);
+	qp->eps = _mm256_movemask_ps(
+			_mm256_castsi256_ps(_mm256_cmpeq_epi32(e, e_max)));
+
+	// v_n = 2(\mu_p-1) + s_n
+	__m256i s = _mm256_add_epi32(_mm256_sub_epi32(val, _mm256_set1_epi32(2)),
+			_mm256_srli_epi32(t, 31));
+	_mm256_storeu_si256((__m256i*) qp->s, _mm256_and_si256(s, sig));
+}
+#else
+/**
+ * Number of significant bits of v
+ */
+static inline int32_t ht_num_bits(uint32_t v) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	return _BitScanReverse(&index, v) ? (int32_t) index + 1 : 0;
+#else
+	return v ? 32 - __builtin_clz(v) : 0;
+#endif
+}
+
+/**
+ * Prepare sample i of a quad pair
+ */
+static inline void ht_prepare_sample(int32_t t, uint32_t p, uint32_t i,
+		HTQuadPair *qp) {
+	uint32_t val = (uint32_t) t + (uint32_t) t; // get rid of sign
+	val >>= p; // 2 \mu_p + x
+	val &= ~1U; // 2 \mu_p
+	if (!val)
+		return;
+	uint32_t q = i >> 2;
+	qp->rho[q] |= 1 << (i & 3);
+	qp->e_q[i] = ht_num_bits(--val); // 2\mu_p - 1
+	if (qp->e_q[i] > qp->e_qmax[q])
+		qp->e_qmax[q] = qp->e_q[i];
+	qp->s[i] = --val + ((uint32_t) t >> 31); // v_n = 2(\mu_p-1) + s_n
+}
+
+/**
+ * Prepare one quad pair from up to 4 columns and 2 rows of samples:
+ * samples outside the code block are insignificant
+ */
+static inline void ht_prepare_quad_pair(const int32_t *sp, uint32_t stride,
+		uint32_t columns, bool two_rows, uint32_t p, HTQuadPair *qp) {
+	memset(qp, 0, sizeof(HTQuadPair));
+	if (columns > 4)
+		columns = 4;
+	for (uint32_t i = 0; i < columns; ++i) {
+		ht_prepare_sample(sp[i], p, 2 * i, qp);
+		if (two_rows)
+			ht_prepare_sample(sp[i + stride], p, 2 * i + 1, qp);
+	}
+	for (uint32_t i = 0; i < 8; ++i) {
+		if (qp->e_q[i] == qp->e_qmax[i >> 2])
+			qp->eps |= 1 << i;
+	}
+}
+#endif
+
+/**
+ * Prepare the (width + 3) / 4 quad pairs of a stripe of two rows
+ */
+static void ht_prepare_quads(const int32_t *sp, uint32_t stride,
+		uint32_t width, bool two_rows, uint32_t p, HTQuadPair *qp) {
+	for (uint32_t x = 0; x < width; x += 4)
+		ht_prepare_quad_pair(sp + x, stride, width - x, two_rows, p, qp++);
+}
+
+/**
+ * MagSgn codewords of a quad pair: m_n = U_q - e_k low bits of v_n
+ * for every significant sample
+ */
+static void ht_magsgn_codewords(const HTQuadPair *qp, const int32_t *U_q,
+		const uint32_t *e_k, uint32_t *cwd, int32_t *len) {
+#if defined(__AVX2__)
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i bit = _mm256_setr_epi32(1, 2, 4, 8, 1, 2, 4, 8);
+	__m256i rho = _mm256_setr_epi32(qp->rho[0], qp->rho[0], qp->rho[0],
+			qp->rho[0], qp->rho[1], qp->rho[1], qp->rho[1], qp->rho[1]);
+	__m256i sig = _mm256_cmpeq_epi32(_mm256_and_si256(rho, bit), zero);
+	__m256i ek = _mm256_setr_epi32((int) e_k[0], (int) e_k[0], (int) e_k[0],
+			(int) e_k[0], (int) e_k[1], (int) e_k[1], (int) e_k[1],
+			(int) e_k[1]);
+	ek = _mm256_min_epu32(_mm256_and_si256(ek, bit), one);
+	__m256i U = _mm256_setr_epi32(U_q[0], U_q[0], U_q[0], U_q[0], U_q[1],
+			U_q[1], U_q[1], U_q[1]);
+	__m256i m = _mm256_andnot_si256(sig, _mm256_sub_epi32(U, ek));
+	__m256i mask = _mm256_sub_epi32(_mm256_sllv_epi32(one, m), one);
+	__m256i s = _mm256_loadu_si256((const __m256i*) qp->s);
+	_mm256_storeu_si256((__m256i*) cwd, _mm256_and_si256(s, mask));
+	_mm256_storeu_si256((__m256i*) len, m);
+#elif defined(__SSE2__) && !defined(GRK_KERNEL_SCALAR)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i bit = _mm_setr_epi32(1, 2, 4, 8);
+	for (uint32_t i = 0; i < 2; ++i) {
+		__m128i sig = _mm_cmpeq_epi32(
+				_mm_and_si128(_mm_set1_epi32(qp->rho[i]), bit), zero);
+		__m128i ek = _mm_andnot_si128(
+				_mm_cmpeq_epi32(
+						_mm_and_si128(_mm_set1_epi32((int) e_k[i]), bit),
+						zero), one);
+		__m128i m = _mm_andnot_si128(sig,
+				_mm_sub_epi32(_mm_set1_epi32(U_q[i]), ek));
+		// 1 << m_n, computed as the float 2^m_n
+		__m128i pow2 = _mm_cvttps_epi32(
+				_mm_castsi128_ps(
+						_mm_slli_epi32(_mm_add_epi32(m, _mm_set1_epi32(127)),
+								23)));
+		__m128i s = _mm_loadu_si128((const __m128i*) (qp->s + 4 * i));
+		_mm_storeu_si128((__m128i*) (cwd + 4 * i),
+				_mm_and_si128(s, _mm_sub_epi32(pow2, one)));
+		_mm_storeu_si128((__m128i*) (len + 4 * i), m);
+	}
+#else
+	for (uint32_t i = 0; i < 8; ++i) {
+		uint32_t q = i >> 2;
+		int32_t m = ((qp->rho[q] >> (i & 3)) & 1) ?
+				U_q[q] - (int32_t) ((e_k[q] >> (i & 3)) & 1) : 0;
+		cwd[i] = qp->s[i] & ((1U << m) - 1);
+		len[i] = m;
+	}
+#endif
+}
+
+}
+}
@@ -16,6 +16,7 @@
  */
 #include <T1Part1.h>
 #include "grok_includes.h"
+#include "Dequantizer.h"
 #include "testing.h"
 #include <algorithm>
 using namespace std;
@@ -26,11 +27,9 @@ namespace t1_part1{
 T1Part1::T1Part1(bool isEncoder, grk_tcp *tcp, uint32_t maxCblkW,
 		uint32_t maxCblkH) : t1(nullptr){
 	(void) tcp;
+	(void) maxCblkW;
+	(void) maxCblkH;
 	t1 = t1_create(isEncoder);
-	if (!isEncoder) {
-	   t1->cblkdatabuffersize = maxCblkW * maxCblkH * (uint32_t)sizeof(int32_t);
-	   t1->cblkdatabuffer = (uint8_t*)grk_malloc(t1->cblkdatabuffersize);
-   }
 }
 T1Part1::~T1Part1() {
 	t1_destroy( t1);
@@ -55,31 +54,48 @@ static inline int32_t int_fix_mul_t1(int32_t a, int32_t b) {
 	return (int32_t) (temp >> (13 + 11 - T1_NMSEDEC_FRACBITS));
 }
 
+/**
+ Copy reversible coefficients into the code block, with T1_NMSEDEC_FRACBITS
+ fractional bits. Tile data is left untouched, so that the tile can be coded again.
+
+ @return maximum magnitude
+ */
+template<typename T> static uint32_t copy_reversible(const T *tiledp,
+		uint32_t stride, int32_t *dest, uint32_t w, uint32_t h) {
+	uint32_t maximum = 0;
+	for (uint32_t j = 0; j < h; ++j) {
+		for (uint32_t i = 0; i < w; ++i) {
+			int32_t temp = tiledp[i] * (1 << T1_NMSEDEC_FRACBITS);
+			maximum = max((uint32_t) abs(temp), maximum);
+			*dest++ = temp;
+		}
+		tiledp += stride;
+	}
+
+	return maximum;
+}
+
 void T1Part1::preEncode(encodeBlockInfo *block, grk_tcd_tile *tile,
 		uint32_t &maximum) {
+	(void)tile;
+
 	auto cblk = block->cblk;
 	auto w = cblk->x1 - cblk->x0;
 	auto h = cblk->y1 - cblk->y0;
 	if (!t1_allocate_buffers(t1, w,h))
 		return;
 	t1->data_stride = w;
-	uint32_t tile_width = (tile->comps + block->compno)->width();
+	uint32_t tile_width = block->stride;
 	auto tileLineAdvance = tile_width - w;
 	auto tiledp = block->tiledp;
 	uint32_t tileIndex = 0;
 	uint32_t cblk_index = 0;
 	maximum = 0;
 	if (block->qmfbid == 1) {
-		for (auto j = 0U; j < h; ++j) {
-			for (auto i = 0U; i < w; ++i) {
-				int32_t temp = (block->tiledp[tileIndex] *= (1<< T1_NMSEDEC_FRACBITS));
-				maximum = max((uint32_t)abs(temp), maximum);
-				t1->data[cblk_index] = temp;
-				tileIndex++;
-				cblk_index++;
-			}
-			tileIndex += tileLineAdvance;
-		}
+		if (block->tiledp16)
+			maximum = copy_reversible(block->tiledp16, tile_width, t1->data, w, h);
+		else
+			maximum = copy_reversible(block->tiledp, tile_width, t1->data, w, h);
 	} else {
 		for (auto j = 0U; j < h; ++j) {
 			for (auto i = 0U; i < w; ++i) {
@@ -113,7 +129,8 @@ double T1Part1::compress(encodeBlockInfo *block, grk_tcd_tile *tile,
 			block->compno,
 			(tile->comps + block->compno)->numresolutions - 1 - block->resno,
 			block->qmfbid, block->stepsize, block->cblk_sty,
-			block->mct_norms, block->mct_numcomps, doRateControl);
+			block->mct_norms, block->mct_numcomps, doRateControl,
+			block->stop_slope);
 
 	cblk->num_passes_encoded = cblkopj.totalpasses;
 	cblk->numbps = cblkopj.numbps;
@@ -141,24 +158,22 @@ bool T1Part1::decompress(decodeBlockInfo *block) {
 
 	auto min_buf_vec = &cblk->seg_buffers;
 	size_t total_seg_len = min_buf_vec->get_len() + GRK_FAKE_MARKER_BYTES;
-	if (t1->cblkdatabuffersize < total_seg_len) {
-		uint8_t *new_block = (uint8_t*) grk_realloc(t1->cblkdatabuffer,
-				total_seg_len);
-		if (!new_block)
-			return false;
-		t1->cblkdatabuffer = new_block;
-		t1->cblkdatabuffersize = (uint32_t)total_seg_len;
+	// concatenate all segments
+	auto cblkdata = ScratchArena::local()->alloc<uint8_t>(total_seg_len);
+	if (!cblkdata) {
+		GROK_ERROR("Out of memory");
+		return false;
 	}
 	size_t offset = 0;
 	// note: min_buf_vec only contains segments of non-zero length
 	for (size_t i = 0; i < min_buf_vec->size(); ++i) {
 		grk_buf *seg = (grk_buf*) min_buf_vec->get(i);
-		memcpy(t1->cblkdatabuffer + offset, seg->buf, seg->len);
+		memcpy(cblkdata + offset, seg->buf, seg->len);
 		offset += seg->len;
 	}
 	tcd_seg_data_chunk_t chunk;
-	chunk.len = t1->cblkdatabuffersize;
-	chunk.data = t1->cblkdatabuffer;
+	chunk.len = (uint32_t)total_seg_len;
+	chunk.data = cblkdata;
 
 	tcd_cblk_dec_t cblkopj;
 	memset(&cblkopj, 0, sizeof(tcd_cblk_dec_t));
@@ -190,6 +205,7 @@ bool T1Part1::decompress(decodeBlockInfo *block) {
     				block->bandno,
 					block->roishift,
 					block->cblk_sty,
+					block->skipped_lsbs,
 					false);
 
 	delete[] segs;
@@ -216,115 +232,37 @@ void T1Part1::postDecode(decodeBlockInfo *block) {
 void T1Part1::post_decode(t1_info *t1,
 						tcd_cblk_dec_t *cblk,
 						decodeBlockInfo *block) {
-	uint32_t roishift = block->roishift;
-	uint32_t qmfbid = block->qmfbid;
-	float stepsize = block->stepsize;
-	int32_t *tilec_data = block->tiledp;
-	uint32_t tile_w = block->tilec->width();
-	bool whole_tile_decoding = block->tilec->whole_tile_decoding;
-	auto src = t1->data;
-	uint32_t dest_width = tile_w;
 	uint32_t cblk_w = (uint32_t) (cblk->x1 - cblk->x0);
 	uint32_t cblk_h = (uint32_t) (cblk->y1 - cblk->y0);
-
-	if (roishift) {
-		if (roishift >= 31) {
-			for (uint16_t j = 0; j < cblk_h; ++j) {
-				for (uint16_t i = 0; i < cblk_w; ++i) {
-					src[(j * cblk_w) + i] = 0;
-				}
-			}
-		} else {
-			int32_t thresh = 1 << roishift;
-			for (uint32_t j = 0; j < cblk_h; ++j) {
-				for (uint32_t i = 0; i < cblk_w; ++i) {
-					int32_t val = src[(j * cblk_w) + i];
-					int32_t mag = abs(val);
-					if (mag >= thresh) {
-						mag >>= roishift;
-						src[(j * cblk_w) + i] = val < 0 ? -mag : mag;
-					}
-				}
-			}
-		}
-	}
-
-	if (!whole_tile_decoding) {
-    	if (qmfbid == 1) {
-    		for (uint32_t j = 0; j < cblk_h; ++j) {
-    			uint32_t i = 0;
-    			for (; i < (cblk_w & ~(uint32_t) 3U); i += 4U) {
-    				src[(j * cblk_w) + i + 0U] /= 2;
-    				src[(j * cblk_w) + i + 1U] /= 2;
-    				src[(j * cblk_w) + i + 2U] /= 2;
-    				src[(j * cblk_w) + i + 3U] /= 2;
-    			}
-    			for (; i < cblk_w; ++i)
-    				src[(j * cblk_w) + i] /= 2;
-     		}
-    	} else {
-			float *GRK_RESTRICT tiledp = (float*) src;
-			for (uint32_t j = 0; j < cblk_h; ++j) {
-				float *GRK_RESTRICT tiledp2 = tiledp;
-				for (uint32_t i = 0; i < cblk_w; ++i) {
-					float tmp = (float) (*src) * stepsize;
-					*tiledp2 = tmp;
-					src++;
-					tiledp2++;
-				}
-				tiledp += cblk_w;
-			}
-    	}
+	auto tilec = block->tilec;
+	auto dequantizer = Dequantizer::part1(block->roishift,
+										block->qmfbid == 1,
+										block->stepsize);
+	if (block->tiledp16) {
+		dequantizer.dequantize(t1->data,
+								cblk_w,
+								block->tiledp16,
+								tilec->width(),
+								cblk_w,
+								cblk_h,
+								tilec->buf->coeff16_frac_bits);
+	} else if (tilec->whole_tile_decoding) {
+		dequantizer.dequantize(t1->data,
+								cblk_w,
+								block->tiledp,
+								tilec->width(),
+								cblk_w,
+								cblk_h);
+	} else {
 		// write directly from t1 to sparse array
-        if (!block->tilec->m_sa->write(block->x,
+		tilec->m_sa->write_transformed(block->x,
 					  block->y,
 					  block->x + cblk_w,
 					  block->y + cblk_h,
 					  t1->data,
-					  1,
 					  cblk_w,
-					  true)) {
-			  return;
-		  }
-	} else {
-		auto dest = tilec_data;
-		if (qmfbid == 1) {
-			int32_t *GRK_RESTRICT tiledp = dest;
-			for (uint32_t j = 0; j < cblk_h; ++j) {
-				uint32_t i = 0;
-				for (; i < (cblk_w & ~(uint32_t) 3U); i += 4U) {
-					int32_t tmp0 = src[(j * cblk_w) + i + 0U];
-					int32_t tmp1 = src[(j * cblk_w) + i + 1U];
-					int32_t tmp2 = src[(j * cblk_w) + i + 2U];
-					int32_t tmp3 = src[(j * cblk_w) + i + 3U];
-					((int32_t*) tiledp)[(j * (size_t) dest_width) + i + 0U] = tmp0
-							/ 2;
-					((int32_t*) tiledp)[(j * (size_t) dest_width) + i + 1U] = tmp1
-							/ 2;
-					((int32_t*) tiledp)[(j * (size_t) dest_width) + i + 2U] = tmp2
-							/ 2;
-					((int32_t*) tiledp)[(j * (size_t) dest_width) + i + 3U] = tmp3
-							/ 2;
-				}
-				for (; i < cblk_w; ++i) {
-					int32_t tmp = src[(j * cblk_w) + i];
-					((int32_t*) tiledp)[(j * (size_t) dest_width) + i] = tmp / 2;
-				}
-			}
-		} else {
-			float *GRK_RESTRICT tiledp = (float*) dest;
-			for (uint32_t j = 0; j < cblk_h; ++j) {
-				float *GRK_RESTRICT tiledp2 = tiledp;
-				for (uint32_t i = 0; i < cblk_w; ++i) {
-					float tmp = (float) (*src) * stepsize;
-					*tiledp2 = tmp;
-					src++;
-					tiledp2++;
-				}
-				tiledp += dest_width;
-			}
-		}
-
+					  dequantizer,
+					  true);
 	}
 }
 
@@ -83,16 +83,14 @@ static INLINE void 		t1_update_flags(grk_flag *flagsp, uint32_t ci, uint32_t s,
 										uint32_t stride, uint32_t vsc);
 static INLINE void 		t1_dec_sigpass_step_raw(t1_info *t1, grk_flag *flagsp,
 												int32_t *datap, int32_t oneplushalf,
-												uint32_t vsc, uint32_t ci);
+												uint32_t vsc, uint32_t ci, uint32_t flags_stride);
 static INLINE void 		t1_dec_sigpass_step_mqc(t1_info *t1, grk_flag *flagsp,
 												int32_t *datap, int32_t oneplushalf, uint32_t ci,
 												uint32_t flags_stride, uint32_t vsc);
 static void 			t1_enc_sigpass(t1_info *t1, int32_t bpno, int32_t *nmsedec,
 										uint8_t type, uint32_t cblksty);
-static void 			t1_dec_sigpass_raw(t1_info *t1, int32_t bpno, int32_t cblksty);
 static void 			t1_enc_refpass(t1_info *t1, int32_t bpno, int32_t *nmsedec,
 										uint8_t type);
-static void 			t1_dec_refpass_raw(t1_info *t1, int32_t bpno);
 static INLINE void 		t1_dec_refpass_step_raw(t1_info *t1, grk_flag *flagsp,
 												int32_t *datap, int32_t poshalf, uint32_t ci);
 static INLINE void 		t1_dec_refpass_step_mqc(t1_info *t1, grk_flag *flagsp,
@@ -231,7 +229,8 @@ static INLINE void t1_enc_sigpass_step(t1_info *t1, grk_flag *flagsp,
 }
 
 static INLINE void t1_dec_sigpass_step_raw(t1_info *t1, grk_flag *flagsp,
-		int32_t *datap, int32_t oneplushalf, uint32_t vsc, uint32_t ci) {
+		int32_t *datap, int32_t oneplushalf, uint32_t vsc, uint32_t ci,
+		uint32_t flags_stride) {
 	uint32_t v;
 	auto mqc = &(t1->mqc);
 	uint32_t const flags = *flagsp;
@@ -241,7 +240,7 @@ static INLINE void t1_dec_sigpass_step_raw(t1_info *t1, grk_flag *flagsp,
 		if (mqc_raw_decode(mqc)) {
 			v = mqc_raw_decode(mqc);
 			*datap = v ? -oneplushalf : oneplushalf;
-			t1_update_flags(flagsp, ci, v, t1->w + 2, vsc);
+			t1_update_flags(flagsp, ci, v, flags_stride, vsc);
 		}
 		*flagsp |= T1_PI_THIS << (ci);
 	}
@@ -337,42 +336,49 @@ static void t1_enc_sigpass(t1_info *t1, int32_t bpno, int32_t *nmsedec,
 	}
 }
 
-static void t1_dec_sigpass_raw(t1_info *t1, int32_t bpno, int32_t cblksty) {
+/**
+ * Decode pass templates are specialized for a w x h code block.
+ * A zero dimension is read from t1 at run time.
+ */
+template <uint32_t w, uint32_t h> static void t1_dec_sigpass_raw(t1_info *t1,
+		int32_t bpno, int32_t cblksty) {
 	int32_t one, half, oneplushalf;
 	uint32_t i, j, k;
 	auto data = t1->data;
-	auto flagsp = &T1_FLAGS(0, 0);
-	const uint32_t l_w = t1->w;
+	const uint32_t l_w = w ? w : t1->w;
+	const uint32_t l_h = h ? h : t1->h;
+	const uint32_t flags_stride = l_w + 2U;
+	auto flagsp = &t1->flags[flags_stride + 1];
 
 	one = 1 << bpno;
 	half = one >> 1;
 	oneplushalf = one | half;
 
-	for (k = 0; k < (t1->h & ~3U); k += 4, flagsp += 2, data += 3 * l_w) {
+	for (k = 0; k < (l_h & ~3U); k += 4, flagsp += 2, data += 3 * l_w) {
 		for (i = 0; i < l_w; ++i, ++flagsp, ++data) {
 			grk_flag flags = *flagsp;
 			if (flags != 0) {
 				t1_dec_sigpass_step_raw(t1, flagsp, data, oneplushalf,
 						cblksty & GRK_CBLKSTY_VSC, /* vsc */
-						0U);
+						0U, flags_stride);
 				t1_dec_sigpass_step_raw(t1, flagsp, data + l_w, oneplushalf,
 						false, /* vsc */
-						3U);
+						3U, flags_stride);
 				t1_dec_sigpass_step_raw(t1, flagsp, data + 2 * l_w, oneplushalf,
 						false, /* vsc */
-						6U);
+						6U, flags_stride);
 				t1_dec_sigpass_step_raw(t1, flagsp, data + 3 * l_w, oneplushalf,
 						false, /* vsc */
-						9U);
+						9U, flags_stride);
 			}
 		}
 	}
-	if (k < t1->h) {
+	if (k < l_h) {
 		for (i = 0; i < l_w; ++i, ++flagsp, ++data) {
-			for (j = 0; j < t1->h - k; ++j) {
+			for (j = 0; j < l_h - k; ++j) {
 				t1_dec_sigpass_step_raw(t1, flagsp, data + j * l_w, oneplushalf,
 						cblksty & GRK_CBLKSTY_VSC, /* vsc */
-						3*j);
+						3*j, flags_stride);
 			}
 		}
 	}
@@ -423,20 +429,14 @@ static void t1_dec_sigpass_raw(t1_info *t1, int32_t bpno, int32_t cblksty) {
         } \
 }
 
-static void t1_dec_sigpass_mqc(t1_info *t1, int32_t bpno, int32_t cblksty) {
-	if (t1->w == 64 && t1->h == 64) {
-		if (cblksty & GRK_CBLKSTY_VSC){
-			t1_dec_sigpass_mqc_internal(t1, bpno, true, 64, 64, 66);
-		}
-		else {
-			t1_dec_sigpass_mqc_internal(t1, bpno, false, 64, 64, 66);
-		}
+template <uint32_t w, uint32_t h> static void t1_dec_sigpass_mqc(t1_info *t1,
+		int32_t bpno, int32_t cblksty) {
+	const uint32_t cblk_w = w ? w : t1->w;
+	const uint32_t cblk_h = h ? h : t1->h;
+	if (cblksty & GRK_CBLKSTY_VSC) {
+		t1_dec_sigpass_mqc_internal(t1, bpno, true, cblk_w, cblk_h, cblk_w + 2U);
 	} else {
-		if (cblksty & GRK_CBLKSTY_VSC) {
-			t1_dec_sigpass_mqc_internal(t1, bpno, true, t1->w, t1->h, t1->w + 2U);
-		} else {
-			t1_dec_sigpass_mqc_internal(t1, bpno, false, t1->w, t1->h, t1->w + 2U);
-		}
+		t1_dec_sigpass_mqc_internal(t1, bpno, false, cblk_w, cblk_h, cblk_w + 2U);
 	}
 }
 
@@ -554,16 +554,18 @@ static void t1_enc_refpass(t1_info *t1, int32_t bpno, int32_t *nmsedec,
 	}
 }
 
-static void t1_dec_refpass_raw(t1_info *t1, int32_t bpno) {
+template <uint32_t w, uint32_t h> static void t1_dec_refpass_raw(t1_info *t1,
+		int32_t bpno) {
 	int32_t one, poshalf;
 	uint32_t i, j, k;
 	auto data = t1->data;
-	auto flagsp = &T1_FLAGS(0, 0);
-	const uint32_t l_w = t1->w;
+	const uint32_t l_w = w ? w : t1->w;
+	const uint32_t l_h = h ? h : t1->h;
+	auto flagsp = &t1->flags[l_w + 2U + 1];
 
 	one = 1 << bpno;
 	poshalf = one >> 1;
-	for (k = 0; k < (t1->h & ~3U); k += 4, flagsp += 2, data += 3 * l_w) {
+	for (k = 0; k < (l_h & ~3U); k += 4, flagsp += 2, data += 3 * l_w) {
 		for (i = 0; i < l_w; ++i, ++flagsp, ++data) {
 			grk_flag flags = *flagsp;
 			if (flags != 0) {
@@ -576,9 +578,9 @@ static void t1_dec_refpass_raw(t1_info *t1, int32_t bpno) {
 			}
 		}
 	}
-	if (k < t1->h) {
+	if (k < l_h) {
 		for (i = 0; i < l_w; ++i, ++flagsp, ++data) {
-			for (j = 0; j < t1->h - k; ++j) {
+			for (j = 0; j < l_h - k; ++j) {
 				t1_dec_refpass_step_raw(t1, flagsp, data + j * l_w, poshalf, 3*j);
 			}
 		}
@@ -628,12 +630,11 @@ static void t1_dec_refpass_raw(t1_info *t1, int32_t bpno) {
         } \
 }
 
-static void t1_dec_refpass_mqc(t1_info *t1, int32_t bpno) {
-	if (t1->w == 64 && t1->h == 64) {
-		t1_dec_refpass_mqc_internal(t1, bpno, 64, 64, 66);
-	} else {
-		t1_dec_refpass_mqc_internal(t1, bpno, t1->w, t1->h, t1->w + 2U);
-	}
+template <uint32_t w, uint32_t h> static void t1_dec_refpass_mqc(t1_info *t1,
+		int32_t bpno) {
+	const uint32_t cblk_w = w ? w : t1->w;
+	const uint32_t cblk_h = h ? h : t1->h;
+	t1_dec_refpass_mqc_internal(t1, bpno, cblk_w, cblk_h, cblk_w + 2U);
 }
 
 static void t1_enc_clnpass_step(t1_info *t1, grk_flag *flagsp, int32_t *datap,
@@ -889,23 +890,17 @@ static void t1_dec_clnpass_check_segsym(t1_info *t1, int32_t cblksty) {
 }
 
 template <uint32_t w, uint32_t h, bool vsc> void t1_dec_clnpass(t1_info *t1, int32_t bpno) {
-	t1_dec_clnpass_internal(t1, bpno, vsc, w, h, w+2);
+	const uint32_t cblk_w = w ? w : t1->w;
+	const uint32_t cblk_h = h ? h : t1->h;
+	t1_dec_clnpass_internal(t1, bpno, vsc, cblk_w, cblk_h, cblk_w + 2U);
 }
 
-static void t1_dec_clnpass(t1_info *t1, int32_t bpno, int32_t cblksty) {
-	if (t1->w == 64 && t1->h == 64) {
-		if (cblksty & GRK_CBLKSTY_VSC)
-			t1_dec_clnpass<64,64,true>(t1, bpno);
-		else
-			t1_dec_clnpass<64,64,false>(t1, bpno);
-	} else {
-		if (cblksty & GRK_CBLKSTY_VSC){
-			t1_dec_clnpass_internal(t1, bpno, true,t1->w,t1->h,t1->w+2);
-		}
-		else {
-			t1_dec_clnpass_internal(t1, bpno, false,t1->w,t1->h,t1->w+2);
-		}
-	}
+template <uint32_t w, uint32_t h> static void t1_dec_clnpass(t1_info *t1,
+		int32_t bpno, int32_t cblksty) {
+	if (cblksty & GRK_CBLKSTY_VSC)
+		t1_dec_clnpass<w,h,true>(t1, bpno);
+	else
+		t1_dec_clnpass<w,h,false>(t1, bpno);
 	t1_dec_clnpass_check_segsym(t1, cblksty);
 }
 
@@ -941,19 +936,18 @@ bool t1_allocate_buffers(t1_info *t1, uint32_t w, uint32_t h) {
 	assert(h <= 1024);
 	assert(w * h <= 4096);
 
+	/* buffers come from the scratch arena of the calling thread,
+	 and are only valid until the enclosing ScratchArena::Frame closes */
+	auto arena = grk::ScratchArena::local();
+
 	/* encoder uses tile buffer, so no need to allocate */
 	uint32_t datasize = w * h;
-
-	if (datasize > t1->datasize) {
-		grk::grk_aligned_free(t1->data);
-		t1->data =
-				(int32_t*) grk::grk_aligned_malloc(datasize * sizeof(int32_t));
-		if (!t1->data) {
-			GROK_ERROR("Out of memory");
-			return false;
-		}
-		t1->datasize = datasize;
+	t1->data = arena->alloc<int32_t>(datasize);
+	if (!t1->data) {
+		GROK_ERROR("Out of memory");
+		return false;
 	}
+	t1->datasize = datasize;
 	/* memset first arg is declared to never be null by gcc */
 	if (t1->data && !t1->encoder)
 		memset(t1->data, 0, datasize * sizeof(int32_t));
@@ -964,15 +958,10 @@ bool t1_allocate_buffers(t1_info *t1, uint32_t w, uint32_t h) {
 	uint32_t x;
 	uint32_t flags_height = (h + 3U) / 4U;
 
-	if (flagssize > t1->flagssize) {
-
-		grk::grk_aligned_free(t1->flags);
-		t1->flags = (grk_flag*) grk::grk_aligned_malloc(
-				flagssize * sizeof(grk_flag));
-		if (!t1->flags) {
-			/* FIXME event manager error callback */
-			return false;
-		}
+	t1->flags = arena->alloc<grk_flag>(flagssize);
+	if (!t1->flags) {
+		GROK_ERROR("Out of memory");
+		return false;
 	}
 	t1->flagssize = flagssize;
 
@@ -1021,48 +1010,24 @@ void t1_destroy(t1_info *p_t1) {
 	if (!p_t1)
 		return;
 
-	if (p_t1->data) {
-		grk::grk_aligned_free(p_t1->data);
-		p_t1->data = 00;
-	}
-
-	if (p_t1->flags) {
-		grk::grk_aligned_free(p_t1->flags);
-		p_t1->flags = 00;
-	}
-
-	grk::grok_free(p_t1->cblkdatabuffer);
+	/* data and flags belong to the scratch arena */
 	grk::grok_free(p_t1);
 }
 
-bool t1_decode_cblk(t1_info *t1, tcd_cblk_dec_t *cblk, uint32_t orient,
-		uint32_t roishift, uint32_t cblksty, bool check_pterm) {
+/**
+ * Decode all segments of a code block, down to bit plane min_bpno_plus_one,
+ * with passes specialized for a w x h code block
+ */
+template <uint32_t w, uint32_t h> static void t1_dec_segments(t1_info *t1,
+		tcd_cblk_dec_t *cblk, uint32_t cblksty, int32_t bpno_plus_one,
+		int32_t min_bpno_plus_one) {
 	auto mqc = &(t1->mqc);
-	int32_t bpno_plus_one;
-	uint32_t passtype;
+	uint32_t passtype = 2;
 	uint32_t segno, passno;
-	uint8_t *cblkdata = nullptr;
+	uint8_t *cblkdata = cblk->chunks[0].data;
 	uint32_t cblkdataindex = 0;
 	uint8_t type = T1_TYPE_MQ;
 
-	mqc->lut_ctxno_zc_orient = lut_ctxno_zc + (orient << 9);
-
-	if (!t1_allocate_buffers(t1, (uint32_t) (cblk->x1 - cblk->x0),
-							(uint32_t) (cblk->y1 - cblk->y0)))
-		return false;
-
-
-	bpno_plus_one = (int32_t) (roishift + cblk->numbps);
-	if (bpno_plus_one >= 31) {
-		grk::GROK_ERROR("unsupported bpno_plus_one = %d >= 31",
-				bpno_plus_one);
-		return false;
-	}
-	passtype = 2;
-
-	mqc_resetstates(mqc);
-	cblkdata = cblk->chunks[0].data;
-
 	for (segno = 0; segno < cblk->real_num_segs; ++segno) {
 		auto seg = cblk->segs + segno;
 
@@ -1081,23 +1046,23 @@ bool t1_decode_cblk(t1_info *t1, tcd_cblk_dec_t *cblk, uint32_t orient,
 		cblkdataindex += seg->len;
 
 		for (passno = 0;
-				(passno < seg->real_num_passes) && (bpno_plus_one >= 1);
+				(passno < seg->real_num_passes) && (bpno_plus_one >= min_bpno_plus_one);
 				++passno) {
 			switch (passtype) {
 			case 0:
 				if (type == T1_TYPE_RAW)
-					t1_dec_sigpass_raw(t1, bpno_plus_one, (int32_t) cblksty);
+					t1_dec_sigpass_raw<w,h>(t1, bpno_plus_one, (int32_t) cblksty);
 				else
-					t1_dec_sigpass_mqc(t1, bpno_plus_one, (int32_t) cblksty);
+					t1_dec_sigpass_mqc<w,h>(t1, bpno_plus_one, (int32_t) cblksty);
 				break;
 			case 1:
 				if (type == T1_TYPE_RAW)
-					t1_dec_refpass_raw(t1, bpno_plus_one);
+					t1_dec_refpass_raw<w,h>(t1, bpno_plus_one);
 				else
-					t1_dec_refpass_mqc(t1, bpno_plus_one);
+					t1_dec_refpass_mqc<w,h>(t1, bpno_plus_one);
 				break;
 			case 2:
-				t1_dec_clnpass(t1, bpno_plus_one, (int32_t) cblksty);
+				t1_dec_clnpass<w,h>(t1, bpno_plus_one, (int32_t) cblksty);
 				break;
 			}
 
@@ -1111,6 +1076,45 @@ bool t1_decode_cblk(t1_info *t1, tcd_cblk_dec_t *cblk, uint32_t orient,
 
 		opq_mqc_finish_dec(mqc);
 	}
+}
+
+bool t1_decode_cblk(t1_info *t1, tcd_cblk_dec_t *cblk, uint32_t orient,
+		uint32_t roishift, uint32_t cblksty, uint32_t skipped_lsbs,
+		bool check_pterm) {
+	auto mqc = &(t1->mqc);
+	int32_t bpno_plus_one;
+	int32_t min_bpno_plus_one = 1 + (int32_t)skipped_lsbs;
+
+	mqc->lut_ctxno_zc_orient = lut_ctxno_zc + (orient << 9);
+
+	if (!t1_allocate_buffers(t1, (uint32_t) (cblk->x1 - cblk->x0),
+							(uint32_t) (cblk->y1 - cblk->y0)))
+		return false;
+
+
+	bpno_plus_one = (int32_t) (roishift + cblk->numbps);
+	if (bpno_plus_one >= 31) {
+		grk::GROK_ERROR("unsupported bpno_plus_one = %d >= 31",
+				bpno_plus_one);
+		return false;
+	}
+
+	mqc_resetstates(mqc);
+
+	/* common code block sizes get passes with constant
+	 * dimensions and flag stride */
+	if (t1->w == 64 && t1->h == 64)
+		t1_dec_segments<64,64>(t1, cblk, cblksty, bpno_plus_one,
+				min_bpno_plus_one);
+	else if (t1->w == 32 && t1->h == 32)
+		t1_dec_segments<32,32>(t1, cblk, cblksty, bpno_plus_one,
+				min_bpno_plus_one);
+	else if (t1->w == 64 && t1->h == 32)
+		t1_dec_segments<64,32>(t1, cblk, cblksty, bpno_plus_one,
+				min_bpno_plus_one);
+	else
+		t1_dec_segments<0,0>(t1, cblk, cblksty, bpno_plus_one,
+				min_bpno_plus_one);
 
 	if (check_pterm) {
 		if (mqc->bp + 2 < mqc->end) {
@@ -1182,7 +1186,8 @@ static bool t1_code_block_enc_allocate(tcd_cblk_enc_t *p_code_block) {
 double t1_encode_cblk(t1_info *t1, tcd_cblk_enc_t *cblk, uint32_t max,
 					uint8_t orient, uint32_t compno, uint32_t level, uint32_t qmfbid,
 					double stepsize, uint32_t cblksty,
-					const double *mct_norms, uint32_t mct_numcomps, bool doRateControl) {
+					const double *mct_norms, uint32_t mct_numcomps, bool doRateControl,
+					double stop_slope) {
 	if (!t1_code_block_enc_allocate(cblk))
 		return 0;
 
@@ -1218,6 +1223,9 @@ double t1_encode_cblk(t1_info *t1, tcd_cblk_enc_t *cblk, uint32_t max,
 	mqc_init_enc(mqc, cblk->data);
 
 	double cumwmsedec = 0.0;
+	// rate and distortion at the end of the previous bit plane
+	uint32_t bitplane_rate = 0;
+	double bitplane_wmsedec = 0.0;
 	for (passno = 0; bpno >= 0; ++passno) {
 		tcd_pass_t *pass = &cblk->passes[passno];
 		type = ((bpno < ((int32_t) (cblk->numbps) - 4)) &&
@@ -1253,7 +1261,19 @@ double t1_encode_cblk(t1_info *t1, tcd_cblk_enc_t *cblk, uint32_t max,
 			pass->distortiondec = cumwmsedec;
 		}
 
-		if (t1_enc_is_term_pass(cblk, cblksty, bpno, passtype)) {
+		// stop after a bit plane whose distortion-rate slope is below the
+		// stop slope: rate control is expected to discard the remaining passes
+		bool stop = false;
+		if (doRateControl && stop_slope > 0 && passtype == 2 && bpno > 0) {
+			uint32_t rate = mqc_numbytes_enc(mqc);
+			if (rate > bitplane_rate)
+				stop = (cumwmsedec - bitplane_wmsedec)
+						< stop_slope * (double) (rate - bitplane_rate);
+			bitplane_rate = rate;
+			bitplane_wmsedec = cumwmsedec;
+		}
+
+		if (stop || t1_enc_is_term_pass(cblk, cblksty, bpno, passtype)) {
 			/* If it is a terminated pass, terminate it */
 			if (type == T1_TYPE_RAW) {
 				mqc_bypass_flush_enc(mqc, cblksty & GRK_CBLKSTY_PTERM);
@@ -1296,6 +1316,11 @@ double t1_encode_cblk(t1_info *t1, tcd_cblk_enc_t *cblk, uint32_t max,
 		/* Code-switch "RESET" */
 		if (cblksty & GRK_CBLKSTY_RESET)
 			mqc_resetstates(mqc);
+
+		if (stop) {
+			passno++;
+			break;
+		}
 	}
 
 	cblk->totalpasses = passno;
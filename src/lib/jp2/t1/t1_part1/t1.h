@@ -174,6 +174,8 @@ struct t1_info {
 	/** MQC component */
 	mqcoder mqc;
 
+	/** data and flags are drawn from the thread's scratch arena
+	 for each code block, by t1_allocate_buffers */
 	int32_t *data;
 	/** Flags used by decoder and encoder.
 	 * Such that flags[1+0] is for state of col=0,row=0..3,
@@ -188,16 +190,17 @@ struct t1_info {
 	uint32_t flagssize;
 	uint32_t data_stride;
 	bool encoder;
-
-	/* Temporary buffer to concatenate all chunks of a codebock */
-	uint8_t *cblkdatabuffer;
-	/* Maximum size available in cblkdatabuffer */
-	uint32_t cblkdatabuffersize;
 };
 
+/**
+ * Decode a code block.
+ *
+ * The lowest skipped_lsbs bit planes are not decoded:
+ * decoding stops after the last pass of the bit plane above them.
+ */
 bool t1_decode_cblk(t1_info *t1, tcd_cblk_dec_t *cblk,
 		uint32_t orient, uint32_t roishift, uint32_t cblksty,
-		bool check_pterm);
+		uint32_t skipped_lsbs, bool check_pterm);
 
 void t1_code_block_enc_deallocate(tcd_cblk_enc_t *
         p_code_block);
@@ -210,7 +213,7 @@ double t1_encode_cblk(t1_info *t1, tcd_cblk_enc_t *cblk,
 		uint8_t orient, uint32_t compno, uint32_t level,
 		uint32_t qmfbid, double stepsize, uint32_t cblksty,
 		const double *mct_norms,
-		uint32_t mct_numcomps, bool doRateControl);
+		uint32_t mct_numcomps, bool doRateControl, double stop_slope);
 
 t1_info* t1_create(bool isEncoder);
 void t1_destroy(t1_info *p_t1);
@@ -0,0 +1,133 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+/**
+ * Thin wrappers over AVX-512, AVX2 or SSE4.1 integer and float vectors, shared
+ * by the code block quantization and dequantization kernels. Must be included
+ * before grok_includes.h. As in simd.h, AVX-512 is only used when
+ * GRK_SIMD_AVX512 is defined.
+ */
+
+#include <cstdint>
+#if defined(__AVX2__) || defined(GRK_SIMD_AVX512)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+namespace grk {
+
+#if defined(GRK_SIMD_AVX512)
+typedef __m512i vint;
+typedef __m512 vfloat;
+const uint32_t vlen = 16;
+static inline vint vset(int32_t x) { return _mm512_set1_epi32(x); }
+static inline vint vload(const int32_t *p) { return _mm512_loadu_si512((const void*)p); }
+static inline void vstore(int32_t *p, vint x) { _mm512_storeu_si512((void*)p, x); }
+static inline vint vand(vint a, vint b) { return _mm512_and_si512(a, b); }
+static inline vint vandnot(vint a, vint b) { return _mm512_andnot_si512(a, b); }
+static inline vint vor(vint a, vint b) { return _mm512_or_si512(a, b); }
+static inline vint vxor(vint a, vint b) { return _mm512_xor_si512(a, b); }
+static inline vint vadd(vint a, vint b) { return _mm512_add_epi32(a, b); }
+static inline vint vsub(vint a, vint b) { return _mm512_sub_epi32(a, b); }
+static inline vint vabs(vint a) { return _mm512_abs_epi32(a); }
+// no sign instruction: negate where b < 0, zero where b == 0
+static inline vint vsign(vint a, vint b) {
+	const vint zero = _mm512_setzero_si512();
+	vint r = _mm512_mask_sub_epi32(a, _mm512_cmplt_epi32_mask(b, zero), zero, a);
+	return _mm512_maskz_mov_epi32(_mm512_cmpneq_epi32_mask(b, zero), r);
+}
+// comparisons give a mask register: expand to all ones lanes
+static inline vint vcmpgt(vint a, vint b) {
+	return _mm512_maskz_mov_epi32(_mm512_cmpgt_epi32_mask(a, b), _mm512_set1_epi32(-1));
+}
+static inline vint vmaxu(vint a, vint b) { return _mm512_max_epu32(a, b); }
+static inline vint vsll(vint a, uint32_t n) { return _mm512_sll_epi32(a, _mm_cvtsi32_si128((int)n)); }
+static inline vint vsra(vint a, uint32_t n) { return _mm512_sra_epi32(a, _mm_cvtsi32_si128((int)n)); }
+static inline vint vsrl(vint a, uint32_t n) { return _mm512_srl_epi32(a, _mm_cvtsi32_si128((int)n)); }
+static inline vfloat vcvt(vint a) { return _mm512_cvtepi32_ps(a); }
+static inline vfloat vsetf(float x) { return _mm512_set1_ps(x); }
+static inline vfloat vmulf(vfloat a, vfloat b) { return _mm512_mul_ps(a, b); }
+static inline vint vcastf(vfloat a) { return _mm512_castps_si512(a); }
+static inline vint vcvttf(vfloat a) { return _mm512_cvttps_epi32(a); }
+static inline uint32_t vhmaxu(vint a) { return _mm512_reduce_max_epu32(a); }
+#elif defined(__AVX2__)
+typedef __m256i vint;
+typedef __m256 vfloat;
+const uint32_t vlen = 8;
+static inline vint vset(int32_t x) { return _mm256_set1_epi32(x); }
+static inline vint vload(const int32_t *p) { return _mm256_loadu_si256((const vint*)p); }
+static inline void vstore(int32_t *p, vint x) { _mm256_storeu_si256((vint*)p, x); }
+static inline vint vand(vint a, vint b) { return _mm256_and_si256(a, b); }
+static inline vint vandnot(vint a, vint b) { return _mm256_andnot_si256(a, b); }
+static inline vint vor(vint a, vint b) { return _mm256_or_si256(a, b); }
+static inline vint vxor(vint a, vint b) { return _mm256_xor_si256(a, b); }
+static inline vint vadd(vint a, vint b) { return _mm256_add_epi32(a, b); }
+static inline vint vsub(vint a, vint b) { return _mm256_sub_epi32(a, b); }
+static inline vint vabs(vint a) { return _mm256_abs_epi32(a); }
+static inline vint vsign(vint a, vint b) { return _mm256_sign_epi32(a, b); }
+static inline vint vcmpgt(vint a, vint b) { return _mm256_cmpgt_epi32(a, b); }
+static inline vint vmaxu(vint a, vint b) { return _mm256_max_epu32(a, b); }
+static inline vint vsll(vint a, uint32_t n) { return _mm256_sll_epi32(a, _mm_cvtsi32_si128((int)n)); }
+static inline vint vsra(vint a, uint32_t n) { return _mm256_sra_epi32(a, _mm_cvtsi32_si128((int)n)); }
+static inline vint vsrl(vint a, uint32_t n) { return _mm256_srl_epi32(a, _mm_cvtsi32_si128((int)n)); }
+static inline vfloat vcvt(vint a) { return _mm256_cvtepi32_ps(a); }
+static inline vfloat vsetf(float x) { return _mm256_set1_ps(x); }
+static inline vfloat vmulf(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+static inline vint vcastf(vfloat a) { return _mm256_castps_si256(a); }
+static inline vint vcvttf(vfloat a) { return _mm256_cvttps_epi32(a); }
+static inline uint32_t vhmaxu(vint a) {
+	__m128i m = _mm_max_epu32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+	m = _mm_max_epu32(m, _mm_shuffle_epi32(m, 0x4E));
+	m = _mm_max_epu32(m, _mm_shuffle_epi32(m, 0xB1));
+	return (uint32_t)_mm_cvtsi128_si32(m);
+}
+#elif defined(__SSE4_1__)
+typedef __m128i vint;
+typedef __m128 vfloat;
+const uint32_t vlen = 4;
+static inline vint vset(int32_t x) { return _mm_set1_epi32(x); }
+static inline vint vload(const int32_t *p) { return _mm_loadu_si128((const vint*)p); }
+static inline void vstore(int32_t *p, vint x) { _mm_storeu_si128((vint*)p, x); }
+static inline vint vand(vint a, vint b) { return _mm_and_si128(a, b); }
+static inline vint vandnot(vint a, vint b) { return _mm_andnot_si128(a, b); }
+static inline vint vor(vint a, vint b) { return _mm_or_si128(a, b); }
+static inline vint vxor(vint a, vint b) { return _mm_xor_si128(a, b); }
+static inline vint vadd(vint a, vint b) { return _mm_add_epi32(a, b); }
+static inline vint vsub(vint a, vint b) { return _mm_sub_epi32(a, b); }
+static inline vint vabs(vint a) { return _mm_abs_epi32(a); }
+static inline vint vsign(vint a, vint b) { return _mm_sign_epi32(a, b); }
+static inline vint vcmpgt(vint a, vint b) { return _mm_cmpgt_epi32(a, b); }
+static inline vint vmaxu(vint a, vint b) { return _mm_max_epu32(a, b); }
+static inline vint vsll(vint a, uint32_t n) { return _mm_sll_epi32(a, _mm_cvtsi32_si128((int)n)); }
+static inline vint vsra(vint a, uint32_t n) { return _mm_sra_epi32(a, _mm_cvtsi32_si128((int)n)); }
+static inline vint vsrl(vint a, uint32_t n) { return _mm_srl_epi32(a, _mm_cvtsi32_si128((int)n)); }
+static inline vfloat vcvt(vint a) { return _mm_cvtepi32_ps(a); }
+static inline vfloat vsetf(float x) { return _mm_set1_ps(x); }
+static inline vfloat vmulf(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+static inline vint vcastf(vfloat a) { return _mm_castps_si128(a); }
+static inline vint vcvttf(vfloat a) { return _mm_cvttps_epi32(a); }
+static inline uint32_t vhmaxu(vint a) {
+	__m128i m = _mm_max_epu32(a, _mm_shuffle_epi32(a, 0x4E));
+	m = _mm_max_epu32(m, _mm_shuffle_epi32(m, 0xB1));
+	return (uint32_t)_mm_cvtsi128_si32(m);
+}
+#endif
+
+}
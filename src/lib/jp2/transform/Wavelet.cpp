@@ -22,6 +22,7 @@
 #include "dwt53.h"
 #include "dwt97.h"
 #include "WaveletForward.h"
+#include "WaveletStrip.h"
 #include "dwt.h"
 
 namespace grk {
@@ -34,6 +35,14 @@ Wavelet::~Wavelet() {
 
 bool Wavelet::compress(TileComponent *tile_comp, uint8_t qmfbid){
 	if (qmfbid == 1) {
+		if (tile_comp->buf->coeff16) {
+			// transform 16 bit samples, packed into the first half of the buffer
+			auto buf = tile_comp->buf;
+			SIMDKernels::get()->narrow16(buf->data, (int16_t*) buf->data,
+					(uint64_t) buf->reduced_region_dim.area());
+			WaveletForward<dwt53_16> dwt;
+			return dwt.run(tile_comp);
+		}
 		WaveletForward<dwt53> dwt;
 		return dwt.run(tile_comp);
 	} else if (qmfbid == 0) {
@@ -43,13 +52,34 @@ bool Wavelet::compress(TileComponent *tile_comp, uint8_t qmfbid){
 	return false;
 }
 
+WaveletStrip* WaveletStrip::create(TileComponent *tilec, uint8_t qmfbid,
+		band_row_fn fn) {
+	WaveletStrip *strip = nullptr;
+	bool rc = false;
+	if (qmfbid == 1) {
+		auto impl = new WaveletStripImpl<dwt53>(tilec, fn);
+		rc = impl->init();
+		strip = impl;
+	} else if (qmfbid == 0) {
+		auto impl = new WaveletStripImpl<dwt97>(tilec, fn);
+		rc = impl->init();
+		strip = impl;
+	}
+	if (!rc) {
+		delete strip;
+		return nullptr;
+	}
+	return strip;
+}
+
 bool Wavelet::decompress(TileProcessor *p_tcd,  TileComponent* tilec,
-                             uint32_t numres, uint8_t qmfbid){
+                             uint32_t numres, uint8_t qmfbid,
+                             const resolution_wait_fn &wait){
 
 	if (qmfbid == 1) {
-		return decode_53(p_tcd,tilec,numres);
+		return decode_53(p_tcd,tilec,numres,wait);
 	} else if (qmfbid == 0) {
-		return decode_97(p_tcd,tilec,numres);
+		return decode_97(p_tcd,tilec,numres,wait);
 	}
 	return false;
 }
@@ -20,6 +20,12 @@
 
 namespace grk {
 
+/**
+ * Block until the code blocks of all resolutions up to
+ * and including resno have been decoded
+ */
+typedef std::function<void(uint32_t resno)> resolution_wait_fn;
+
 class Wavelet {
 public:
 	Wavelet();
@@ -27,8 +33,14 @@ public:
 
 	static bool compress(TileComponent *tile_comp, uint8_t qmfbid);
 
+	/**
+	 * Inverse transform. If wait is set, each level of the whole tile
+	 * transform calls it before touching the bands of the next resolution,
+	 * so the transform can run while code blocks are still being decoded.
+	 */
 	static bool decompress(TileProcessor *p_tcd,  TileComponent* tilec,
-	                             uint32_t numres, uint8_t qmfbid);
+	                             uint32_t numres, uint8_t qmfbid,
+	                             const resolution_wait_fn &wait = nullptr);
 
 };
 
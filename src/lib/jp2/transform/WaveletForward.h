@@ -41,8 +41,12 @@ template <typename DWT> bool WaveletForward<DWT>::run(TileComponent *tilec){
 	if (tilec->numresolutions == 1U)
 		return true;
 
-	size_t l_data_size = dwt_utils::max_resolution(tilec->resolutions,
-			tilec->numresolutions) * sizeof(int32_t);
+	typedef typename DWT::sample_t T;
+	static constexpr uint32_t pll_cols = DWT::pll_cols;
+
+	// vertical pass transforms pll_cols columns at a time
+	size_t l_data_size = (size_t)dwt_utils::max_resolution(tilec->resolutions,
+			tilec->numresolutions) * pll_cols * sizeof(T);
 	/* overflow check */
 	if (l_data_size > SIZE_MAX) {
 		GROK_ERROR("Wavelet compress: overflow");
@@ -51,26 +55,17 @@ template <typename DWT> bool WaveletForward<DWT>::run(TileComponent *tilec){
 	if (!l_data_size)
 		return false;
 
-	bool rc = true;
 	uint32_t rw,rh,rw_next,rh_next;
 	uint8_t cas_row,cas_col;
 	uint32_t stride = tilec->width();
 	int32_t num_decomps = (int32_t) tilec->numresolutions - 1;
-	int32_t *a = tilec->buf->get_ptr( 0, 0, 0, 0);
+	// samples of type T, packed with the stride of the tile buffer
+	T *a = (T*)tilec->buf->get_ptr( 0, 0, 0, 0);
 	grk_tcd_resolution *cur_res = tilec->resolutions + num_decomps;
 	grk_tcd_resolution *next_res = cur_res - 1;
 
-	int32_t **bj_array = new int32_t*[ThreadPool::hardware_concurrency()];
-	for (uint32_t i = 0; i < ThreadPool::hardware_concurrency(); ++i){
-		bj_array[i] = nullptr;
-	}
-	for (uint32_t i = 0; i < ThreadPool::hardware_concurrency(); ++i){
-		bj_array[i] = (int32_t*)grk_aligned_malloc(l_data_size);
-		if (!bj_array[i]){
-			rc = false;
-			goto cleanup;
-		}
-	}
+	const uint32_t num_threads = (uint32_t)ThreadPool::get()->concurrency();
+	std::atomic_bool rc(true);
 
 	for (int32_t i = 0; i < num_decomps; ++i) {
 
@@ -88,76 +83,79 @@ template <typename DWT> bool WaveletForward<DWT>::run(TileComponent *tilec){
 		/* 0 = non inversion on vertical filtering 1 = inversion between low-pass and high-pass filtering   */
 		cas_col = cur_res->y0 & 1;
 
-		// transform vertical
+		// transform vertical, pll_cols columns at a time
 		if (rw) {
-			const uint32_t linesPerThreadV = static_cast<uint32_t>(std::ceil((float)rw / (float)ThreadPool::hardware_concurrency()));
+			const uint32_t num_col_groups = (rw + pll_cols - 1) / pll_cols;
+			const uint32_t groupsPerThreadV = (num_col_groups + num_threads - 1) / num_threads;
 			const uint32_t s_n = rh_next;
 			const uint32_t d_n = rh - rh_next;
 			std::vector< std::future<int> > results;
-			for(uint32_t i = 0; i < ThreadPool::hardware_concurrency(); ++i) {
+			for(uint32_t i = 0; i < num_threads; ++i) {
 				uint32_t index = i;
 				results.emplace_back(
-					ThreadPool::get()->enqueue([index, bj_array,a,
-												 stride, rw,rh,
+					ThreadPool::get()->enqueue([index, l_data_size,a,
+												 stride, rw,
 												 d_n, s_n, cas_col,
-												 linesPerThreadV] {
+												 groupsPerThreadV, &rc] {
+						// working buffer from the arena of the thread running the task
+						ScratchArena::Frame frame;
+						auto bj = (T*)ScratchArena::local()->alloc(l_data_size);
+						if (!bj) {
+							GROK_ERROR("Out of memory");
+							rc = false;
+							return 0;
+						}
 						DWT wavelet;
-						for (uint32_t m = index * linesPerThreadV;
-								m < std::min<uint32_t>((index+1)*linesPerThreadV, rw); ++m) {
-							int32_t *bj = bj_array[index];
-							int32_t *aj = a + m;
-							for (uint32_t k = 0; k < rh; ++k)
-								bj[k] = aj[k * stride];
-							wavelet.encode_line(bj, (int32_t)d_n, (int32_t)s_n, cas_col);
-							dwt_utils::deinterleave_v(bj, aj, d_n, s_n, stride, cas_col);
+						for (uint32_t m = index * groupsPerThreadV * pll_cols;
+								m < std::min<uint32_t>((index+1)*groupsPerThreadV * pll_cols, rw);
+								m += pll_cols) {
+							wavelet.encode_v(a + m, bj, d_n, s_n, cas_col, stride,
+									std::min<uint32_t>(pll_cols, rw - m));
 						}
 						return 0;
 					})
 				);
 			}
-			for(auto && result: results){
-				result.get();
-			}
+			ThreadPool::get()->wait(results);
 		}
 
 		// transform horizontal
 		if (rh){
 			const uint32_t s_n = rw_next;
 			const uint32_t d_n = rw - rw_next;
-			const uint32_t linesPerThreadH = static_cast<uint32_t>(std::ceil((float)rh / (float)ThreadPool::hardware_concurrency()));
+			const uint32_t linesPerThreadH = static_cast<uint32_t>(std::ceil((float)rh / (float)num_threads));
 			std::vector< std::future<int> > results;
-			for(uint32_t i = 0; i < ThreadPool::hardware_concurrency(); ++i) {
+			for(uint32_t i = 0; i < num_threads; ++i) {
 				uint32_t index = i;
 				results.emplace_back(
-					ThreadPool::get()->enqueue([index, bj_array,a,
+					ThreadPool::get()->enqueue([index, l_data_size,a,
 												 stride, rw,rh,
 												 d_n, s_n, cas_row,
-												 linesPerThreadH] {
+												 linesPerThreadH, &rc] {
+						ScratchArena::Frame frame;
+						auto bj = (T*)ScratchArena::local()->alloc(l_data_size);
+						if (!bj) {
+							GROK_ERROR("Out of memory");
+							rc = false;
+							return 0;
+						}
 						DWT wavelet;
 						for (auto m = index * linesPerThreadH;
 								m < std::min<uint32_t>((index+1)*linesPerThreadH, rh); ++m) {
-							int32_t *bj = bj_array[index];
-							int32_t *aj = a + m * stride;
-							memcpy(bj,aj,rw << 2);
-							wavelet.encode_line(bj, (int32_t)d_n, (int32_t)s_n, cas_row);
-							dwt_utils::deinterleave_h(bj, aj, d_n, s_n, cas_row);
+							wavelet.encode_h(a + m * stride, bj, d_n, s_n, cas_row);
 						}
 						return 0;
 					})
 				);
 			}
-			for(auto && result: results){
-				result.get();
-			}
+			ThreadPool::get()->wait(results);
 		}
+		if (!rc)
+			return false;
 		cur_res = next_res;
 		next_res--;
 	}
-cleanup:
-	for (uint32_t i = 0; i < ThreadPool::hardware_concurrency(); ++i)
-		grk_aligned_free(bj_array[i]);
-	delete[] bj_array;
-	return rc;
+	return true;
 }
 
 }
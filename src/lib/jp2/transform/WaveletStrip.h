@@ -0,0 +1,259 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include "grok_includes.h"
+#include <functional>
+
+/*
+ Line based forward wavelet transform.
+
+ Tile component rows are pushed in order, and each decomposition level keeps
+ a window of at most strip_window_rows rows. Once the window is full, the
+ vertical transform is run over the whole window, but only rows at least
+ strip_margin rows away from the window's lower edge are kept; the window
+ then slides down, keeping strip_margin rows above the first row not yet
+ transformed. Lifting errors from the artificial window edges spread by one
+ sample per lifting step in each sub-band, so they never reach the kept rows,
+ and the result is identical to WaveletForward.
+
+ Transformed rows then go through the horizontal transform, and are
+ split into sub-band rows: LL rows feed the next level's window, while all
+ other band rows (and the final LL rows) are handed to a callback.
+ */
+
+namespace grk {
+
+/** Margin that absorbs lifting errors at artificial window edges */
+const uint32_t strip_margin = 16;
+/** Number of rows in each level's window */
+const uint32_t strip_window_rows = 128;
+
+/**
+ Receives one row of a sub-band: band index into resolution's bands,
+ row relative to top of band, and row samples
+ */
+typedef std::function<bool(uint32_t resno, uint32_t band_index, uint32_t row,
+		const int32_t *data)> band_row_fn;
+
+class WaveletStrip {
+public:
+	virtual ~WaveletStrip() = default;
+	/**
+	 Push next row of tile component
+	 */
+	virtual bool push(const int32_t *row) = 0;
+	/**
+	 Create line based forward wavelet transform
+	 @param tilec		tile component
+	 @param qmfbid		1 for 5-3, 0 for 9-7
+	 @param fn			sub-band row callback
+	 */
+	static WaveletStrip* create(TileComponent *tilec, uint8_t qmfbid,
+			band_row_fn fn);
+};
+
+template<typename DWT> class WaveletStripImpl : public WaveletStrip {
+public:
+	WaveletStripImpl(TileComponent *tilec, band_row_fn fn);
+	~WaveletStripImpl();
+	bool init(void);
+	bool push(const int32_t *row) override;
+private:
+	struct Level {
+		Level() : resno(0), rw(0), rh(0), rw_next(0), rh_next(0), cas_row(0),
+				cas_col(0), capacity(0), win(nullptr), out(nullptr),
+				win_start(0), win_rows(0), next_out(0) {
+		}
+		// resolution that this level decomposes
+		uint32_t resno;
+		uint32_t rw, rh, rw_next, rh_next;
+		uint8_t cas_row, cas_col;
+		// rows in window
+		uint32_t capacity;
+		int32_t *win;
+		// transformed rows
+		int32_t *out;
+		// tile row of first window row
+		uint32_t win_start;
+		uint32_t win_rows;
+		// first row not yet transformed
+		uint32_t next_out;
+	};
+	bool push(uint32_t level, const int32_t *row);
+	bool transform(uint32_t level);
+	TileComponent *tilec;
+	band_row_fn band_row;
+	std::vector<Level> levels;
+	std::vector<int32_t*> tmp;
+	// rows received by final LL band when there are no decompositions
+	uint32_t ll_rows;
+};
+
+template<typename DWT> WaveletStripImpl<DWT>::WaveletStripImpl(
+		TileComponent *tilec, band_row_fn fn) :
+		tilec(tilec), band_row(fn), ll_rows(0) {
+}
+
+template<typename DWT> WaveletStripImpl<DWT>::~WaveletStripImpl() {
+	for (auto &lev : levels) {
+		grk_aligned_free(lev.win);
+		grk_aligned_free(lev.out);
+	}
+	for (auto &t : tmp)
+		grk_aligned_free(t);
+}
+
+template<typename DWT> bool WaveletStripImpl<DWT>::init(void) {
+	uint32_t num_decomps = tilec->numresolutions - 1;
+	levels.resize(num_decomps);
+	uint32_t max_rows = 0;
+	for (uint32_t i = 0; i < num_decomps; ++i) {
+		auto &lev = levels[i];
+		lev.resno = num_decomps - i;
+		auto cur_res = tilec->resolutions + lev.resno;
+		auto next_res = cur_res - 1;
+		lev.rw = cur_res->x1 - cur_res->x0;
+		lev.rh = cur_res->y1 - cur_res->y0;
+		lev.rw_next = next_res->x1 - next_res->x0;
+		lev.rh_next = next_res->y1 - next_res->y0;
+		lev.cas_row = cur_res->x0 & 1;
+		lev.cas_col = cur_res->y0 & 1;
+		lev.capacity = std::min<uint32_t>(lev.rh, strip_window_rows);
+		max_rows = std::max<uint32_t>(max_rows, lev.capacity);
+		size_t win_size = (size_t) lev.capacity * lev.rw * sizeof(int32_t);
+		if (win_size) {
+			lev.win = (int32_t*) grk_aligned_malloc(win_size);
+			lev.out = (int32_t*) grk_aligned_malloc(win_size);
+			if (!lev.win || !lev.out)
+				return false;
+		}
+	}
+	if (!num_decomps)
+		return true;
+	size_t tmp_size = (size_t) std::max<uint32_t>(max_rows * PLL_COLS_FWD,
+			levels[0].rw) * sizeof(int32_t);
+	for (size_t i = 0; i < ThreadPool::get()->num_threads(); ++i) {
+		auto t = (int32_t*) grk_aligned_malloc(tmp_size);
+		if (!t)
+			return false;
+		tmp.push_back(t);
+	}
+
+	return true;
+}
+
+template<typename DWT> bool WaveletStripImpl<DWT>::push(const int32_t *row) {
+	if (levels.empty())
+		return band_row(0, 0, ll_rows++, row);
+
+	return push(0, row);
+}
+
+template<typename DWT> bool WaveletStripImpl<DWT>::push(uint32_t level,
+		const int32_t *row) {
+	auto &lev = levels[level];
+	if (lev.rw)
+		memcpy(lev.win + (size_t) lev.win_rows * lev.rw, row,
+				lev.rw * sizeof(int32_t));
+	lev.win_rows++;
+	if (lev.win_rows == lev.capacity || lev.win_start + lev.win_rows == lev.rh)
+		return transform(level);
+
+	return true;
+}
+
+template<typename DWT> bool WaveletStripImpl<DWT>::transform(uint32_t level) {
+	auto &lev = levels[level];
+	uint32_t total = lev.win_start + lev.win_rows;
+	bool last = total == lev.rh;
+	uint32_t out_begin = lev.next_out;
+	uint32_t out_end = last ? lev.rh : total - strip_margin;
+	uint32_t rw = lev.rw;
+	auto pool = ThreadPool::get();
+
+	// vertical transform of window, keeping rows in [out_begin, out_end)
+	uint8_t cas = (uint8_t) ((lev.cas_col + lev.win_start) & 1);
+	uint32_t n = lev.win_rows;
+	uint32_t s_n = cas ? n / 2 : (n + 1) / 2;
+	uint32_t d_n = n - s_n;
+	size_t num_col_groups = (rw + PLL_COLS_FWD - 1) / PLL_COLS_FWD;
+	pool->parallel_for(num_col_groups,
+			[this, &lev, rw, cas, s_n, d_n, out_begin, out_end, pool](size_t g) {
+				auto buf = tmp[(size_t) pool->thread_number(std::this_thread::get_id())];
+				uint32_t m = (uint32_t) g * PLL_COLS_FWD;
+				uint32_t cols = std::min<uint32_t>(PLL_COLS_FWD, rw - m);
+				DWT wavelet;
+				wavelet.encode_v_buf(lev.win + m, buf, d_n, s_n, cas, rw, cols);
+				for (uint32_t k = out_begin; k < out_end; ++k) {
+					uint32_t kk = k - lev.win_start;
+					uint32_t trow = ((kk & 1) == cas) ? (kk >> 1) : s_n + (kk >> 1);
+					memcpy(lev.out + (size_t) (k - out_begin) * rw + m,
+							buf + (size_t) trow * PLL_COLS_FWD, cols * sizeof(int32_t));
+				}
+			});
+
+	// horizontal transform
+	uint32_t s_n_h = lev.rw_next;
+	uint32_t d_n_h = rw - lev.rw_next;
+	pool->parallel_for(out_end - out_begin,
+			[this, &lev, rw, s_n_h, d_n_h, pool](size_t k) {
+				auto buf = tmp[(size_t) pool->thread_number(std::this_thread::get_id())];
+				DWT wavelet;
+				wavelet.encode_h(lev.out + k * rw, buf, d_n_h, s_n_h, lev.cas_row);
+			});
+
+	// slide window down before LL rows are pushed to next level
+	uint32_t keep_start = last ? total :
+			std::max<uint32_t>(lev.win_start, out_end - strip_margin);
+	uint32_t keep_rows = total - keep_start;
+	if (keep_rows && rw)
+		memmove(lev.win,
+				lev.win + (size_t) (keep_start - lev.win_start) * rw,
+				(size_t) keep_rows * rw * sizeof(int32_t));
+	lev.win_start = keep_start;
+	lev.win_rows = keep_rows;
+	lev.next_out = out_end;
+
+	// hand out sub-band rows
+	for (uint32_t k = out_begin; k < out_end; ++k) {
+		auto row = lev.out + (size_t) (k - out_begin) * rw;
+		uint32_t r = k >> 1;
+		if ((k & 1) == lev.cas_col) {
+			if (d_n_h && !band_row(lev.resno, 0, r, row + s_n_h))
+				return false;
+			if (s_n_h) {
+				if (level + 1 < levels.size()) {
+					if (!push(level + 1, row))
+						return false;
+				} else if (!band_row(0, 0, r, row)) {
+					return false;
+				}
+			}
+		} else {
+			if (s_n_h && !band_row(lev.resno, 1, r, row))
+				return false;
+			if (d_n_h && !band_row(lev.resno, 2, r, row + s_n_h))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+}
@@ -60,6 +60,7 @@
 #include "simd.h"
 #include "grok_includes.h"
 #include "dwt.h"
+#include "dwt_lift.h"
 #include <algorithm>
 
 using namespace std;
@@ -70,14 +71,12 @@ namespace grk {
 #define GRK_WS(i) v->mem[(i)*2]
 #define GRK_WD(i) v->mem[(1+(i)*2)]
 
-/** Number of columns that we can process in parallel in the vertical pass */
-#define PLL_COLS_53     (2*VREG_INT_COUNT)
-
 /** @name Local data structures */
 /*@{*/
 
 template <typename T> struct dwt_data {
 	dwt_data() : mem(nullptr),
+		         owns_mem(false),
 		         dn(0),
 				 sn(0),
 				 cas(0),
@@ -90,6 +89,7 @@ template <typename T> struct dwt_data {
 	dwt_data(const dwt_data& rhs)
 	{
 		mem = nullptr;
+		owns_mem = false;
 	    dn = rhs.dn;
 	    sn = rhs.sn;
 	    cas = rhs.cas;
@@ -101,28 +101,31 @@ template <typename T> struct dwt_data {
 
 	bool alloc(size_t len) {
 		release();
-
-	    /* overflow check */
-		// add 10 just to be sure to we are safe from
-		// segment growth overflow
-	    if (len > (SIZE_MAX - 10U)) {
-	        GROK_ERROR("data size overflow");
-	        return false;
-	    }
-	    len += 10U;
-	    /* overflow check */
-	    if (len > (SIZE_MAX / sizeof(T))) {
-	        GROK_ERROR("data size overflow");
-	        return false;
-	    }
+		if (!pad(len))
+			return false;
 		mem = (T*)grk_aligned_malloc(len * sizeof(T));
+		owns_mem = true;
+		return mem != nullptr;
+	}
+	/**
+	 Allocate from the scratch arena of the calling thread. The memory
+	 belongs to the enclosing ScratchArena::Frame: release() leaves it alone.
+	 */
+	bool alloc_scratch(size_t len) {
+		release();
+		if (!pad(len))
+			return false;
+		mem = ScratchArena::local()->alloc<T>(len);
 		return mem != nullptr;
 	}
 	void release(){
-		grk_aligned_free(mem);
+		if (owns_mem)
+			grk_aligned_free(mem);
 		mem = nullptr;
+		owns_mem = false;
 	}
     T* mem;
+    bool owns_mem;
     int32_t dn;   /* number of elements in high pass band */
     int32_t sn;   /* number of elements in low pass band */
     int32_t cas;  /* 0 = start on even coord, 1 = start on odd coord */
@@ -130,6 +133,23 @@ template <typename T> struct dwt_data {
     uint32_t      win_l_x1; /* end coord in low pass band */
     uint32_t      win_h_x0; /* start coord in high pass band */
     uint32_t      win_h_x1; /* end coord in high pass band */
+private:
+	static bool pad(size_t &len){
+	    /* overflow check */
+		// add 10 just to be sure to we are safe from
+		// segment growth overflow
+	    if (len > (SIZE_MAX - 10U)) {
+	        GROK_ERROR("data size overflow");
+	        return false;
+	    }
+	    len += 10U;
+	    /* overflow check */
+	    if (len > (SIZE_MAX / sizeof(T))) {
+	        GROK_ERROR("data size overflow");
+	        return false;
+	    }
+	    return true;
+	}
 };
 
 
@@ -182,26 +202,11 @@ static const float c13318 = 1.625732422f;
 /** @name Local static functions */
 /*@{*/
 
-/**
-Inverse wavelet transform in 2-D.
-*/
-static bool decode_tile_53(TileComponent* tilec, uint32_t i);
-
 /* <summary>                             */
 /* Inverse 9-7 wavelet transform in 1-D. */
 /* </summary>                            */
 static void decode_step_97(dwt_data<v4_data>* GRK_RESTRICT dwt);
 
-static void interleave_h_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
-                                   float* GRK_RESTRICT a,
-                                   uint32_t width,
-                                   uint32_t remaining_height);
-
-static void interleave_v_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
-                                   float* GRK_RESTRICT a,
-                                   uint32_t width,
-                                   uint32_t nb_elts_read);
-
 #ifdef __SSE__
 static void decode_step1_sse_97(v4_data* w,
                                        uint32_t start,
@@ -253,608 +258,141 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 ==========================================================
 */
 
-static void  decode_h_cas0_53(int32_t* tmp,
-                               const int32_t sn,
-                               const int32_t len,
-                               int32_t* tiledp){
-    assert(len > 1);
-
-    /* Improved version of the TWO_PASS_VERSION: */
-    /* Performs lifting in one single iteration. Saves memory */
-    /* accesses and explicit interleaving. */
-    const int32_t* in_even = tiledp;
-    const int32_t* in_odd = tiledp + sn;
-    int32_t s1n = in_even[0];
-    int32_t d1n = in_odd[0];
-    int32_t s0n = s1n - ((d1n + 1) >> 1);
-
-    int32_t i, j;
-    for (i = 0, j = 1; i < (len - 3); i += 2, j++) {
-    	int32_t d1c = d1n;
-    	int32_t s0c = s0n;
-
-        s1n = in_even[j];
-        d1n = in_odd[j];
-
-        s0n = s1n - ((d1c + d1n + 2) >> 2);
-
-        tmp[i  ] = s0c;
-        tmp[i + 1] = d1c + ((s0c + s0n) >> 1);
-    }
-
-    tmp[i] = s0n;
-
-    if (len & 1) {
-        tmp[len - 1] = in_even[(len - 1) >> 1] - ((d1n + 1) >> 1);
-        tmp[len - 2] = d1n + ((s0n + tmp[len - 1]) >> 1);
-    } else {
-        tmp[len - 1] = d1n + s0n;
-    }
-    memcpy(tiledp, tmp, (uint32_t)len * sizeof(int32_t));
-}
-
-static void  decode_h_cas1_53(int32_t* tmp,
-                               const int32_t sn,
-                               const int32_t len,
-                               int32_t* tiledp){
-    assert(len > 2);
-
-    /* Improved version of the TWO_PASS_VERSION:
-       Performs lifting in one single iteration. Saves memory
-       accesses and explicit interleaving. */
-    const int32_t* in_even = tiledp + sn;
-    const int32_t* in_odd = tiledp;
-    int32_t s1 = in_even[1];
-    int32_t dc = in_odd[0] - ((in_even[0] + s1 + 2) >> 2);
-    tmp[0] = in_even[0] + dc;
-    int32_t i, j;
-    for (i = 1, j = 1; i < (len - 2 - !(len & 1)); i += 2, j++) {
-    	int32_t s2 = in_even[j + 1];
-    	int32_t dn = in_odd[j] - ((s1 + s2 + 2) >> 2);
-
-        tmp[i  ] = dc;
-        tmp[i + 1] = s1 + ((dn + dc) >> 1);
-
-        dc = dn;
-        s1 = s2;
-    }
-
-    tmp[i] = dc;
-
-    if (!(len & 1)) {
-    	int32_t dn = in_odd[len / 2 - 1] - ((s1 + 1) >> 1);
-        tmp[len - 2] = s1 + ((dn + dc) >> 1);
-        tmp[len - 1] = dn;
-    } else {
-        tmp[len - 1] = s1 + dc;
-    }
-    memcpy(tiledp, tmp, (uint32_t)len * sizeof(int32_t));
-}
-
-/* <summary>                            */
-/* Inverse 5-3 wavelet transform in 1-D for one row. */
-/* </summary>                           */
-/* Performs interleave, inverse wavelet transform and copy back to buffer */
-static void decode_h_53(const dwt_data<int32_t> *dwt,
-                         int32_t* tiledp)
-{
-    const int32_t sn = dwt->sn;
-    const int32_t len = sn + dwt->dn;
-    if (dwt->cas == 0) { /* Left-most sample is on even coordinate */
-        if (len > 1) {
-            decode_h_cas0_53(dwt->mem, sn, len, tiledp);
-        } else {
-            /* Unmodified value */
-        }
-    } else { /* Left-most sample is on odd coordinate */
-        if (len == 1) {
-            tiledp[0] /= 2;
-        } else if (len == 2) {
-            int32_t* out = dwt->mem;
-            const int32_t* in_even = &tiledp[sn];
-            const int32_t* in_odd = &tiledp[0];
-            out[1] = in_odd[0] - ((in_even[0] + 1) >> 1);
-            out[0] = in_even[0] + out[1];
-            memcpy(tiledp, dwt->mem, (uint32_t)len * sizeof(int32_t));
-        } else if (len > 2) {
-            decode_h_cas1_53(dwt->mem, sn, len, tiledp);
-        }
-    }
-}
-
-#if (defined(__SSE2__) || defined(__AVX2__))
-
-#define ADD3(x,y,z) ADD(ADD(x,y),z)
-
-static
-void decode_v_final_memcpy_53(int32_t* tiledp_col,
-                               const int32_t* tmp,
-                               int32_t len,
-                               size_t stride){
-    int32_t i;
-    for (i = 0; i < len; ++i) {
-        /* A memcpy(&tiledp_col[i * stride + 0],
-                    &tmp[PARALLEL_COLS_53 * i + 0],
-                    PARALLEL_COLS_53 * sizeof(int32_t))
-           would do but would be a tiny bit slower.
-           We can take here advantage of our knowledge of alignment */
-        STOREU(&tiledp_col[(size_t)i * stride + 0],              LOAD(&tmp[PLL_COLS_53 * i + 0]));
-        STOREU(&tiledp_col[(size_t)i * stride + VREG_INT_COUNT], LOAD(&tmp[PLL_COLS_53 * i + VREG_INT_COUNT]));
-    }
-}
-
-/** Vertical inverse 5x3 wavelet transform for 8 columns in SSE2, or
- * 16 in AVX2, when top-most pixel is on even coordinate */
-static void decode_v_cas0_mcols_SSE2_OR_AVX2_53(int32_t* tmp,
-												const int32_t sn,
-												const int32_t len,
-												int32_t* tiledp_col,
-												const size_t stride){
-    int32_t i;
-    size_t j;
-    const VREG two = LOAD_CST(2);
-
-    assert(len > 1);
-#if __AVX2__
-    assert(PLL_COLS_53 == 16);
-    assert(VREG_INT_COUNT == 8);
-#else
-    assert(PLL_COLS_53 == 8);
-    assert(VREG_INT_COUNT == 4);
-#endif
-
-    /* Note: loads of input even/odd values must be done in a unaligned */
-    /* fashion. But stores in tmp can be done with aligned store, since */
-    /* the temporary buffer is properly aligned */
-    assert((size_t)tmp % (sizeof(int32_t) * VREG_INT_COUNT) == 0);
-
-    const int32_t* in_even = &tiledp_col[0];
-    const int32_t* in_odd = &tiledp_col[(size_t)sn * stride];
-    VREG s1n_0 = LOADU(in_even + 0);
-    VREG s1n_1 = LOADU(in_even + VREG_INT_COUNT);
-    VREG d1n_0 = LOADU(in_odd);
-    VREG d1n_1 = LOADU(in_odd + VREG_INT_COUNT);
-
-    /* s0n = s1n - ((d1n + 1) >> 1); <==> */
-    /* s0n = s1n - ((d1n + d1n + 2) >> 2); */
-    VREG s0n_0 = SUB(s1n_0, SAR(ADD3(d1n_0, d1n_0, two), 2));
-    VREG s0n_1 = SUB(s1n_1, SAR(ADD3(d1n_1, d1n_1, two), 2));
-
-    for (i = 0, j = 1; i < (len - 3); i += 2, j++) {
-    	VREG d1c_0 = d1n_0;
-    	VREG s0c_0 = s0n_0;
-    	VREG d1c_1 = d1n_1;
-    	VREG s0c_1 = s0n_1;
-
-        s1n_0 = LOADU(in_even + j * stride);
-        s1n_1 = LOADU(in_even + j * stride + VREG_INT_COUNT);
-        d1n_0 = LOADU(in_odd + j * stride);
-        d1n_1 = LOADU(in_odd + j * stride + VREG_INT_COUNT);
-
-        /*s0n = s1n - ((d1c + d1n + 2) >> 2);*/
-        s0n_0 = SUB(s1n_0, SAR(ADD3(d1c_0, d1n_0, two), 2));
-        s0n_1 = SUB(s1n_1, SAR(ADD3(d1c_1, d1n_1, two), 2));
-
-        STORE(tmp + PLL_COLS_53 * (i + 0), s0c_0);
-        STORE(tmp + PLL_COLS_53 * (i + 0) + VREG_INT_COUNT, s0c_1);
-
-        /* d1c + ((s0c + s0n) >> 1) */
-        STORE(tmp + PLL_COLS_53 * (i + 1) + 0,              ADD(d1c_0, SAR(ADD(s0c_0, s0n_0), 1)));
-        STORE(tmp + PLL_COLS_53 * (i + 1) + VREG_INT_COUNT, ADD(d1c_1, SAR(ADD(s0c_1, s0n_1), 1)));
-    }
-
-    STORE(tmp + PLL_COLS_53 * (i + 0) + 0, s0n_0);
-    STORE(tmp + PLL_COLS_53 * (i + 0) + VREG_INT_COUNT, s0n_1);
-
-    if (len & 1) {
-        VREG tmp_len_minus_1;
-        s1n_0 = LOADU(in_even + (size_t)((len - 1) / 2) * stride);
-        /* tmp_len_minus_1 = s1n - ((d1n + 1) >> 1); */
-        tmp_len_minus_1 = SUB(s1n_0, SAR(ADD3(d1n_0, d1n_0, two), 2));
-        STORE(tmp + PLL_COLS_53 * (len - 1), tmp_len_minus_1);
-        /* d1n + ((s0n + tmp_len_minus_1) >> 1) */
-        STORE(tmp + PLL_COLS_53 * (len - 2), ADD(d1n_0, SAR(ADD(s0n_0, tmp_len_minus_1), 1)));
-
-        s1n_1 = LOADU(in_even + (size_t)((len - 1) / 2) * stride + VREG_INT_COUNT);
-        /* tmp_len_minus_1 = s1n - ((d1n + 1) >> 1); */
-        tmp_len_minus_1 = SUB(s1n_1, SAR(ADD3(d1n_1, d1n_1, two), 2));
-        STORE(tmp + PLL_COLS_53 * (len - 1) + VREG_INT_COUNT, tmp_len_minus_1);
-        /* d1n + ((s0n + tmp_len_minus_1) >> 1) */
-        STORE(tmp + PLL_COLS_53 * (len - 2) + VREG_INT_COUNT, ADD(d1n_1, SAR(ADD(s0n_1, tmp_len_minus_1), 1)));
-
-    } else {
-        STORE(tmp + PLL_COLS_53 * (len - 1) + 0,              ADD(d1n_0, s0n_0));
-        STORE(tmp + PLL_COLS_53 * (len - 1) + VREG_INT_COUNT, ADD(d1n_1, s0n_1));
-    }
-    decode_v_final_memcpy_53(tiledp_col, tmp, len, stride);
-}
-
-
-/** Vertical inverse 5x3 wavelet transform for 8 columns in SSE2, or
- * 16 in AVX2, when top-most pixel is on odd coordinate */
-static void decode_v_cas1_mcols_SSE2_OR_AVX2_53(int32_t* tmp,
-												const int32_t sn,
-												const int32_t len,
-												int32_t* tiledp_col,
-												const size_t stride){
-    int32_t i;
-    size_t j;
-
-    const VREG two = LOAD_CST(2);
-
-    assert(len > 2);
-#if __AVX2__
-    assert(PLL_COLS_53 == 16);
-    assert(VREG_INT_COUNT == 8);
-#else
-    assert(PLL_COLS_53 == 8);
-    assert(VREG_INT_COUNT == 4);
-#endif
-
-    /* Note: loads of input even/odd values must be done in a unaligned */
-    /* fashion. But stores in tmp can be done with aligned store, since */
-    /* the temporary buffer is properly aligned */
-    assert((size_t)tmp % (sizeof(int32_t) * VREG_INT_COUNT) == 0);
-
-    const int32_t* in_even = &tiledp_col[(size_t)sn * stride];
-    const int32_t* in_odd = &tiledp_col[0];
-    VREG s1_0 = LOADU(in_even + stride);
-    /* in_odd[0] - ((in_even[0] + s1 + 2) >> 2); */
-    VREG dc_0 = SUB(LOADU(in_odd + 0), SAR(ADD3(LOADU(in_even + 0), s1_0, two), 2));
-    STORE(tmp + PLL_COLS_53 * 0, ADD(LOADU(in_even + 0), dc_0));
-
-    VREG s1_1 = LOADU(in_even + stride + VREG_INT_COUNT);
-    /* in_odd[0] - ((in_even[0] + s1 + 2) >> 2); */
-    VREG dc_1 = SUB(LOADU(in_odd + VREG_INT_COUNT), SAR(ADD3(LOADU(in_even + VREG_INT_COUNT), s1_1, two), 2));
-    STORE(tmp + PLL_COLS_53 * 0 + VREG_INT_COUNT,   ADD(LOADU(in_even + VREG_INT_COUNT), dc_1));
-
-    for (i = 1, j = 1; i < (len - 2 - !(len & 1)); i += 2, j++) {
-
-    	VREG s2_0 = LOADU(in_even + (j + 1) * stride);
-    	VREG s2_1 = LOADU(in_even + (j + 1) * stride + VREG_INT_COUNT);
-
-        /* dn = in_odd[j * stride] - ((s1 + s2 + 2) >> 2); */
-    	VREG dn_0 = SUB(LOADU(in_odd + j * stride),                 SAR(ADD3(s1_0, s2_0, two), 2));
-    	VREG dn_1 = SUB(LOADU(in_odd + j * stride + VREG_INT_COUNT),SAR(ADD3(s1_1, s2_1, two), 2));
-
-        STORE(tmp + PLL_COLS_53 * i, dc_0);
-        STORE(tmp + PLL_COLS_53 * i + VREG_INT_COUNT, dc_1);
-
-        /* tmp[i + 1] = s1 + ((dn + dc) >> 1); */
-        STORE(tmp + PLL_COLS_53 * (i + 1) + 0,             ADD(s1_0, SAR(ADD(dn_0, dc_0), 1)));
-        STORE(tmp + PLL_COLS_53 * (i + 1) + VREG_INT_COUNT,ADD(s1_1, SAR(ADD(dn_1, dc_1), 1)));
-
-        dc_0 = dn_0;
-        s1_0 = s2_0;
-        dc_1 = dn_1;
-        s1_1 = s2_1;
-    }
-    STORE(tmp + PLL_COLS_53 * i, dc_0);
-    STORE(tmp + PLL_COLS_53 * i + VREG_INT_COUNT, dc_1);
-
-    if (!(len & 1)) {
-        /*dn = in_odd[(len / 2 - 1) * stride] - ((s1 + 1) >> 1); */
-    	VREG dn_0 = SUB(LOADU(in_odd + (size_t)(len / 2 - 1) * stride),SAR(ADD3(s1_0, s1_0, two), 2));
-    	VREG dn_1 = SUB(LOADU(in_odd + (size_t)(len / 2 - 1) * stride + VREG_INT_COUNT), SAR(ADD3(s1_1, s1_1, two), 2));
-
-        /* tmp[len - 2] = s1 + ((dn + dc) >> 1); */
-        STORE(tmp + PLL_COLS_53 * (len - 2) + 0, ADD(s1_0, SAR(ADD(dn_0, dc_0), 1)));
-        STORE(tmp + PLL_COLS_53 * (len - 2) + VREG_INT_COUNT, ADD(s1_1, SAR(ADD(dn_1, dc_1), 1)));
-
-        STORE(tmp + PLL_COLS_53 * (len - 1) + 0, dn_0);
-        STORE(tmp + PLL_COLS_53 * (len - 1) + VREG_INT_COUNT, dn_1);
-    } else {
-        STORE(tmp + PLL_COLS_53 * (len - 1) + 0, ADD(s1_0, dc_0));
-        STORE(tmp + PLL_COLS_53 * (len - 1) + VREG_INT_COUNT,ADD(s1_1, dc_1));
-    }
-    decode_v_final_memcpy_53(tiledp_col, tmp, len, stride);
-}
-
-#undef VREG
-#undef LOAD_CST
-#undef LOADU
-#undef LOAD
-#undef STORE
-#undef STOREU
-#undef ADD
-#undef ADD3
-#undef SUB
-#undef SAR
-
-#endif /* (defined(__SSE2__) || defined(__AVX2__)) */
-
-/** Vertical inverse 5x3 wavelet transform for one column, when top-most
- * pixel is on even coordinate */
-static void decode_v_cas0_53(int32_t* tmp,
-                             const int32_t sn,
-                             const int32_t len,
-                             int32_t* tiledp_col,
-                             const size_t stride){
-    int32_t i, j;
-    int32_t d1c, d1n, s1n, s0c, s0n;
-
-    assert(len > 1);
-
-    /* Performs lifting in one single iteration. Saves memory */
-    /* accesses and explicit interleaving. */
-
-    s1n = tiledp_col[0];
-    d1n = tiledp_col[(size_t)sn * stride];
-    s0n = s1n - ((d1n + 1) >> 1);
-
-    for (i = 0, j = 0; i < (len - 3); i += 2, j++) {
-        d1c = d1n;
-        s0c = s0n;
-
-        s1n = tiledp_col[(size_t)(j + 1) * stride];
-        d1n = tiledp_col[(size_t)(sn + j + 1) * stride];
-
-        s0n = s1n - ((d1c + d1n + 2) >> 2);
-
-        tmp[i  ] = s0c;
-        tmp[i + 1] = d1c + ((s0c + s0n) >> 1);
-    }
-
-    tmp[i] = s0n;
-
-    if (len & 1) {
-        tmp[len - 1] =
-            tiledp_col[(size_t)((len - 1) / 2) * stride] -
-            ((d1n + 1) >> 1);
-        tmp[len - 2] = d1n + ((s0n + tmp[len - 1]) >> 1);
-    } else {
-        tmp[len - 1] = d1n + s0n;
-    }
-
-    for (i = 0; i < len; ++i) {
-        tiledp_col[(size_t)i * stride] = tmp[i];
-    }
-}
-
-
-/** Vertical inverse 5x3 wavelet transform for one column, when top-most
- * pixel is on odd coordinate */
-static void decode_v_cas1_53(int32_t* tmp,
-                             const int32_t sn,
-                             const int32_t len,
-                             int32_t* tiledp_col,
-                             const size_t stride){
-    int32_t i, j;
-    const int32_t* in_even = &tiledp_col[(size_t)sn * stride];
-    const int32_t* in_odd = &tiledp_col[0];
-
-    assert(len > 2);
-
-    /* Performs lifting in one single iteration. Saves memory */
-    /* accesses and explicit interleaving. */
-
-    int32_t s1 = in_even[stride];
-    int32_t dc = in_odd[0] - ((in_even[0] + s1 + 2) >> 2);
-    tmp[0] = in_even[0] + dc;
-    for (i = 1, j = 1; i < (len - 2 - !(len & 1)); i += 2, j++) {
-
-    	int32_t s2 = in_even[(size_t)(j + 1) * stride];
-
-    	int32_t dn = in_odd[(size_t)j * stride] - ((s1 + s2 + 2) >> 2);
-        tmp[i  ] = dc;
-        tmp[i + 1] = s1 + ((dn + dc) >> 1);
-
-        dc = dn;
-        s1 = s2;
-    }
-    tmp[i] = dc;
-    if (!(len & 1)) {
-    	int32_t dn = in_odd[(size_t)(len / 2 - 1) * stride] - ((s1 + 1) >> 1);
-        tmp[len - 2] = s1 + ((dn + dc) >> 1);
-        tmp[len - 1] = dn;
-    } else {
-        tmp[len - 1] = s1 + dc;
-    }
-    for (i = 0; i < len; ++i)
-        tiledp_col[(size_t)i * stride] = tmp[i];
-}
-
-/* <summary>                            */
-/* Inverse vertical 5-3 wavelet transform in 1-D for several columns. */
-/* </summary>                           */
-/* Performs interleave, inverse wavelet transform and copy back to buffer */
-static void decode_v_53(const dwt_data<int32_t> *dwt,
-                         int32_t* tiledp_col,
-                         size_t stride,
-                         int32_t nb_cols){
-    const int32_t sn = dwt->sn;
-    const int32_t len = sn + dwt->dn;
-    if (dwt->cas == 0) {
-        /* If len == 1, unmodified value */
-
-#if (defined(__SSE2__) || defined(__AVX2__))
-        if (len > 1 && nb_cols == PLL_COLS_53) {
-            /* Same as below general case, except that thanks to SSE2/AVX2 */
-            /* we can efficiently process 8/16 columns in parallel */
-            decode_v_cas0_mcols_SSE2_OR_AVX2_53(dwt->mem, sn, len, tiledp_col, stride);
-            return;
-        }
-#endif
-        if (len > 1) {
-            for (int32_t c = 0; c < nb_cols; c++, tiledp_col++)
-                decode_v_cas0_53(dwt->mem, sn, len, tiledp_col, stride);
-            return;
-        }
-    } else {
-        if (len == 1) {
-            for (int32_t c = 0; c < nb_cols; c++, tiledp_col++)
-                tiledp_col[0] /= 2;
-            return;
-        }
-        else if (len == 2) {
-            int32_t* out = dwt->mem;
-            for (int32_t c = 0; c < nb_cols; c++, tiledp_col++) {
-                const int32_t* in_even = &tiledp_col[(size_t)sn * stride];
-                const int32_t* in_odd = &tiledp_col[0];
-
-                out[1] = in_odd[0] - ((in_even[0] + 1) >> 1);
-                out[0] = in_even[0] + out[1];
-
-                for (int32_t i = 0; i < len; ++i)
-                    tiledp_col[(size_t)i * stride] = out[i];
-            }
-            return;
-        }
-
-#if (defined(__SSE2__) || defined(__AVX2__))
-        if (len > 2 && nb_cols == PLL_COLS_53) {
-            /* Same as below general case, except that thanks to SSE2/AVX2 */
-            /* we can efficiently process 8/16 columns in parallel */
-            decode_v_cas1_mcols_SSE2_OR_AVX2_53(dwt->mem, sn, len, tiledp_col, stride);
-            return;
-        }
-#endif
-        if (len > 2) {
-            for (int32_t c = 0; c < nb_cols; c++, tiledp_col++)
-                decode_v_cas1_53(dwt->mem, sn, len, tiledp_col, stride);
-            return;
-        }
-    }
-}
-
-
-/* <summary>                            */
-/* Inverse wavelet transform in 2-D.    */
-/* </summary>                           */
-static bool decode_tile_53( TileComponent* tilec, uint32_t numres){
-    if (numres == 1U)
-        return true;
+/* rows per horizontal task of decode_tile_lift */
+const uint32_t rows_per_task = 8;
 
+/**
+ Inverse wavelet transform of a whole tile component with samples of type T
+ at tiledp, with the given horizontal and vertical lifting kernels.
+ Vertical kernels work on COLS columns at a time.
+ */
+template<typename T, uint32_t COLS> static bool decode_tile_lift(TileComponent* tilec,
+							T *tiledp, uint32_t numres,
+							const resolution_wait_fn &wait,
+							void (*decode_h)(T*, T*, int32_t, int32_t, uint8_t),
+							void (*decode_v)(T*, T*, int32_t, int32_t, uint8_t)){
     auto tr = tilec->resolutions;
-
-    /* width of the resolution level computed */
     uint32_t rw = (uint32_t)(tr->x1 - tr->x0);
-    /* height of the resolution level computed */
     uint32_t rh = (uint32_t)(tr->y1 - tr->y0);
-
     uint32_t w = (uint32_t)(tilec->resolutions[tilec->minimum_num_resolutions - 1].x1 -
                                 tilec->resolutions[tilec->minimum_num_resolutions - 1].x0);
-
-    size_t num_threads = ThreadPool::get()->num_threads();
-    size_t h_mem_size = dwt_utils::max_resolution(tr, numres);
-    /* overflow check */
-    if (h_mem_size > (SIZE_MAX / PLL_COLS_53 / sizeof(int32_t))) {
-        GROK_ERROR("Overflow");
-        return false;
-    }
-    /* We need PLL_COLS_53 times the height of the array, */
-    /* since for the vertical pass */
-    /* we process PLL_COLS_53 columns at a time */
-    dwt_data<int32_t> horiz;
-    dwt_data<int32_t> vert;
-    h_mem_size *= PLL_COLS_53 * sizeof(int32_t);
-    bool rc = true;
-    int32_t * GRK_RESTRICT tiledp = tilec->buf->get_ptr( 0, 0, 0, 0);
-    while (--numres) {
+    auto pool = ThreadPool::get();
+    std::atomic_bool rc(true);
+    if (numres == 1U && wait)
+        wait(0);
+    for (uint32_t resno = 1; resno < numres; ++resno) {
         ++tr;
-        horiz.sn = (int32_t)rw;
-        vert.sn = (int32_t)rh;
-
+        /* code blocks up to this resolution must be decoded */
+        if (wait)
+            wait(resno);
+        uint32_t sn_h = rw, sn_v = rh;
         rw = (uint32_t)(tr->x1 - tr->x0);
         rh = (uint32_t)(tr->y1 - tr->y0);
+        uint32_t dn_h = rw - sn_h, dn_v = rh - sn_v;
+        uint8_t cas_h = tr->x0 & 1, cas_v = tr->y0 & 1;
+
+        pool->parallel_for((rh + rows_per_task - 1) / rows_per_task,
+        		[=, &rc](size_t index) {
+            ScratchArena::Frame frame;
+            auto tmp = ScratchArena::local()->alloc<T>(rw);
+            if (!tmp) {
+                GROK_ERROR("Out of memory");
+                rc = false;
+                return;
+            }
+            uint32_t j1 = std::min<uint32_t>((uint32_t)(index + 1) * rows_per_task, rh);
+            for (uint32_t j = (uint32_t)index * rows_per_task; j < j1; ++j) {
+                auto row = tiledp + (size_t)j * w;
+                memcpy(tmp, row, rw * sizeof(T));
+                decode_h(tmp, tmp + sn_h, (int32_t)dn_h, (int32_t)sn_h, cas_h);
+                lift_merge_h(tmp, row, dn_h, sn_h, cas_h);
+            }
+        });
+        if (!rc)
+            return false;
+
+        pool->parallel_for((rw + COLS - 1) / COLS,
+        		[=, &rc](size_t index) {
+            ScratchArena::Frame frame;
+            auto tmp = ScratchArena::local()->alloc<T>((size_t)rh * COLS);
+            if (!tmp) {
+                GROK_ERROR("Out of memory");
+                rc = false;
+                return;
+            }
+            uint32_t j = (uint32_t)index * COLS;
+            uint32_t cols = std::min<uint32_t>(COLS, rw - j);
+            lift_load_v<T, COLS>(tiledp + j, tmp, rh, w, cols);
+            decode_v(tmp, tmp + (size_t)sn_v * COLS,
+            		(int32_t)dn_v, (int32_t)sn_v, cas_v);
+            lift_interleave_v<T, COLS>(tmp, tiledp + j, dn_v, sn_v,
+            		cas_v, w, cols);
+        });
+        if (!rc)
+            return false;
+    }
 
-        horiz.dn = (int32_t)(rw - (uint32_t)horiz.sn);
-        horiz.cas = tr->x0 % 2;
+    return true;
+}
 
-        if (num_threads <= 1 || rh <= 1) {
-        	if (!horiz.mem){
-        	    if (! horiz.alloc(h_mem_size)) {
-        	        GROK_ERROR("Out of memory");
-        	        return false;
-        	    }
-        	    vert.mem = horiz.mem;
-        	}
-            for (uint32_t j = 0; j < rh; ++j)
-                decode_h_53(&horiz, &tiledp[(size_t)j * w]);
-        } else {
-            uint32_t num_jobs = (uint32_t)num_threads;
-            if (rh < num_jobs)
-                num_jobs = rh;
-            uint32_t step_j = (rh / num_jobs);
-			std::vector< std::future<int> > results;
-			for(uint32_t j = 0; j < num_jobs; ++j) {
-               auto job = new decode_job<int32_t, dwt_data<int32_t>>(horiz,
-											w,
-											tiledp,
-											j * step_j,
-											j < (num_jobs - 1U) ? (j + 1U) * step_j : rh);
-                if (!job->data.alloc(h_mem_size)) {
-                    GROK_ERROR("Out of memory");
-                    grk_aligned_free(horiz.mem);
-                    return false;
-                }
-				results.emplace_back(
-					ThreadPool::get()->enqueue([job] {
-					    for (uint32_t j = job->min_j; j < job->max_j; j++)
-					        decode_h_53(&job->data, &job->tiledp[j * job->w]);
-					    grk_aligned_free(job->data.mem);
-					    delete job;
-						return 0;
-					})
-				);
-			}
-			for(auto && result: results)
-				result.get();
-        }
+/**
+ Inverse 5-3 wavelet transform in 2-D
+ */
+static bool decode_tile_53(TileComponent* tilec, uint32_t numres,
+							const resolution_wait_fn &wait){
+    auto kernels = SIMDKernels::get();
+    return decode_tile_lift<int32_t, PLL_COLS_FWD>(tilec,
+    		tilec->buf->get_ptr(0, 0, 0, 0), numres, wait,
+    		kernels->decode_53_h, kernels->decode_53_v);
+}
 
-        vert.dn = (int32_t)(rh - (uint32_t)vert.sn);
-        vert.cas = tr->y0 % 2;
+/**
+ Inverse 9-7 wavelet transform in 2-D
+ */
+static bool decode_tile_97(TileComponent* tilec, uint32_t numres,
+							const resolution_wait_fn &wait){
+    auto kernels = SIMDKernels::get();
+    return decode_tile_lift<float, PLL_COLS_FWD>(tilec,
+    		(float*)tilec->buf->get_ptr(0, 0, 0, 0), numres, wait,
+    		kernels->decode_97_h, kernels->decode_97_v);
+}
 
-        if (num_threads <= 1 || rw <= 1) {
-        	if (!horiz.mem){
-        	    if (! horiz.alloc(h_mem_size)) {
-        	        GROK_ERROR("Out of memory");
-        	        return false;
-        	    }
-        	    vert.mem = horiz.mem;
-        	}
-            uint32_t j;
-            for (j = 0; j + PLL_COLS_53 <= rw; j += PLL_COLS_53)
-                decode_v_53(&vert, &tiledp[j], (size_t)w, PLL_COLS_53);
-            if (j < rw)
-                decode_v_53(&vert, &tiledp[j], (size_t)w, (int32_t)(rw - j));
-        } else {
-            uint32_t num_jobs = (uint32_t)num_threads;
-            if (rw < num_jobs)
-                num_jobs = rw;
-            uint32_t step_j = (rw / num_jobs);
-			std::vector< std::future<int> > results;
-            for (uint32_t j = 0; j < num_jobs; j++) {
-                auto job = new decode_job<int32_t, dwt_data<int32_t>>(vert,
-											w,
-											tiledp,
-											j * step_j,
-											j < (num_jobs - 1U) ? (j + 1U) * step_j : rw);
-                if (!job->data.alloc(h_mem_size)) {
-                    GROK_ERROR("Out of memory");
-                    grk_aligned_free(vert.mem);
-                    return false;
-                }
-				results.emplace_back(
-					ThreadPool::get()->enqueue([job] {
-						uint32_t j;
-						for (j = job->min_j; j + PLL_COLS_53 <= job->max_j;	j += PLL_COLS_53)
-							decode_v_53(&job->data, &job->tiledp[j], (size_t)job->w, PLL_COLS_53);
-						if (j < job->max_j)
-							decode_v_53(&job->data, &job->tiledp[j], (size_t)job->w, (int32_t)(job->max_j - j));
-						grk_aligned_free(job->data.mem);
-						delete job;
-					return 0;
-					})
-				);
-            }
-			for(auto && result: results)
-				result.get();
-        }
-    }
-    grk_aligned_free(horiz.mem);
+/**
+ Inverse 5-3 wavelet transform of 16 bit coefficients, followed by
+ widening of the transformed samples to 32 bits in place
+ */
+static bool decode_tile_53_16(TileComponent* tilec, uint32_t numres,
+							const resolution_wait_fn &wait){
+    auto kernels = SIMDKernels::get();
+    auto buf = tilec->buf;
+    if (!decode_tile_lift<int16_t, PLL_COLS_16>(tilec, buf->get_ptr16(0, 0, 0, 0),
+    		numres, wait, kernels->decode_53_h16, kernels->decode_53_v16))
+        return false;
+    // widening runs from last sample to first, so it can be done in place
+    kernels->widen16(buf->get_ptr16(0, 0, 0, 0), buf->data,
+    		(uint64_t)buf->reduced_region_dim.area());
+    buf->coeff16 = false;
+
+    return true;
+}
+
+/**
+ Inverse 9-7 wavelet transform of 16 bit fixed point coefficients,
+ followed by conversion of the transformed samples to float in place
+ */
+static bool decode_tile_97_16(TileComponent* tilec, uint32_t numres,
+							const resolution_wait_fn &wait){
+    auto kernels = SIMDKernels::get();
+    auto buf = tilec->buf;
+    if (!decode_tile_lift<int16_t, PLL_COLS_16>(tilec, buf->get_ptr16(0, 0, 0, 0),
+    		numres, wait, kernels->decode_97_h16, kernels->decode_97_v16))
+        return false;
+    kernels->widen_fix16(buf->get_ptr16(0, 0, 0, 0), (float*)buf->data,
+    		(uint64_t)buf->reduced_region_dim.area(),
+    		1.0f / (float)(1U << buf->coeff16_frac_bits));
+    buf->coeff16 = false;
 
-    return rc;
+    return true;
 }
 
 static void interleave_partial_h_53(dwt_data<int32_t> *dwt,
@@ -1202,72 +740,368 @@ public:
 	}
 };
 
+/*
+ Cache blocked inverse wavelet transform of a whole tile component.
+
+ Instead of sweeping the whole tile horizontally and then vertically
+ at each level, every decomposition level keeps a window of at most
+ blocked_window_rows rows. Rows enter the window in natural order:
+ low rows are built from the LL row produced by the level below and the HL row
+ in the tile buffer, while high rows are read from the tile buffer.
+ New rows are transformed horizontally as they enter, and once the window
+ is full, the vertical transform runs over it in column groups, keeping only
+ rows at least blocked_margin rows away from artificial window edges.
+ Kept rows feed the next level's window straight away, so each row crosses
+ all levels while it is still in cache, and the tile buffer is read once and
+ the result written once.
+
+ Lifting errors from artificial window edges spread by one sample per
+ lifting step, so they never reach the kept rows, and each kept sample goes
+ through exactly the same operations as in decode_tile_53 / decode_tile_97:
+ the result is bit-exact.
+
+ Since the tile buffer holds the sub-bands of all levels, the final rows
+ can't be written in place until every level has finished reading them;
+ they are written to a second buffer that then replaces the tile buffer.
+ */
+
+/** Number of rows in each level's window */
+const uint32_t blocked_window_rows = 64;
+/** Margin that absorbs lifting errors at artificial window edges */
+const uint32_t blocked_margin = 8;
+
+/**
+ Lifting for the cache blocked inverse transform, with
+ one thread's scratch memory
+ */
+template <typename S> class BlockedLift {
+public:
+	typedef S T;
+	typedef void (*kernel)(T*, T*, int32_t, int32_t, uint8_t);
+	/** number of columns transformed together vertically */
+	static const uint32_t v_cols = PLL_COLS_FWD;
+
+	BlockedLift(kernel h, kernel v) : h_kernel(h),
+									v_kernel(v),
+									row(nullptr),
+									cols(nullptr),
+									out(nullptr)
+	{}
+	~BlockedLift(){
+		grk_aligned_free(row);
+		grk_aligned_free(cols);
+		grk_aligned_free(out);
+	}
+	bool alloc(uint32_t max_width, uint32_t max_rows){
+		row = (T*)grk_aligned_malloc((size_t)max_width * sizeof(T));
+		cols = (T*)grk_aligned_malloc((size_t)max_rows * v_cols * sizeof(T));
+		out = (T*)grk_aligned_malloc((size_t)max_rows * v_cols * sizeof(T));
+		return row && cols && out;
+	}
+	/**
+	 Horizontal transform of rows, in place
+	 */
+	void decode_h(T *rows, uint32_t num_rows, uint32_t stride,
+					uint32_t sn, uint32_t dn, uint8_t cas){
+		for (uint32_t j = 0; j < num_rows; ++j) {
+			auto a = rows + (size_t)j * stride;
+			memcpy(row, a, (sn + dn) * sizeof(T));
+			h_kernel(row, row + sn, (int32_t)dn, (int32_t)sn, cas);
+			lift_merge_h(row, a, dn, sn, cas);
+		}
+	}
+	/**
+	 Vertical transform of up to v_cols columns of n rows in natural order.
+	 Row k of the result is at offset k * v_cols of the returned pointer.
+	 */
+	const T* decode_v(const T *win, uint32_t n, uint32_t stride,
+						uint8_t cas, uint32_t num_cols){
+		uint32_t sn = cas ? n / 2 : (n + 1) / 2;
+		uint32_t dn = n - sn;
+		lift_gather_v<T, v_cols>(win, cols, dn, sn, cas, stride, num_cols);
+		v_kernel(cols, cols + (size_t)sn * v_cols, (int32_t)dn, (int32_t)sn, cas);
+		lift_interleave_v<T, v_cols>(cols, out, dn, sn, cas, v_cols, v_cols);
+		return out;
+	}
+private:
+	kernel h_kernel;
+	kernel v_kernel;
+	/* one row, deinterleaved */
+	T *row;
+	/* v_cols columns, deinterleaved */
+	T *cols;
+	/* v_cols columns, in natural order */
+	T *out;
+};
+
+class Blocked53 : public BlockedLift<int32_t> {
+public:
+	Blocked53() : BlockedLift(SIMDKernels::get()->decode_53_h,
+								SIMDKernels::get()->decode_53_v)
+	{}
+};
+
+class Blocked97 : public BlockedLift<float> {
+public:
+	Blocked97() : BlockedLift(SIMDKernels::get()->decode_97_h,
+								SIMDKernels::get()->decode_97_v)
+	{}
+};
+
+template <typename D> class BlockedInverse {
+public:
+	typedef typename D::T T;
+	BlockedInverse(TileComponent* tilec, uint32_t numres) : tilec(tilec),
+															numres(numres),
+															src(nullptr),
+															dest(nullptr),
+															w(0)
+	{}
+	~BlockedInverse(){
+		for (auto &lev : levels) {
+			grk_aligned_free(lev.win);
+			grk_aligned_free(lev.out);
+		}
+		grk_aligned_free(dest);
+		for (auto &s : scratch)
+			delete s;
+	}
+	bool decode(void){
+		auto tr = tilec->resolutions;
+		w = (uint32_t)(tilec->resolutions[tilec->minimum_num_resolutions - 1].x1 -
+				tilec->resolutions[tilec->minimum_num_resolutions - 1].x0);
+		src = (T*)tilec->buf->get_ptr(0, 0, 0, 0);
+		levels.resize(numres - 1);
+		uint32_t max_rows = 0;
+		for (uint32_t i = 0; i < levels.size(); ++i) {
+			auto &lev = levels[i];
+			auto prev = tr + i;
+			auto cur = prev + 1;
+			lev.rw = (uint32_t)(cur->x1 - cur->x0);
+			lev.rh = (uint32_t)(cur->y1 - cur->y0);
+			lev.sn_h = (uint32_t)(prev->x1 - prev->x0);
+			lev.sn_v = (uint32_t)(prev->y1 - prev->y0);
+			lev.cas_h = (uint8_t)(cur->x0 & 1);
+			lev.cas_v = (uint8_t)(cur->y0 & 1);
+			lev.capacity = min<uint32_t>(lev.rh, blocked_window_rows);
+			max_rows = max<uint32_t>(max_rows, lev.capacity);
+			/* allocate at least one sample, so that empty levels have valid pointers */
+			size_t win_size = max<size_t>((size_t)lev.capacity * lev.rw, 1) * sizeof(T);
+			lev.win = (T*)grk_aligned_malloc(win_size);
+			if (!lev.win) {
+				GROK_ERROR("Out of memory");
+				return false;
+			}
+			if (i + 1 < levels.size()) {
+				lev.out = (T*)grk_aligned_malloc(win_size);
+				if (!lev.out) {
+					GROK_ERROR("Out of memory");
+					return false;
+				}
+			}
+		}
+		auto &top = levels.back();
+		size_t dest_size = max<size_t>((size_t)w * top.rh, 1) * sizeof(T);
+		dest = (T*)grk_aligned_malloc(dest_size);
+		if (!dest) {
+			GROK_ERROR("Out of memory");
+			return false;
+		}
+		for (size_t i = 0; i < ThreadPool::get()->num_threads(); ++i) {
+			auto s = new D();
+			scratch.push_back(s);
+			if (!s->alloc(top.rw, max_rows)) {
+				GROK_ERROR("Out of memory");
+				return false;
+			}
+		}
+
+		/* the LL band of the lowest resolution feeds the first level */
+		uint32_t ll_rows = (uint32_t)(tr->y1 - tr->y0);
+		for (uint32_t j = 0; j < ll_rows; ++j)
+			push(0, src + (size_t)j * w);
+		for (uint32_t i = 0; i < levels.size(); ++i)
+			finish(i);
+
+		auto buf = tilec->buf;
+		if (buf->owns_data && top.rw == w && buf->data_size == dest_size) {
+			grk_aligned_free(buf->data);
+			buf->data = (int32_t*)dest;
+			dest = nullptr;
+		} else {
+			for (uint32_t k = 0; k < top.rh; ++k)
+				memcpy(src + (size_t)k * w, dest + (size_t)k * w, top.rw * sizeof(T));
+		}
+
+		return true;
+	}
+private:
+	struct Level {
+		Level() : rw(0), rh(0), sn_h(0), sn_v(0), cas_h(0), cas_v(0),
+				capacity(0), win(nullptr), out(nullptr), win_start(0),
+				win_rows(0), h_rows(0), next_out(0)
+		{}
+		uint32_t rw, rh;
+		/* width and height of the resolution below */
+		uint32_t sn_h, sn_v;
+		uint8_t cas_h, cas_v;
+		/* rows in window */
+		uint32_t capacity;
+		T *win;
+		/* transformed rows, unless this is the top level */
+		T *out;
+		/* resolution row of first window row */
+		uint32_t win_start;
+		uint32_t win_rows;
+		/* window rows already transformed horizontally */
+		uint32_t h_rows;
+		/* first row not yet transformed */
+		uint32_t next_out;
+	};
+
+	/**
+	 Push next LL row into level's window, preceded by any high rows
+	 */
+	void push(uint32_t level, const T *ll_row){
+		auto &lev = levels[level];
+		while (((lev.win_start + lev.win_rows) & 1) != lev.cas_v)
+			append(level, nullptr);
+		append(level, ll_row);
+	}
+	/**
+	 Append remaining high rows to level's window, once all LL rows
+	 have been pushed
+	 */
+	void finish(uint32_t level){
+		auto &lev = levels[level];
+		while (lev.win_start + lev.win_rows < lev.rh)
+			append(level, nullptr);
+	}
+	void append(uint32_t level, const T *ll_row){
+		auto &lev = levels[level];
+		uint32_t k = lev.win_start + lev.win_rows;
+		auto dest_row = lev.win + (size_t)lev.win_rows * lev.rw;
+		uint32_t i = k >> 1;
+		/* only low rows come with an LL row */
+		assert(((k & 1) == lev.cas_v) == (ll_row != nullptr));
+		if (ll_row) {
+			memcpy(dest_row, ll_row, lev.sn_h * sizeof(T));
+			memcpy(dest_row + lev.sn_h, src + (size_t)i * w + lev.sn_h,
+					(lev.rw - lev.sn_h) * sizeof(T));
+		} else {
+			memcpy(dest_row, src + (size_t)(lev.sn_v + i) * w, lev.rw * sizeof(T));
+		}
+		lev.win_rows++;
+		bool last = k + 1 == lev.rh;
+		if (lev.win_rows == lev.capacity || last)
+			transform(level, last);
+	}
+	void transform(uint32_t level, bool last){
+		auto &lev = levels[level];
+		auto pool = ThreadPool::get();
+		uint32_t rw = lev.rw;
+		uint32_t total = lev.win_start + lev.win_rows;
+		uint32_t out_begin = lev.next_out;
+		uint32_t out_end = last ? lev.rh : total - blocked_margin;
+
+		/* horizontal transform of new rows, four at a time */
+		uint32_t h_rows = lev.h_rows;
+		uint32_t new_rows = lev.win_rows - h_rows;
+		pool->parallel_for((new_rows + 3) / 4,
+				[this, &lev, rw, h_rows, new_rows, pool](size_t g) {
+					auto s = scratch[(size_t)pool->thread_number(std::this_thread::get_id())];
+					uint32_t j = (uint32_t)g * 4;
+					s->decode_h(lev.win + (size_t)(h_rows + j) * rw,
+							min<uint32_t>(4, new_rows - j), rw,
+							lev.sn_h, rw - lev.sn_h, lev.cas_h);
+				});
+
+		/* vertical transform of window, keeping rows in [out_begin, out_end) */
+		bool top = level + 1 == levels.size();
+		T *out = top ? dest + (size_t)out_begin * w : lev.out;
+		size_t out_stride = top ? w : rw;
+		uint8_t cas = (uint8_t)((lev.cas_v + lev.win_start) & 1);
+		uint32_t n = lev.win_rows;
+		pool->parallel_for((rw + D::v_cols - 1) / D::v_cols,
+				[this, &lev, rw, cas, n, out, out_stride, out_begin, out_end, pool](size_t g) {
+					auto s = scratch[(size_t)pool->thread_number(std::this_thread::get_id())];
+					uint32_t m = (uint32_t)g * D::v_cols;
+					uint32_t cols = min<uint32_t>(D::v_cols, rw - m);
+					auto res = s->decode_v(lev.win + m, n, rw, cas, cols);
+					for (uint32_t k = out_begin; k < out_end; ++k)
+						memcpy(out + (k - out_begin) * out_stride + m,
+								res + (size_t)(k - lev.win_start) * D::v_cols,
+								cols * sizeof(T));
+				});
+
+		/* slide window down, before rows are pushed to next level */
+		uint32_t keep_start = last ? total :
+				max<uint32_t>(lev.win_start, out_end - blocked_margin);
+		uint32_t keep_rows = total - keep_start;
+		if (keep_rows)
+			memmove(lev.win, lev.win + (size_t)(keep_start - lev.win_start) * rw,
+					(size_t)keep_rows * rw * sizeof(T));
+		lev.win_start = keep_start;
+		lev.win_rows = keep_rows;
+		lev.h_rows = keep_rows;
+		lev.next_out = out_end;
+
+		if (!top) {
+			for (uint32_t k = out_begin; k < out_end; ++k)
+				push(level + 1, lev.out + (size_t)(k - out_begin) * rw);
+		}
+	}
+
+	TileComponent* tilec;
+	uint32_t numres;
+	std::vector<Level> levels;
+	/* per-thread lifting scratch memory */
+	std::vector<D*> scratch;
+	/* tile buffer, holding the sub-bands */
+	T *src;
+	/* transformed top resolution */
+	T *dest;
+	/* distance between rows of tile buffer */
+	uint32_t w;
+};
+
+/**
+ Cache blocked inverse wavelet transform of a whole tile component,
+ bit-exact with decode_tile_53 / decode_tile_97
+ */
+template <typename D> static bool decode_tile_blocked(TileComponent* tilec,
+										uint32_t numres,
+										const resolution_wait_fn &wait){
+    if (numres == 1U)
+        return true;
+    /* every level is visited by each stripe of rows */
+    if (wait)
+        wait(numres - 1);
+    BlockedInverse<D> blocked(tilec, numres);
+
+    return blocked.decode();
+}
+
 /* <summary>                            */
 /* Inverse 5-3 wavelet transform in 2-D. */
 /* </summary>                           */
 bool decode_53(TileProcessor *p_tcd, TileComponent* tilec,
-                        uint32_t numres)
+                        uint32_t numres, const resolution_wait_fn &wait)
 {
     if (p_tcd->whole_tile_decoding) {
-        return decode_tile_53(tilec,numres);
+        if (tilec->buf->coeff16)
+            return decode_tile_53_16(tilec, numres, wait);
+        if (p_tcd->m_cp && p_tcd->m_cp->m_coding_param.m_dec.m_blocked_dwt)
+            return decode_tile_blocked<Blocked53>(tilec, numres, wait);
+        return decode_tile_53(tilec,numres, wait);
     } else {
+        if (wait)
+            wait(numres - 1);
         return decode_partial_tile<int32_t, 1, 4,2, Partial53>(tilec, numres, tilec->m_sa);
     }
 }
 
 
-static void interleave_h_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
-                                   float* GRK_RESTRICT a,
-                                   uint32_t width,
-                                   uint32_t remaining_height){
-    float* GRK_RESTRICT bi = (float*)(dwt->mem + dwt->cas);
-    uint32_t i, k;
-    uint32_t x0 = dwt->win_l_x0;
-    uint32_t x1 = dwt->win_l_x1;
-
-    for (k = 0; k < 2; ++k) {
-        if (remaining_height >= 4 && ((size_t) a & 0x0f) == 0 &&
-                ((size_t) bi & 0x0f) == 0 && (width & 0x0f) == 0) {
-            /* Fast code path */
-            for (i = x0; i < x1; ++i) {
-                uint32_t j = i;
-                bi[i * 8    ] = a[j];
-                j += width;
-                bi[i * 8 + 1] = a[j];
-                j += width;
-                bi[i * 8 + 2] = a[j];
-                j += width;
-                bi[i * 8 + 3] = a[j];
-            }
-        } else {
-            /* Slow code path */
-            for (i = x0; i < x1; ++i) {
-                uint32_t j = i;
-                bi[i * 8    ] = a[j];
-                j += width;
-                if (remaining_height == 1) {
-                    continue;
-                }
-                bi[i * 8 + 1] = a[j];
-                j += width;
-                if (remaining_height == 2) {
-                    continue;
-                }
-                bi[i * 8 + 2] = a[j];
-                j += width;
-                if (remaining_height == 3) {
-                    continue;
-                }
-                bi[i * 8 + 3] = a[j]; /* This one*/
-            }
-        }
-
-        bi = (float*)(dwt->mem + 1 - dwt->cas);
-        a += dwt->sn;
-        x0 = dwt->win_h_x0;
-        x1 = dwt->win_h_x1;
-    }
-}
 static void interleave_partial_h_97(dwt_data<v4_data>* dwt,
 									sparse_array* sa,
 									uint32_t sa_line,
@@ -1295,26 +1129,6 @@ static void interleave_partial_h_97(dwt_data<v4_data>* dwt,
     }
 }
 
-static void interleave_v_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
-                                   float* GRK_RESTRICT a,
-                                   uint32_t width,
-                                   uint32_t nb_elts_read){
-    v4_data* GRK_RESTRICT bi = dwt->mem + dwt->cas;
-
-    for (uint32_t i = dwt->win_l_x0; i < dwt->win_l_x1; ++i) {
-        memcpy((float*)&bi[i * 2], &a[i * (size_t)width],
-               (size_t)nb_elts_read * sizeof(float));
-    }
-
-    a += (uint32_t)dwt->sn * (size_t)width;
-    bi = dwt->mem + 1 - dwt->cas;
-
-    for (uint32_t i = dwt->win_h_x0; i < dwt->win_h_x1; ++i) {
-        memcpy((float*)&bi[i * 2], &a[i * (size_t)width],
-               (size_t)nb_elts_read * sizeof(float));
-    }
-}
-
 static void interleave_partial_v_97(dwt_data<v4_data>* GRK_RESTRICT dwt,
 									sparse_array* sa,
 									uint32_t sa_col,
@@ -1537,206 +1351,6 @@ static void decode_step_97(dwt_data<v4_data>* GRK_RESTRICT dwt)
 }
 
 
-/* <summary>                             */
-/* Inverse 9-7 wavelet transform in 2-D. */
-/* </summary>                            */
-static
-bool decode_tile_97(TileComponent* GRK_RESTRICT tilec,uint32_t numres){
-    if (numres == 1U)
-        return true;
-
-    auto res = tilec->resolutions;
-    /* width of the resolution level computed */
-    uint32_t rw = (uint32_t)(res->x1 - res->x0);
-    /* height of the resolution level computed */
-    uint32_t rh = (uint32_t)(res->y1 - res->y0);
-    uint32_t w = (uint32_t)(tilec->resolutions[tilec->minimum_num_resolutions - 1].x1 -
-                            tilec->resolutions[tilec->minimum_num_resolutions - 1].x0);
-
-    size_t data_size = dwt_utils::max_resolution(res, numres);
-    dwt_data<v4_data> horiz;
-    dwt_data<v4_data> vert;
-    if (!horiz.alloc(data_size)) {
-        GROK_ERROR("Out of memory");
-        return false;
-    }
-    vert.mem = horiz.mem;
-    size_t num_threads = ThreadPool::get()->num_threads();
-    while (--numres) {
-        horiz.sn = (int32_t)rw;
-        vert.sn = (int32_t)rh;
-        ++res;
-        /* width of the resolution level computed */
-        rw = (uint32_t)(res->x1 -  res->x0);
-        /* height of the resolution level computed */
-        rh = (uint32_t)(res->y1 -  res->y0);
-        horiz.dn = (int32_t)(rw - (uint32_t)horiz.sn);
-        horiz.cas = res->x0 % 2;
-        horiz.win_l_x0 = 0;
-        horiz.win_l_x1 = (uint32_t)horiz.sn;
-        horiz.win_h_x0 = 0;
-        horiz.win_h_x1 = (uint32_t)horiz.dn;
-        uint32_t j;
-        float * GRK_RESTRICT tiledp = (float*) tilec->buf->get_ptr( 0, 0, 0, 0);
-        uint32_t num_jobs = (uint32_t)num_threads;
-        if (rh < num_jobs)
-            num_jobs = rh;
-        uint32_t step_j = num_jobs ? (rh / num_jobs) : 0;
-        if (step_j < 4) {
-			for (j = 0; j + 3 < rh; j += 4) {
-				interleave_h_97(&horiz, tiledp, w, rh - j);
-				decode_step_97(&horiz);
-				for (uint32_t k = 0; k < rw; k++) {
-					tiledp[k      ] 			= horiz.mem[k].f[0];
-					tiledp[k + (size_t)w  ] 	= horiz.mem[k].f[1];
-					tiledp[k + (size_t)w * 2] 	= horiz.mem[k].f[2];
-					tiledp[k + (size_t)w * 3] 	= horiz.mem[k].f[3];
-				}
-				tiledp += w * 4;
-			}
-			if (j < rh) {
-				interleave_h_97(&horiz, tiledp, w, rh - j);
-				decode_step_97(&horiz);
-				for (uint32_t k = 0; k < rw; k++) {
-					switch (rh - j) {
-					case 3:
-						tiledp[k + (size_t)w * 2] = horiz.mem[k].f[2];
-					/* FALLTHRU */
-					case 2:
-						tiledp[k + (size_t)w  ] = horiz.mem[k].f[1];
-					/* FALLTHRU */
-					case 1:
-						tiledp[k] = horiz.mem[k].f[0];
-					}
-				}
-			}
-        } else {
-			std::vector< std::future<int> > results;
-			for(uint32_t j = 0; j < num_jobs; ++j) {
-			   auto job = new decode_job<float, dwt_data<v4_data>>(horiz,
-											w,
-											tiledp,
-											j * step_j,
-											j < (num_jobs - 1U) ? (j + 1U) * step_j : rh);
-				if (!job->data.alloc(data_size)) {
-					GROK_ERROR("Out of memory");
-					horiz.release();
-					return false;
-				}
-				results.emplace_back(
-					ThreadPool::get()->enqueue([job,w,rw] {
-					    float* tdp = nullptr;
-					    uint32_t j;
-						for (j = job->min_j; j + 3 < job->max_j; j+=4){
-							tdp = &job->tiledp[j * job->w];
-							interleave_h_97(&job->data, tdp, w, job->max_j - j);
-							decode_step_97(&job->data);
-							for (uint32_t k = 0; k < rw; k++) {
-								tdp[k      ] 			= job->data.mem[k].f[0];
-								tdp[k + (size_t)w  ] 	= job->data.mem[k].f[1];
-								tdp[k + (size_t)w * 2] 	= job->data.mem[k].f[2];
-								tdp[k + (size_t)w * 3] 	= job->data.mem[k].f[3];
-							}
-						}
-						if (j < job->max_j) {
-							tdp += 4 * job->w;
-							interleave_h_97(&job->data, tdp, w, job->max_j - j);
-							decode_step_97(&job->data);
-							for (uint32_t k = 0; k < rw; k++) {
-								switch (job->max_j - j) {
-								case 3:
-									tdp[k + (size_t)w * 2] = job->data.mem[k].f[2];
-								/* FALLTHRU */
-								case 2:
-									tdp[k + (size_t)w  ] = job->data.mem[k].f[1];
-								/* FALLTHRU */
-								case 1:
-									tdp[k] = job->data.mem[k].f[0];
-								}
-							}
-						}
-						job->data.release();
-						delete job;
-						return 0;
-					})
-				);
-			}
-			for(auto && result: results)
-				result.get();
-        }
-        vert.dn = (int32_t)rh - vert.sn;
-        vert.cas = res->y0 % 2;
-        vert.win_l_x0 = 0;
-        vert.win_l_x1 = (uint32_t)vert.sn;
-        vert.win_h_x0 = 0;
-        vert.win_h_x1 = (uint32_t)vert.dn;
-        tiledp = (float*) tilec->buf->get_ptr( 0, 0, 0, 0);
-        num_jobs = (uint32_t)num_threads;
-        if (rw < num_jobs)
-            num_jobs = rw;
-        step_j = num_jobs ? (rw / num_jobs) : 0;
-        if (step_j < 4) {
-			for (j = 0; j + 3 < rw; j += 4) {
-				interleave_v_97(&vert, tiledp, w, 4);
-				decode_step_97(&vert);
-				for (uint32_t k = 0; k < rh; ++k)
-					memcpy(&tiledp[k * (size_t)w], &vert.mem[k], 4 * sizeof(float));
-				 tiledp += 4;
-			}
-			if (j < rw) {
-				j = rw & 0x03;
-				interleave_v_97(&vert, tiledp, w, j);
-				decode_step_97(&vert);
-				for (uint32_t k = 0; k < rh; ++k)
-					memcpy(&tiledp[k * (size_t)w], &vert.mem[k],(size_t)j * sizeof(float));
-			}
-        } else {
-			std::vector< std::future<int> > results;
-            for (uint32_t j = 0; j < num_jobs; j++) {
-            	auto job = new decode_job<float, dwt_data<v4_data>>(vert,
-            												w,
-            												tiledp,
-            												j * step_j,
-            												j < (num_jobs - 1U) ? (j + 1U) * step_j : rw);
-				if (!job->data.alloc(data_size)) {
-					GROK_ERROR("Out of memory");
-					horiz.release();
-					return false;
-				}
-				results.emplace_back(
-					ThreadPool::get()->enqueue([job,rh] {
-						float* tdp = job->tiledp + job->min_j;
-						uint32_t w = job->w;
-						uint32_t j;
-						for (j = job->min_j; j + 3 < job->max_j; j+=4){
-							interleave_v_97(&job->data, tdp, w, 4);
-							decode_step_97(&job->data);
-							for (uint32_t k = 0; k < rh; ++k)
-								memcpy(&tdp[k * (size_t)job->w], &job->data.mem[k], 4 * sizeof(float));
-							tdp += 4;
-						}
-						if (j < job->max_j) {
-							j = job->max_j - j;
-							interleave_v_97(&job->data, tdp, w, j);
-							decode_step_97(&job->data);
-							for (uint32_t k = 0; k < rh; ++k)
-								memcpy(&tdp[k * (size_t)w], &job->data.mem[k],(size_t)j * sizeof(float));
-						}
-						job->data.release();
-						delete job;
-						return 0;
-					})
-				);
-            }
-			for(auto && result: results)
-				result.get();
-        }
-    }
-    horiz.release();
-
-    return true;
-}
-
 class Partial97 {
 public:
 	void interleave_partial_h(dwt_data<v4_data>* dwt,
@@ -1806,13 +1420,16 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
     // in 53 vertical pass, we process 4 vertical columns at a time
     const uint32_t data_multiplier = (sizeof(T) == 4) ? 4 : 1;
     size_t data_size = dwt_utils::max_resolution(tr, numres) * data_multiplier;
-    if (!horiz.alloc(data_size)) {
+    std::atomic_bool success(true);
+    // single threaded working buffer
+    ScratchArena::Frame frame;
+    if (!horiz.alloc_scratch(data_size)) {
         GROK_ERROR("Out of memory");
         return false;
     }
     vert.mem = horiz.mem;
     D decoder;
-    size_t num_threads = ThreadPool::get()->num_threads();
+    size_t num_threads = ThreadPool::get()->concurrency();
 
     for (resno = 1; resno < numres; resno ++) {
         uint32_t j;
@@ -1981,13 +1598,16 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 											nullptr,
 											bounds[k][0] + j * step_j,
 											j < (num_jobs - 1U) ? bounds[k][0] + (j + 1U) * step_j : bounds[k][1]);
-				if (!job->data.alloc(data_size)) {
-					GROK_ERROR("Out of memory");
-					horiz.release();
-					return false;
-				}
 				results.emplace_back(
-					ThreadPool::get()->enqueue([job,sa, win_tr_x0, win_tr_x1, &decoder] {
+					ThreadPool::get()->enqueue([job,sa, win_tr_x0, win_tr_x1, data_size, &decoder, &success] {
+					 // working buffer from the arena of the thread running the job
+					 ScratchArena::Frame frame;
+					 if (!job->data.alloc_scratch(data_size)) {
+						 GROK_ERROR("Out of memory");
+						 success = false;
+						 delete job;
+						 return 0;
+					 }
 					 uint32_t j;
 					 for (j = job->min_j; j + HORIZ_STEP-1 < job->max_j; j += HORIZ_STEP) {
 						 decoder.interleave_partial_h(&job->data, sa, j,HORIZ_STEP);
@@ -2001,7 +1621,8 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 										  1,
 										  true)) {
 							 GROK_ERROR("sparse array write failure");
-							 job->data.release();
+							 success = false;
+							 delete job;
 							 return 0;
 						 }
 					 }
@@ -2017,18 +1638,19 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 										  1,
 										  true)) {
 							 GROK_ERROR("Sparse array write failure");
-							 job->data.release();
+							 success = false;
+							 delete job;
 							 return 0;
 						 }
 					  }
-					  job->data.release();
 					  delete job;
 					  return 0;
 					})
 				);
 			}
-			for(auto && result: results)
-				result.get();
+			ThreadPool::get()->wait(results);
+			if (!success)
+				return false;
 		   }
         }
 
@@ -2083,13 +1705,16 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 											nullptr,
 											win_tr_x0 + j * step_j,
 											j < (num_jobs - 1U) ? win_tr_x0 + (j + 1U) * step_j : win_tr_x1);
-				if (!job->data.alloc(data_size)) {
-					GROK_ERROR("Out of memory");
-					horiz.release();
-					return false;
-				}
 				results.emplace_back(
-					ThreadPool::get()->enqueue([job,sa, win_tr_y0, win_tr_y1, &decoder] {
+					ThreadPool::get()->enqueue([job,sa, win_tr_y0, win_tr_y1, data_size, &decoder, &success] {
+					 // working buffer from the arena of the thread running the job
+					 ScratchArena::Frame frame;
+					 if (!job->data.alloc_scratch(data_size)) {
+						 GROK_ERROR("Out of memory");
+						 success = false;
+						 delete job;
+						 return 0;
+					 }
 					 uint32_t j;
 					 for (j = job->min_j; j + VERT_STEP-1 < job->max_j; j += VERT_STEP) {
 						decoder.interleave_partial_v(&job->data, sa, j, VERT_STEP);
@@ -2103,7 +1728,8 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 									  VERT_STEP,
 									  true)) {
 							GROK_ERROR("Sparse array write failure");
-							job->data.release();
+							success = false;
+							delete job;
 							return 0;
 						}
 					 }
@@ -2119,19 +1745,20 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 												  VERT_STEP,
 												  true)) {
 							GROK_ERROR("Sparse array write failure");
-							job->data.release();
+							success = false;
+							delete job;
 							return 0;
 						}
 					}
 
-				  job->data.release();
 				  delete job;
 				  return 0;
 				})
 				);
 			}
-			for(auto && result: results)
-				result.get();
+			ThreadPool::get()->wait(results);
+			if (!success)
+				return false;
 		}
     }
 
@@ -2146,17 +1773,22 @@ template <typename T, uint32_t HORIZ_STEP, uint32_t VERT_STEP, uint32_t FILTER_W
 							   true);
 	assert(ret);
 	GRK_UNUSED(ret);
-    horiz.release();
 
     return true;
 }
 
 bool decode_97(TileProcessor *p_tcd,
                 TileComponent* GRK_RESTRICT tilec,
-                uint32_t numres){
+                uint32_t numres, const resolution_wait_fn &wait){
     if (p_tcd->whole_tile_decoding) {
-        return decode_tile_97(tilec, numres);
+        if (tilec->buf->coeff16)
+            return decode_tile_97_16(tilec, numres, wait);
+        if (p_tcd->m_cp && p_tcd->m_cp->m_coding_param.m_dec.m_blocked_dwt)
+            return decode_tile_blocked<Blocked97>(tilec, numres, wait);
+        return decode_tile_97(tilec, numres, wait);
     } else {
+        if (wait)
+            wait(numres - 1);
         return decode_partial_tile<v4_data,4,4,4, Partial97>(tilec, numres, tilec->m_sa);
     }
 }
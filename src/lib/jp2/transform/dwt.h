@@ -63,10 +63,12 @@ Apply a reversible inverse DWT transform to a component of an image.
 @param p_tcd TCD handle
 @param tilec Tile component information (current tile)
 @param numres Number of resolution levels to decompress
+@param wait optional wait for the code blocks of a resolution to be decoded
 */
 bool decode_53(TileProcessor *p_tcd,
                         TileComponent* GRK_RESTRICT tilec,
-                        uint32_t numres);
+                        uint32_t numres,
+                        const resolution_wait_fn &wait = nullptr);
 
 /**
 Inverse 9-7 wavelet transform in 2-D.
@@ -74,9 +76,11 @@ Apply an irreversible inverse DWT transform to a component of an image.
 @param p_tcd TCD handle
 @param tilec Tile component information (current tile)
 @param numres Number of resolution levels to decompress
+@param wait optional wait for the code blocks of a resolution to be decoded
 */
 bool decode_97(TileProcessor *p_tcd,
                              TileComponent* GRK_RESTRICT tilec,
-							 uint32_t numres);
+							 uint32_t numres,
+							 const resolution_wait_fn &wait = nullptr);
 
 }
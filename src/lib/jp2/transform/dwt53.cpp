@@ -103,6 +103,7 @@
 #include <atomic>
 #include "testing.h"
 #include "dwt53.h"
+#include "dwt_lift.h"
 
 namespace grk {
 
@@ -168,4 +169,41 @@ void dwt53::encode_line(int32_t *a, int32_t d_n, int32_t s_n, uint8_t cas) {
 	}
 }
 
+void dwt53::encode_v_buf(const int32_t *a, int32_t *tmp, uint32_t d_n,
+		uint32_t s_n, uint8_t cas, uint32_t stride, uint32_t cols) {
+	lift_gather_v(a, tmp, d_n, s_n, cas, stride, cols);
+	SIMDKernels::get()->encode_53_v(tmp, tmp + (size_t) s_n * PLL_COLS_FWD,
+			(int32_t) d_n, (int32_t) s_n, cas);
+}
+
+void dwt53::encode_v(int32_t *a, int32_t *tmp, uint32_t d_n, uint32_t s_n,
+		uint8_t cas, uint32_t stride, uint32_t cols) {
+	encode_v_buf(a, tmp, d_n, s_n, cas, stride, cols);
+	lift_scatter_v(tmp, a, d_n + s_n, stride, cols);
+}
+
+void dwt53::encode_h(int32_t *a, int32_t *tmp, uint32_t d_n, uint32_t s_n,
+		uint8_t cas) {
+	lift_split_h(a, tmp, d_n, s_n, cas);
+	SIMDKernels::get()->encode_53_h(tmp, tmp + s_n, (int32_t) d_n,
+			(int32_t) s_n, cas);
+	memcpy(a, tmp, (d_n + s_n) * sizeof(int32_t));
+}
+
+void dwt53_16::encode_v(int16_t *a, int16_t *tmp, uint32_t d_n, uint32_t s_n,
+		uint8_t cas, uint32_t stride, uint32_t cols) {
+	lift_gather_v<int16_t, PLL_COLS_16>(a, tmp, d_n, s_n, cas, stride, cols);
+	SIMDKernels::get()->encode_53_v16(tmp, tmp + (size_t) s_n * PLL_COLS_16,
+			(int32_t) d_n, (int32_t) s_n, cas);
+	lift_scatter_v<int16_t, PLL_COLS_16>(tmp, a, d_n + s_n, stride, cols);
+}
+
+void dwt53_16::encode_h(int16_t *a, int16_t *tmp, uint32_t d_n, uint32_t s_n,
+		uint8_t cas) {
+	lift_split_h(a, tmp, d_n, s_n, cas);
+	SIMDKernels::get()->encode_53_h16(tmp, tmp + s_n, (int32_t) d_n,
+			(int32_t) s_n, cas);
+	memcpy(a, tmp, (d_n + s_n) * sizeof(int16_t));
+}
+
 }
@@ -92,11 +92,48 @@ struct TileComponent;
 
 class dwt97 {
 public:
+	typedef int32_t sample_t;
+	/* columns per vertical transform */
+	static constexpr uint32_t pll_cols = PLL_COLS_FWD;
 
 	/**
 	 Forward 9-7 wavelet transform in 1-D
 	 */
 	void encode_line(int32_t* GRK_RESTRICT a, int32_t d_n, int32_t s_n, uint8_t cas);
 
+	/**
+	 Forward 9-7 wavelet transform in 1-D of up to PLL_COLS_FWD adjacent
+	 tile columns, followed by vertical deinterleave
+	 @param a 		top of first column
+	 @param tmp 	aligned buffer of (d_n + s_n) * PLL_COLS_FWD samples
+	 @param d_n 	number of high pass samples
+	 @param s_n 	number of low pass samples
+	 @param cas 	parity of first row
+	 @param stride 	tile stride
+	 @param cols 	number of columns
+	 */
+	void encode_v(int32_t *a, int32_t *tmp, uint32_t d_n, uint32_t s_n,
+			uint8_t cas, uint32_t stride, uint32_t cols);
+
+	/**
+	 Same as encode_v, but leave transformed columns in tmp:
+	 PLL_COLS_FWD samples per row, s_n low pass rows followed
+	 by d_n high pass rows. Tile is not modified.
+	 */
+	void encode_v_buf(const int32_t *a, int32_t *tmp, uint32_t d_n,
+			uint32_t s_n, uint8_t cas, uint32_t stride, uint32_t cols);
+
+	/**
+	 Forward 9-7 wavelet transform in 1-D of one tile row,
+	 followed by horizontal deinterleave
+	 @param a 		row
+	 @param tmp 	aligned buffer of d_n + s_n samples
+	 @param d_n 	number of high pass samples
+	 @param s_n 	number of low pass samples
+	 @param cas 	parity of first column
+	 */
+	void encode_h(int32_t *a, int32_t *tmp, uint32_t d_n, uint32_t s_n,
+			uint8_t cas);
+
 };
 }
@@ -0,0 +1,119 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "dwt_utils.h"
+
+/*
+ Buffer layout for lifting on deinterleaved data
+ (see dwt_lift_kernels.h and dwt_lift16_kernels.h).
+
+ Samples are split into a low pass array L of s_n samples followed by a
+ high pass array H of d_n samples. Horizontal lifting works on one row,
+ while vertical lifting works on PLL_COLS_FWD columns at a time: each
+ element of L and H is then a row of PLL_COLS_FWD samples (PLL_COLS_16 for
+ 16 bit samples), so the tile is read and written one cache line at a time.
+ */
+
+namespace grk {
+
+/**
+ Copy cols columns of tile into aligned buffer of COLS columns,
+ low pass rows followed by high pass rows
+ */
+template<typename T, uint32_t COLS = PLL_COLS_FWD> static inline void lift_gather_v(
+		const T *a, T *tmp, uint32_t d_n, uint32_t s_n, uint8_t cas,
+		uint32_t stride, uint32_t cols) {
+	uint32_t rh = d_n + s_n;
+	for (uint32_t k = 0; k < rh; ++k) {
+		uint32_t row = ((k & 1) == cas) ? (k >> 1) : s_n + (k >> 1);
+		auto dest = tmp + (size_t) row * COLS;
+		memcpy(dest, a + (size_t) k * stride, cols * sizeof(T));
+		if (cols < COLS)
+			memset(dest + cols, 0, (COLS - cols) * sizeof(T));
+	}
+}
+
+/**
+ Copy transformed columns back to tile
+ */
+template<typename T, uint32_t COLS = PLL_COLS_FWD> static inline void lift_scatter_v(
+		const T *tmp, T *a, uint32_t rh, uint32_t stride, uint32_t cols) {
+	for (uint32_t k = 0; k < rh; ++k)
+		memcpy(a + (size_t) k * stride, tmp + (size_t) k * COLS,
+				cols * sizeof(T));
+}
+
+/**
+ Split row into low pass samples followed by high pass samples
+ */
+template<typename T> static inline void lift_split_h(const T *a, T *tmp,
+		uint32_t d_n, uint32_t s_n, uint8_t cas) {
+	auto src = a + cas;
+	for (uint32_t i = 0; i < s_n; ++i)
+		tmp[i] = src[i << 1];
+	src = a + 1 - cas;
+	for (uint32_t i = 0; i < d_n; ++i)
+		tmp[s_n + i] = src[i << 1];
+}
+
+/**
+ Inverse of lift_split_h: interleave low and high pass samples into row
+ */
+template<typename T> static inline void lift_merge_h(const T *tmp, T *a,
+		uint32_t d_n, uint32_t s_n, uint8_t cas) {
+	auto dest = a + cas;
+	for (uint32_t i = 0; i < s_n; ++i)
+		dest[i << 1] = tmp[i];
+	dest = a + 1 - cas;
+	for (uint32_t i = 0; i < d_n; ++i)
+		dest[i << 1] = tmp[s_n + i];
+}
+
+/**
+ Copy cols columns of deinterleaved tile into aligned buffer of COLS columns,
+ for inverse lifting
+ */
+template<typename T, uint32_t COLS> static inline void lift_load_v(const T *a,
+		T *tmp, uint32_t rh, uint32_t stride, uint32_t cols) {
+	for (uint32_t k = 0; k < rh; ++k) {
+		auto dest = tmp + (size_t) k * COLS;
+		memcpy(dest, a + (size_t) k * stride, cols * sizeof(T));
+		if (cols < COLS)
+			memset(dest + cols, 0, (COLS - cols) * sizeof(T));
+	}
+}
+
+/**
+ Inverse of lift_gather_v: copy low pass and high pass rows
+ of buffer back to tile, interleaved
+ */
+template<typename T, uint32_t COLS> static inline void lift_interleave_v(
+		const T *tmp, T *a, uint32_t d_n, uint32_t s_n, uint8_t cas,
+		uint32_t stride, uint32_t cols) {
+	uint32_t rh = d_n + s_n;
+	for (uint32_t k = 0; k < rh; ++k) {
+		uint32_t row = ((k & 1) == cas) ? (k >> 1) : s_n + (k >> 1);
+		memcpy(a + (size_t) k * stride, tmp + (size_t) row * COLS,
+				cols * sizeof(T));
+	}
+}
+
+}
@@ -0,0 +1,482 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ Forward and inverse 5-3 lifting kernels for 16 bit reversible
+ coefficients, and inverse 9-7 lifting kernels for 16 bit fixed point
+ coefficients (see TileBuffer::coeff16), with the same layout and the same
+ symmetric extension as the 32 bit kernels in dwt_lift_kernels.h.
+ Compiled once per instruction set: only include from SIMDKernelsImpl.h.
+
+ AVX2 transforms 16 samples per register, SSE2 8 samples. There is no
+ AVX-512 version: 16 bit lanes need AVX-512BW, so the AVX-512 kernels
+ use AVX2 here.
+
+ Sums of two coefficients may not fit in 16 bits, so they are never formed:
+
+ (a + b) >> 1 == (a & b) + ((a ^ b) >> 1)
+ (a + b + 2) >> 2 == avg - (avg >> 1), with avg = (a + b) >> 1
+
+ Each lifting step then adds or subtracts with saturation. Coefficients
+ that fit in 16 bits at every level of the transform give the same results
+ as the 32 bit transform; others are clamped instead of wrapping around.
+
+ The inverse 9-7 kernels work on fixed point samples, and follow the
+ float transform in dwt.cpp step by step. Lifting constants are stored in
+ Q15, minus one if they are larger than one, and each product is rounded
+ to nearest, like _mm256_mulhrs_epi16. SSE2 has no such instruction,
+ so it is built from the low and high halves of the products.
+ */
+
+namespace grk {
+namespace GRK_KERNEL_NS {
+
+static_assert(PLL_COLS_16 * sizeof(int16_t) == 64,
+		"vertical lifting works on one cache line per row");
+
+#if !defined(GRK_KERNEL_SCALAR) && defined(__AVX2__)
+#define GRK_KERNEL_V16
+typedef __m256i v16;
+const uint32_t v16_lanes = 16;
+static inline v16 v16_loadu(const int16_t *p) {
+	return _mm256_loadu_si256((const __m256i*) p);
+}
+static inline v16 v16_load(const int16_t *p) {
+	return _mm256_load_si256((const __m256i*) p);
+}
+static inline void v16_storeu(int16_t *p, v16 v) {
+	_mm256_storeu_si256((__m256i*) p, v);
+}
+static inline void v16_store(int16_t *p, v16 v) {
+	_mm256_store_si256((__m256i*) p, v);
+}
+static inline v16 v16_avg(v16 a, v16 b) {
+	return _mm256_add_epi16(_mm256_and_si256(a, b),
+			_mm256_srai_epi16(_mm256_xor_si256(a, b), 1));
+}
+static inline v16 v16_half_up(v16 a) {
+	return _mm256_sub_epi16(a, _mm256_srai_epi16(a, 1));
+}
+static inline v16 v16_adds(v16 a, v16 b) {
+	return _mm256_adds_epi16(a, b);
+}
+static inline v16 v16_subs(v16 a, v16 b) {
+	return _mm256_subs_epi16(a, b);
+}
+static inline v16 v16_set1(int16_t c) {
+	return _mm256_set1_epi16(c);
+}
+static inline v16 v16_mulhrs(v16 a, v16 c) {
+	return _mm256_mulhrs_epi16(a, c);
+}
+#elif !defined(GRK_KERNEL_SCALAR) && defined(__SSE2__)
+#define GRK_KERNEL_V16
+typedef __m128i v16;
+const uint32_t v16_lanes = 8;
+static inline v16 v16_loadu(const int16_t *p) {
+	return _mm_loadu_si128((const __m128i*) p);
+}
+static inline v16 v16_load(const int16_t *p) {
+	return _mm_load_si128((const __m128i*) p);
+}
+static inline void v16_storeu(int16_t *p, v16 v) {
+	_mm_storeu_si128((__m128i*) p, v);
+}
+static inline void v16_store(int16_t *p, v16 v) {
+	_mm_store_si128((__m128i*) p, v);
+}
+static inline v16 v16_avg(v16 a, v16 b) {
+	return _mm_add_epi16(_mm_and_si128(a, b),
+			_mm_srai_epi16(_mm_xor_si128(a, b), 1));
+}
+static inline v16 v16_half_up(v16 a) {
+	return _mm_sub_epi16(a, _mm_srai_epi16(a, 1));
+}
+static inline v16 v16_adds(v16 a, v16 b) {
+	return _mm_adds_epi16(a, b);
+}
+static inline v16 v16_subs(v16 a, v16 b) {
+	return _mm_subs_epi16(a, b);
+}
+static inline v16 v16_set1(int16_t c) {
+	return _mm_set1_epi16(c);
+}
+static inline v16 v16_mulhrs(v16 a, v16 c) {
+	__m128i hi = _mm_mulhi_epi16(a, c);
+	__m128i lo = _mm_mullo_epi16(a, c);
+	// bits 15 to 30 of the product, plus bit 14 for rounding
+	__m128i t = _mm_or_si128(_mm_slli_epi16(hi, 1), _mm_srli_epi16(lo, 15));
+	return _mm_add_epi16(t,
+			_mm_and_si128(_mm_srli_epi16(lo, 14), _mm_set1_epi16(1)));
+}
+#endif
+
+static inline int16_t sat16(int32_t v) {
+	return (int16_t) (v < -32768 ? -32768 : (v > 32767 ? 32767 : v));
+}
+
+/**
+ Horizontal lifting step on a deinterleaved row of 16 bit samples:
+
+ dst[i] = op(dst[i], src[i + off], src[i + off + 1])
+ */
+struct lift16_h {
+	static constexpr uint32_t cols = 1;
+	template<typename OP> static void step(int16_t *dst, int32_t dst_n,
+			const int16_t *src, int32_t src_n, int32_t off, OP op) {
+		int32_t i = 0;
+		int32_t start = -off < dst_n ? -off : dst_n;
+		for (; i < start; ++i)
+			dst[i] = op(dst[i], src[lift_clamp(i + off, src_n)],
+					src[lift_clamp(i + off + 1, src_n)]);
+		int32_t end = src_n - 1 - off < dst_n ? src_n - 1 - off : dst_n;
+		if (end < start)
+			end = start;
+#ifdef GRK_KERNEL_V16
+		for (; i + (int32_t) v16_lanes <= end; i += v16_lanes)
+			v16_storeu(dst + i,
+					op(v16_loadu(dst + i), v16_loadu(src + i + off),
+							v16_loadu(src + i + off + 1)));
+#endif
+		for (; i < end; ++i)
+			dst[i] = op(dst[i], src[i + off], src[i + off + 1]);
+		for (; i < dst_n; ++i)
+			dst[i] = op(dst[i], src[lift_clamp(i + off, src_n)],
+					src[lift_clamp(i + off + 1, src_n)]);
+	}
+};
+
+/**
+ Vertical lifting step on PLL_COLS_16 deinterleaved columns
+ */
+struct lift16_v {
+	static constexpr uint32_t cols = PLL_COLS_16;
+	template<typename OP> static void step(int16_t *dst, int32_t dst_n,
+			const int16_t *src, int32_t src_n, int32_t off, OP op) {
+		for (int32_t i = 0; i < dst_n; ++i) {
+			auto d = dst + (size_t) i * PLL_COLS_16;
+			auto s0 = src + (size_t) lift_clamp(i + off, src_n) * PLL_COLS_16;
+			auto s1 = src
+					+ (size_t) lift_clamp(i + off + 1, src_n) * PLL_COLS_16;
+#ifdef GRK_KERNEL_V16
+			for (uint32_t c = 0; c < PLL_COLS_16; c += v16_lanes)
+				v16_store(d + c,
+						op(v16_load(d + c), v16_load(s0 + c), v16_load(s1 + c)));
+#else
+			for (uint32_t c = 0; c < PLL_COLS_16; ++c)
+				d[c] = op(d[c], s0[c], s1[c]);
+#endif
+		}
+	}
+};
+
+/** d - ((s0 + s1) >> 1) */
+struct predict16 {
+	int16_t operator()(int16_t d, int16_t s0, int16_t s1) const {
+		return sat16(d - ((s0 + s1) >> 1));
+	}
+#ifdef GRK_KERNEL_V16
+	v16 operator()(v16 d, v16 s0, v16 s1) const {
+		return v16_subs(d, v16_avg(s0, s1));
+	}
+#endif
+};
+
+/** s + ((d0 + d1 + 2) >> 2) */
+struct update16 {
+	int16_t operator()(int16_t s, int16_t d0, int16_t d1) const {
+		return sat16(s + ((d0 + d1 + 2) >> 2));
+	}
+#ifdef GRK_KERNEL_V16
+	v16 operator()(v16 s, v16 d0, v16 d1) const {
+		return v16_adds(s, v16_half_up(v16_avg(d0, d1)));
+	}
+#endif
+};
+
+/** inverse of predict16: d + ((s0 + s1) >> 1) */
+struct unpredict16 {
+	int16_t operator()(int16_t d, int16_t s0, int16_t s1) const {
+		return sat16(d + ((s0 + s1) >> 1));
+	}
+#ifdef GRK_KERNEL_V16
+	v16 operator()(v16 d, v16 s0, v16 s1) const {
+		return v16_adds(d, v16_avg(s0, s1));
+	}
+#endif
+};
+
+/** inverse of update16: s - ((d0 + d1 + 2) >> 2) */
+struct unupdate16 {
+	int16_t operator()(int16_t s, int16_t d0, int16_t d1) const {
+		return sat16(s - ((d0 + d1 + 2) >> 2));
+	}
+#ifdef GRK_KERNEL_V16
+	v16 operator()(v16 s, v16 d0, v16 d1) const {
+		return v16_subs(s, v16_half_up(v16_avg(d0, d1)));
+	}
+#endif
+};
+
+/**
+ Forward 5-3 lifting of 16 bit samples: same as encode_53
+ */
+template<typename LIFT> static void encode_53_16(int16_t *l, int16_t *h,
+		int32_t d_n, int32_t s_n, uint8_t cas) {
+	if (!cas) {
+		if ((d_n > 0) || (s_n > 1)) {
+			LIFT::step(h, d_n, l, s_n, 0, predict16());
+			LIFT::step(l, s_n, h, d_n, -1, update16());
+		}
+	} else {
+		if (!s_n && d_n == 1) {
+			for (uint32_t c = 0; c < LIFT::cols; ++c)
+				h[c] = sat16(h[c] * 2);
+		} else {
+			LIFT::step(h, d_n, l, s_n, -1, predict16());
+			LIFT::step(l, s_n, h, d_n, 0, update16());
+		}
+	}
+}
+
+/**
+ Inverse 5-3 lifting of 16 bit samples: undoes encode_53_16,
+ and matches the 32 bit inverse transform
+ */
+template<typename LIFT> static void decode_53_16(int16_t *l, int16_t *h,
+		int32_t d_n, int32_t s_n, uint8_t cas) {
+	if (!cas) {
+		if ((d_n > 0) || (s_n > 1)) {
+			LIFT::step(l, s_n, h, d_n, -1, unupdate16());
+			LIFT::step(h, d_n, l, s_n, 0, unpredict16());
+		}
+	} else {
+		if (!s_n && d_n == 1) {
+			for (uint32_t c = 0; c < LIFT::cols; ++c)
+				h[c] = (int16_t) (h[c] / 2);
+		} else {
+			LIFT::step(l, s_n, h, d_n, 0, unupdate16());
+			LIFT::step(h, d_n, l, s_n, -1, unpredict16());
+		}
+	}
+}
+
+/* 9-7 lifting constants, as in dwt.cpp */
+const int16_t fix16_97_alpha = 19206; /* 1.586134342 - 1 */
+const int16_t fix16_97_beta = 1736; /* 0.052980118 */
+const int16_t fix16_97_gamma = -28931; /* -0.882911075 */
+const int16_t fix16_97_delta = -14533; /* -0.443506852 */
+const int16_t fix16_97_K = 7542; /* 1.230174105 - 1 */
+const int16_t fix16_97_c13318 = 20504; /* 1.625732422 - 1 */
+
+/** a * c, with c in Q15, rounded to nearest */
+static inline int16_t mulhrs16(int16_t a, int16_t c) {
+	return (int16_t) (((int32_t) a * c + 0x4000) >> 15);
+}
+
+/**
+ d + c * (s0 + s1), with c in Q15, or d + (1 + c) * (s0 + s1) if ONE
+ */
+template<int16_t C, bool ONE> struct lift97_16 {
+	int16_t operator()(int16_t d, int16_t s0, int16_t s1) const {
+		int32_t v = d;
+		if (ONE)
+			v = sat16(sat16(v + s0) + s1);
+		return sat16(sat16(v + mulhrs16(s0, C)) + mulhrs16(s1, C));
+	}
+#ifdef GRK_KERNEL_V16
+	v16 operator()(v16 d, v16 s0, v16 s1) const {
+		const v16 c = v16_set1(C);
+		if (ONE)
+			d = v16_adds(v16_adds(d, s0), s1);
+		return v16_adds(v16_adds(d, v16_mulhrs(s0, c)), v16_mulhrs(s1, c));
+	}
+#endif
+};
+
+/** multiply n samples by 1 + c, with c in Q15 */
+template<int16_t C> static void scale97_16(int16_t *p, uint64_t n) {
+	uint64_t i = 0;
+#ifdef GRK_KERNEL_V16
+	const v16 c = v16_set1(C);
+	for (; i + v16_lanes <= n; i += v16_lanes) {
+		v16 v = v16_loadu(p + i);
+		v16_storeu(p + i, v16_adds(v, v16_mulhrs(v, c)));
+	}
+#endif
+	for (; i < n; ++i)
+		p[i] = sat16(p[i] + mulhrs16(p[i], C));
+}
+
+/**
+ Inverse 9-7 lifting of 16 bit fixed point samples: same steps as
+ decode_step_97, on deinterleaved samples
+ */
+template<typename LIFT> static void decode_97_16(int16_t *l, int16_t *h,
+		int32_t d_n, int32_t s_n, uint8_t cas) {
+	int32_t off_l, off_h;
+	if (!cas) {
+		if (!((d_n > 0) || (s_n > 1)))
+			return;
+		off_l = -1;
+		off_h = 0;
+	} else {
+		if (!((s_n > 0) || (d_n > 1)))
+			return;
+		off_l = 0;
+		off_h = -1;
+	}
+	scale97_16<fix16_97_K>(l, (uint64_t) s_n * LIFT::cols);
+	scale97_16<fix16_97_c13318>(h, (uint64_t) d_n * LIFT::cols);
+	LIFT::step(l, s_n, h, d_n, off_l, lift97_16<fix16_97_delta, false>());
+	LIFT::step(h, d_n, l, s_n, off_h, lift97_16<fix16_97_gamma, false>());
+	LIFT::step(l, s_n, h, d_n, off_l, lift97_16<fix16_97_beta, false>());
+	LIFT::step(h, d_n, l, s_n, off_h, lift97_16<fix16_97_alpha, true>());
+}
+
+static void narrow16(const int32_t *src, int16_t *dest, uint64_t n) {
+	uint64_t i = 0;
+#if !defined(GRK_KERNEL_SCALAR) && defined(__AVX2__)
+	for (; i + 16 <= n; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i*) (src + i));
+		__m256i b = _mm256_loadu_si256((const __m256i*) (src + i + 8));
+		// packs works within 128 bit lanes
+		_mm256_storeu_si256((__m256i*) (dest + i),
+				_mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+	}
+#elif !defined(GRK_KERNEL_SCALAR) && defined(__SSE2__)
+	for (; i + 8 <= n; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i b = _mm_loadu_si128((const __m128i*) (src + i + 4));
+		_mm_storeu_si128((__m128i*) (dest + i), _mm_packs_epi32(a, b));
+	}
+#endif
+	for (; i < n; ++i)
+		dest[i] = sat16(src[i]);
+}
+
+/* samples are widened from last to first, so that dest may alias src */
+static void widen16(const int16_t *src, int32_t *dest, uint64_t n) {
+	uint64_t i = n;
+#if !defined(GRK_KERNEL_SCALAR) && defined(__AVX2__)
+	for (; i & 15; --i)
+		dest[i - 1] = src[i - 1];
+	while (i) {
+		i -= 16;
+		__m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+		_mm256_storeu_si256((__m256i*) (dest + i + 8),
+				_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)));
+		_mm256_storeu_si256((__m256i*) (dest + i),
+				_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+	}
+#elif !defined(GRK_KERNEL_SCALAR) && defined(__SSE2__)
+	for (; i & 7; --i)
+		dest[i - 1] = src[i - 1];
+	while (i) {
+		i -= 8;
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		// sign extend by shifting each sample down from the upper half
+		_mm_storeu_si128((__m128i*) (dest + i + 4),
+				_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+		_mm_storeu_si128((__m128i*) (dest + i),
+				_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+	}
+#endif
+	for (; i; --i)
+		dest[i - 1] = src[i - 1];
+}
+
+static inline int16_t fix16(float v) {
+	v = v < -32768.0f ? -32768.0f : (v > 32767.0f ? 32767.0f : v);
+	return (int16_t) lrintf(v);
+}
+
+/* samples are converted from first to last, so that dest may alias src */
+static void narrow_fix16(const float *src, int16_t *dest, uint64_t n,
+		float scale) {
+	uint64_t i = 0;
+#if !defined(GRK_KERNEL_SCALAR) && defined(__AVX2__)
+	const __m256 s = _mm256_set1_ps(scale);
+	const __m256 lo = _mm256_set1_ps(-32768.0f);
+	const __m256 hi = _mm256_set1_ps(32767.0f);
+	for (; i + 16 <= n; i += 16) {
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i), s);
+		__m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), s);
+		a = _mm256_min_ps(_mm256_max_ps(a, lo), hi);
+		b = _mm256_min_ps(_mm256_max_ps(b, lo), hi);
+		_mm256_storeu_si256((__m256i*) (dest + i),
+				_mm256_permute4x64_epi64(
+						_mm256_packs_epi32(_mm256_cvtps_epi32(a),
+								_mm256_cvtps_epi32(b)), 0xD8));
+	}
+#elif !defined(GRK_KERNEL_SCALAR) && defined(__SSE2__)
+	const __m128 s = _mm_set1_ps(scale);
+	const __m128 lo = _mm_set1_ps(-32768.0f);
+	const __m128 hi = _mm_set1_ps(32767.0f);
+	for (; i + 8 <= n; i += 8) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), s);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), s);
+		a = _mm_min_ps(_mm_max_ps(a, lo), hi);
+		b = _mm_min_ps(_mm_max_ps(b, lo), hi);
+		_mm_storeu_si128((__m128i*) (dest + i),
+				_mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+	}
+#endif
+	for (; i < n; ++i)
+		dest[i] = fix16(src[i] * scale);
+}
+
+/* samples are converted from last to first, so that dest may alias src */
+static void widen_fix16(const int16_t *src, float *dest, uint64_t n,
+		float scale) {
+	uint64_t i = n;
+#if !defined(GRK_KERNEL_SCALAR) && defined(__AVX2__)
+	const __m256 s = _mm256_set1_ps(scale);
+	for (; i & 15; --i)
+		dest[i - 1] = (float) src[i - 1] * scale;
+	while (i) {
+		i -= 16;
+		__m256i v = _mm256_loadu_si256((const __m256i*) (src + i));
+		_mm256_storeu_ps(dest + i + 8,
+				_mm256_mul_ps(_mm256_cvtepi32_ps(
+						_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1))), s));
+		_mm256_storeu_ps(dest + i,
+				_mm256_mul_ps(_mm256_cvtepi32_ps(
+						_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v))), s));
+	}
+#elif !defined(GRK_KERNEL_SCALAR) && defined(__SSE2__)
+	const __m128 s = _mm_set1_ps(scale);
+	for (; i & 7; --i)
+		dest[i - 1] = (float) src[i - 1] * scale;
+	while (i) {
+		i -= 8;
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		_mm_storeu_ps(dest + i + 4,
+				_mm_mul_ps(_mm_cvtepi32_ps(
+						_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)), s));
+		_mm_storeu_ps(dest + i,
+				_mm_mul_ps(_mm_cvtepi32_ps(
+						_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)), s));
+	}
+#endif
+	for (; i; --i)
+		dest[i - 1] = (float) src[i - 1] * scale;
+}
+
+}
+}
@@ -0,0 +1,370 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ Forward and inverse 5-3 and 9-7 lifting kernels, on deinterleaved data
+ laid out as described in dwt_lift.h. Compiled once per instruction set:
+ only include from SIMDKernelsImpl.h.
+
+ Each lifting step has the form
+
+ dst[i] = op(dst[i], src[i + off] + src[i + off + 1])
+
+ with off equal to 0 or -1, and source indices clamped to the source array
+ (symmetric extension). Away from the array boundaries, this is a straight
+ vector loop. Vertical lifting vectorizes across the PLL_COLS_FWD columns
+ of each row. Samples are 32 bit integers, or floats for the inverse 9-7
+ transform, which has as many lanes per register.
+ */
+
+namespace grk {
+namespace GRK_KERNEL_NS {
+
+#ifdef GRK_KERNEL_VREG
+static_assert(PLL_COLS_FWD % VREG_INT_COUNT == 0,
+		"vertical lifting works on whole vector registers");
+#endif
+
+static inline int32_t lift_clamp(int32_t i, int32_t n) {
+	return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+#ifdef GRK_KERNEL_VREG
+/* vector access to integer or float samples */
+static inline VREG lift_load(const int32_t *p) {
+	return LOAD(p);
+}
+static inline VREGF lift_load(const float *p) {
+	return LOADF(p);
+}
+static inline VREG lift_loadu(const int32_t *p) {
+	return LOADU(p);
+}
+static inline VREGF lift_loadu(const float *p) {
+	return LOADUF(p);
+}
+static inline void lift_store(int32_t *p, VREG v) {
+	STORE(p, v);
+}
+static inline void lift_store(float *p, VREGF v) {
+	STOREF(p, v);
+}
+static inline void lift_storeu(int32_t *p, VREG v) {
+	STOREU(p, v);
+}
+static inline void lift_storeu(float *p, VREGF v) {
+	STOREUF(p, v);
+}
+static inline VREG lift_add(VREG a, VREG b) {
+	return ADD(a, b);
+}
+static inline VREGF lift_add(VREGF a, VREGF b) {
+	return ADDF(a, b);
+}
+#endif
+
+/**
+ Horizontal lifting step on a deinterleaved row
+ */
+struct lift_h {
+	/** samples per array element */
+	static const uint32_t cols = 1;
+	template<typename T, typename OP> static void step(T *dst, int32_t dst_n,
+			const T *src, int32_t src_n, int32_t off, OP op) {
+		int32_t i = 0;
+		// first samples may need clamping on the left
+		int32_t start = -off < dst_n ? -off : dst_n;
+		for (; i < start; ++i)
+			dst[i] = op(dst[i],
+					src[lift_clamp(i + off, src_n)]
+							+ src[lift_clamp(i + off + 1, src_n)]);
+		// no clamping needed below end
+		int32_t end = src_n - 1 - off < dst_n ? src_n - 1 - off : dst_n;
+		if (end < start)
+			end = start;
+#ifdef GRK_KERNEL_VREG
+		for (; i + (int32_t) VREG_INT_COUNT <= end; i += VREG_INT_COUNT)
+			lift_storeu(dst + i,
+					op(lift_loadu(dst + i),
+							lift_add(lift_loadu(src + i + off),
+									lift_loadu(src + i + off + 1))));
+#endif
+		for (; i < end; ++i)
+			dst[i] = op(dst[i], src[i + off] + src[i + off + 1]);
+		for (; i < dst_n; ++i)
+			dst[i] = op(dst[i],
+					src[lift_clamp(i + off, src_n)]
+							+ src[lift_clamp(i + off + 1, src_n)]);
+	}
+	template<typename T, typename OP> static void scale(T *dst, int32_t dst_n,
+			OP op) {
+		int32_t i = 0;
+#ifdef GRK_KERNEL_VREG
+		for (; i + (int32_t) VREG_INT_COUNT <= dst_n; i += VREG_INT_COUNT)
+			lift_storeu(dst + i, op(lift_loadu(dst + i)));
+#endif
+		for (; i < dst_n; ++i)
+			dst[i] = op(dst[i]);
+	}
+};
+
+/**
+ Vertical lifting step on PLL_COLS_FWD deinterleaved columns
+ */
+struct lift_v {
+	/** samples per array element */
+	static const uint32_t cols = PLL_COLS_FWD;
+	template<typename T, typename OP> static void step(T *dst, int32_t dst_n,
+			const T *src, int32_t src_n, int32_t off, OP op) {
+		for (int32_t i = 0; i < dst_n; ++i) {
+			auto d = dst + (size_t) i * PLL_COLS_FWD;
+			auto s0 = src + (size_t) lift_clamp(i + off, src_n) * PLL_COLS_FWD;
+			auto s1 = src
+					+ (size_t) lift_clamp(i + off + 1, src_n) * PLL_COLS_FWD;
+#ifdef GRK_KERNEL_VREG
+			for (uint32_t c = 0; c < PLL_COLS_FWD; c += VREG_INT_COUNT)
+				lift_store(d + c,
+						op(lift_load(d + c),
+								lift_add(lift_load(s0 + c), lift_load(s1 + c))));
+#else
+			for (uint32_t c = 0; c < PLL_COLS_FWD; ++c)
+				d[c] = op(d[c], s0[c] + s1[c]);
+#endif
+		}
+	}
+	template<typename T, typename OP> static void scale(T *dst, int32_t dst_n,
+			OP op) {
+		auto end = dst + (size_t) dst_n * PLL_COLS_FWD;
+#ifdef GRK_KERNEL_VREG
+		for (; dst < end; dst += VREG_INT_COUNT)
+			lift_store(dst, op(lift_load(dst)));
+#else
+		for (; dst < end; ++dst)
+			*dst = op(*dst);
+#endif
+	}
+};
+
+struct predict_53 {
+	int32_t operator()(int32_t d, int32_t sum) const {
+		return d - (sum >> 1);
+	}
+#ifdef GRK_KERNEL_VREG
+	VREG operator()(VREG d, VREG sum) const {
+		return SUB(d, SAR(sum, 1));
+	}
+#endif
+};
+
+struct update_53 {
+	int32_t operator()(int32_t s, int32_t sum) const {
+		return s + ((sum + 2) >> 2);
+	}
+#ifdef GRK_KERNEL_VREG
+	VREG operator()(VREG s, VREG sum) const {
+		return ADD(s, SAR(ADD(sum, LOAD_CST(2)), 2));
+	}
+#endif
+};
+
+struct double_53 {
+	int32_t operator()(int32_t s) const {
+		return s << 1;
+	}
+#ifdef GRK_KERNEL_VREG
+	VREG operator()(VREG s) const {
+		return ADD(s, s);
+	}
+#endif
+};
+
+/**
+ Forward 5-3 lifting on deinterleaved low pass samples l
+ and high pass samples h. Equivalent to dwt53::encode_line.
+ */
+template<typename LIFT> static void encode_53(int32_t *l, int32_t *h,
+		int32_t d_n, int32_t s_n, uint8_t cas) {
+	if (!cas) {
+		if ((d_n > 0) || (s_n > 1)) {
+			LIFT::step(h, d_n, l, s_n, 0, predict_53());
+			LIFT::step(l, s_n, h, d_n, -1, update_53());
+		}
+	} else {
+		if (!s_n && d_n == 1) {
+			LIFT::scale(h, 1, double_53());
+		} else {
+			LIFT::step(h, d_n, l, s_n, -1, predict_53());
+			LIFT::step(l, s_n, h, d_n, 0, update_53());
+		}
+	}
+}
+
+struct unpredict_53 {
+	int32_t operator()(int32_t d, int32_t sum) const {
+		return d + (sum >> 1);
+	}
+#ifdef GRK_KERNEL_VREG
+	VREG operator()(VREG d, VREG sum) const {
+		return ADD(d, SAR(sum, 1));
+	}
+#endif
+};
+
+struct unupdate_53 {
+	int32_t operator()(int32_t s, int32_t sum) const {
+		return s - ((sum + 2) >> 2);
+	}
+#ifdef GRK_KERNEL_VREG
+	VREG operator()(VREG s, VREG sum) const {
+		return SUB(s, SAR(ADD(sum, LOAD_CST(2)), 2));
+	}
+#endif
+};
+
+/**
+ Inverse 5-3 lifting: undoes encode_53, and leaves the samples
+ deinterleaved.
+ */
+template<typename LIFT> static void decode_53(int32_t *l, int32_t *h,
+		int32_t d_n, int32_t s_n, uint8_t cas) {
+	if (!cas) {
+		if ((d_n > 0) || (s_n > 1)) {
+			LIFT::step(l, s_n, h, d_n, -1, unupdate_53());
+			LIFT::step(h, d_n, l, s_n, 0, unpredict_53());
+		}
+	} else {
+		if (!s_n && d_n == 1) {
+			for (uint32_t c = 0; c < LIFT::cols; ++c)
+				h[c] /= 2;
+		} else {
+			LIFT::step(l, s_n, h, d_n, 0, unupdate_53());
+			LIFT::step(h, d_n, l, s_n, -1, unpredict_53());
+		}
+	}
+}
+
+/**
+ Lifting step dst +/-= C * sum
+ */
+template<int32_t C, bool SUBTRACT> struct lift_97 {
+	int32_t operator()(int32_t d, int32_t sum) const {
+		return SUBTRACT ? d - fix_mul(sum, C) : d + fix_mul(sum, C);
+	}
+#ifdef GRK_KERNEL_VREG
+	VREG operator()(VREG d, VREG sum) const {
+		return SUBTRACT ? SUB(d, fix_mul_v<C>(sum)) : ADD(d, fix_mul_v<C>(sum));
+	}
+#endif
+};
+
+/**
+ Scaling step dst = C * dst
+ */
+template<int32_t C> struct scale_97 {
+	int32_t operator()(int32_t d) const {
+		return fix_mul(d, C);
+	}
+#ifdef GRK_KERNEL_VREG
+	VREG operator()(VREG d) const {
+		return fix_mul_v<C>(d);
+	}
+#endif
+};
+
+/**
+ Forward 9-7 lifting on deinterleaved low pass samples l
+ and high pass samples h. Equivalent to dwt97::encode_line.
+ */
+template<typename LIFT> static void encode_97(int32_t *l, int32_t *h,
+		int32_t d_n, int32_t s_n, uint8_t cas) {
+	if (!cas) {
+		if ((d_n <= 0) && (s_n <= 1))
+			return;
+	} else {
+		if ((s_n <= 0) && (d_n <= 1))
+			return;
+	}
+	int32_t off_h = cas ? -1 : 0;
+	int32_t off_l = cas ? 0 : -1;
+	LIFT::step(h, d_n, l, s_n, off_h, lift_97<12994, true>());
+	LIFT::step(l, s_n, h, d_n, off_l, lift_97<434, true>());
+	LIFT::step(h, d_n, l, s_n, off_h, lift_97<7233, false>());
+	LIFT::step(l, s_n, h, d_n, off_l, lift_97<3633, false>());
+	LIFT::scale(h, d_n, scale_97<5039>());
+	LIFT::scale(l, s_n, scale_97<6659>());
+}
+
+/**
+ Inverse lifting step dst += c * sum, on floats
+ */
+struct unlift_97 {
+	explicit unlift_97(float c) : c(c) {
+	}
+	float operator()(float d, float sum) const {
+		return d + sum * c;
+	}
+#ifdef GRK_KERNEL_VREG
+	VREGF operator()(VREGF d, VREGF sum) const {
+		return ADDF(d, MULF(sum, LOAD_CST_F(c)));
+	}
+#endif
+	float c;
+};
+
+/**
+ Scaling step dst = c * dst, on floats
+ */
+struct unscale_97 {
+	explicit unscale_97(float c) : c(c) {
+	}
+	float operator()(float d) const {
+		return d * c;
+	}
+#ifdef GRK_KERNEL_VREG
+	VREGF operator()(VREGF d) const {
+		return MULF(d, LOAD_CST_F(c));
+	}
+#endif
+	float c;
+};
+
+/**
+ Inverse 9-7 lifting on float samples: undoes the forward transform,
+ and leaves the samples deinterleaved. Equivalent to decode_step_97.
+ */
+template<typename LIFT> static void decode_97(float *l, float *h, int32_t d_n,
+		int32_t s_n, uint8_t cas) {
+	if (!cas) {
+		if (!((d_n > 0) || (s_n > 1)))
+			return;
+	} else {
+		if (!((s_n > 0) || (d_n > 1)))
+			return;
+	}
+	int32_t off_h = cas ? -1 : 0;
+	int32_t off_l = cas ? 0 : -1;
+	LIFT::scale(l, s_n, unscale_97(1.230174105f));
+	LIFT::scale(h, d_n, unscale_97(1.625732422f));
+	LIFT::step(l, s_n, h, d_n, off_l, unlift_97(-0.443506852f));
+	LIFT::step(h, d_n, l, s_n, off_h, unlift_97(-0.882911075f));
+	LIFT::step(l, s_n, h, d_n, off_l, unlift_97(0.052980118f));
+	LIFT::step(h, d_n, l, s_n, off_h, unlift_97(1.586134342f));
+}
+
+}
+}
@@ -126,6 +126,38 @@ void dwt_utils::deinterleave_h(int32_t *a, int32_t *b, uint32_t d_n, uint32_t s_
 	}
 }
 
+/*
+ Bound the 5-3 coefficients by the l1 norms of the lifting filters, per level:
+ a vertical then a horizontal pass take a bound b of the LL band to 1.5b + 1
+ for low pass samples, and 2b + 1 for high pass samples. The inverse
+ transform goes back through exactly the same values.
+ */
+bool dwt_utils::fits_int16_53(uint32_t bits, uint32_t numres) {
+	if (bits == 0 || bits > 15)
+		return false;
+	// one spare value, so that rounding in 16 bit lifting cannot overflow
+	const uint64_t limit = INT16_MAX - 1;
+	uint64_t ll = (uint64_t) 1 << (bits - 1);
+	uint64_t max = ll;
+	for (uint32_t level = 1; level < numres; ++level) {
+		uint64_t l = (3 * ll + 1) / 2 + 1;
+		uint64_t h = 2 * ll + 1;
+		// HH band is the largest
+		max = std::max<uint64_t>(max, 2 * h + 1);
+		ll = (3 * l + 1) / 2 + 1;
+		if (max > limit)
+			return false;
+	}
+
+	return max <= limit;
+}
+
+uint32_t dwt_utils::fix16_97_frac_bits(uint32_t prec) {
+	assert(prec <= 13);
+	// sign bit, prec - 1 magnitude bits and 3 bits of headroom
+	return 13 - prec;
+}
+
 /* <summary>                */
 /* Get norm of 5-3 wavelet. */
 /* </summary>               */
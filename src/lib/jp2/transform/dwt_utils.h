@@ -55,6 +55,8 @@
 
 #pragma once
 
+#include "SIMDKernels.h"
+
 namespace grk {
 
 struct TileComponent;
@@ -85,6 +87,27 @@ public:
 	static double getnorm_97(uint32_t level, uint8_t orient);
 
 
+	/**
+	 Check whether all reversible 5-3 coefficients of a tile component,
+	 at every level of the transform, fit in 16 bits
+	 @param bits	number of bits of the signed samples before the transform
+	 @param numres	number of resolutions
+	 @return true if 16 bit coefficients can be used
+	 */
+	static bool fits_int16_53(uint32_t bits, uint32_t numres);
+
+	/**
+	 Number of fractional bits of 16 bit fixed point 9-7 coefficients.
+	 Values up to 8 times the largest sample magnitude fit, while coefficients
+	 and intermediate values of the inverse transform of a valid image stay
+	 below 6.8 times. Once samples are scaled down to 8 bits, rounding
+	 errors keep them within one of the float transform, with a root mean
+	 square error below 0.2.
+	 @param prec	sample precision, at most 13
+	 @return number of fractional bits
+	 */
+	static uint32_t fix16_97_frac_bits(uint32_t prec);
+
 	static uint32_t max_resolution(grk_tcd_resolution* GRK_RESTRICT r, uint32_t i);
 	static void deinterleave_v(int32_t *a, int32_t *b, uint32_t d_n, uint32_t s_n,
 			uint32_t stride, int32_t cas);
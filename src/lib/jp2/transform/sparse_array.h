@@ -137,6 +137,62 @@ public:
 							  uint32_t src_line_stride,
 							  bool forgiving);
 
+	/** Write the content of a rectangular region into the sparse array from a
+	 * user buffer, passing each contiguous run of samples through a transform
+	 * on its way into the destination block.
+	 *
+	 * Blocks intersecting the region are allocated, if not already done.
+	 *
+	 * @param x0 left x coordinate of the region to write into the sparse array.
+	 * @param y0 top x coordinate of the region to write into the sparse array.
+	 * @param x1 right x coordinate (not included) of the region to write into the sparse array. Must be greater than x0.
+	 * @param y1 bottom y coordinate (not included) of the region to write into the sparse array. Must be greater than y0.
+	 * @param src user buffer, with unit column stride.
+	 * @param src_line_stride spacing (in elements, not in bytes) in y dimension between consecutive lines of the user buffer.
+	 * @param transform callable as transform(const int32_t* src, int32_t* dest, uint32_t len)
+	 * @param forgiving if set to TRUE and the region is invalid, true will still be returned.
+	 * @return true in case of success.
+	 */
+	template<typename T> bool write_transformed(uint32_t x0,
+							  uint32_t y0,
+							  uint32_t x1,
+							  uint32_t y1,
+							  const int32_t* src,
+							  uint32_t src_line_stride,
+							  const T &transform,
+							  bool forgiving){
+	    if (!is_region_valid(x0, y0, x1, y1))
+	        return forgiving;
+	    if (!alloc(x0, y0, x1, y1))
+	        return false;
+
+	    uint32_t y_incr = 0;
+	    uint32_t block_y = y0 / block_height;
+	    for (uint32_t y = y0; y < y1; block_y ++, y += y_incr) {
+	        y_incr = (y == y0) ? block_height - (y0 % block_height) :
+	                 block_height;
+	        uint32_t block_y_offset = block_height - y_incr;
+	        y_incr = std::min<uint32_t>(y_incr, y1 - y);
+	        uint32_t x_incr = 0;
+	        uint32_t block_x = x0 / block_width;
+	        for (uint32_t x = x0; x < x1; block_x ++, x += x_incr) {
+	            x_incr = (x == x0) ? block_width - (x0 % block_width) : block_width;
+	            uint32_t block_x_offset = block_width - x_incr;
+	            x_incr = std::min<uint32_t>(x_incr, x1 - x);
+	            auto block = data_blocks[(uint64_t)block_y * block_count_hor + block_x];
+	            auto dest_ptr = block + (uint64_t)block_y_offset * block_width + block_x_offset;
+	            auto src_ptr = src + (y - y0) * (size_t)src_line_stride + (x - x0);
+	            for (uint32_t j = 0; j < y_incr; j++) {
+	                transform(src_ptr, dest_ptr, x_incr);
+	                dest_ptr += block_width;
+	                src_ptr  += src_line_stride;
+	            }
+	        }
+	    }
+
+	    return true;
+	}
+
 	/** Allocate all blocks for a rectangular region into the sparse array from a
 	 * user buffer.
 	 *
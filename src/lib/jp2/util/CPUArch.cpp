@@ -255,12 +255,29 @@ const InstructionSet::InstructionSet_Internal InstructionSet::CPU_Rep;
 namespace grk {
 
 
+/* GCC and clang: run time check, which includes OS support for vector state */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GRK_CPU_SUPPORTS(x) __builtin_cpu_supports(x)
+#endif
+
+bool CPUArch::AVX512F(){
+#ifdef WIN32
+	// OS must save ZMM state as well as YMM state
+	return InstructionSet::AVX512F() && InstructionSet::OSXSAVE()
+			&& (_xgetbv(0) & 0xE6) == 0xE6;
+#elif defined(GRK_CPU_SUPPORTS)
+	return GRK_CPU_SUPPORTS("avx512f");
+#endif
+	return false;
+}
 bool CPUArch::AVX2(){
 #ifdef __AVX2__
 	return true;
 #else
 #ifdef WIN32
 	return InstructionSet::AVX2();
+#elif defined(GRK_CPU_SUPPORTS)
+	return GRK_CPU_SUPPORTS("avx2");
 #endif
 #endif
 	return false;
@@ -307,5 +324,17 @@ bool CPUArch::BMI2(){
 #endif
 	return false;
 }
+bool CPUArch::SSE2(){
+#ifdef __SSE2__
+	return true;
+#else
+#ifdef WIN32
+	return InstructionSet::SSE2();
+#elif defined(GRK_CPU_SUPPORTS)
+	return GRK_CPU_SUPPORTS("sse2");
+#endif
+#endif
+	return false;
+}
 
 }
@@ -36,12 +36,14 @@ namespace grk {
 
 class CPUArch {
 public:
+	bool AVX512F();
 	bool AVX2();
 	bool AVX();
 	bool SSE4_1();
 	bool SSE3();
 	bool BMI1();
 	bool BMI2();
+	bool SSE2();
 
 };
 
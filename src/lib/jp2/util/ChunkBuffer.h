@@ -20,6 +20,12 @@
 #pragma once
 namespace grk {
 
+/*
+ Number of readable bytes guaranteed past the end of each tile data chunk,
+ so that block decoders can read code block data in place
+ */
+#define GRK_CHUNK_PAD_BYTES 8
+
 /*  ChunkBuffer
 
  Store a list of buffers, or chunks, which can be treated as one single
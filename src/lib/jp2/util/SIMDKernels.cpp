@@ -0,0 +1,115 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "CPUArch.h"
+#include "SIMDKernels.h"
+
+namespace grk {
+
+static const char *level_names[SIMD_NUM_LEVELS] = { "scalar", "sse2", "avx2",
+		"avx512" };
+
+const char* SIMDKernels::name(SIMDLevel level) {
+	return level < SIMD_NUM_LEVELS ? level_names[level] : "unknown";
+}
+
+static bool cpu_supports(SIMDLevel level) {
+	CPUArch arch;
+	switch (level) {
+	case SIMD_SCALAR:
+		return true;
+	case SIMD_SSE2:
+		return arch.SSE2();
+	case SIMD_AVX2:
+		return arch.AVX2();
+	case SIMD_AVX512:
+		return arch.AVX512F();
+	default:
+		return false;
+	}
+}
+
+bool SIMDKernels::select(SIMDKernels *kernels, SIMDLevel level) {
+	if (!cpu_supports(level))
+		return false;
+	bool rc = false;
+	switch (level) {
+	case SIMD_SCALAR:
+		rc = simd_scalar::fill_kernels(kernels);
+		break;
+	case SIMD_SSE2:
+		rc = simd_sse2::fill_kernels(kernels);
+		break;
+	case SIMD_AVX2:
+		rc = simd_avx2::fill_kernels(kernels);
+		break;
+	case SIMD_AVX512:
+		rc = simd_avx512::fill_kernels(kernels);
+		break;
+	default:
+		break;
+	}
+	if (rc)
+		kernels->level = level;
+
+	return rc;
+}
+
+SIMDLevel SIMDKernels::detect(void) {
+	SIMDKernels kernels;
+	for (int level = SIMD_NUM_LEVELS - 1; level > SIMD_SCALAR; --level) {
+		if (select(&kernels, (SIMDLevel) level))
+			return (SIMDLevel) level;
+	}
+
+	return SIMD_SCALAR;
+}
+
+/**
+ Best level, capped by the GRK_SIMD environment variable
+ */
+static SIMDKernels select_kernels(void) {
+	SIMDLevel level = SIMDKernels::detect();
+	auto forced = getenv("GRK_SIMD");
+	if (forced && *forced) {
+		int i = 0;
+		for (; i < SIMD_NUM_LEVELS; ++i) {
+			if (!strcmp(forced, level_names[i]))
+				break;
+		}
+		if (i == SIMD_NUM_LEVELS) {
+			GROK_WARN("Ignoring unknown GRK_SIMD level %s", forced);
+		} else if (i > level) {
+			GROK_WARN("GRK_SIMD level %s is not supported: using %s", forced,
+					level_names[level]);
+		} else {
+			level = (SIMDLevel) i;
+		}
+	}
+	SIMDKernels kernels;
+	SIMDKernels::select(&kernels, level);
+
+	return kernels;
+}
+
+const SIMDKernels* SIMDKernels::get(void) {
+	static const SIMDKernels kernels = select_kernels();
+
+	return &kernels;
+}
+
+}
@@ -0,0 +1,219 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/*
+ Runtime dispatch of SIMD kernels.
+
+ The kernel bodies in dwt_lift_kernels.h, dwt_lift16_kernels.h, mct_kernels.h,
+ dequantize_kernels.h, quantize_kernels.h, ht_encode_kernels.h and
+ ht_decode_kernels.h are compiled once per instruction set, in
+ SIMDKernels_scalar.cpp, SIMDKernels_sse2.cpp, SIMDKernels_avx2.cpp and
+ SIMDKernels_avx512.cpp, each with its own compiler flags and namespace.
+ The first call to SIMDKernels::get(), made by grk_initialize, picks the
+ best level supported by the CPU, unless the GRK_SIMD environment variable
+ (scalar, sse2, avx2 or avx512) forces a lower one.
+
+ All levels give bit identical results.
+ */
+
+namespace grk {
+
+/** Number of columns transformed together in the vertical transform:
+ one cache line of 32 bit samples, for every kernel level */
+const uint32_t PLL_COLS_FWD = 16;
+/** Same for 16 bit samples: one cache line, or two AVX2 registers */
+const uint32_t PLL_COLS_16 = 32;
+
+enum SIMDLevel {
+	SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512, SIMD_NUM_LEVELS
+};
+
+/** Multi component transform of n samples, in place */
+typedef void (*mct_kernel)(int32_t *c0, int32_t *c1, int32_t *c2, uint64_t n);
+typedef void (*mct_float_kernel)(float *c0, float *c1, float *c2, uint64_t n);
+
+/** Dequantization of len code block samples: shift is only used by HT */
+typedef void (*dequantize_kernel)(const int32_t *src, int32_t *dest,
+		uint32_t len, uint32_t roishift, uint32_t shift, float stepsize);
+
+/**
+ Quantization of len HT code block samples to sign-magnitude: returns the
+ largest magnitude. Reversible samples are shifted left by shift, and
+ irreversible samples are multiplied by inv_step and scale
+ */
+typedef uint32_t (*quantize_kernel)(const int32_t *src, int32_t *dest,
+		uint32_t len, uint32_t shift, float inv_step, float scale);
+
+/**
+ Forward or inverse lifting on s_n deinterleaved low pass samples l and d_n
+ high pass samples h. Horizontal kernels work on one row, vertical kernels
+ on rows of PLL_COLS_FWD columns, in a buffer aligned to 64 bytes.
+ Inverse kernels leave the samples deinterleaved.
+ */
+typedef void (*lift_kernel)(int32_t *l, int32_t *h, int32_t d_n, int32_t s_n,
+		uint8_t cas);
+/** Same as lift_kernel, for the inverse 9-7 transform of float samples */
+typedef void (*lift_float_kernel)(float *l, float *h, int32_t d_n,
+		int32_t s_n, uint8_t cas);
+
+/**
+ Same as lift_kernel, for 16 bit reversible samples, or 16 bit fixed point
+ irreversible samples. Inverse kernels undo the forward kernels, and leave
+ the samples deinterleaved. Vertical kernels work on rows of PLL_COLS_16
+ columns.
+ */
+typedef void (*lift16_kernel)(int16_t *l, int16_t *h, int32_t d_n,
+		int32_t s_n, uint8_t cas);
+
+/** Saturating conversion of n samples to 16 bits: dest may alias src */
+typedef void (*narrow16_kernel)(const int32_t *src, int16_t *dest, uint64_t n);
+/** Conversion of n samples to 32 bits: dest may alias src */
+typedef void (*widen16_kernel)(const int16_t *src, int32_t *dest, uint64_t n);
+/**
+ Conversion of n float samples to 16 bit fixed point: each sample is
+ multiplied by scale, rounded to nearest and saturated. dest may alias src
+ */
+typedef void (*narrow_fix16_kernel)(const float *src, int16_t *dest,
+		uint64_t n, float scale);
+/** Conversion of n fixed point samples to float: dest may alias src */
+typedef void (*widen_fix16_kernel)(const int16_t *src, float *dest,
+		uint64_t n, float scale);
+
+/**
+ Significance, exponents and MagSgn values of a quad pair of the HT block
+ encoder. Samples 0 to 3 belong to the first quad and 4 to 7 to the second;
+ even samples are in the top row and odd samples in the bottom row.
+ */
+struct HTQuadPair {
+	/* significance of the samples of each quad */
+	int32_t rho[2];
+	/* maximum exponent of each quad */
+	int32_t e_qmax[2];
+	/* exponent of each sample, 0 if not significant */
+	int32_t e_q[8];
+	/* bit i is set if e_q[i] is the maximum exponent of its quad */
+	int32_t eps;
+	/* v_n = 2(\mu_p-1) + s_n, 0 if not significant */
+	uint32_t s[8];
+};
+
+/**
+ Preparation of the (width + 3) / 4 quad pairs of a stripe of an HT code
+ block, from the sign-magnitude samples of one or two rows starting at sp.
+ Magnitudes are taken from bit p + 1 upwards
+ */
+typedef void (*ht_prepare_quads_kernel)(const int32_t *sp, uint32_t stride,
+		uint32_t width, bool two_rows, uint32_t p, HTQuadPair *qp);
+
+/**
+ MagSgn codewords of a quad pair of the HT block encoder. A significant
+ sample of quad q takes U_q[q] low bits of its v_n, less one if bit k of
+ e_k[q] is set for sample k of the quad: len receives the number of bits
+ of each codeword, 0 for insignificant samples
+ */
+typedef void (*ht_magsgn_kernel)(const HTQuadPair *qp, const int32_t *U_q,
+		const uint32_t *e_k, uint32_t *cwd, int32_t *len);
+
+/**
+ MagSgn decoding of the 8 samples of a quad pair of the HT block decoder,
+ numbered as in HTQuadPair. qinf holds the VLC information of both quads,
+ and U_p their exponent bounds. The MagSgn bits of the quad pair start at
+ bit ms_pos of the unstuffed words in ms_buf, followed by at least 64
+ readable bits. Samples whose bit is set in locs are written to sp, with
+ their most significant bit plane at p, and v_n receives the 8 magnitudes
+ */
+typedef void (*ht_decode_magsgn_kernel)(const uint32_t *ms_buf,
+		uint32_t ms_pos, const uint32_t *qinf, const int32_t *U_p, int32_t p,
+		uint32_t locs, int32_t *sp, uint32_t stride, uint32_t *v_n);
+
+struct SIMDKernels {
+	SIMDLevel level;
+
+	mct_kernel rct_encode;
+	mct_kernel rct_decode;
+	mct_kernel ict_encode;
+	mct_float_kernel ict_decode;
+
+	/** indexed by [reversible][ROI] */
+	dequantize_kernel dequantize_part1[2][2];
+	dequantize_kernel dequantize_ht[2][2];
+	/** indexed by [reversible] */
+	quantize_kernel quantize_ht[2];
+
+	lift_kernel encode_53_h;
+	lift_kernel encode_53_v;
+	lift_kernel encode_97_h;
+	lift_kernel encode_97_v;
+	lift_kernel decode_53_h;
+	lift_kernel decode_53_v;
+	lift_float_kernel decode_97_h;
+	lift_float_kernel decode_97_v;
+
+	lift16_kernel encode_53_h16;
+	lift16_kernel encode_53_v16;
+	lift16_kernel decode_53_h16;
+	lift16_kernel decode_53_v16;
+	narrow16_kernel narrow16;
+	widen16_kernel widen16;
+	ht_prepare_quads_kernel ht_prepare_quads;
+	ht_magsgn_kernel ht_magsgn_codewords;
+	/** null if samples are decoded one at a time */
+	ht_decode_magsgn_kernel ht_decode_magsgn;
+
+	lift16_kernel decode_97_h16;
+	lift16_kernel decode_97_v16;
+	narrow_fix16_kernel narrow_fix16;
+	widen_fix16_kernel widen_fix16;
+
+	/**
+	 Kernels for this CPU, selected on first call
+	 */
+	static const SIMDKernels* get(void);
+
+	/**
+	 Highest level supported by both build and CPU
+	 */
+	static SIMDLevel detect(void);
+
+	/**
+	 Fill kernels for level
+
+	 @return false if level is not supported by build or CPU
+	 */
+	static bool select(SIMDKernels *kernels, SIMDLevel level);
+
+	static const char* name(SIMDLevel level);
+};
+
+/* one per kernel translation unit: false if instruction set was not compiled */
+namespace simd_scalar {
+bool fill_kernels(SIMDKernels *kernels);
+}
+namespace simd_sse2 {
+bool fill_kernels(SIMDKernels *kernels);
+}
+namespace simd_avx2 {
+bool fill_kernels(SIMDKernels *kernels);
+}
+namespace simd_avx512 {
+bool fill_kernels(SIMDKernels *kernels);
+}
+
+}
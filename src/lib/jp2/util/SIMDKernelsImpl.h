@@ -0,0 +1,155 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ Kernels for one instruction set. Each SIMDKernels_*.cpp file defines
+ GRK_KERNEL_NS, and optionally GRK_KERNEL_SCALAR or GRK_SIMD_AVX512,
+ before including this file, and is compiled with the matching flags.
+
+ Since the same code is compiled with different instruction sets, nothing
+ here may have external linkage outside of GRK_KERNEL_NS: in particular,
+ grok_includes.h and standard library templates are not used, as the
+ linker could otherwise pick an instantiation built for a newer
+ instruction set than the CPU supports.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "simd.h"
+#include "vint.h"
+#include "SIMDKernels.h"
+
+#if !defined(GRK_KERNEL_SCALAR) && (defined(__SSE2__) || defined(__AVX2__))
+#define GRK_KERNEL_VREG
+#endif
+#if !defined(GRK_KERNEL_SCALAR) && (defined(GRK_SIMD_AVX512) || defined(__AVX2__) || defined(__SSE4_1__))
+#define GRK_KERNEL_VINT
+#endif
+
+namespace grk {
+namespace GRK_KERNEL_NS {
+
+/**
+ Same as int_fix_mul: multiply by 13 bit fixed point constant, with rounding
+ */
+static inline int32_t fix_mul(int32_t a, int32_t b) {
+	return (int32_t) (((int64_t) a * b + 4096) >> 13);
+}
+
+#ifdef GRK_KERNEL_VREG
+/**
+ Vector version of fix_mul, with identical rounding
+ */
+template<int32_t C> static inline VREG fix_mul_v(VREG a) {
+#if defined(GRK_SIMD_AVX512)
+	const VREG c = _mm512_set1_epi32(C);
+	const VREG round = _mm512_set1_epi64(4096);
+	// 64 bit products of even and odd lanes
+	VREG even = _mm512_add_epi64(_mm512_mul_epi32(a, c), round);
+	VREG odd = _mm512_add_epi64(
+			_mm512_mul_epi32(_mm512_srli_epi64(a, 32), c), round);
+	// bits 13 to 44 of each product
+	return _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 13),
+			_mm512_slli_epi64(odd, 19));
+#elif defined(__AVX2__)
+	const VREG c = _mm256_set1_epi32(C);
+	const VREG round = _mm256_set1_epi64x(4096);
+	VREG even = _mm256_add_epi64(_mm256_mul_epi32(a, c), round);
+	VREG odd = _mm256_add_epi64(
+			_mm256_mul_epi32(_mm256_srli_epi64(a, 32), c), round);
+	return _mm256_blend_epi32(_mm256_srli_epi64(even, 13),
+			_mm256_slli_epi64(odd, 19), 0xAA);
+#elif defined(__SSE4_1__)
+	const VREG c = _mm_set1_epi32(C);
+	const VREG round = _mm_set1_epi64x(4096);
+	VREG even = _mm_add_epi64(_mm_mul_epi32(a, c), round);
+	VREG odd = _mm_add_epi64(_mm_mul_epi32(_mm_srli_epi64(a, 32), c), round);
+	return _mm_blend_epi16(_mm_srli_epi64(even, 13), _mm_slli_epi64(odd, 19),
+			0xCC);
+#else
+	// no signed 32 bit multiply in SSE2
+	int32_t v[VREG_INT_COUNT];
+	STOREU(v, a);
+	for (uint32_t i = 0; i < VREG_INT_COUNT; ++i)
+		v[i] = fix_mul(v[i], C);
+	return LOADU(v);
+#endif
+}
+#endif
+
+}
+}
+
+#include "mct_kernels.h"
+#include "dequantize_kernels.h"
+#include "quantize_kernels.h"
+#include "dwt_lift_kernels.h"
+#include "dwt_lift16_kernels.h"
+#include "ht_encode_kernels.h"
+#include "ht_decode_kernels.h"
+
+namespace grk {
+namespace GRK_KERNEL_NS {
+
+bool fill_kernels(SIMDKernels *kernels) {
+	kernels->rct_encode = rct_encode;
+	kernels->rct_decode = rct_decode;
+	kernels->ict_encode = ict_encode;
+	kernels->ict_decode = ict_decode;
+	kernels->dequantize_part1[0][0] = dequantize_part1<false, false>;
+	kernels->dequantize_part1[0][1] = dequantize_part1<false, true>;
+	kernels->dequantize_part1[1][0] = dequantize_part1<true, false>;
+	kernels->dequantize_part1[1][1] = dequantize_part1<true, true>;
+	kernels->dequantize_ht[0][0] = dequantize_ht<false, false>;
+	kernels->dequantize_ht[0][1] = dequantize_ht<false, true>;
+	kernels->dequantize_ht[1][0] = dequantize_ht<true, false>;
+	kernels->dequantize_ht[1][1] = dequantize_ht<true, true>;
+	kernels->quantize_ht[0] = quantize_ht<false>;
+	kernels->quantize_ht[1] = quantize_ht<true>;
+	kernels->encode_53_h = encode_53<lift_h>;
+	kernels->encode_53_v = encode_53<lift_v>;
+	kernels->encode_97_h = encode_97<lift_h>;
+	kernels->encode_97_v = encode_97<lift_v>;
+	kernels->decode_53_h = decode_53<lift_h>;
+	kernels->decode_53_v = decode_53<lift_v>;
+	kernels->decode_97_h = decode_97<lift_h>;
+	kernels->decode_97_v = decode_97<lift_v>;
+	kernels->encode_53_h16 = encode_53_16<lift16_h>;
+	kernels->encode_53_v16 = encode_53_16<lift16_v>;
+	kernels->decode_53_h16 = decode_53_16<lift16_h>;
+	kernels->decode_53_v16 = decode_53_16<lift16_v>;
+	kernels->narrow16 = narrow16;
+	kernels->widen16 = widen16;
+	kernels->decode_97_h16 = decode_97_16<lift16_h>;
+	kernels->decode_97_v16 = decode_97_16<lift16_v>;
+	kernels->narrow_fix16 = narrow_fix16;
+	kernels->widen_fix16 = widen_fix16;
+	kernels->ht_prepare_quads = ht_prepare_quads;
+	kernels->ht_magsgn_codewords = ht_magsgn_codewords;
+#ifdef GRK_HT_DECODE_MAGSGN
+	kernels->ht_decode_magsgn = ht_decode_magsgn;
+#else
+	kernels->ht_decode_magsgn = nullptr;
+#endif
+
+	return true;
+}
+
+}
+}
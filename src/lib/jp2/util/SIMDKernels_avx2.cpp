@@ -0,0 +1,38 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ AVX2 kernels: compiled with -mavx2, or /arch:AVX2 for MSVC.
+ */
+
+#if defined(__AVX2__)
+#define GRK_KERNEL_NS simd_avx2
+#include "SIMDKernelsImpl.h"
+#else
+#include "SIMDKernels.h"
+
+namespace grk {
+namespace simd_avx2 {
+
+bool fill_kernels(SIMDKernels *kernels) {
+	(void) kernels;
+	return false;
+}
+
+}
+}
+#endif
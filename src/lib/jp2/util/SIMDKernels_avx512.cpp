@@ -0,0 +1,45 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ AVX-512 kernels: compiled with -mavx512f, or /arch:AVX512 for MSVC.
+ Contraction into fused multiply-add is disabled, so that the inverse ICT
+ gives the same results as the other levels.
+ */
+
+#if defined(__AVX512F__)
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC 12 flags the undefined vectors used inside AVX-512 intrinsics
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#define GRK_SIMD_AVX512
+#define GRK_KERNEL_NS simd_avx512
+#include "SIMDKernelsImpl.h"
+#else
+#include "SIMDKernels.h"
+
+namespace grk {
+namespace simd_avx512 {
+
+bool fill_kernels(SIMDKernels *kernels) {
+	(void) kernels;
+	return false;
+}
+
+}
+}
+#endif
@@ -0,0 +1,39 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ SSE2 kernels: compiled with -mno-sse3, so that they only use SSE2
+ even when the rest of the library is built for AVX2.
+ */
+
+#if defined(__SSE2__)
+#define GRK_KERNEL_NS simd_sse2
+#include "SIMDKernelsImpl.h"
+#else
+#include "SIMDKernels.h"
+
+namespace grk {
+namespace simd_sse2 {
+
+bool fill_kernels(SIMDKernels *kernels) {
+	(void) kernels;
+	return false;
+}
+
+}
+}
+#endif
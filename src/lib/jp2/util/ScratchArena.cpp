@@ -0,0 +1,189 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "grok_includes.h"
+#include <atomic>
+#include <set>
+
+namespace grk {
+
+/* all allocations are rounded up to a cache line */
+const size_t scratch_align = 64;
+/* smallest chunk: avoids a string of small chunks while an arena warms up */
+const size_t scratch_min_chunk = 64 * 1024;
+
+static std::atomic<uint64_t> scratch_held(0);
+static std::atomic<uint64_t> scratch_peak_held(0);
+
+struct ScratchRegistry {
+	std::mutex mutex;
+	std::set<ScratchArena*> arenas;
+};
+
+// never destroyed, as pool workers may outlive static destructors
+static ScratchRegistry* scratch_registry(void) {
+	static auto registry = new ScratchRegistry();
+	return registry;
+}
+
+ScratchArena* ScratchArena::local(void) {
+	static thread_local ScratchArena arena;
+	return &arena;
+}
+
+ScratchArena::ScratchArena() :
+		m_current(0), m_in_use(0), m_capacity(0), m_high_water(0), m_depth(0),
+		m_active(false) {
+	auto registry = scratch_registry();
+	std::unique_lock<std::mutex> lock(registry->mutex);
+	registry->arenas.insert(this);
+}
+
+ScratchArena::~ScratchArena() {
+	{
+		auto registry = scratch_registry();
+		std::unique_lock<std::mutex> lock(registry->mutex);
+		registry->arenas.erase(this);
+	}
+	free_chunks();
+}
+
+bool ScratchArena::add_chunk(size_t size) {
+	auto data = (uint8_t*) grk_aligned_malloc(size);
+	if (!data)
+		return false;
+	chunks.push_back( { data, size, 0 });
+	m_capacity += size;
+	uint64_t held = (scratch_held += size);
+	uint64_t peak = scratch_peak_held;
+	while (held > peak && !scratch_peak_held.compare_exchange_weak(peak, held))
+		;
+
+	return true;
+}
+
+void ScratchArena::free_chunks(void) {
+	for (auto &c : chunks)
+		grk_aligned_free(c.data);
+	chunks.clear();
+	scratch_held -= m_capacity;
+	m_capacity = 0;
+	m_current = 0;
+	m_in_use = 0;
+}
+
+void* ScratchArena::alloc(size_t len) {
+	assert(m_depth);
+	if (len > SIZE_MAX - scratch_align)
+		return nullptr;
+	len = ((len ? len : 1) + scratch_align - 1) & ~(scratch_align - 1);
+	// chunks after the current one are empty
+	while (m_current < chunks.size()) {
+		auto &c = chunks[m_current];
+		if (c.size - c.used >= len)
+			break;
+		if (m_current + 1 == chunks.size()) {
+			// grow: at least double the capacity, so that
+			// the number of chunks stays logarithmic
+			if (!add_chunk(std::max<size_t>(len,
+					std::max<size_t>(m_capacity, scratch_min_chunk))))
+				return nullptr;
+		}
+		++m_current;
+	}
+	if (chunks.empty()) {
+		if (!add_chunk(std::max<size_t>(len, scratch_min_chunk)))
+			return nullptr;
+		m_current = 0;
+	}
+	auto &c = chunks[m_current];
+	auto p = c.data + c.used;
+	c.used += len;
+	m_in_use += len;
+	if (m_in_use > m_high_water)
+		m_high_water = m_in_use;
+
+	return p;
+}
+
+void ScratchArena::open(void) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_active = true;
+}
+
+void ScratchArena::close(size_t chunk, size_t used, size_t in_use) {
+	for (size_t i = chunk + 1; i < chunks.size(); ++i)
+		chunks[i].used = 0;
+	if (chunk < chunks.size())
+		chunks[chunk].used = used;
+	m_current = chunk;
+	m_in_use = in_use;
+	if (m_depth)
+		return;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	// merge the chunks of a growing arena, so that
+	// the next frames are served from one contiguous block
+	if (chunks.size() > 1) {
+		size_t size = m_capacity;
+		free_chunks();
+		add_chunk(size);
+	}
+	m_active = false;
+}
+
+size_t ScratchArena::trim(void) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_active)
+		return 0;
+	size_t freed = m_capacity;
+	free_chunks();
+
+	return freed;
+}
+
+size_t ScratchArena::trim_all(void) {
+	auto registry = scratch_registry();
+	std::unique_lock<std::mutex> lock(registry->mutex);
+	size_t freed = 0;
+	for (auto arena : registry->arenas)
+		freed += arena->trim();
+
+	return freed;
+}
+
+uint64_t ScratchArena::held(void) {
+	return scratch_held;
+}
+
+uint64_t ScratchArena::peak_held(void) {
+	return scratch_peak_held;
+}
+
+ScratchArena::Frame::Frame() :
+		arena(ScratchArena::local()) {
+	if (arena->m_depth++ == 0)
+		arena->open();
+	chunk = arena->m_current;
+	used = arena->chunks.empty() ? 0 : arena->chunks[chunk].used;
+	in_use = arena->m_in_use;
+}
+
+ScratchArena::Frame::~Frame() {
+	arena->m_depth--;
+	arena->close(chunk, used, in_use);
+}
+
+}
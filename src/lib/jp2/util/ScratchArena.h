@@ -0,0 +1,132 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace grk {
+
+/*
+ Per-thread scratch memory for wavelet and T1 working buffers.
+
+ Each thread, in particular each pool worker, owns one arena, created on
+ first use. Buffers are bump allocated inside a Frame, and all buffers
+ allocated since the Frame was opened are released when it closes.
+ Frames nest: a wavelet task that waits on code blocks may run T1 decodes
+ on the same thread, each in its own inner Frame.
+
+ Memory is not returned to the system when frames close: the arena grows
+ to the largest working set seen on its thread, and is then reused for
+ every tile, so that steady state decoding does not allocate.
+ ScratchArena::trim_all (grk_trim_scratch) frees the memory of idle arenas.
+ */
+class ScratchArena {
+public:
+	/**
+	 Arena of the calling thread
+	 */
+	static ScratchArena* local(void);
+
+	/**
+	 Allocate len bytes, aligned to 64 bytes, in the innermost open Frame
+
+	 @return nullptr if out of memory
+	 */
+	void* alloc(size_t len);
+	template<typename T> T* alloc(size_t count) {
+		if (count > SIZE_MAX / sizeof(T))
+			return nullptr;
+		return (T*) alloc(count * sizeof(T));
+	}
+
+	/** bytes reserved by this arena */
+	size_t capacity(void) const {
+		return m_capacity;
+	}
+	/** largest number of bytes in use at once */
+	size_t high_water(void) const {
+		return m_high_water;
+	}
+
+	/**
+	 Free the memory of this arena, if no Frame is open
+
+	 @return number of bytes freed
+	 */
+	size_t trim(void);
+
+	/**
+	 Free the memory of all idle arenas, on all threads
+
+	 @return number of bytes freed
+	 */
+	static size_t trim_all(void);
+
+	/** bytes currently reserved by all arenas */
+	static uint64_t held(void);
+	/** largest number of bytes reserved by all arenas at once */
+	static uint64_t peak_held(void);
+
+	/**
+	 Scope of scratch allocations on the calling thread
+	 */
+	class Frame {
+	public:
+		Frame();
+		~Frame();
+		Frame(const Frame&) = delete;
+		Frame& operator=(const Frame&) = delete;
+	private:
+		ScratchArena *arena;
+		size_t chunk;
+		size_t used;
+		size_t in_use;
+	};
+
+	ScratchArena();
+	~ScratchArena();
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+private:
+	struct Chunk {
+		uint8_t *data;
+		size_t size;
+		size_t used;
+	};
+	void open(void);
+	void close(size_t chunk, size_t used, size_t in_use);
+	void free_chunks(void);
+	bool add_chunk(size_t size);
+
+	std::vector<Chunk> chunks;
+	// chunk being filled: all later chunks are empty
+	size_t m_current;
+	size_t m_in_use;
+	size_t m_capacity;
+	size_t m_high_water;
+	// number of open frames, only touched by the owning thread
+	uint32_t m_depth;
+	// guards chunks against trim_all while no frame is open
+	std::mutex m_mutex;
+	bool m_active;
+};
+
+}
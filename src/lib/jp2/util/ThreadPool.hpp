@@ -19,7 +19,8 @@
 #pragma once
 
 #include <vector>
-#include <queue>
+#include <deque>
+#include <algorithm>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -27,24 +28,168 @@
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <atomic>
 #include <map>
+#include <new>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <chrono>
+#include <exception>
 
+/*
+ * Move-only type-erased task.
+ *
+ * Callables that fit in the inline buffer are stored in place,
+ * so that submitting a task does not require a heap allocation.
+ * Larger callables fall back to the heap.
+ */
+class ThreadPoolTask {
+public:
+	ThreadPoolTask() : ops(nullptr) {}
+
+	template<class F, class = typename std::enable_if<
+			!std::is_same<typename std::decay<F>::type, ThreadPoolTask>::value>::type>
+	ThreadPoolTask(F &&f) : ops(nullptr) {
+		using T = typename std::decay<F>::type;
+		if (sizeof(T) <= inline_size
+				&& alignof(T) <= alignof(std::max_align_t)
+				&& std::is_nothrow_move_constructible<T>::value) {
+			new (storage) T(std::forward<F>(f));
+			ops = &inline_ops<T>::table;
+		} else {
+			*reinterpret_cast<T**>(storage) = new T(std::forward<F>(f));
+			ops = &heap_ops<T>::table;
+		}
+	}
+	ThreadPoolTask(ThreadPoolTask &&rhs) noexcept : ops(rhs.ops) {
+		if (ops) {
+			ops->move(storage, rhs.storage);
+			rhs.ops = nullptr;
+		}
+	}
+	ThreadPoolTask& operator=(ThreadPoolTask &&rhs) noexcept {
+		if (this != &rhs) {
+			reset();
+			ops = rhs.ops;
+			if (ops) {
+				ops->move(storage, rhs.storage);
+				rhs.ops = nullptr;
+			}
+		}
+		return *this;
+	}
+	ThreadPoolTask(const ThreadPoolTask&) = delete;
+	ThreadPoolTask& operator=(const ThreadPoolTask&) = delete;
+	~ThreadPoolTask() {
+		reset();
+	}
+	explicit operator bool() const {
+		return ops != nullptr;
+	}
+	void operator()() {
+		ops->invoke(storage);
+	}
+private:
+	static const size_t inline_size = 56;
+
+	struct Ops {
+		void (*invoke)(void*);
+		void (*move)(void *dest, void *src);
+		void (*destroy)(void*);
+	};
+	template<class T> struct inline_ops {
+		static void invoke(void *p) {
+			(*static_cast<T*>(p))();
+		}
+		static void move(void *dest, void *src) {
+			new (dest) T(std::move(*static_cast<T*>(src)));
+			static_cast<T*>(src)->~T();
+		}
+		static void destroy(void *p) {
+			static_cast<T*>(p)->~T();
+		}
+		static constexpr Ops table = { invoke, move, destroy };
+	};
+	template<class T> struct heap_ops {
+		static void invoke(void *p) {
+			(**static_cast<T**>(p))();
+		}
+		static void move(void *dest, void *src) {
+			*static_cast<T**>(dest) = *static_cast<T**>(src);
+		}
+		static void destroy(void *p) {
+			delete *static_cast<T**>(p);
+		}
+		static constexpr Ops table = { invoke, move, destroy };
+	};
+	void reset() {
+		if (ops) {
+			ops->destroy(storage);
+			ops = nullptr;
+		}
+	}
 
+	alignas(std::max_align_t) unsigned char storage[inline_size];
+	const Ops *ops;
+};
+
+/*
+ * Work-stealing thread pool.
+ *
+ * Each worker owns a deque: it pushes and pops its own work at the back,
+ * while idle workers steal from the front of the other deques.
+ * Tasks submitted from outside the pool are spread round-robin
+ * over the worker deques, so there is no single queue lock.
+ *
+ * parallel_for submits a batch of indexed work as at most concurrency()
+ * runner tasks that claim indices from a shared counter, and waits
+ * for the batch without any std::future round trip.
+ * A worker that waits on a batch or a future runs queued tasks meanwhile;
+ * once it fails to find any for a while, it sleeps until either the
+ * awaited work completes or new work is queued.
+ *
+ * Besides the process-wide singleton, pools may be created per codec.
+ * A ThreadPoolScope routes the work of the current thread to such a pool,
+ * and may cap the number of threads that this work is split over.
+ * The cap travels with each submitted task, so that nested work
+ * running on the pool's workers honours it too.
+ */
 class ThreadPool {
 public:
     ThreadPool(size_t);
     template<class F, class... Args>
-    auto enqueue(F&& f, Args&&... args) 
-        -> std::future<typename std::result_of<F(Args...)>::type>;
+    auto enqueue(F&& f, Args&&... args)
+        -> std::future<typename std::invoke_result<F, Args...>::type>;
+    template<class F>
+    void parallel_for(size_t count, F&& f);
+    template<class T>
+    void wait(std::future<T> &result);
+    template<class T>
+    void wait(std::vector< std::future<T> > &results);
     ~ThreadPool();
     int thread_number(std::thread::id id){
-    	if (id_map.find(id) != id_map.end())
-    		return id_map[id];
+    	if (tl_pool == this && id == std::this_thread::get_id())
+    		return tl_thread_number;
+    	auto iter = id_map.find(id);
+    	if (iter != id_map.end())
+    		return iter->second;
     	return -1;
     }
     size_t num_threads(){return m_num_threads;}
+    // number of threads that work submitted from this thread is split over
+    size_t concurrency(){
+    	return tl_concurrency ?
+    			std::min<size_t>(tl_concurrency, m_num_threads) : m_num_threads;
+    }
 
+	// pool for work submitted from this thread: the pool of the enclosing
+	// scope, else the pool this worker belongs to, else the singleton
 	static ThreadPool* get(){
+		if (tl_scope_pool)
+			return tl_scope_pool;
+		if (tl_pool)
+			return tl_pool;
 		return instance(0);
 	}
 	static ThreadPool* instance(uint32_t numthreads){
@@ -55,9 +200,18 @@ public:
 	}
 	static void release(){
 		std::unique_lock<std::mutex> lock(singleton_mutex);
-		delete singleton;
+		destroy(singleton);
 		singleton = nullptr;
 	}
+	// delete a pool. A worker can't join itself, so when called from one
+	// of the pool's own tasks, the pool is deleted by a helper thread,
+	// which joins this worker once its task has returned
+	static void destroy(ThreadPool *pool){
+		if (pool && tl_pool == pool)
+			std::thread([pool]{ delete pool; }).detach();
+		else
+			delete pool;
+	}
 	static uint32_t hardware_concurrency() {
 		uint32_t ret = 0;
 
@@ -69,95 +223,330 @@ public:
 	#else
 		ret = std::thread::hardware_concurrency();
 	#endif
-		return ret;
+		return ret ? ret : 1;
 	}
 private:
+    friend class ThreadPoolScope;
+
+    struct QueuedTask {
+    	ThreadPoolTask task;
+    	// concurrency cap of the submitting thread
+    	uint32_t concurrency;
+    };
+    struct alignas(64) WorkQueue {
+    	std::mutex mutex;
+    	std::deque<QueuedTask> tasks;
+    };
+
+    void push(ThreadPoolTask &&task);
+    bool pop(size_t thread_num, QueuedTask &task);
+    void run(QueuedTask &task);
+    void wake(size_t count);
+    void notify_waiters(void);
+    template<class P>
+    void help_until(P done);
+    void worker_loop(size_t thread_num);
+
     // need to keep track of threads so we can join them
     std::vector< std::thread > workers;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
-    
-    // synchronization
-    std::mutex queue_mutex;
+    // one task deque per worker
+    std::vector< std::unique_ptr<WorkQueue> > queues;
+    // number of tasks sitting in the deques
+    std::atomic<int64_t> pending;
+    std::atomic<size_t> next_queue;
+
+    // idle workers sleep here
+    std::mutex sleep_mutex;
     std::condition_variable condition;
-    bool stop;
+    std::atomic<size_t> sleepers;
+    // workers sleeping in help_until
+    std::atomic<size_t> waiters;
+    std::atomic<bool> stop;
 
     std::map<std::thread::id, int> id_map;
-    std::atomic<int> thread_count;
     size_t m_num_threads;
 
 	static ThreadPool* singleton;
 	static std::mutex singleton_mutex;
+	static thread_local ThreadPool* tl_pool;
+	static thread_local int tl_thread_number;
+	static thread_local ThreadPool* tl_scope_pool;
+	static thread_local uint32_t tl_concurrency;
+};
 
-
+/*
+ * Routes work submitted from the current thread to a pool,
+ * for the lifetime of the scope.
+ *
+ * A null pool selects the default pool. A concurrency of zero
+ * leaves the number of threads that work is split over uncapped.
+ */
+class ThreadPoolScope {
+public:
+	ThreadPoolScope(ThreadPool *pool, uint32_t concurrency) :
+		prev_pool(ThreadPool::tl_scope_pool),
+		prev_concurrency(ThreadPool::tl_concurrency) {
+		ThreadPool::tl_scope_pool = pool;
+		ThreadPool::tl_concurrency = concurrency;
+	}
+	~ThreadPoolScope() {
+		ThreadPool::tl_scope_pool = prev_pool;
+		ThreadPool::tl_concurrency = prev_concurrency;
+	}
+	ThreadPoolScope(const ThreadPoolScope&) = delete;
+	ThreadPoolScope& operator=(const ThreadPoolScope&) = delete;
+private:
+	ThreadPool *prev_pool;
+	uint32_t prev_concurrency;
 };
- 
+
 // the constructor just launches some amount of workers
 inline ThreadPool::ThreadPool(size_t threads)
-    :   stop(false), thread_count(-1), m_num_threads(threads)
+    :   pending(0), next_queue(0), sleepers(0), waiters(0), stop(false),
+		m_num_threads(threads ? threads : 1)
 {
-    for(size_t i = 0;i<threads;++i)
-        workers.emplace_back(
-            [this]
-            {
-    			{
-    			std::unique_lock<std::mutex> lock(this->queue_mutex);
-    			auto thread_num = ++thread_count;
-    			id_map[std::this_thread::get_id()] = thread_num;
-    			}
-                for(;;)
-                {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock,
-                            [this]{ return this->stop || !this->tasks.empty(); });
-                        if(this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-
-                    task();
-                }
-            }
-        );
+	for (size_t i = 0; i < m_num_threads; ++i)
+		queues.emplace_back(new WorkQueue());
+    for(size_t i = 0;i<m_num_threads;++i){
+        workers.emplace_back(&ThreadPool::worker_loop, this, i);
+        id_map[workers.back().get_id()] = (int)i;
+    }
+}
+
+inline void ThreadPool::worker_loop(size_t thread_num){
+	tl_pool = this;
+	tl_thread_number = (int)thread_num;
+	for(;;) {
+		QueuedTask task;
+		if (pop(thread_num, task)) {
+			run(task);
+			// the task deleted the pool, and this worker was detached
+			if (tl_pool != this)
+				return;
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		++sleepers;
+		condition.wait(lock,
+			[this]{ return stop || pending > 0; });
+		--sleepers;
+		if(stop && pending == 0)
+			return;
+	}
+}
+
+// own deque is popped LIFO, other deques are stolen from FIFO
+inline bool ThreadPool::pop(size_t thread_num, QueuedTask &task){
+	if (pending == 0)
+		return false;
+	for (size_t i = 0; i < m_num_threads; ++i){
+		auto q = queues[(thread_num + i) % m_num_threads].get();
+		std::unique_lock<std::mutex> lock(q->mutex);
+		if (q->tasks.empty())
+			continue;
+		if (i == 0) {
+			task = std::move(q->tasks.back());
+			q->tasks.pop_back();
+		} else {
+			task = std::move(q->tasks.front());
+			q->tasks.pop_front();
+		}
+		--pending;
+		return true;
+	}
+	return false;
+}
+
+inline void ThreadPool::push(ThreadPoolTask &&task){
+	// don't allow enqueueing after stopping the pool
+	if(stop)
+		throw std::runtime_error("enqueue on stopped ThreadPool");
+	size_t q = (tl_pool == this) ?
+			(size_t)tl_thread_number : next_queue++ % m_num_threads;
+	{
+		std::unique_lock<std::mutex> lock(queues[q]->mutex);
+		queues[q]->tasks.push_back(QueuedTask{std::move(task), tl_concurrency});
+		++pending;
+	}
+}
+
+// run a task under the concurrency cap it was submitted with
+inline void ThreadPool::run(QueuedTask &task){
+	auto prev_concurrency = tl_concurrency;
+	tl_concurrency = task.concurrency;
+	task.task();
+	tl_concurrency = prev_concurrency;
+}
+
+inline void ThreadPool::wake(size_t count){
+	if (sleepers == 0)
+		return;
+	// taking the lock orders us after any worker
+	// that is between its predicate check and its wait
+	{
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+	}
+	if (count == 1)
+		condition.notify_one();
+	else
+		condition.notify_all();
+}
+
+// wake the workers sleeping in help_until, after their awaited work completed
+inline void ThreadPool::notify_waiters(void){
+	// pairs with the increment of waiters in help_until: either we see
+	// the waiter, or the waiter sees the completed work
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiters == 0)
+		return;
+	{
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+	}
+	condition.notify_all();
+}
+
+// run queued tasks on this worker until done() holds.
+// After max_failed_pops attempts that find no task, sleep until done()
+// holds or a task is queued. Futures that don't come from enqueue are
+// never signalled, so the sleep is cut into bounded slices.
+template<class P>
+void ThreadPool::help_until(P done){
+	const uint32_t max_failed_pops = 64;
+	uint32_t failed_pops = 0;
+	while (!done()) {
+		QueuedTask task;
+		if (pop((size_t)tl_thread_number, task)) {
+			run(task);
+			failed_pops = 0;
+		} else if (++failed_pops < max_failed_pops) {
+			std::this_thread::yield();
+		} else {
+			std::unique_lock<std::mutex> lock(sleep_mutex);
+			++waiters;
+			++sleepers;
+			condition.wait_for(lock, std::chrono::milliseconds(10),
+				[this, &done]{ return pending > 0 || done(); });
+			--sleepers;
+			--waiters;
+			failed_pops = 0;
+		}
+	}
 }
 
 // add new work item to the pool
 template<class F, class... Args>
-auto ThreadPool::enqueue(F&& f, Args&&... args) 
-    -> std::future<typename std::result_of<F(Args...)>::type>
+auto ThreadPool::enqueue(F&& f, Args&&... args)
+    -> std::future<typename std::invoke_result<F, Args...>::type>
 {
-    using return_type = typename std::result_of<F(Args...)>::type;
+    using return_type = typename std::invoke_result<F, Args...>::type;
 
-    auto task = std::make_shared< std::packaged_task<return_type()> >(
+    std::packaged_task<return_type()> task(
             std::bind(std::forward<F>(f), std::forward<Args>(args)...)
         );
-        
-    std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+    std::future<return_type> res = task.get_future();
+    push(ThreadPoolTask([this, task = std::move(task)]() mutable {
+    	task();
+    	// unless the task deleted the pool
+    	if (tl_pool == this)
+    		notify_waiters();
+    }));
+    wake(1);
+    return res;
+}
 
-        // don't allow enqueueing after stopping the pool
-        if(stop)
-            throw std::runtime_error("enqueue on stopped ThreadPool");
+// run f(i) for i in [0,count) and wait for completion.
+// A worker thread calling this helps execute queued tasks while it waits,
+// so parallel_for may be nested inside pool tasks.
+// If f throws, no further indices are started, and the first
+// exception is rethrown on the calling thread once the batch is done.
+template<class F>
+void ThreadPool::parallel_for(size_t count, F&& f){
+	if (count == 0)
+		return;
+	struct Batch {
+		std::atomic<size_t> next;
+		std::atomic<size_t> active;
+		std::mutex mutex;
+		std::condition_variable done;
+		std::exception_ptr error;
+	} batch;
+	batch.next = 0;
+	size_t num_runners = std::min(count, concurrency());
+	batch.active = num_runners;
+	auto fn = &f;
+	for (size_t i = 0; i < num_runners; ++i) {
+		push(ThreadPoolTask([this, &batch, fn, count] {
+			std::exception_ptr error;
+			try {
+				for (size_t index = batch.next++; index < count; index = batch.next++)
+					(*fn)(index);
+			} catch (...) {
+				error = std::current_exception();
+				batch.next = count;
+			}
+			// decrement under the lock, so that the waiter
+			// can't release the batch while we still touch it
+			std::unique_lock<std::mutex> lock(batch.mutex);
+			if (error && !batch.error)
+				batch.error = error;
+			if (--batch.active == 0) {
+				batch.done.notify_all();
+				notify_waiters();
+			}
+		}));
+	}
+	wake(num_runners);
+	if (tl_pool == this) {
+		help_until([&batch]{ return batch.active == 0; });
+		std::unique_lock<std::mutex> lock(batch.mutex);
+	} else {
+		std::unique_lock<std::mutex> lock(batch.mutex);
+		batch.done.wait(lock, [&batch]{ return batch.active == 0; });
+	}
+	if (batch.error)
+		std::rethrow_exception(batch.error);
+}
 
-        tasks.emplace([task](){ (*task)(); });
-    }
-    condition.notify_one();
-    return res;
+// wait until a future is ready, without retrieving its value.
+// A worker thread calling this helps execute queued tasks while it waits,
+// so futures may be waited on from inside pool tasks.
+template<class T>
+void ThreadPool::wait(std::future<T> &result){
+	if (tl_pool == this) {
+		help_until([&result]{
+			return result.wait_for(std::chrono::seconds(0))
+					== std::future_status::ready;
+		});
+	}
+	result.wait();
+}
+
+// wait for all futures, propagating any exception.
+template<class T>
+void ThreadPool::wait(std::vector< std::future<T> > &results){
+	for (auto &result : results)
+		wait(result);
+	for (auto &result : results)
+		result.get();
 }
 
-// the destructor joins all threads
+// the destructor joins all threads, except the calling thread when
+// it is one of the workers: that worker is detached, and leaves its loop
+// without touching the pool once the task running the destructor returns.
+// This is only safe from a top level task; prefer destroy()
 inline ThreadPool::~ThreadPool()
 {
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        std::unique_lock<std::mutex> lock(sleep_mutex);
         stop = true;
     }
     condition.notify_all();
-    for(std::thread &worker: workers)
-        worker.join();
+    for(std::thread &worker: workers) {
+    	if (tl_pool == this && worker.get_id() == std::this_thread::get_id())
+    		worker.detach();
+    	else
+    		worker.join();
+    }
+    if (tl_pool == this)
+    	tl_pool = nullptr;
 }
@@ -0,0 +1,108 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+#include <chrono>  // for high_resolution_clock
+
+namespace grk {
+
+// small amount of work per task, comparable to a tiny code block
+static uint32_t spin(uint64_t seed, uint32_t work){
+	uint32_t val = (uint32_t)seed;
+	for (uint32_t i = 0; i < work; ++i)
+		val = val * 1664525U + 1013904223U;
+	return val;
+}
+
+void usage(void)
+{
+    printf(
+        "bench_threadpool [-num_tasks value] [-max_threads value] [-work value] [-batches value]\n");
+}
+
+}
+
+using namespace grk;
+
+int main(int argc, char** argv)
+{
+	uint32_t num_tasks = 100000;
+	uint32_t max_threads = ThreadPool::hardware_concurrency();
+	uint32_t work = 64;
+	uint32_t batches = 10;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-num_tasks") == 0 && i + 1 < argc) {
+			num_tasks = (uint32_t)atoi(argv[i + 1]);
+			i++;
+		} else if (strcmp(argv[i], "-max_threads") == 0 && i + 1 < argc) {
+			max_threads = (uint32_t)atoi(argv[i + 1]);
+			i++;
+		} else if (strcmp(argv[i], "-work") == 0 && i + 1 < argc) {
+			work = (uint32_t)atoi(argv[i + 1]);
+			i++;
+		} else if (strcmp(argv[i], "-batches") == 0 && i + 1 < argc) {
+			batches = (uint32_t)atoi(argv[i + 1]);
+			i++;
+		} else {
+			usage();
+			return 1;
+		}
+	}
+	if (!num_tasks || !max_threads || !batches) {
+		usage();
+		return 1;
+	}
+
+	std::vector<uint32_t> results(num_tasks);
+	printf("%8s %20s %20s\n", "threads", "parallel_for tasks/s", "enqueue tasks/s");
+	for (uint32_t num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+		ThreadPool pool(num_threads);
+		std::chrono::duration<double> elapsed;
+
+		// batched submission
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t b = 0; b < batches; ++b) {
+			pool.parallel_for(num_tasks, [&results, work, b](size_t index) {
+				results[index] = spin(index + b, work);
+			});
+		}
+		elapsed = std::chrono::high_resolution_clock::now() - start;
+		double batched = (double)num_tasks * batches / elapsed.count();
+
+		// one future per task
+		start = std::chrono::high_resolution_clock::now();
+		std::vector<std::future<uint32_t>> futures;
+		futures.reserve(num_tasks);
+		for (uint32_t b = 0; b < batches; ++b) {
+			futures.clear();
+			for (uint32_t i = 0; i < num_tasks; ++i)
+				futures.emplace_back(pool.enqueue([i, work, b] {
+					return spin(i + b, work);
+				}));
+			for (uint32_t i = 0; i < num_tasks; ++i)
+				results[i] = futures[i].get();
+		}
+		elapsed = std::chrono::high_resolution_clock::now() - start;
+		double single = (double)num_tasks * batches / elapsed.count();
+
+		printf("%8u %20.0f %20.0f\n", num_threads, batched, single);
+		if (num_threads < max_threads && num_threads * 2 > max_threads)
+			num_threads = max_threads / 2;
+	}
+
+	return 0;
+}
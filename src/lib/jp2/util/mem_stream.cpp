@@ -139,6 +139,69 @@ grk_stream* create_mem_stream(uint8_t *buf, size_t len, bool ownsBuffer,
 	return (grk_stream*) l_stream;
 }
 
+// grow buffer so that it can hold at least len bytes
+static bool grow_mem(size_t len, buf_info *dest) {
+	if (len <= dest->len)
+		return true;
+	size_t new_len = std::max<size_t>(len, 2 * dest->len);
+	auto new_buf = new (std::nothrow) uint8_t[new_len];
+	if (!new_buf)
+		return false;
+	if (dest->buf) {
+		memcpy(new_buf, dest->buf, dest->len);
+		delete[] dest->buf;
+	}
+	dest->buf = new_buf;
+	dest->len = new_len;
+	return true;
+}
+
+static size_t write_to_growable_mem(void *src, size_t nb_bytes,
+		buf_info *dest) {
+	if (!grow_mem(dest->off + nb_bytes, dest))
+		return 0;
+	if (nb_bytes) {
+		memcpy(dest->buf + dest->off, src, nb_bytes);
+		dest->off += nb_bytes;
+	}
+	return nb_bytes;
+}
+
+// seeking past the end is allowed, e.g. to skip over a marker length
+static bool seek_growable_mem(uint64_t nb_bytes, buf_info *dest) {
+	if (!grow_mem((size_t) nb_bytes, dest))
+		return false;
+	dest->off = (size_t) nb_bytes;
+	return true;
+}
+
+grk_stream* create_growable_mem_stream(void) {
+	auto l_stream = new BufferedStream(nullptr, growable_mem_stream_chunk,
+			false);
+	auto p_dest_buffer = new buf_info(nullptr, 0, 0, true);
+	if (!grow_mem(growable_mem_stream_chunk, p_dest_buffer)) {
+		delete p_dest_buffer;
+		delete l_stream;
+		return nullptr;
+	}
+	grk_stream_set_user_data((grk_stream*) l_stream, p_dest_buffer, free_mem);
+	grk_stream_set_write_function((grk_stream*) l_stream,
+			(grk_stream_write_fn) write_to_growable_mem);
+	grk_stream_set_seek_function((grk_stream*) l_stream,
+			(grk_stream_seek_fn) seek_growable_mem);
+
+	return (grk_stream*) l_stream;
+}
+
+uint8_t* get_growable_mem_stream_data(grk_stream *stream, size_t *len) {
+	auto private_stream = (BufferedStream*) stream;
+	if (!private_stream || !private_stream->flush())
+		return nullptr;
+	auto buf = (buf_info*) private_stream->m_user_data;
+	*len = (size_t) private_stream->tell();
+	return buf->buf;
+}
+
 static int32_t get_file_open_mode(const char *mode) {
 	int32_t m = -1;
 	switch (mode[0]) {
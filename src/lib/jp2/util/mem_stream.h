@@ -46,6 +46,25 @@ struct buf_info {
 		bool is_read_stream);
 size_t get_mem_stream_offset( grk_stream  *stream);
 
+/* initial buffer size, and double buffer size, of a growable memory stream */
+const size_t growable_mem_stream_chunk = 64 * 1024;
+
+/**
+ * Create a memory write stream whose buffer grows as data is written.
+ */
+grk_stream* create_growable_mem_stream(void);
+
+/**
+ * Flush a growable memory stream and get its contents.
+ *
+ * @param stream	growable memory stream
+ * @param len		set to the number of bytes written, up to current position
+ *
+ * @return pointer to stream contents, owned by the stream,
+ * 			or nullptr if the stream could not be flushed
+ */
+uint8_t* get_growable_mem_stream_data(grk_stream *stream, size_t *len);
+
  grk_stream  *  create_mapped_file_read_stream(const char *fname);
 
 }
@@ -68,12 +68,19 @@
 #ifdef __SSSE3__
 #include <tmmintrin.h>
 #endif
-#ifdef __AVX2__
+#if defined(__AVX2__) || defined(GRK_SIMD_AVX512)
 #include <immintrin.h>
 #endif
 
-
-#ifdef __AVX2__
+/*
+ AVX-512 registers are only used when GRK_SIMD_AVX512 is defined, i.e. by
+ the runtime dispatched kernels in SIMDKernels_avx512.cpp. Code compiled with
+ plain -mavx512f keeps the AVX2 layout that it was written for.
+ */
+#if defined(GRK_SIMD_AVX512)
+/** Number of int32 values in a AVX-512 register */
+#define VREG_INT_COUNT       16
+#elif defined(__AVX2__)
 /** Number of int32 values in a AVX2 register */
 #define VREG_INT_COUNT       8
 #else
@@ -86,7 +93,27 @@
 #if (defined(__SSE2__) || defined(__AVX2__))
 
 /* Convenience macros to improve the readability of the formulas */
-#if __AVX2__
+#if defined(GRK_SIMD_AVX512)
+#define VREG        __m512i
+#define LOAD_CST(x) _mm512_set1_epi32(x)
+#define LOAD(x)     _mm512_load_si512((const void*)(x))
+#define LOADU(x)    _mm512_loadu_si512((const void*)(x))
+#define STORE(x,y)  _mm512_store_si512((void*)(x),(y))
+#define STOREU(x,y) _mm512_storeu_si512((void*)(x),(y))
+#define ADD(x,y)    _mm512_add_epi32((x),(y))
+#define SUB(x,y)    _mm512_sub_epi32((x),(y))
+#define SAR(x,y)    _mm512_srai_epi32((x),(y))
+#define MUL(x,y)    _mm512_mullo_epi32((x),(y))
+#define VREGF        __m512
+#define LOADF(x)     _mm512_load_ps((float const*)(x))
+#define LOADUF(x)    _mm512_loadu_ps((float const*)(x))
+#define LOAD_CST_F(x)_mm512_set1_ps(x)
+#define ADDF(x,y)    _mm512_add_ps((x),(y))
+#define MULF(x,y)    _mm512_mul_ps((x),(y))
+#define SUBF(x,y)    _mm512_sub_ps((x),(y))
+#define STOREF(x,y)  _mm512_store_ps((float*)(x),(y))
+#define STOREUF(x,y) _mm512_storeu_ps((float*)(x),(y))
+#elif __AVX2__
 #define VREG        __m256i
 #define LOAD_CST(x) _mm256_set1_epi32(x)
 #define LOAD(x)     _mm256_load_si256((const VREG*)(x))
@@ -99,11 +126,13 @@
 #define MUL(x,y)    _mm256_mullo_epi32((x),(y))
 #define VREGF        __m256
 #define LOADF(x)     _mm256_load_ps((float const*)(x))
+#define LOADUF(x)    _mm256_loadu_ps((float const*)(x))
 #define LOAD_CST_F(x)_mm256_set1_ps(x)
 #define ADDF(x,y)    _mm256_add_ps((x),(y))
 #define MULF(x,y)    _mm256_mul_ps((x),(y))
 #define SUBF(x,y)     _mm256_sub_ps((x),(y))
 #define STOREF(x,y)  _mm256_store_ps((float*)(x),(y))
+#define STOREUF(x,y) _mm256_storeu_ps((float*)(x),(y))
 #else
 #define VREG        __m128i
 #define LOAD_CST(x) _mm_set1_epi32(x)
@@ -118,11 +147,13 @@
 #define SAR(x,y)    _mm_srai_epi32((x),(y))
 #define VREGF        __m128
 #define LOADF(x)     _mm_load_ps((float const*)(x))
+#define LOADUF(x)    _mm_loadu_ps((float const*)(x))
 #define LOAD_CST_F(x)      _mm_set1_ps(x)
 #define ADDF(x,y)    _mm_add_ps((x),(y))
 #define MULF(x,y)    _mm_mul_ps((x),(y))
 #define SUBF(x,y)    _mm_sub_ps((x),(y))
 #define STOREF(x,y)  _mm_store_ps((float*)(x),(y))
+#define STOREUF(x,y) _mm_storeu_ps((float*)(x),(y))
 #endif
 
 #endif
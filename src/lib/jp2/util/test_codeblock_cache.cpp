@@ -0,0 +1,175 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#undef NDEBUG
+
+#include "grok_includes.h"
+
+using namespace grk;
+
+static CodeblockKey make_key(uint32_t cblkno, uint32_t num_layers,
+		uint32_t fix16_frac_bits = 0) {
+	CodeblockKey key = { 0, 0, 1, 2, cblkno * 64, 0, num_layers, 0,
+			fix16_frac_bits };
+	return key;
+}
+
+static std::vector<int32_t> make_samples(uint32_t len, int32_t val) {
+	return std::vector<int32_t>(len, val);
+}
+
+const uint32_t image_dim = 256;
+
+/* compress a noisy gradient with the irreversible transform */
+static size_t compress(uint8_t *buf, size_t len) {
+	grk_image_cmptparm cmptparm;
+	memset(&cmptparm, 0, sizeof(cmptparm));
+	cmptparm.dx = 1;
+	cmptparm.dy = 1;
+	cmptparm.w = image_dim;
+	cmptparm.h = image_dim;
+	cmptparm.prec = 8;
+	auto image = grk_image_create(1, &cmptparm, GRK_CLRSPC_GRAY);
+	image->x1 = image_dim;
+	image->y1 = image_dim;
+	uint32_t rand_state = 1;
+	for (uint32_t i = 0; i < image_dim * image_dim; ++i) {
+		rand_state = rand_state * 1664525U + 1013904223U;
+		image->comps[0].data[i] = (int32_t) ((i % image_dim + i / image_dim) / 2
+				+ ((rand_state >> 8) % 32)) & 0xFF;
+	}
+	grk_cparameters param;
+	grk_set_default_compress_params(&param);
+	param.irreversible = true;
+	param.tcp_numlayers = 1;
+	param.cp_disto_alloc = 1;
+	param.tcp_rates[0] = 4;
+	auto stream = grk_stream_create_mem_stream(buf, len, false, false);
+	auto codec = grk_create_compress(GRK_CODEC_J2K, stream);
+	size_t rc = 0;
+	if (grk_init_compress(codec, &param, image) && grk_start_compress(codec)
+			&& grk_compress(codec) && grk_end_compress(codec))
+		rc = grk_stream_get_write_mem_stream_length(stream);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	grk_image_destroy(image);
+
+	return rc;
+}
+
+static std::vector<int32_t> decompress(uint8_t *buf, size_t len,
+		uint32_t output_precision, grk_codeblock_cache *cache) {
+	grk_dparameters dparam;
+	grk_set_default_decompress_params(&dparam);
+	dparam.output_precision = output_precision;
+	dparam.codeblock_cache = cache;
+	auto stream = grk_stream_create_mem_stream(buf, len, false, true);
+	auto codec = grk_create_decompress(GRK_CODEC_J2K, stream);
+	grk_image *image = nullptr;
+	std::vector<int32_t> samples;
+	if (grk_init_decompress(codec, &dparam)
+			&& grk_read_header(codec, nullptr, &image)
+			&& grk_set_decompress_area(codec, image, 0, 0, 0, 0)
+			&& grk_decompress(codec, nullptr, image))
+		samples.assign(image->comps[0].data,
+				image->comps[0].data + image_dim * image_dim);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	grk_image_destroy(image);
+
+	return samples;
+}
+
+/**
+ * 8 bit output precision decodes irreversible samples in 16 bit
+ * fixed point: full precision decodes sharing the cache must not
+ * pick up these rounded samples, nor the other way round
+ */
+static void check_fixed_point(void) {
+	std::vector<uint8_t> buf(image_dim * image_dim * 4);
+	size_t len = compress(buf.data(), buf.size());
+	assert(len);
+	auto full = decompress(buf.data(), len, 0, nullptr);
+	auto fixed = decompress(buf.data(), len, 8, nullptr);
+	assert(full.size() && fixed.size() && full != fixed);
+	auto cache = grk_codeblock_cache_create(64 << 20);
+	assert(decompress(buf.data(), len, 8, cache) == fixed);
+	assert(decompress(buf.data(), len, 0, cache) == full);
+	assert(decompress(buf.data(), len, 8, cache) == fixed);
+	assert(decompress(buf.data(), len, 0, cache) == full);
+	grk_codeblock_cache_destroy(cache);
+}
+
+/**
+ * Check look up, least recently used eviction and memory bound
+ * of the code block cache, and that code blocks decoded at different
+ * precisions are cached apart
+ */
+int main() {
+	const uint32_t len = 64 * 64;
+	const uint64_t block_bytes = len * sizeof(int32_t);
+	CodeblockCache cache(3 * block_bytes);
+
+	assert(cache.get(make_key(0, 1)) == nullptr);
+	for (uint32_t i = 0; i < 3; ++i)
+		cache.put(make_key(i, 1), make_samples(len, (int32_t) i));
+	for (uint32_t i = 0; i < 3; ++i) {
+		auto samples = cache.get(make_key(i, 1));
+		assert(samples && samples->size() == len);
+		assert((*samples)[len - 1] == (int32_t) i);
+	}
+	// same block, with a different number of layers, is a different entry
+	assert(cache.get(make_key(0, 2)) == nullptr);
+	// and so are samples rounded to fixed point
+	assert(cache.get(make_key(0, 1, 5)) == nullptr);
+
+	// block 0 is now least recently used, unless it is looked up again
+	cache.get(make_key(0, 1));
+	cache.put(make_key(3, 1), make_samples(len, 3));
+	assert(cache.get(make_key(1, 1)) == nullptr);
+	assert(cache.get(make_key(0, 1)) != nullptr);
+	assert(cache.get(make_key(2, 1)) != nullptr);
+	assert(cache.get(make_key(3, 1)) != nullptr);
+
+	// replacing a block keeps the cache within its budget
+	cache.put(make_key(3, 1), make_samples(len, 4));
+	assert((*cache.get(make_key(3, 1)))[0] == 4);
+	assert(cache.get(make_key(0, 1)) != nullptr);
+	assert(cache.get(make_key(2, 1)) != nullptr);
+
+	// samples stay valid while in use, even when evicted
+	auto in_use = cache.get(make_key(2, 1));
+	cache.put(make_key(4, 1), make_samples(len, 5));
+	cache.put(make_key(5, 1), make_samples(len, 6));
+	cache.put(make_key(6, 1), make_samples(len, 7));
+	assert(cache.get(make_key(2, 1)) == nullptr);
+	assert((*in_use)[0] == 2);
+
+	// blocks larger than the cache are not added
+	cache.put(make_key(7, 1), make_samples(4 * len, 8));
+	assert(cache.get(make_key(7, 1)) == nullptr);
+	assert(cache.get(make_key(6, 1)) != nullptr);
+
+	printf("%llu hits, %llu misses\n", (unsigned long long) cache.hits(),
+			(unsigned long long) cache.misses());
+
+	grk_initialize(nullptr, 4);
+	check_fixed_point();
+	grk_deinitialize();
+
+	return 0;
+}
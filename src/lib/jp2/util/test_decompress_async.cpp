@@ -0,0 +1,290 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+
+namespace grk {
+
+const uint32_t image_w = 256;
+const uint32_t image_h = 192;
+const uint32_t tile_dim = 32;
+const uint32_t num_tiles = (image_w / tile_dim) * (image_h / tile_dim);
+
+#define CHECK(cond) \
+	if (!(cond)) { \
+		printf("line %d: check failed: %s\n", __LINE__, #cond); \
+		return false; \
+	}
+
+/**
+ * Compress a gray image of w x h samples, in tiles of tile_w x tile_h,
+ * losslessly to buffer, and return code stream length
+ */
+static size_t compress(uint8_t *buf, size_t len, uint32_t w, uint32_t h,
+		uint32_t tile_w, uint32_t tile_h) {
+	grk_image_cmptparm cmptparm;
+	memset(&cmptparm, 0, sizeof(cmptparm));
+	cmptparm.dx = 1;
+	cmptparm.dy = 1;
+	cmptparm.w = w;
+	cmptparm.h = h;
+	cmptparm.prec = 8;
+	auto image = grk_image_create(1, &cmptparm, GRK_CLRSPC_GRAY);
+	image->x1 = w;
+	image->y1 = h;
+	uint32_t rand_state = 1;
+	auto data = image->comps[0].data;
+	for (uint32_t y = 0; y < h; ++y) {
+		for (uint32_t x = 0; x < w; ++x) {
+			rand_state = rand_state * 1664525U + 1013904223U;
+			data[y * w + x] = (int32_t) ((x + y) / 2
+					+ ((rand_state >> 8) % 16)) & 0xFF;
+		}
+	}
+	grk_cparameters param;
+	grk_set_default_compress_params(&param);
+	param.tile_size_on = true;
+	param.t_width = tile_w;
+	param.t_height = tile_h;
+	param.numresolution = 4;
+	param.tcp_numlayers = 1;
+	param.cp_disto_alloc = 1;
+	param.tcp_rates[0] = 0;
+	auto stream = grk_stream_create_mem_stream(buf, len, false, false);
+	auto codec = grk_create_compress(GRK_CODEC_J2K, stream);
+	size_t rc = 0;
+	if (grk_init_compress(codec, &param, image) && grk_start_compress(codec)
+			&& grk_compress(codec) && grk_end_compress(codec))
+		rc = grk_stream_get_write_mem_stream_length(stream);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	grk_image_destroy(image);
+
+	return rc;
+}
+
+/* code stream being decompressed, and its image */
+struct Decompression {
+	Decompression(uint8_t *buf, size_t len) :
+			stream(grk_stream_create_mem_stream(buf, len, false, true)),
+			codec(grk_create_decompress(GRK_CODEC_J2K, stream)),
+			image(nullptr) {
+	}
+	~Decompression() {
+		grk_destroy_codec(codec);
+		grk_stream_destroy(stream);
+		grk_image_destroy(image);
+	}
+	bool read_header(uint32_t max_tiles_in_flight) {
+		grk_dparameters dparam;
+		grk_set_default_decompress_params(&dparam);
+		dparam.max_tiles_in_flight = max_tiles_in_flight;
+		return grk_init_decompress(codec, &dparam)
+				&& grk_read_header(codec, nullptr, &image)
+				&& grk_set_decompress_area(codec, image, 0, 0, 0, 0);
+	}
+	grk_stream *stream;
+	grk_codec *codec;
+	grk_image *image;
+};
+
+/* state shared with the tile callback */
+struct CallbackState {
+	grk_codec *codec;
+	std::atomic<size_t> num_tiles{0};
+	std::vector<uint16_t> tiles;
+	bool images_valid = true;
+	// if not null, then tile images are compared with this decompressed image
+	const grk_image *reference = nullptr;
+	// cancel once this many tiles are reported, if non zero
+	size_t cancel_after = 0;
+};
+
+/* the tile image covers the tile, and matches the reference image there */
+static bool check_tile_image(uint16_t tile_index, const grk_image *image,
+		const grk_image *reference) {
+	if (!image || !image->comps || image->numcomps != 1
+			|| !image->comps[0].data)
+		return false;
+	uint32_t tiles_x = image_w / tile_dim;
+	uint32_t x0 = (tile_index % tiles_x) * tile_dim;
+	uint32_t y0 = (tile_index / tiles_x) * tile_dim;
+	auto comp = image->comps;
+	if (image->x0 != x0 || image->y0 != y0 || image->x1 != x0 + tile_dim
+			|| image->y1 != y0 + tile_dim || comp->x0 != x0 || comp->y0 != y0
+			|| comp->w != tile_dim || comp->h != tile_dim)
+		return false;
+	if (!reference)
+		return true;
+	for (uint32_t y = 0; y < tile_dim; ++y) {
+		if (memcmp(comp->data + y * tile_dim,
+				reference->comps[0].data + (y0 + y) * image_w + x0,
+				tile_dim * sizeof(int32_t)))
+			return false;
+	}
+
+	return true;
+}
+
+static void tile_callback(uint16_t tile_index, grk_image *image,
+		void *user_data) {
+	auto state = (CallbackState*) user_data;
+	if (!check_tile_image(tile_index, image, state->reference))
+		state->images_valid = false;
+	state->tiles.push_back(tile_index);
+	state->num_tiles++;
+	if (state->cancel_after && state->tiles.size() == state->cancel_after)
+		grk_decompress_cancel(state->codec);
+}
+
+/* full decompress: every tile is reported once, in order,
+ * and the image matches a synchronous decompress */
+static bool check_decompress(uint8_t *buf, size_t len,
+		uint32_t max_tiles_in_flight) {
+	Decompression sync(buf, len);
+	CHECK(sync.read_header(1));
+	CHECK(grk_decompress(sync.codec, nullptr, sync.image));
+
+	Decompression async(buf, len);
+	CHECK(async.read_header(max_tiles_in_flight));
+	// nothing to wait for yet
+	CHECK(!grk_decompress_wait(async.codec));
+	CallbackState state;
+	state.codec = async.codec;
+	state.reference = sync.image;
+	CHECK(grk_decompress_async(async.codec, async.image, tile_callback, &state));
+	CHECK(grk_decompress_wait(async.codec));
+	CHECK(grk_end_decompress(async.codec));
+	CHECK(state.images_valid);
+	CHECK(state.tiles.size() == num_tiles);
+	for (uint16_t i = 0; i < state.tiles.size(); ++i)
+		CHECK(state.tiles[i] == i);
+	CHECK(!memcmp(sync.image->comps[0].data, async.image->comps[0].data,
+			(size_t) image_w * image_h * sizeof(int32_t)));
+
+	return true;
+}
+
+/* cancelling from the callback stops the decompress part way */
+static bool check_cancel(uint8_t *buf, size_t len) {
+	Decompression async(buf, len);
+	CHECK(async.read_header(1));
+	CallbackState state;
+	state.codec = async.codec;
+	state.cancel_after = 2;
+	CHECK(grk_decompress_async(async.codec, async.image, tile_callback, &state));
+	CHECK(!grk_decompress_wait(async.codec));
+	CHECK(state.tiles.size() >= state.cancel_after);
+	CHECK(state.tiles.size() < num_tiles);
+
+	return true;
+}
+
+/* a single tile image is cancelled part way through its code blocks */
+static bool check_cancel_single_tile(void) {
+	const uint32_t dim = 2048;
+	size_t buf_len = (size_t) dim * dim * 2 + 65536;
+	std::unique_ptr<uint8_t[]> buf(new uint8_t[buf_len]);
+	size_t len = compress(buf.get(), buf_len, dim, dim, dim, dim);
+	CHECK(len != 0);
+	Decompression async(buf.get(), len);
+	CHECK(async.read_header(1));
+	CallbackState state;
+	state.codec = async.codec;
+	CHECK(grk_decompress_async(async.codec, async.image, tile_callback, &state));
+	// let the decompression get past the check made before each tile
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	grk_decompress_cancel(async.codec);
+	CHECK(!grk_decompress_wait(async.codec));
+	CHECK(state.tiles.empty());
+
+	return true;
+}
+
+/* a finished decompression that was not waited on
+ * can be followed by another one */
+static bool check_restart(uint8_t *buf, size_t len) {
+	Decompression async(buf, len);
+	CHECK(async.read_header(1));
+	CallbackState state;
+	state.codec = async.codec;
+	CHECK(grk_decompress_tile_async(async.codec, async.image, 5,
+			tile_callback, &state));
+	while (state.num_tiles == 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	// the decompression finishes shortly after its last callback
+	bool started = false;
+	for (uint32_t i = 0; i < 1000 && !started; ++i) {
+		started = grk_decompress_tile_async(async.codec, async.image, 6,
+				tile_callback, &state);
+		if (!started)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	CHECK(started);
+	CHECK(grk_decompress_wait(async.codec));
+	CHECK(state.images_valid);
+	CHECK(state.tiles.size() == 2 && state.tiles[0] == 5 && state.tiles[1] == 6);
+
+	return true;
+}
+
+/* a single tile is reported once, with its index */
+static bool check_tile(uint8_t *buf, size_t len) {
+	Decompression async(buf, len);
+	CHECK(async.read_header(1));
+	CallbackState state;
+	state.codec = async.codec;
+	const uint16_t tile_index = 5;
+	CHECK(grk_decompress_tile_async(async.codec, async.image, tile_index,
+			tile_callback, &state));
+	CHECK(grk_decompress_wait(async.codec));
+	CHECK(state.images_valid);
+	CHECK(state.tiles.size() == 1 && state.tiles[0] == tile_index);
+
+	return true;
+}
+
+}
+
+using namespace grk;
+
+/**
+ * Check asynchronous decompression: tile callbacks and their tile images,
+ * cancellation between tiles and within a tile, restarting,
+ * and single tile decompression
+ */
+int main(void)
+{
+	grk_initialize(nullptr, 4);
+	size_t buf_len = (size_t) image_w * image_h * 2 + 65536;
+	auto buf = new uint8_t[buf_len];
+	size_t len = compress(buf, buf_len, image_w, image_h, tile_dim, tile_dim);
+	bool rc = len != 0;
+	if (!rc)
+		printf("failed to compress\n");
+	rc = rc && check_decompress(buf, len, 1);
+	rc = rc && check_decompress(buf, len, 4);
+	rc = rc && check_cancel(buf, len);
+	rc = rc && check_tile(buf, len);
+	rc = rc && check_restart(buf, len);
+	rc = rc && check_cancel_single_tile();
+	delete[] buf;
+	printf("%s\n", rc ? "passed" : "failed");
+	grk_deinitialize();
+
+	return rc ? 0 : 1;
+}
@@ -0,0 +1,441 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "grok_includes.h"
+
+using namespace grk;
+
+static uint32_t rand_state = 1;
+static uint32_t next_rand(void) {
+	rand_state = rand_state * 1664525U + 1013904223U;
+	return rand_state >> 8;
+}
+
+enum Pattern {
+	PATTERN_RANDOM,
+	/* alternating extremes: largest high pass coefficients */
+	PATTERN_CHECKERBOARD,
+	/* extremes in 2x2 squares, alternating: large coefficients at level 2 */
+	PATTERN_CHECKERBOARD_2
+};
+
+struct Dwt16Case {
+	uint32_t x0, y0, w, h;
+	uint32_t numresolutions;
+	/* sample precision, after DC level shift */
+	uint32_t bits;
+	Pattern pattern;
+};
+
+static const Dwt16Case cases[] = {
+	{ 0, 0, 256, 256, 6, 8, PATTERN_RANDOM },
+	{ 3, 5, 301, 517, 6, 8, PATTERN_RANDOM },
+	{ 1, 0, 1000, 77, 4, 9, PATTERN_RANDOM },
+	{ 0, 1, 37, 1000, 7, 8, PATTERN_RANDOM },
+	{ 7, 9, 3, 300, 5, 10, PATTERN_RANDOM },
+	{ 0, 0, 1, 1, 3, 8, PATTERN_RANDOM },
+	{ 2, 3, 130, 131, 1, 8, PATTERN_RANDOM },
+	{ 0, 0, 128, 128, 7, 8, PATTERN_CHECKERBOARD },
+	{ 1, 1, 129, 127, 6, 9, PATTERN_CHECKERBOARD },
+	{ 0, 0, 256, 256, 7, 8, PATTERN_CHECKERBOARD_2 },
+	{ 1, 0, 97, 200, 6, 9, PATTERN_CHECKERBOARD_2 },
+};
+
+/**
+ * Create tile component with samples of the given precision
+ */
+static TileComponent* create_tilec(const Dwt16Case &c) {
+	auto tilec = new TileComponent();
+	tilec->x0 = c.x0;
+	tilec->y0 = c.y0;
+	tilec->x1 = c.x0 + c.w;
+	tilec->y1 = c.y0 + c.h;
+	tilec->m_is_encoder = false;
+	tilec->numresolutions = c.numresolutions;
+	tilec->minimum_num_resolutions = c.numresolutions;
+	tilec->resolutions = new grk_tcd_resolution[c.numresolutions];
+	for (uint32_t resno = 0; resno < c.numresolutions; ++resno) {
+		uint32_t level = c.numresolutions - 1 - resno;
+		auto res = tilec->resolutions + resno;
+		res->x0 = uint_ceildivpow2(tilec->x0, level);
+		res->y0 = uint_ceildivpow2(tilec->y0, level);
+		res->x1 = uint_ceildivpow2(tilec->x1, level);
+		res->y1 = uint_ceildivpow2(tilec->y1, level);
+	}
+	tilec->create_buffer(nullptr, 1, 1);
+	size_t area = (size_t) c.w * c.h;
+	auto buf = tilec->buf;
+	buf->data = (int32_t*) grk_aligned_malloc(area * sizeof(int32_t));
+	buf->data_size = area * sizeof(int32_t);
+	buf->data_size_needed = buf->data_size;
+	buf->owns_data = true;
+	int32_t lo = -(1 << (c.bits - 1));
+	int32_t hi = (1 << (c.bits - 1)) - 1;
+	for (uint32_t y = 0; y < c.h; ++y) {
+		for (uint32_t x = 0; x < c.w; ++x) {
+			int32_t v;
+			switch (c.pattern) {
+			case PATTERN_CHECKERBOARD:
+				v = ((x + y) & 1) ? lo : hi;
+				break;
+			case PATTERN_CHECKERBOARD_2:
+				v = (((x >> 1) + (y >> 1)) & 1) ? lo : hi;
+				break;
+			default:
+				v = lo + (int32_t) (next_rand() % (uint32_t) (hi - lo + 1));
+				break;
+			}
+			buf->data[(size_t) y * c.w + x] = v;
+		}
+	}
+
+	return tilec;
+}
+
+static bool run(const Dwt16Case &c, uint32_t caseno) {
+	TileProcessor tcd(true);
+	grk_image image;
+	memset(&image, 0, sizeof(image));
+	tcd.image = &image;
+	tcd.m_cp = nullptr;
+
+	size_t area = (size_t) c.w * c.h;
+	uint32_t state = rand_state;
+	auto expected = create_tilec(c);
+	rand_state = state;
+	auto actual = create_tilec(c);
+	std::vector<int32_t> samples(expected->buf->data,
+			expected->buf->data + area);
+	bool rc = true;
+
+	// forward transform: 16 bit coefficients match 32 bit coefficients
+	actual->buf->coeff16 = true;
+	if (!Wavelet::compress(expected, 1) || !Wavelet::compress(actual, 1)) {
+		printf("Case %u: forward transform failed\n", caseno);
+		rc = false;
+	}
+	auto coeff16 = (int16_t*) actual->buf->data;
+	for (size_t i = 0; i < area && rc; ++i) {
+		if (coeff16[i] != expected->buf->data[i]) {
+			printf("Case %u: 16 bit forward transform differs at %u\n", caseno,
+					(uint32_t) i);
+			rc = false;
+		}
+	}
+
+	// inverse transform of the 16 bit coefficients restores the samples
+	if (rc && !decode_53(&tcd, actual, c.numresolutions)) {
+		printf("Case %u: inverse transform failed\n", caseno);
+		rc = false;
+	}
+	if (rc && (actual->buf->coeff16
+			|| memcmp(samples.data(), actual->buf->data,
+					area * sizeof(int32_t)))) {
+		printf("Case %u: 16 bit inverse transform is not lossless\n", caseno);
+		rc = false;
+	}
+	delete actual;
+	delete expected;
+
+	return rc;
+}
+
+/* inverse of the lifting steps of the inverse 9-7 transform in dwt.cpp */
+static const float alpha_97 = 1.586134342f;
+static const float beta_97 = 0.052980118f;
+static const float gamma_97 = -0.882911075f;
+static const float delta_97 = -0.443506852f;
+static const float K_97 = 1.230174105f;
+static const float c13318_97 = 1.625732422f;
+
+static void lift_97(float *d, uint32_t d_n, const float *s, uint32_t s_n,
+		int32_t off, float c) {
+	for (int32_t i = 0; i < (int32_t) d_n; ++i) {
+		int32_t i0 = std::clamp<int32_t>(i + off, 0, (int32_t) s_n - 1);
+		int32_t i1 = std::clamp<int32_t>(i + off + 1, 0, (int32_t) s_n - 1);
+		d[i] += c * (s[i0] + s[i1]);
+	}
+}
+
+/**
+ * Forward 9-7 transform of n samples with the given stride, which
+ * the floating point inverse transform of the decoder undoes
+ */
+static void encode_97(float *a, size_t stride, uint32_t n, uint32_t s_n,
+		uint8_t cas) {
+	uint32_t d_n = n - s_n;
+	if (cas ? !(s_n > 0 || d_n > 1) : !(d_n > 0 || s_n > 1))
+		return;
+	std::vector<float> tmp(n);
+	auto l = tmp.data();
+	auto h = l + s_n;
+	for (uint32_t i = 0; i < s_n; ++i)
+		l[i] = a[(2 * i + cas) * stride];
+	for (uint32_t i = 0; i < d_n; ++i)
+		h[i] = a[(2 * i + 1 - cas) * stride];
+	int32_t off_l = cas ? 0 : -1;
+	int32_t off_h = cas ? -1 : 0;
+	lift_97(h, d_n, l, s_n, off_h, -alpha_97);
+	lift_97(l, s_n, h, d_n, off_l, -beta_97);
+	lift_97(h, d_n, l, s_n, off_h, -gamma_97);
+	lift_97(l, s_n, h, d_n, off_l, -delta_97);
+	for (uint32_t i = 0; i < s_n; ++i)
+		a[i * stride] = l[i] / K_97;
+	for (uint32_t i = 0; i < d_n; ++i)
+		a[(s_n + i) * stride] = h[i] / c13318_97;
+}
+
+static void encode_tile_97(TileComponent *tilec) {
+	auto a = (float*) tilec->buf->data;
+	uint32_t w = tilec->width();
+	for (uint32_t resno = tilec->numresolutions - 1; resno > 0; --resno) {
+		auto res = tilec->resolutions + resno;
+		auto lower = res - 1;
+		uint32_t rw = (uint32_t) (res->x1 - res->x0);
+		uint32_t rh = (uint32_t) (res->y1 - res->y0);
+		for (uint32_t x = 0; x < rw; ++x)
+			encode_97(a + x, w, rh, (uint32_t) (lower->y1 - lower->y0),
+					res->y0 & 1);
+		for (uint32_t y = 0; y < rh; ++y)
+			encode_97(a + (size_t) y * w, 1, rw,
+					(uint32_t) (lower->x1 - lower->x0), res->x0 & 1);
+	}
+}
+
+/* worst and root mean square errors of fixed point samples,
+ * in units of samples scaled down to 8 bits */
+static double max_error_97 = 0;
+static double max_rms_97 = 0;
+
+/**
+ * Compare the 16 bit fixed point inverse 9-7 transform with the float
+ * transform, on coefficients quantized with the given step size
+ */
+static bool run_97(const Dwt16Case &c, uint32_t caseno, float step) {
+	TileProcessor tcd(true);
+	grk_image image;
+	memset(&image, 0, sizeof(image));
+	tcd.image = &image;
+	tcd.m_cp = nullptr;
+
+	size_t area = (size_t) c.w * c.h;
+	auto expected = create_tilec(c);
+	auto coeffs = (float*) expected->buf->data;
+	for (size_t i = 0; i < area; ++i)
+		coeffs[i] = (float) expected->buf->data[i];
+	encode_tile_97(expected);
+	for (size_t i = 0; i < area && step > 0; ++i)
+		coeffs[i] = std::round(coeffs[i] / step) * step;
+
+	auto actual = create_tilec(c);
+	auto buf = actual->buf;
+	memcpy(buf->data, coeffs, area * sizeof(float));
+	buf->coeff16 = true;
+	buf->coeff16_frac_bits = dwt_utils::fix16_97_frac_bits(c.bits);
+	SIMDKernels::get()->narrow_fix16((float*) buf->data,
+			(int16_t*) buf->data, area,
+			(float) (1U << buf->coeff16_frac_bits));
+
+	bool rc = decode_97(&tcd, expected, c.numresolutions)
+			&& decode_97(&tcd, actual, c.numresolutions);
+	if (!rc)
+		printf("Case %u: 9-7 inverse transform failed\n", caseno);
+	// fixed point is used for output precision of 8 bits or less
+	double scale = c.bits > 8 ? 1.0 / (1 << (c.bits - 8)) : 1.0;
+	auto fixed = (float*) buf->data;
+	double sq = 0;
+	for (size_t i = 0; i < area && rc; ++i) {
+		double e = std::fabs(fixed[i] - coeffs[i]) * scale;
+		if (e >= 1) {
+			printf("Case %u: fixed point 9-7 sample %u is %f instead of %f\n",
+					caseno, (uint32_t) i, fixed[i], coeffs[i]);
+			rc = false;
+		}
+		max_error_97 = std::max<double>(max_error_97, e);
+		sq += e * e;
+	}
+	double rms = sqrt(sq / (double) area);
+	max_rms_97 = std::max<double>(max_rms_97, rms);
+	if (rc && rms > 0.25) {
+		printf("Case %u: fixed point 9-7 RMS error %.3f is too high\n", caseno,
+				rms);
+		rc = false;
+	}
+	delete actual;
+	delete expected;
+
+	return rc;
+}
+
+/**
+ * Compress irreversible image of 12 bit samples to buffer,
+ * and return code stream length
+ */
+static size_t compress_97(uint32_t numcomps, uint8_t mct, uint8_t *buf,
+		size_t len) {
+	const uint32_t dim = 256;
+	grk_image_cmptparm cmptparms[3];
+	for (uint32_t i = 0; i < numcomps; ++i) {
+		auto p = cmptparms + i;
+		memset(p, 0, sizeof(*p));
+		p->dx = 1;
+		p->dy = 1;
+		p->w = dim;
+		p->h = dim;
+		p->prec = 12;
+	}
+	auto image = grk_image_create(numcomps, cmptparms,
+			numcomps == 3 ? GRK_CLRSPC_SRGB : GRK_CLRSPC_GRAY);
+	image->x1 = dim;
+	image->y1 = dim;
+	// gradients with noise, and saturated squares
+	for (uint32_t compno = 0; compno < numcomps; ++compno) {
+		auto data = image->comps[compno].data;
+		for (uint32_t y = 0; y < dim; ++y) {
+			for (uint32_t x = 0; x < dim; ++x) {
+				int32_t v = (int32_t) (((x + compno * 50) * 4095) / dim
+						+ (y * 4095) / dim) / 2 + (int32_t) (next_rand() % 257)
+						- 128;
+				if (((x / 16) + (y / 16) + compno) % 7 == 0)
+					v = ((x / 16) & 1) ? 4095 : 0;
+				data[y * dim + x] = std::min<int32_t>(std::max<int32_t>(v, 0),
+						4095);
+			}
+		}
+	}
+	grk_cparameters param;
+	grk_set_default_compress_params(&param);
+	param.irreversible = true;
+	param.tcp_mct = mct;
+	auto stream = grk_stream_create_mem_stream(buf, len, false, false);
+	auto codec = grk_create_compress(GRK_CODEC_J2K, stream);
+	size_t rc = 0;
+	if (grk_init_compress(codec, &param, image) && grk_start_compress(codec)
+			&& grk_compress(codec) && grk_end_compress(codec))
+		rc = grk_stream_get_write_mem_stream_length(stream);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	grk_image_destroy(image);
+
+	return rc;
+}
+
+static grk_image* decompress_97(uint8_t *buf, size_t len,
+		uint32_t output_precision) {
+	grk_dparameters dparam;
+	grk_set_default_decompress_params(&dparam);
+	dparam.output_precision = output_precision;
+	auto stream = grk_stream_create_mem_stream(buf, len, false, true);
+	auto codec = grk_create_decompress(GRK_CODEC_J2K, stream);
+	grk_image *image = nullptr;
+	bool rc = grk_init_decompress(codec, &dparam)
+			&& grk_read_header(codec, nullptr, &image)
+			&& grk_set_decompress_area(codec, image, 0, 0, 0, 0)
+			&& grk_decompress(codec, nullptr, image)
+			&& grk_end_decompress(codec);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	if (!rc) {
+		grk_image_destroy(image);
+		return nullptr;
+	}
+
+	return image;
+}
+
+/**
+ * Decompress irreversible image with and without an output precision of
+ * 8 bits, and check that samples scaled down to 8 bits stay within one,
+ * with and without the irreversible colour transform
+ */
+static bool run_97_decode(uint32_t numcomps, uint8_t mct) {
+	size_t buf_len = (size_t) numcomps * 256 * 256 * 4 + 65536;
+	std::vector<uint8_t> buf(buf_len);
+	size_t len = compress_97(numcomps, mct, buf.data(), buf_len);
+	auto expected = len ? decompress_97(buf.data(), len, 0) : nullptr;
+	auto actual = len ? decompress_97(buf.data(), len, 8) : nullptr;
+	bool rc = expected && actual;
+	if (!rc)
+		printf("%u components, MCT %u: failed to compress or decompress\n",
+				numcomps, mct);
+	double max_error = 0;
+	for (uint32_t compno = 0; compno < numcomps && rc; ++compno) {
+		auto a = expected->comps[compno].data;
+		auto b = actual->comps[compno].data;
+		for (uint32_t i = 0; i < 256 * 256; ++i) {
+			double e = std::abs(a[i] - b[i]) / 16.0;
+			max_error = std::max<double>(max_error, e);
+			if (e > 1) {
+				printf("%u components, MCT %u: component %u sample %u is %d "
+						"instead of %d\n", numcomps, mct, compno, i, b[i], a[i]);
+				rc = false;
+				break;
+			}
+		}
+	}
+	if (rc)
+		printf("%u components, MCT %u: largest 8 bit error %.3f\n", numcomps,
+				mct, max_error);
+	grk_image_destroy(actual);
+	grk_image_destroy(expected);
+
+	return rc;
+}
+
+/**
+ * Check that the 16 bit 5-3 wavelet transforms match the 32 bit
+ * transforms bit for bit, and that the bit depths they are used for
+ * cannot overflow 16 bits. Check that the 16 bit fixed point 9-7
+ * inverse transform stays within one 8 bit sample of the float transform,
+ * also for whole images decompressed with an 8 bit output precision.
+ */
+int main(void) {
+	grk_initialize(nullptr, 0);
+	uint32_t failures = 0;
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		if (!dwt_utils::fits_int16_53(cases[i].bits, cases[i].numresolutions)) {
+			printf("Case %u: does not fit in 16 bits\n", i);
+			failures++;
+			continue;
+		}
+		if (!run(cases[i], i))
+			failures++;
+		for (float step : { 0.0f, 0.5f, 3.0f }) {
+			if (!run_97(cases[i], i, step))
+				failures++;
+		}
+	}
+	printf("Fixed point 9-7: largest error %.3f, largest RMS error %.3f\n",
+			max_error_97, max_rms_97);
+	for (uint8_t mct : { 0, 1 }) {
+		if (!run_97_decode(3, mct))
+			failures++;
+	}
+	if (!run_97_decode(1, 0))
+		failures++;
+	if (!dwt_utils::fits_int16_53(8, 7) || dwt_utils::fits_int16_53(8, 8)
+			|| !dwt_utils::fits_int16_53(9, 6)
+			|| dwt_utils::fits_int16_53(9, 7)
+			|| dwt_utils::fits_int16_53(16, 1)) {
+		printf("Wrong 16 bit bound\n");
+		failures++;
+	}
+	grk_deinitialize();
+	if (!failures)
+		printf("16 bit DWT: all tests passed\n");
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+
+using namespace grk;
+
+static uint32_t rand_state = 1;
+static uint32_t next_rand(void) {
+	rand_state = rand_state * 1664525U + 1013904223U;
+	return rand_state >> 8;
+}
+
+struct BlockedCase {
+	uint32_t x0, y0, w, h;
+	uint32_t numresolutions;
+	/* if true, then tile buffer is replaced rather than copied to */
+	bool owns_data;
+};
+
+static const BlockedCase cases[] = {
+	{ 0, 0, 256, 256, 6, true },
+	{ 3, 5, 301, 517, 6, true },
+	{ 1, 0, 1000, 77, 4, false },
+	{ 0, 1, 37, 1000, 7, true },
+	{ 7, 9, 3, 300, 5, false },
+	{ 0, 0, 1, 1, 3, true },
+	{ 2, 3, 130, 131, 1, true },
+	{ 11, 13, 640, 480, 2, false },
+};
+
+/**
+ * Create tile component with random sub-band samples
+ */
+static TileComponent* create_tilec(const BlockedCase &c, bool irreversible) {
+	auto tilec = new TileComponent();
+	tilec->x0 = c.x0;
+	tilec->y0 = c.y0;
+	tilec->x1 = c.x0 + c.w;
+	tilec->y1 = c.y0 + c.h;
+	tilec->m_is_encoder = false;
+	tilec->numresolutions = c.numresolutions;
+	tilec->minimum_num_resolutions = c.numresolutions;
+	tilec->resolutions = new grk_tcd_resolution[c.numresolutions];
+	for (uint32_t resno = 0; resno < c.numresolutions; ++resno) {
+		uint32_t level = c.numresolutions - 1 - resno;
+		auto res = tilec->resolutions + resno;
+		res->x0 = uint_ceildivpow2(tilec->x0, level);
+		res->y0 = uint_ceildivpow2(tilec->y0, level);
+		res->x1 = uint_ceildivpow2(tilec->x1, level);
+		res->y1 = uint_ceildivpow2(tilec->y1, level);
+	}
+	tilec->create_buffer(nullptr, 1, 1);
+	size_t area = (size_t) c.w * c.h;
+	auto buf = tilec->buf;
+	buf->data = (int32_t*) grk_aligned_malloc(area * sizeof(int32_t));
+	buf->data_size = area * sizeof(int32_t);
+	buf->data_size_needed = buf->data_size;
+	buf->owns_data = c.owns_data;
+	for (size_t i = 0; i < area; ++i) {
+		int32_t v = (int32_t) (next_rand() % 4096) - 2048;
+		if (irreversible) {
+			float f = (float) v / 7.0f;
+			memcpy(buf->data + i, &f, sizeof(f));
+		} else {
+			buf->data[i] = v;
+		}
+	}
+
+	return tilec;
+}
+
+static void destroy_tilec(TileComponent *tilec) {
+	if (!tilec->buf->owns_data) {
+		grk_aligned_free(tilec->buf->data);
+		tilec->buf->data = nullptr;
+	}
+	delete tilec;
+}
+
+static bool run(const BlockedCase &c, uint32_t caseno, bool irreversible) {
+	grk_coding_parameters cp;
+	memset(&cp, 0, sizeof(cp));
+	cp.m_coding_param.m_dec.m_blocked_dwt = true;
+	TileProcessor tcd(true);
+	grk_image image;
+	memset(&image, 0, sizeof(image));
+	tcd.image = &image;
+
+	uint32_t state = rand_state;
+	auto expected = create_tilec(c, irreversible);
+	rand_state = state;
+	auto actual = create_tilec(c, irreversible);
+	bool rc = true;
+
+	tcd.m_cp = nullptr;
+	if (irreversible)
+		rc = decode_97(&tcd, expected, c.numresolutions);
+	else
+		rc = decode_53(&tcd, expected, c.numresolutions);
+	tcd.m_cp = &cp;
+	if (rc) {
+		if (irreversible)
+			rc = decode_97(&tcd, actual, c.numresolutions);
+		else
+			rc = decode_53(&tcd, actual, c.numresolutions);
+	}
+	tcd.m_cp = nullptr;
+	if (!rc) {
+		printf("Case %u, %s: decode failed\n", caseno,
+				irreversible ? "9-7" : "5-3");
+	} else if (memcmp(expected->buf->data, actual->buf->data,
+			(size_t) c.w * c.h * sizeof(int32_t))) {
+		printf("Case %u, %s: blocked inverse transform differs\n", caseno,
+				irreversible ? "9-7" : "5-3");
+		rc = false;
+	}
+	destroy_tilec(actual);
+	destroy_tilec(expected);
+
+	return rc;
+}
+
+/**
+ * Check that the cache blocked inverse wavelet transform
+ * matches the whole tile transform bit for bit, for 5-3 and 9-7
+ */
+int main(void) {
+	grk_initialize(nullptr, 0);
+	uint32_t failures = 0;
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		if (!run(cases[i], i, false))
+			failures++;
+		if (!run(cases[i], i, true))
+			failures++;
+	}
+	grk_deinitialize();
+	if (!failures)
+		printf("Blocked inverse DWT: all tests passed\n");
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+#include "dwt53.h"
+#include "dwt97.h"
+
+using namespace grk;
+
+static uint32_t rand_state = 1;
+static int32_t next_rand(int32_t range) {
+	rand_state = rand_state * 1664525U + 1013904223U;
+	return (int32_t) ((rand_state >> 8) % (uint32_t) (2 * range + 1)) - range;
+}
+
+/**
+ * Compare multi-column vertical and deinterleaved horizontal transforms
+ * against encode_line, for one transform and one length
+ */
+template<typename DWT> static bool check(const char *name, uint32_t len,
+		uint8_t cas, int32_t range) {
+	const uint32_t cols = PLL_COLS_FWD + 3;
+	const uint32_t stride = std::max<uint32_t>(cols, len) + 5;
+	uint32_t s_n = cas ? len / 2 : (len + 1) / 2;
+	uint32_t d_n = len - s_n;
+	std::vector<int32_t> tile(stride * len);
+	for (auto &v : tile)
+		v = next_rand(range);
+	auto expected = tile;
+	auto tmp = (int32_t*) grk_aligned_malloc(
+			(len + 1) * PLL_COLS_FWD * sizeof(int32_t));
+	std::vector<int32_t> line(len);
+	DWT wavelet;
+	bool rc = true;
+
+	// vertical
+	for (uint32_t m = 0; m < cols; ++m) {
+		for (uint32_t k = 0; k < len; ++k)
+			line[k] = expected[m + k * stride];
+		wavelet.encode_line(line.data(), (int32_t) d_n, (int32_t) s_n, cas);
+		dwt_utils::deinterleave_v(line.data(), expected.data() + m, d_n, s_n,
+				stride, cas);
+	}
+	for (uint32_t m = 0; m < cols; m += PLL_COLS_FWD)
+		wavelet.encode_v(tile.data() + m, tmp, d_n, s_n, cas, stride,
+				std::min<uint32_t>(PLL_COLS_FWD, cols - m));
+	if (tile != expected) {
+		printf("%s: vertical transform mismatch, length %u, cas %u\n", name,
+				len, cas);
+		rc = false;
+	}
+
+	// horizontal
+	for (uint32_t k = 0; k < len; ++k) {
+		auto row = tile.data() + k * stride;
+		auto row_expected = expected.data() + k * stride;
+		for (uint32_t m = 0; m < len; ++m)
+			row[m] = row_expected[m] = next_rand(range);
+	}
+	for (uint32_t k = 0; k < len; ++k) {
+		auto row_expected = expected.data() + k * stride;
+		memcpy(line.data(), row_expected, len * sizeof(int32_t));
+		wavelet.encode_line(line.data(), (int32_t) d_n, (int32_t) s_n, cas);
+		dwt_utils::deinterleave_h(line.data(), row_expected, d_n, s_n, cas);
+		wavelet.encode_h(tile.data() + k * stride, tmp, d_n, s_n, cas);
+	}
+	if (tile != expected) {
+		printf("%s: horizontal transform mismatch, length %u, cas %u\n",
+				name, len, cas);
+		rc = false;
+	}
+	grk_aligned_free(tmp);
+
+	return rc;
+}
+
+/**
+ * Check that forward 5-3 and 9-7 lifting on deinterleaved data
+ * matches encode_line exactly, for all lengths and parities that
+ * exercise the boundary and vector code paths
+ */
+int main() {
+	uint32_t failures = 0;
+	for (uint32_t len = 1; len <= 3 * PLL_COLS_FWD + 2; ++len) {
+		for (uint8_t cas = 0; cas < 2; ++cas) {
+			if (!check<dwt53>("5-3", len, cas, 1 << 16))
+				failures++;
+			if (!check<dwt97>("9-7", len, cas, 1 << 16))
+				failures++;
+		}
+	}
+	if (!failures)
+		printf("Forward DWT: all tests passed\n");
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,261 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+
+namespace grk {
+
+static uint32_t rand_state = 1;
+static uint32_t next_rand(void){
+	rand_state = rand_state * 1664525U + 1013904223U;
+	return rand_state >> 8;
+}
+
+const uint32_t dim = 512;
+const uint32_t cblk = 32;
+
+struct EarlyTerminationCase {
+	uint32_t numcomps;
+	uint32_t numresolution;
+	bool irreversible;
+	uint32_t numlayers;
+	double rates[3];
+	// only code blocks sampled by tier 1 are textured, so that the
+	// estimated slope threshold is far too high, and the tile is re-coded
+	bool textured_sampled;
+};
+
+static const EarlyTerminationCase cases[] = {
+	{ 1, 6, true, 1, { 20 }, false },
+	{ 3, 5, true, 1, { 50 }, false },
+	{ 1, 6, false, 1, { 10 }, false },
+	{ 3, 6, true, 3, { 80, 30, 10 }, false },
+	{ 1, 1, true, 1, { 8 }, true },
+};
+
+static grk_image* create_image(const EarlyTerminationCase &c) {
+	grk_image_cmptparm cmptparms[3];
+	for (uint32_t i = 0; i < c.numcomps; ++i) {
+		auto p = cmptparms + i;
+		memset(p, 0, sizeof(*p));
+		p->dx = 1;
+		p->dy = 1;
+		p->w = dim;
+		p->h = dim;
+		p->prec = 8;
+	}
+	auto image = grk_image_create(c.numcomps, cmptparms,
+			c.numcomps == 3 ? GRK_CLRSPC_SRGB : GRK_CLRSPC_GRAY);
+	image->x1 = dim;
+	image->y1 = dim;
+	rand_state = 1;
+	uint32_t blocks_wide = dim / cblk;
+	for (uint32_t compno = 0; compno < c.numcomps; ++compno) {
+		auto data = image->comps[compno].data;
+		for (uint32_t y = 0; y < dim; ++y) {
+			for (uint32_t x = 0; x < dim; ++x) {
+				uint64_t i = (y / cblk) * blocks_wide + x / cblk;
+				bool textured = !c.textured_sampled
+						|| (uint32_t) (i * 2654435761U) < UINT_MAX / 8;
+				if (!textured) {
+					data[y * dim + x] = 128;
+					continue;
+				}
+				// smooth waves, with noise that grows across the image
+				double v = 128 + 60 * sin((x + compno * 17) / 23.0)
+						* cos(y / 37.0) + 30 * sin((x + y) / 91.0);
+				v += (double) ((int32_t) (next_rand() % 33) - 16)
+						* (x + y) / (2 * dim);
+				data[y * dim + x] = std::min<int32_t>(
+						std::max<int32_t>((int32_t) v, 0), 255);
+			}
+		}
+	}
+
+	return image;
+}
+
+static bool recoded = false;
+static void info_callback(const char *msg, void *client_data) {
+	(void) client_data;
+	if (strstr(msg, "coding all passes"))
+		recoded = true;
+}
+
+/**
+ * Compress new image to buffer, and return code stream length,
+ * together with the number of coded passes
+ */
+static size_t compress(const EarlyTerminationCase &c, bool early_termination,
+		uint8_t *buf, size_t len, uint64_t *passes) {
+	auto image = create_image(c);
+	grk_cparameters param;
+	grk_set_default_compress_params(&param);
+	param.numresolution = c.numresolution;
+	param.cblockw_init = cblk;
+	param.cblockh_init = cblk;
+	param.irreversible = c.irreversible;
+	param.tcp_mct = c.numcomps == 3 ? 1 : 0;
+	param.tcp_numlayers = c.numlayers;
+	param.cp_disto_alloc = 1;
+	for (uint32_t i = 0; i < c.numlayers; ++i)
+		param.tcp_rates[i] = c.rates[i];
+	param.early_termination = early_termination;
+	auto stream = grk_stream_create_mem_stream(buf, len, false, false);
+	auto codec = grk_create_compress(GRK_CODEC_J2K, stream);
+	size_t rc = 0;
+	uint32_t num_threads = 0;
+	*passes = 0;
+	if (grk_init_compress(codec, &param, image) && grk_start_compress(codec)
+			&& grk_compress(codec) && grk_end_compress(codec)
+			&& grk_get_t1_encode_stats(codec, nullptr, &num_threads)) {
+		std::vector<grk_t1_thread_stats> stats(num_threads);
+		if (grk_get_t1_encode_stats(codec, stats.data(), &num_threads)) {
+			for (auto &s : stats)
+				*passes += s.passes;
+			rc = grk_stream_get_write_mem_stream_length(stream);
+		}
+	}
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	grk_image_destroy(image);
+
+	return rc;
+}
+
+static grk_image* decompress(uint8_t *buf, size_t len) {
+	grk_dparameters dparam;
+	grk_set_default_decompress_params(&dparam);
+	auto stream = grk_stream_create_mem_stream(buf, len, false, true);
+	auto codec = grk_create_decompress(GRK_CODEC_J2K, stream);
+	grk_image *image = nullptr;
+	bool rc = grk_init_decompress(codec, &dparam)
+			&& grk_read_header(codec, nullptr, &image)
+			&& grk_set_decompress_area(codec, image, 0, 0, 0, 0)
+			&& grk_decompress(codec, nullptr, image)
+			&& grk_end_decompress(codec);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	if (!rc) {
+		grk_image_destroy(image);
+		return nullptr;
+	}
+
+	return image;
+}
+
+/**
+ * PSNR of decompressed code stream against the original image
+ */
+static double psnr(const EarlyTerminationCase &c, uint8_t *buf, size_t len) {
+	auto decompressed = decompress(buf, len);
+	if (!decompressed)
+		return 0;
+	auto original = create_image(c);
+	double sse = 0;
+	for (uint32_t compno = 0; compno < c.numcomps; ++compno) {
+		auto a = original->comps[compno].data;
+		auto b = decompressed->comps[compno].data;
+		for (uint32_t i = 0; i < dim * dim; ++i) {
+			double d = a[i] - b[i];
+			sse += d * d;
+		}
+	}
+	grk_image_destroy(original);
+	grk_image_destroy(decompressed);
+	double mse = sse / ((double) dim * dim * c.numcomps);
+
+	return mse > 0 ? 10 * log10(255.0 * 255.0 / mse) : 100;
+}
+
+static bool run(const EarlyTerminationCase &c, uint32_t caseno) {
+	size_t buf_len = (size_t) c.numcomps * dim * dim * 2 + 65536;
+	std::vector<uint8_t> full(buf_len);
+	std::vector<uint8_t> early(buf_len);
+	uint64_t full_passes = 0;
+	uint64_t early_passes = 0;
+	size_t full_len = compress(c, false, full.data(), buf_len, &full_passes);
+	recoded = false;
+	grk_set_info_handler(info_callback, nullptr);
+	size_t early_len = full_len ?
+			compress(c, true, early.data(), buf_len, &early_passes) : 0;
+	grk_set_info_handler(nullptr, nullptr);
+	if (!early_len) {
+		printf("Case %u: failed to compress\n", caseno);
+		return false;
+	}
+	// rates are compression ratios of the raw 8 bit samples
+	size_t target = (size_t) ((double) c.numcomps * dim * dim
+			/ c.rates[c.numlayers - 1]);
+	double full_psnr = psnr(c, full.data(), full_len);
+	double early_psnr = psnr(c, early.data(), early_len);
+	printf("Case %u: %zu bytes, %.2f dB, %" PRIu64 " passes; early termination "
+			"%zu bytes, %.2f dB, %" PRIu64 " passes%s\n", caseno, full_len,
+			full_psnr, full_passes, early_len, early_psnr, early_passes,
+			recoded ? ", re-coded" : "");
+	// rate control may overshoot the target by a few bytes of markers,
+	// and early termination must not make that worse
+	if (early_len > std::max(target, full_len)) {
+		printf("Case %u: %zu bytes exceed target of %zu bytes\n", caseno,
+				early_len, target);
+		return false;
+	}
+	if (early_psnr < full_psnr - 0.1) {
+		printf("Case %u: PSNR dropped by %.2f dB\n", caseno,
+				full_psnr - early_psnr);
+		return false;
+	}
+	if (recoded != c.textured_sampled) {
+		printf("Case %u: tile was %sre-coded\n", caseno, recoded ? "" : "not ");
+		return false;
+	}
+	if (!recoded && early_passes >= full_passes) {
+		printf("Case %u: no coding passes were skipped\n", caseno);
+		return false;
+	}
+	// a re-coded tile has all its passes, like a full encode
+	if (recoded && (early_len != full_len
+			|| memcmp(early.data(), full.data(), full_len))) {
+		printf("Case %u: re-coded code stream differs from full encode\n",
+				caseno);
+		return false;
+	}
+
+	return true;
+}
+
+}
+
+using namespace grk;
+
+/**
+ * Compress images at fixed rates with and without early termination of
+ * tier 1 coding passes, and check that early termination stays within the
+ * target size, at nearly the same quality.
+ */
+int main(void)
+{
+	grk_initialize(nullptr, 0);
+	uint32_t failures = 0;
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		if (!run(cases[i], i))
+			failures++;
+	}
+	grk_deinitialize();
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ojph_block_decoder.h"
+#include "ojph_block_encoder.h"
+#include "ojph_mem.h"
+using namespace ojph;
+using namespace ojph::local;
+
+#include "grok_includes.h"
+
+namespace grk {
+
+static uint32_t rand_state = 1;
+static uint32_t next_rand(void){
+	rand_state = rand_state * 1664525U + 1013904223U;
+	return rand_state >> 8;
+}
+
+void usage(void)
+{
+    printf(
+        "test_ht_block_decoder [-num_blocks value] [-seed value]\n");
+}
+
+}
+
+using namespace grk;
+
+/**
+ * Encode random code blocks with the HT block encoder, and check that
+ * the quad pair MagSgn decoder of every SIMD level matches the serial
+ * decoder bit for bit. Also corrupt some of the blocks, and check that
+ * the decoder either rejects them or writes every sample.
+ */
+int main(int argc, char** argv)
+{
+	uint32_t num_blocks = 2000;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-num_blocks") == 0 && i + 1 < argc) {
+			num_blocks = (uint32_t)atoi(argv[i + 1]);
+			i++;
+		} else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+			rand_state = (uint32_t)atoi(argv[i + 1]);
+			i++;
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	// MagSgn kernels of every level supported by build and CPU
+	SIMDKernels kernels[SIMD_NUM_LEVELS];
+	uint32_t num_levels = 0;
+	for (uint32_t level = SIMD_SCALAR; level < SIMD_NUM_LEVELS; ++level) {
+		if (SIMDKernels::select(kernels + num_levels, (SIMDLevel) level))
+			num_levels++;
+	}
+
+	const uint32_t max_samples = 4096;
+	const uint32_t pad = 16;
+	auto src = new int32_t[max_samples];
+	auto dest = new int32_t[max_samples];
+	auto dest_serial = new int32_t[max_samples];
+	auto elastic = new mem_elastic_allocator(1048576);
+	uint32_t failures = 0;
+	uint32_t corrupt_failures = 0;
+	uint32_t corrupt_rejected = 0;
+	uint64_t significant = 0;
+
+	for (uint32_t b = 0; b < num_blocks; ++b) {
+		// width up to 256, as covered by the decoder's sigma arrays,
+		// height up to 1024, with at most 4096 samples
+		uint32_t w = 1 + next_rand() % (1 << (next_rand() % 9));
+		uint32_t h = 1 + next_rand() % std::min<uint32_t>(max_samples / w, 1024);
+		uint32_t k_msbs = next_rand() % 30;
+		uint32_t shift = 31 - (k_msbs + 1);
+		uint32_t density = next_rand() % 101;
+		uint32_t mag_bits = 1 + next_rand() % (k_msbs + 1);
+
+		// sign-magnitude samples, as prepared by T1HT::preEncode
+		for (uint32_t i = 0; i < w * h; ++i) {
+			uint32_t mag = 0;
+			if (next_rand() % 100 < density)
+				mag = next_rand() & ((1U << mag_bits) - 1);
+			uint32_t sign = (next_rand() & 1) ? 0x80000000 : 0;
+			src[i] = (int32_t) (sign | (mag << shift));
+		}
+
+		int lengths[2] = { 0, 0 };
+		coded_lists *coded = nullptr;
+		ojph_encode_codeblock(src, (int) k_msbs, 1, (int) w, (int) h, (int) w,
+				lengths, elastic, coded);
+		// stream readers may fetch whole words on either side of the data
+		auto coded_buf = new uint8_t[(size_t) lengths[0] + 2 * pad];
+		memset(coded_buf, 0, (size_t) lengths[0] + 2 * pad);
+		auto coded_data = coded_buf + pad;
+		memcpy(coded_data, coded->buf, (size_t) lengths[0]);
+
+		memset(dest_serial, 0x5A, w * h * sizeof(int32_t));
+		ojph_decode_codeblock_serial(coded_data, dest_serial, (int) k_msbs, 1,
+				lengths[0], 0, (int) w, (int) h, (int) w);
+		for (uint32_t l = 0; l < num_levels; ++l) {
+			auto decode_magsgn = kernels[l].ht_decode_magsgn;
+			memset(dest, 0xA5, w * h * sizeof(int32_t));
+			ojph_decode_codeblock(decode_magsgn, coded_data, dest, (int) k_msbs,
+					1, lengths[0], 0, (int) w, (int) h, (int) w);
+			for (uint32_t i = 0; i < w * h; ++i) {
+				if (dest[i] != dest_serial[i]) {
+					printf("%s, block %u (%ux%u, k_msbs %u): mismatch at "
+							"(%u,%u): 0x%08x != 0x%08x\n",
+							SIMDKernels::name(kernels[l].level), b, w, h, k_msbs,
+							i % w, i / w, (uint32_t) dest[i],
+							(uint32_t) dest_serial[i]);
+					failures++;
+					break;
+				}
+			}
+		}
+		for (uint32_t i = 0; i < w * h; ++i) {
+			if (dest_serial[i] & 0x7FFFFFFF)
+				significant++;
+		}
+		bool corrupt_mismatch = false;
+#ifdef NDEBUG
+		// the decoder asserts on corrupt data in debug builds
+		for (uint32_t l = 0; l < num_levels && lengths[0] > 2; ++l) {
+			// corrupt bytes ahead of the segment lengths: decoding is
+			// garbage, but every sample must still be written, whatever
+			// the destination held before
+			auto corrupt_buf = new uint8_t[(size_t) lengths[0] + 2 * pad];
+			memcpy(corrupt_buf, coded_buf, (size_t) lengths[0] + 2 * pad);
+			uint32_t num_corrupt = 1 + next_rand() % 4;
+			for (uint32_t i = 0; i < num_corrupt; ++i)
+				corrupt_buf[pad + next_rand() % (uint32_t) (lengths[0] - 2)] =
+						(uint8_t) next_rand();
+			auto corrupt_a = new int32_t[w * h];
+			auto corrupt_b = new int32_t[w * h];
+			memset(corrupt_a, 0xA5, w * h * sizeof(int32_t));
+			memset(corrupt_b, 0x5A, w * h * sizeof(int32_t));
+			// the decoder may also reject the block, by throwing
+			uint32_t num_rejected = 0;
+			for (auto corrupt_dest : { corrupt_a, corrupt_b }) {
+				try {
+					ojph_decode_codeblock(kernels[l].ht_decode_magsgn,
+							corrupt_buf + pad, corrupt_dest, (int) k_msbs, 1,
+							lengths[0], 0, (int) w, (int) h, (int) w);
+				} catch (std::runtime_error&) {
+					num_rejected++;
+				}
+			}
+			corrupt_rejected += num_rejected ? 1 : 0;
+			corrupt_mismatch |= num_rejected == 1
+					|| (num_rejected == 0 && memcmp(corrupt_a, corrupt_b,
+							w * h * sizeof(int32_t)) != 0);
+			delete[] corrupt_b;
+			delete[] corrupt_a;
+			delete[] corrupt_buf;
+		}
+#endif
+		if (corrupt_mismatch) {
+			printf("Block %u (%ux%u, k_msbs %u): corrupt block is not "
+					"fully decoded\n", b, w, h, k_msbs);
+			corrupt_failures++;
+		}
+		delete[] coded_buf;
+	}
+	delete elastic;
+	delete[] dest_serial;
+	delete[] dest;
+	delete[] src;
+
+	printf("Levels:");
+	for (uint32_t l = 0; l < num_levels; ++l)
+		printf(" %s", SIMDKernels::name(kernels[l].level));
+	printf("\n%u blocks, %llu significant samples, %u mismatched blocks, "
+			"%u rejected and %u partly decoded corrupt blocks\n", num_blocks,
+			(unsigned long long) significant, failures, corrupt_rejected,
+			corrupt_failures);
+
+	return (failures || corrupt_failures) ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "ojph_block_decoder.h"
+#include "ojph_block_encoder.h"
+#include "ojph_mem.h"
+using namespace ojph;
+using namespace ojph::local;
+
+#include "grok_includes.h"
+#include "BlockQuantizer.h"
+
+namespace grk {
+
+static uint32_t rand_state = 1;
+static uint32_t next_rand(void){
+	rand_state = rand_state * 1664525U + 1013904223U;
+	return rand_state >> 8;
+}
+
+void usage(void)
+{
+    printf(
+        "test_ht_block_encoder [-num_blocks value] [-seed value]\n");
+}
+
+}
+
+using namespace grk;
+
+/**
+ * Quantize random code blocks and encode them with the HT block encoder.
+ * Check that quantization matches the per-sample formula, that the
+ * encoder output is byte-identical to the serial encoder, and that
+ * decoding recovers the quantization indices.
+ */
+int main(int argc, char** argv)
+{
+	uint32_t num_blocks = 2000;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-num_blocks") == 0 && i + 1 < argc) {
+			num_blocks = (uint32_t)atoi(argv[i + 1]);
+			i++;
+		} else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+			rand_state = (uint32_t)atoi(argv[i + 1]);
+			i++;
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	const uint32_t max_samples = 4096;
+	const uint32_t max_stride = 1024 + 7;
+	const uint32_t pad = 16;
+	auto coeffs = new int32_t[max_stride * 1024];
+	auto src = new int32_t[max_samples];
+	auto dest = new int32_t[max_samples];
+	auto elastic = new mem_elastic_allocator(1048576);
+	uint32_t failures = 0;
+
+	for (uint32_t b = 0; b < num_blocks; ++b) {
+		// width up to 256, as covered by the decoder's sigma arrays,
+		// height up to 1024, with at most 4096 samples
+		uint32_t w = 1 + next_rand() % (1 << (next_rand() % 9));
+		uint32_t h = 1 + next_rand() % std::min<uint32_t>(max_samples / w, 1024);
+		uint32_t stride = w + next_rand() % 8;
+		bool reversible = next_rand() & 1;
+		uint32_t k_msbs = next_rand() % (reversible ? 30 : 20);
+		int32_t shift = 31 - (int32_t)(k_msbs + 1);
+		float inv_step = 1.0f;
+		// irreversible coefficients must quantize to less than 2^11
+		uint32_t mag_bits = 1 + next_rand() % (reversible ? k_msbs + 1 : 10);
+		if (!reversible) {
+			shift -= 11;
+			inv_step = 0.5f + (float)(next_rand() % 1024) / 1024.0f;
+		}
+		uint32_t density = next_rand() % 101;
+		for (uint32_t j = 0; j < h; ++j) {
+			for (uint32_t i = 0; i < w; ++i) {
+				int32_t mag = 0;
+				if (next_rand() % 100 < density)
+					mag = (int32_t)(next_rand() & ((1U << mag_bits) - 1));
+				coeffs[j * stride + i] = (next_rand() & 1) ? -mag : mag;
+			}
+		}
+
+		auto quantizer = BlockQuantizer::ht(reversible, shift, inv_step);
+		uint32_t maximum = quantizer.quantize(coeffs, stride, src, w, h);
+		uint32_t expected_max = 0;
+		bool ok = true;
+		for (uint32_t j = 0; j < h && ok; ++j) {
+			for (uint32_t i = 0; i < w; ++i) {
+				int32_t temp = coeffs[j * stride + i];
+				uint32_t res;
+				if (reversible) {
+					uint32_t val = (uint32_t)(temp >= 0 ? temp : -temp);
+					res = (temp >= 0 ? 0U : 0x80000000) | (val << shift);
+					expected_max = std::max(expected_max, res);
+				} else {
+					int32_t t = (int32_t)((float)temp * inv_step * (float)(1 << shift));
+					uint32_t val = (uint32_t)(t >= 0 ? t : -t);
+					res = (t >= 0 ? 0U : 0x80000000) | val;
+					expected_max = std::max(expected_max, val);
+				}
+				if ((uint32_t)src[j * w + i] != res) {
+					printf("Block %u: quantization mismatch at (%u,%u)\n", b, i, j);
+					ok = false;
+					break;
+				}
+			}
+		}
+		if (ok && maximum != expected_max) {
+			printf("Block %u: maximum 0x%08x != 0x%08x\n", b, maximum, expected_max);
+			ok = false;
+		}
+
+		int lengths[2] = { 0, 0 }, lengths_serial[2] = { 0, 0 };
+		coded_lists *coded = nullptr, *coded_serial = nullptr;
+		ojph_encode_codeblock(src, (int) k_msbs, 1, (int) w, (int) h, (int) w,
+				lengths, elastic, coded);
+		ojph_encode_codeblock_serial(src, (int) k_msbs, 1, (int) w, (int) h,
+				(int) w, lengths_serial, elastic, coded_serial);
+		if (ok && (lengths[0] != lengths_serial[0] ||
+				memcmp(coded->buf, coded_serial->buf, (size_t) lengths[0]))) {
+			printf("Block %u (%ux%u, k_msbs %u): encoder output differs\n", b,
+					w, h, k_msbs);
+			ok = false;
+		}
+
+		// stream readers may fetch whole words on either side of the data
+		auto coded_buf = new uint8_t[(size_t) lengths[0] + 2 * pad];
+		memset(coded_buf, 0, (size_t) lengths[0] + 2 * pad);
+		auto coded_data = coded_buf + pad;
+		memcpy(coded_data, coded->buf, (size_t) lengths[0]);
+		ojph_decode_codeblock(coded_data, dest, (int) k_msbs, 1, lengths[0],
+				0, (int) w, (int) h, (int) w);
+		delete[] coded_buf;
+		int32_t p = 30 - (int32_t)k_msbs;
+		for (uint32_t i = 0; i < w * h && ok; ++i) {
+			uint32_t index = ((uint32_t)src[i] & 0x7FFFFFFF) >> p;
+			uint32_t decoded = ((uint32_t)dest[i] & 0x7FFFFFFF) >> p;
+			if (index != decoded ||
+					(index && ((src[i] ^ dest[i]) & 0x80000000))) {
+				printf("Block %u (%ux%u, k_msbs %u): round trip mismatch at "
+						"(%u,%u)\n", b, w, h, k_msbs, i % w, i / w);
+				ok = false;
+			}
+		}
+		if (!ok)
+			failures++;
+
+		// release coded buffers from time to time
+		if ((b & 0xFF) == 0xFF) {
+			delete elastic;
+			elastic = new mem_elastic_allocator(1048576);
+		}
+	}
+	delete elastic;
+	delete[] dest;
+	delete[] src;
+	delete[] coeffs;
+
+	printf("%u blocks, %u failed\n", num_blocks, failures);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "grok_includes.h"
+
+using namespace grk;
+
+#define CHECK(cond) \
+	if (!(cond)) { \
+		printf("line %d: check failed: %s\n", __LINE__, #cond); \
+		return false; \
+	}
+
+/* nested frames release in LIFO order, and buffers are aligned and disjoint */
+static bool check_nesting(void) {
+	auto arena = ScratchArena::local();
+	ScratchArena::Frame outer;
+	auto a = arena->alloc<int32_t>(1000);
+	CHECK(a && ((size_t) a & 63) == 0);
+	memset(a, 1, 1000 * sizeof(int32_t));
+	uint8_t *first_inner = nullptr;
+	for (int i = 0; i < 3; ++i) {
+		ScratchArena::Frame inner;
+		auto b = arena->alloc<uint8_t>(33);
+		CHECK(b && ((size_t) b & 63) == 0);
+		CHECK(b >= (uint8_t* )(a + 1000) || b + 33 <= (uint8_t* )a);
+		// an inner frame reuses the memory of the previous one
+		if (!first_inner)
+			first_inner = b;
+		CHECK(b == first_inner);
+		memset(b, 2, 33);
+	}
+	for (int i = 0; i < 1000; ++i)
+		CHECK(a[i] == 0x01010101);
+
+	return true;
+}
+
+/* growth keeps earlier buffers valid, then settles in one chunk */
+static bool check_growth(void) {
+	auto arena = ScratchArena::local();
+	std::vector<uint8_t*> bufs;
+	{
+		ScratchArena::Frame frame;
+		for (uint32_t i = 0; i < 12; ++i) {
+			size_t len = (size_t) 4096 << i;
+			auto p = arena->alloc<uint8_t>(len);
+			CHECK(p);
+			memset(p, (int) i, len);
+			bufs.push_back(p);
+		}
+		for (uint32_t i = 0; i < 12; ++i)
+			CHECK(bufs[i][0] == i && bufs[i][((size_t) 4096 << i) - 1] == i);
+	}
+	size_t capacity = arena->capacity();
+	size_t high_water = arena->high_water();
+	CHECK(high_water >= ((size_t) 4096 << 12) - 4096);
+	CHECK(capacity >= high_water);
+	{
+		// steady state: the same working set needs no new memory
+		ScratchArena::Frame frame;
+		for (uint32_t i = 0; i < 12; ++i)
+			CHECK(arena->alloc<uint8_t>((size_t) 4096 << i));
+		CHECK(arena->capacity() == capacity);
+	}
+	CHECK(arena->high_water() == high_water);
+
+	return true;
+}
+
+/* trim frees idle arenas only */
+static bool check_trim(void) {
+	auto arena = ScratchArena::local();
+	{
+		ScratchArena::Frame frame;
+		CHECK(arena->alloc(1 << 20));
+		// arena is busy
+		ScratchArena::trim_all();
+		CHECK(arena->capacity());
+		CHECK(arena->trim() == 0);
+	}
+	CHECK(arena->capacity());
+	CHECK(ScratchArena::trim_all() >= (1 << 20));
+	CHECK(arena->capacity() == 0);
+	{
+		ScratchArena::Frame frame;
+		CHECK(arena->alloc(100));
+	}
+	CHECK(arena->capacity());
+
+	return true;
+}
+
+/* each pool worker draws from its own arena */
+static bool check_threads(void) {
+	auto pool = ThreadPool::get();
+	std::atomic_bool rc(true);
+	pool->parallel_for(64, [&rc](size_t index) {
+		ScratchArena::Frame frame;
+		auto n = 1000 + index * 100;
+		auto p = ScratchArena::local()->alloc<uint64_t>(n);
+		if (!p) {
+			rc = false;
+			return;
+		}
+		for (size_t i = 0; i < n; ++i)
+			p[i] = index;
+		std::this_thread::yield();
+		for (size_t i = 0; i < n; ++i) {
+			if (p[i] != index)
+				rc = false;
+		}
+	});
+	CHECK(rc);
+	CHECK(ScratchArena::peak_held() >= ScratchArena::held());
+	ScratchArena::trim_all();
+	CHECK(ScratchArena::held() == 0);
+
+	return true;
+}
+
+/**
+ * Check nesting, growth, trimming and per thread ownership of scratch arenas
+ */
+int main(void) {
+	grk_initialize(nullptr, 4);
+	bool rc = check_nesting();
+	rc = check_growth() && rc;
+	rc = check_trim() && rc;
+	rc = check_threads() && rc;
+	printf("scratch high water: %llu bytes\n",
+			(unsigned long long) grk_scratch_high_water());
+	printf("%s\n", rc ? "passed" : "failed");
+	grk_deinitialize();
+
+	return rc ? 0 : 1;
+}
@@ -0,0 +1,420 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "grok_includes.h"
+
+using namespace grk;
+
+static uint32_t rand_state = 1;
+static int32_t next_rand(int32_t range) {
+	rand_state = rand_state * 1664525U + 1013904223U;
+	return (int32_t) ((rand_state >> 8) % (uint32_t) (2 * range + 1)) - range;
+}
+
+static void fill(std::vector<int32_t> &v, int32_t range) {
+	for (auto &x : v)
+		x = next_rand(range);
+}
+
+/* lengths cover empty runs, vector tails and unaligned starts */
+const uint32_t max_len = 75;
+
+static bool check_mct(const SIMDKernels &ref, const SIMDKernels &k) {
+	const mct_kernel ref_fns[] = { ref.rct_encode, ref.rct_decode,
+			ref.ict_encode };
+	const mct_kernel fns[] = { k.rct_encode, k.rct_decode, k.ict_encode };
+	const char *names[] = { "rct_encode", "rct_decode", "ict_encode" };
+	for (uint32_t f = 0; f < 3; ++f) {
+		for (uint32_t off = 0; off < 3; ++off) {
+			for (uint32_t n = 0; n <= max_len; ++n) {
+				std::vector<int32_t> expected(3 * (n + off));
+				fill(expected, 1 << 16);
+				auto actual = expected;
+				auto e = expected.data() + off;
+				auto a = actual.data() + off;
+				ref_fns[f](e, e + n + off, e + 2 * (n + off), n);
+				fns[f](a, a + n + off, a + 2 * (n + off), n);
+				if (expected != actual) {
+					printf("%s: %s differs for %u samples\n",
+							SIMDKernels::name(k.level), names[f], n);
+					return false;
+				}
+			}
+		}
+	}
+	for (uint32_t n = 0; n <= max_len; ++n) {
+		std::vector<float> expected(3 * n);
+		for (auto &x : expected)
+			x = (float) next_rand(1 << 12) / 3.0f;
+		auto actual = expected;
+		ref.ict_decode(expected.data(), expected.data() + n,
+				expected.data() + 2 * n, n);
+		k.ict_decode(actual.data(), actual.data() + n, actual.data() + 2 * n,
+				n);
+		if (n && memcmp(expected.data(), actual.data(), 3 * n * sizeof(float))) {
+			printf("%s: ict_decode differs for %u samples\n",
+					SIMDKernels::name(k.level), n);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool check_dequantize(const SIMDKernels &ref, const SIMDKernels &k) {
+	for (uint32_t ht = 0; ht < 2; ++ht) {
+		for (uint32_t rev = 0; rev < 2; ++rev) {
+			for (uint32_t roi = 0; roi < 2; ++roi) {
+				auto ref_fn = ht ? ref.dequantize_ht[rev][roi] :
+						ref.dequantize_part1[rev][roi];
+				auto fn = ht ? k.dequantize_ht[rev][roi] :
+						k.dequantize_part1[rev][roi];
+				uint32_t roishift = roi ? 7 : 0;
+				for (uint32_t n = 0; n <= max_len; ++n) {
+					std::vector<int32_t> src(n);
+					for (auto &x : src) {
+						int32_t v = next_rand(roi ? (1 << 26) : (1 << 18));
+						// HT samples are sign-magnitude
+						x = (ht && v < 0) ? (int32_t) (0x80000000 | (uint32_t) -v) : v;
+					}
+					std::vector<int32_t> expected(n), actual(n);
+					ref_fn(src.data(), expected.data(), n, roishift, 3, 0.37f);
+					fn(src.data(), actual.data(), n, roishift, 3, 0.37f);
+					if (expected != actual) {
+						printf("%s: %s dequantization (rev %u, roi %u) differs for %u samples\n",
+								SIMDKernels::name(k.level), ht ? "HT" : "part 1",
+								rev, roi, n);
+						return false;
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool check_lift(const SIMDKernels &ref, const SIMDKernels &k) {
+	const lift_kernel ref_fns[] = { ref.encode_53_h, ref.encode_97_h,
+			ref.decode_53_h, ref.encode_53_v, ref.encode_97_v, ref.decode_53_v };
+	const lift_kernel fns[] = { k.encode_53_h, k.encode_97_h, k.decode_53_h,
+			k.encode_53_v, k.encode_97_v, k.decode_53_v };
+	const char *names[] = { "encode_53_h", "encode_97_h", "decode_53_h",
+			"encode_53_v", "encode_97_v", "decode_53_v" };
+	auto expected = (int32_t*) grk_aligned_malloc(
+			max_len * PLL_COLS_FWD * sizeof(int32_t));
+	auto actual = (int32_t*) grk_aligned_malloc(
+			max_len * PLL_COLS_FWD * sizeof(int32_t));
+	bool rc = true;
+	for (uint32_t f = 0; f < 6 && rc; ++f) {
+		// vertical kernels work on rows of PLL_COLS_FWD samples
+		size_t cols = f < 3 ? 1 : PLL_COLS_FWD;
+		for (uint32_t n = 1; n <= max_len && rc; ++n) {
+			for (uint8_t cas = 0; cas < 2 && rc; ++cas) {
+				int32_t s_n = (int32_t) (cas ? n / 2 : (n + 1) / 2);
+				int32_t d_n = (int32_t) n - s_n;
+				for (size_t i = 0; i < n * cols; ++i)
+					expected[i] = next_rand(1 << 16);
+				memcpy(actual, expected, n * cols * sizeof(int32_t));
+				ref_fns[f](expected, expected + s_n * cols, d_n, s_n, cas);
+				fns[f](actual, actual + s_n * cols, d_n, s_n, cas);
+				if (memcmp(expected, actual, n * cols * sizeof(int32_t))) {
+					printf("%s: %s differs for length %u, cas %u\n",
+							SIMDKernels::name(k.level), names[f], n, cas);
+					rc = false;
+				}
+			}
+		}
+	}
+	grk_aligned_free(expected);
+	grk_aligned_free(actual);
+
+	return rc;
+}
+
+/**
+ Inverse 5-3 lifting must restore the samples of the forward transform
+ */
+static bool check_lift_53_roundtrip(const SIMDKernels &k) {
+	const lift_kernel encode[] = { k.encode_53_h, k.encode_53_v };
+	const lift_kernel decode[] = { k.decode_53_h, k.decode_53_v };
+	auto orig = (int32_t*) grk_aligned_malloc(
+			max_len * PLL_COLS_FWD * sizeof(int32_t));
+	auto actual = (int32_t*) grk_aligned_malloc(
+			max_len * PLL_COLS_FWD * sizeof(int32_t));
+	bool rc = true;
+	for (uint32_t f = 0; f < 2 && rc; ++f) {
+		size_t cols = f ? PLL_COLS_FWD : 1;
+		for (uint32_t n = 1; n <= max_len && rc; ++n) {
+			for (uint8_t cas = 0; cas < 2 && rc; ++cas) {
+				int32_t s_n = (int32_t) (cas ? n / 2 : (n + 1) / 2);
+				int32_t d_n = (int32_t) n - s_n;
+				for (size_t i = 0; i < n * cols; ++i)
+					orig[i] = next_rand(1 << 16);
+				memcpy(actual, orig, n * cols * sizeof(int32_t));
+				encode[f](actual, actual + s_n * cols, d_n, s_n, cas);
+				decode[f](actual, actual + s_n * cols, d_n, s_n, cas);
+				if (memcmp(orig, actual, n * cols * sizeof(int32_t))) {
+					printf("%s: 5-3 %s round trip differs for length %u, "
+							"cas %u\n", SIMDKernels::name(k.level),
+							f ? "vertical" : "horizontal", n, cas);
+					rc = false;
+				}
+			}
+		}
+	}
+	grk_aligned_free(orig);
+	grk_aligned_free(actual);
+
+	return rc;
+}
+
+static bool check_lift_float(const SIMDKernels &ref, const SIMDKernels &k) {
+	const lift_float_kernel ref_fns[] = { ref.decode_97_h, ref.decode_97_v };
+	const lift_float_kernel fns[] = { k.decode_97_h, k.decode_97_v };
+	const char *names[] = { "decode_97_h", "decode_97_v" };
+	auto expected = (float*) grk_aligned_malloc(
+			max_len * PLL_COLS_FWD * sizeof(float));
+	auto actual = (float*) grk_aligned_malloc(
+			max_len * PLL_COLS_FWD * sizeof(float));
+	bool rc = true;
+	for (uint32_t f = 0; f < 2 && rc; ++f) {
+		size_t cols = f ? PLL_COLS_FWD : 1;
+		for (uint32_t n = 1; n <= max_len && rc; ++n) {
+			for (uint8_t cas = 0; cas < 2 && rc; ++cas) {
+				int32_t s_n = (int32_t) (cas ? n / 2 : (n + 1) / 2);
+				int32_t d_n = (int32_t) n - s_n;
+				for (size_t i = 0; i < n * cols; ++i)
+					expected[i] = (float) next_rand(1 << 16) / 64.0f;
+				memcpy(actual, expected, n * cols * sizeof(float));
+				ref_fns[f](expected, expected + s_n * cols, d_n, s_n, cas);
+				fns[f](actual, actual + s_n * cols, d_n, s_n, cas);
+				// bit identical, not just close
+				if (memcmp(expected, actual, n * cols * sizeof(float))) {
+					printf("%s: %s differs for length %u, cas %u\n",
+							SIMDKernels::name(k.level), names[f], n, cas);
+					rc = false;
+				}
+			}
+		}
+	}
+	grk_aligned_free(expected);
+	grk_aligned_free(actual);
+
+	return rc;
+}
+
+static bool check_lift16(const SIMDKernels &ref, const SIMDKernels &k) {
+	const lift16_kernel ref_fns[] = { ref.encode_53_h16, ref.decode_53_h16,
+			ref.decode_97_h16, ref.encode_53_v16, ref.decode_53_v16,
+			ref.decode_97_v16 };
+	const lift16_kernel fns[] = { k.encode_53_h16, k.decode_53_h16,
+			k.decode_97_h16, k.encode_53_v16, k.decode_53_v16, k.decode_97_v16 };
+	const char *names[] = { "encode_53_h16", "decode_53_h16", "decode_97_h16",
+			"encode_53_v16", "decode_53_v16", "decode_97_v16" };
+	auto expected = (int16_t*) grk_aligned_malloc(
+			max_len * PLL_COLS_16 * sizeof(int16_t));
+	auto actual = (int16_t*) grk_aligned_malloc(
+			max_len * PLL_COLS_16 * sizeof(int16_t));
+	bool rc = true;
+	for (uint32_t f = 0; f < 6 && rc; ++f) {
+		size_t cols = f < 3 ? 1 : PLL_COLS_16;
+		for (uint32_t n = 1; n <= max_len && rc; ++n) {
+			for (uint8_t cas = 0; cas < 2 && rc; ++cas) {
+				int32_t s_n = (int32_t) (cas ? n / 2 : (n + 1) / 2);
+				int32_t d_n = (int32_t) n - s_n;
+				// full 16 bit range, so that saturation is exercised
+				for (size_t i = 0; i < n * cols; ++i)
+					expected[i] = (int16_t) next_rand(INT16_MAX);
+				memcpy(actual, expected, n * cols * sizeof(int16_t));
+				ref_fns[f](expected, expected + s_n * cols, d_n, s_n, cas);
+				fns[f](actual, actual + s_n * cols, d_n, s_n, cas);
+				if (memcmp(expected, actual, n * cols * sizeof(int16_t))) {
+					printf("%s: %s differs for length %u, cas %u\n",
+							SIMDKernels::name(k.level), names[f], n, cas);
+					rc = false;
+				}
+			}
+		}
+	}
+	grk_aligned_free(expected);
+	grk_aligned_free(actual);
+	for (uint32_t n = 0; n <= max_len && rc; ++n) {
+		std::vector<int32_t> src(n);
+		fill(src, 1 << 16);
+		std::vector<int16_t> narrow_expected(n), narrow_actual(n);
+		ref.narrow16(src.data(), narrow_expected.data(), n);
+		k.narrow16(src.data(), narrow_actual.data(), n);
+		// widen in place: the 16 bit samples alias the 32 bit output
+		std::vector<int32_t> wide(n);
+		memcpy(wide.data(), narrow_actual.data(), n * sizeof(int16_t));
+		k.widen16((int16_t*) wide.data(), wide.data(), n);
+		for (uint32_t i = 0; i < n; ++i) {
+			if (narrow_actual[i] != narrow_expected[i]
+					|| wide[i] != narrow_expected[i]) {
+				printf("%s: narrow16 / widen16 differ for %u samples\n",
+						SIMDKernels::name(k.level), n);
+				rc = false;
+				break;
+			}
+		}
+	}
+	for (uint32_t n = 0; n <= max_len && rc; ++n) {
+		// out of range samples, and samples half way between fixed point values
+		std::vector<float> src(n);
+		for (auto &x : src)
+			x = (float) next_rand(1 << 12) / 4.0f;
+		std::vector<int16_t> narrow_expected(n), narrow_actual(n);
+		ref.narrow_fix16(src.data(), narrow_expected.data(), n, 32.0f);
+		k.narrow_fix16(src.data(), narrow_actual.data(), n, 32.0f);
+		std::vector<float> wide(n);
+		memcpy(wide.data(), narrow_actual.data(), n * sizeof(int16_t));
+		k.widen_fix16((int16_t*) wide.data(), wide.data(), n, 1.0f / 32.0f);
+		for (uint32_t i = 0; i < n; ++i) {
+			if (narrow_actual[i] != narrow_expected[i]
+					|| wide[i] != (float) narrow_expected[i] / 32.0f) {
+				printf("%s: narrow_fix16 / widen_fix16 differ for %u samples\n",
+						SIMDKernels::name(k.level), n);
+				rc = false;
+				break;
+			}
+		}
+	}
+
+	return rc;
+}
+
+static bool check_quantize(const SIMDKernels &ref, const SIMDKernels &k) {
+	for (uint32_t rev = 0; rev < 2; ++rev) {
+		for (uint32_t n = 0; n <= max_len; ++n) {
+			std::vector<int32_t> src(n);
+			fill(src, 1 << 20);
+			std::vector<int32_t> expected(n), actual(n);
+			uint32_t max_expected = ref.quantize_ht[rev](src.data(),
+					expected.data(), n, 5, 0.37f, 64.0f);
+			uint32_t max_actual = k.quantize_ht[rev](src.data(), actual.data(),
+					n, 5, 0.37f, 64.0f);
+			if (expected != actual || max_expected != max_actual) {
+				printf("%s: HT quantization (rev %u) differs for %u samples\n",
+						SIMDKernels::name(k.level), rev, n);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool check_ht_magsgn_codewords(const SIMDKernels &ref,
+		const SIMDKernels &k) {
+	for (uint32_t i = 0; i < 10000; ++i) {
+		HTQuadPair qp;
+		memset(&qp, 0, sizeof(qp));
+		int32_t U_q[2];
+		uint32_t e_k[2];
+		for (uint32_t q = 0; q < 2; ++q) {
+			qp.rho[q] = (next_rand(8) + 8) & 0xF;
+			U_q[q] = next_rand(15) + 16;
+			// only the low 4 bits of a VLC tuple are exponent bits
+			e_k[q] = (uint32_t) (next_rand(1 << 15) + (1 << 15));
+		}
+		for (auto &x : qp.s)
+			x = (uint32_t) next_rand(1 << 30) * 3;
+		uint32_t cwd_expected[8], cwd_actual[8];
+		int32_t len_expected[8], len_actual[8];
+		ref.ht_magsgn_codewords(&qp, U_q, e_k, cwd_expected, len_expected);
+		k.ht_magsgn_codewords(&qp, U_q, e_k, cwd_actual, len_actual);
+		if (memcmp(cwd_expected, cwd_actual, sizeof(cwd_expected))
+				|| memcmp(len_expected, len_actual, sizeof(len_expected))) {
+			printf("%s: ht_magsgn_codewords differs\n",
+					SIMDKernels::name(k.level));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool check_ht_prepare_quads(const SIMDKernels &ref,
+		const SIMDKernels &k) {
+	for (uint32_t p : { 1, 9, 20, 30 }) {
+		for (uint32_t two_rows = 0; two_rows < 2; ++two_rows) {
+			for (uint32_t width = 1; width <= max_len; ++width) {
+				// sign-magnitude samples of every bit depth
+				uint32_t stride = width + 3;
+				std::vector<int32_t> src(2 * stride);
+				for (auto &x : src) {
+					int32_t v = next_rand(1 << 30);
+					uint32_t mag = (uint32_t) (v < 0 ? -v : v)
+							>> (uint32_t) (next_rand(15) + 15);
+					x = (int32_t) ((v < 0 ? 0x80000000 : 0) | mag);
+				}
+				uint32_t num_quads = (width + 3) / 4;
+				std::vector<HTQuadPair> expected(num_quads), actual(num_quads);
+				ref.ht_prepare_quads(src.data(), stride, width, two_rows != 0, p,
+						expected.data());
+				k.ht_prepare_quads(src.data(), stride, width, two_rows != 0, p,
+						actual.data());
+				if (memcmp(expected.data(), actual.data(),
+						num_quads * sizeof(HTQuadPair))) {
+					printf("%s: ht_prepare_quads differs for width %u, "
+							"%u rows, p %u\n", SIMDKernels::name(k.level), width,
+							two_rows + 1, p);
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Check that the kernels of every SIMD level supported by this build and CPU
+ * match the scalar kernels bit for bit
+ */
+int main(void) {
+	SIMDKernels ref;
+	if (!SIMDKernels::select(&ref, SIMD_SCALAR)) {
+		printf("No scalar kernels\n");
+		return 1;
+	}
+	printf("Selected level: %s\n",
+			SIMDKernels::name(SIMDKernels::get()->level));
+	uint32_t failures = 0;
+	for (int level = SIMD_SSE2; level < SIMD_NUM_LEVELS; ++level) {
+		SIMDKernels k;
+		if (!SIMDKernels::select(&k, (SIMDLevel) level)) {
+			printf("%s: not supported\n", SIMDKernels::name((SIMDLevel) level));
+			continue;
+		}
+		bool rc = check_mct(ref, k);
+		rc = check_dequantize(ref, k) && rc;
+		rc = check_quantize(ref, k) && rc;
+		rc = check_lift(ref, k) && rc;
+		rc = check_lift_53_roundtrip(k) && rc;
+		rc = check_lift_float(ref, k) && rc;
+		rc = check_lift16(ref, k) && rc;
+		rc = check_ht_prepare_quads(ref, k) && rc;
+		rc = check_ht_magsgn_codewords(ref, k) && rc;
+		printf("%s: %s\n", SIMDKernels::name(k.level), rc ? "passed" : "failed");
+		if (!rc)
+			failures++;
+	}
+
+	return failures ? 1 : 0;
+}
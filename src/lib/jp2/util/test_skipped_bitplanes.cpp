@@ -0,0 +1,260 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+
+namespace grk {
+
+static uint32_t rand_state = 1;
+static uint32_t next_rand(void){
+	rand_state = rand_state * 1664525U + 1013904223U;
+	return rand_state >> 8;
+}
+
+const uint32_t dim = 256;
+const uint32_t prec = 16;
+const uint32_t output_precision = 8;
+
+struct SkipCase {
+	uint32_t numcomps;
+	bool irreversible;
+	uint32_t numresolution;
+	uint32_t reduce;
+};
+
+static const SkipCase cases[] = {
+	{ 1, false, 6, 0 },
+	{ 3, false, 6, 0 },
+	{ 1, true, 6, 0 },
+	{ 3, true, 6, 0 },
+	{ 1, false, 6, 2 },
+	{ 3, true, 5, 1 },
+	{ 1, true, 1, 0 },
+};
+
+/**
+ * Compress 16 bit image to buffer, losslessly if reversible,
+ * and return code stream length
+ */
+static size_t compress(const SkipCase &c, uint8_t *buf, size_t len) {
+	grk_image_cmptparm cmptparms[3];
+	for (uint32_t i = 0; i < c.numcomps; ++i) {
+		auto p = cmptparms + i;
+		memset(p, 0, sizeof(*p));
+		p->dx = 1;
+		p->dy = 1;
+		p->w = dim;
+		p->h = dim;
+		p->prec = prec;
+	}
+	auto image = grk_image_create(c.numcomps, cmptparms,
+			c.numcomps == 3 ? GRK_CLRSPC_SRGB : GRK_CLRSPC_GRAY);
+	image->x1 = dim;
+	image->y1 = dim;
+	// smooth gradients with noise, so that all bit planes are coded
+	int32_t max_val = (int32_t) ((1U << prec) - 1);
+	rand_state = 1;
+	for (uint32_t compno = 0; compno < c.numcomps; ++compno) {
+		auto data = image->comps[compno].data;
+		for (uint32_t y = 0; y < dim; ++y) {
+			for (uint32_t x = 0; x < dim; ++x) {
+				int32_t v = (int32_t) (((x + compno * 37) * max_val) / dim
+						+ ((y * max_val) / dim)) / 2;
+				v += (int32_t) (next_rand() % 1025) - 512;
+				data[y * dim + x] = std::min<int32_t>(std::max<int32_t>(v, 0),
+						max_val);
+			}
+		}
+	}
+	grk_cparameters param;
+	grk_set_default_compress_params(&param);
+	param.numresolution = c.numresolution;
+	param.irreversible = c.irreversible;
+	param.tcp_mct = c.numcomps == 3 ? 1 : 0;
+	auto stream = grk_stream_create_mem_stream(buf, len, false, false);
+	auto codec = grk_create_compress(GRK_CODEC_J2K, stream);
+	size_t rc = 0;
+	if (grk_init_compress(codec, &param, image) && grk_start_compress(codec)
+			&& grk_compress(codec) && grk_end_compress(codec))
+		rc = grk_stream_get_write_mem_stream_length(stream);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	grk_image_destroy(image);
+
+	return rc;
+}
+
+/**
+ * Decompress code stream; bit planes are only skipped
+ * when an output precision is set
+ */
+static grk_image* decompress(const SkipCase &c, uint8_t *buf, size_t len,
+		uint32_t precision) {
+	grk_dparameters dparam;
+	grk_set_default_decompress_params(&dparam);
+	dparam.cp_reduce = c.reduce;
+	dparam.output_precision = precision;
+	auto stream = grk_stream_create_mem_stream(buf, len, false, true);
+	auto codec = grk_create_decompress(GRK_CODEC_J2K, stream);
+	grk_image *image = nullptr;
+	bool rc = grk_init_decompress(codec, &dparam)
+			&& grk_read_header(codec, nullptr, &image)
+			&& grk_set_decompress_area(codec, image, 0, 0, 0, 0)
+			&& grk_decompress(codec, nullptr, image)
+			&& grk_end_decompress(codec);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	if (!rc) {
+		grk_image_destroy(image);
+		return nullptr;
+	}
+
+	return image;
+}
+
+/**
+ * Check that skipping bit planes leaves samples, scaled down to the output
+ * precision, within one of a full decode, and that bit planes were
+ * actually skipped
+ */
+static bool run(const SkipCase &c, uint32_t caseno) {
+	size_t buf_len = (size_t) c.numcomps * dim * dim * 4 + 65536;
+	std::vector<uint8_t> buf(buf_len);
+	size_t len = compress(c, buf.data(), buf_len);
+	auto full = len ? decompress(c, buf.data(), len, 0) : nullptr;
+	auto skipped = full ? decompress(c, buf.data(), len, output_precision) :
+			nullptr;
+	if (!skipped) {
+		printf("Case %u: failed to compress or decompress\n", caseno);
+		grk_image_destroy(full);
+		return false;
+	}
+	const int32_t lsb = 1 << (prec - output_precision);
+	bool rc = true;
+	uint64_t num_differ = 0;
+	uint64_t num_samples = 0;
+	int32_t max_diff = 0;
+	for (uint32_t compno = 0; compno < c.numcomps && rc; ++compno) {
+		auto a = full->comps + compno;
+		auto b = skipped->comps + compno;
+		if (a->w != b->w || a->h != b->h) {
+			printf("Case %u: dimensions differ\n", caseno);
+			rc = false;
+			break;
+		}
+		for (uint32_t y = 0; y < a->h && rc; ++y) {
+			for (uint32_t x = 0; x < a->w; ++x) {
+				int32_t va = a->data[(size_t) y * a->w + x];
+				int32_t vb = b->data[(size_t) y * b->w + x];
+				int32_t diff = std::abs(va - vb);
+				max_diff = std::max<int32_t>(max_diff, diff);
+				num_samples++;
+				if (diff)
+					num_differ++;
+				// scaled to the output precision, samples differ by at most one
+				if (std::abs(va / lsb - vb / lsb) > 1) {
+					printf("Case %u: component %u sample (%u,%u) is %d instead "
+							"of %d\n", caseno, compno, x, y, vb, va);
+					rc = false;
+					break;
+				}
+			}
+		}
+	}
+	if (rc) {
+		printf("Case %u: %.2f%% of samples differ, by at most %.3f of an "
+				"output bit\n", caseno, 100.0 * (double) num_differ
+						/ (double) num_samples, (double) max_diff / lsb);
+		// noise is coded down to the lowest bit plane,
+		// so skipping any bit plane changes samples
+		if (!num_differ) {
+			printf("Case %u: no bit planes were skipped\n", caseno);
+			rc = false;
+		}
+	}
+	grk_image_destroy(skipped);
+	grk_image_destroy(full);
+
+	return rc;
+}
+
+/**
+ * Check the number of skipped bit planes for a single band,
+ * with step size 1, and one resolution so that the synthesis norm is 1
+ */
+static bool check_band(void) {
+	grk_tccp tccp;
+	memset(&tccp, 0, sizeof(tccp));
+	tccp.qmfbid = 1;
+	// unit step size: exponent equals the precision, and mantissa is 0
+	tccp.stepsizes[0].expn = (uint8_t) prec;
+	tccp.stepsizes[0].mant = 0;
+	grk_tcd_band band;
+	memset(&band, 0, sizeof(band));
+	// budget of 2^(discarded_bits - 2) steps
+	for (uint32_t discarded = 0; discarded <= 8; ++discarded) {
+		uint32_t expected = discarded > 2 ? discarded - 2 : 0;
+		uint32_t skipped = Quantizer::getSkippedBitplanes(&tccp, &band, 0, 0, 1,
+				prec, discarded, false);
+		if (skipped != expected) {
+			printf("%u discarded bits: %u bit planes skipped instead of %u\n",
+					discarded, skipped, expected);
+			return false;
+		}
+		// half the budget with an MCT
+		expected = discarded > 3 ? discarded - 3 : 0;
+		skipped = Quantizer::getSkippedBitplanes(&tccp, &band, 0, 0, 1, prec,
+				discarded, true);
+		if (skipped != expected) {
+			printf("%u discarded bits, MCT: %u bit planes skipped instead "
+					"of %u\n", discarded, skipped, expected);
+			return false;
+		}
+	}
+	// region of interest background lives in the lowest bit planes
+	tccp.roishift = 4;
+	if (Quantizer::getSkippedBitplanes(&tccp, &band, 0, 0, 1, prec, 8, false)) {
+		printf("bit planes skipped with region of interest\n");
+		return false;
+	}
+
+	return true;
+}
+
+}
+
+using namespace grk;
+
+/**
+ * Decompress 16 bit images with an output precision of 8 bits, and check
+ * that the bit planes skipped below that precision change samples by at
+ * most one, once scaled down to 8 bits
+ */
+int main(void)
+{
+	grk_initialize(nullptr, 0);
+	uint32_t failures = 0;
+	if (!check_band())
+		failures++;
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		if (!run(cases[i], i))
+			failures++;
+	}
+	grk_deinitialize();
+
+	return failures ? 1 : 0;
+}
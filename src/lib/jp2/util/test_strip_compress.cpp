@@ -0,0 +1,218 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+
+namespace grk {
+
+static uint32_t rand_state = 1;
+static uint32_t next_rand(void){
+	rand_state = rand_state * 1664525U + 1013904223U;
+	return rand_state >> 8;
+}
+
+struct StripCase {
+	uint32_t numcomps;
+	uint32_t w, h;
+	uint32_t x0, y0;
+	uint32_t prec;
+	bool sgnd;
+	uint32_t numresolution;
+	uint32_t cblk;
+	uint32_t precinct;
+	bool irreversible;
+	uint8_t mct;
+	bool ht;
+	bool rates;
+};
+
+static const StripCase cases[] = {
+	{ 3, 333, 217, 0, 0, 8, false, 6, 64, 0, false, 1, false, false },
+	{ 3, 300, 200, 7, 3, 8, false, 5, 32, 0, true, 1, false, true },
+	{ 1, 700, 300, 0, 0, 12, false, 6, 32, 64, false, 0, false, false },
+	{ 1, 190, 261, 1, 0, 16, true, 4, 64, 0, false, 0, true, false },
+	{ 2, 100, 40, 0, 0, 8, false, 1, 32, 0, true, 0, false, true },
+	{ 1, 64, 1000, 0, 5, 8, false, 6, 64, 0, true, 0, false, true },
+	{ 1, 3, 300, 1, 1, 8, false, 3, 16, 0, false, 0, false, false },
+};
+
+/**
+ * Samples read by strip read callback
+ */
+struct StripSource {
+	const std::vector<int32_t> *comps;
+	uint32_t numcomps;
+	uint32_t w, h;
+	uint32_t next_row;
+};
+
+static bool read_strip(uint32_t y, uint32_t num_rows, int32_t **comp_rows,
+		void *user_data) {
+	auto src = (StripSource*) user_data;
+	if (y != src->next_row || y + num_rows > src->h)
+		return false;
+	for (uint32_t compno = 0; compno < src->numcomps; ++compno)
+		memcpy(comp_rows[compno], src->comps[compno].data() + (size_t) y * src->w,
+				(size_t) num_rows * src->w * sizeof(int32_t));
+	src->next_row += num_rows;
+
+	return true;
+}
+
+static grk_image* create_image(const StripCase &c) {
+	grk_image_cmptparm cmptparms[4];
+	for (uint32_t i = 0; i < c.numcomps; ++i) {
+		auto p = cmptparms + i;
+		memset(p, 0, sizeof(*p));
+		p->dx = 1;
+		p->dy = 1;
+		p->w = c.w;
+		p->h = c.h;
+		p->x0 = c.x0;
+		p->y0 = c.y0;
+		p->prec = c.prec;
+		p->sgnd = c.sgnd;
+	}
+	auto image = grk_image_create(c.numcomps, cmptparms,
+			c.numcomps == 3 ? GRK_CLRSPC_SRGB : GRK_CLRSPC_GRAY);
+	image->x0 = c.x0;
+	image->y0 = c.y0;
+	image->x1 = c.x0 + c.w;
+	image->y1 = c.y0 + c.h;
+
+	return image;
+}
+
+/**
+ * Compress image to buffer, either from image data or in strips
+ * from source, and return code stream length
+ */
+static size_t compress(grk_image *image, const StripCase &c,
+		StripSource *source, uint8_t *buf, size_t len) {
+	grk_cparameters param;
+	grk_set_default_compress_params(&param);
+	param.numresolution = c.numresolution;
+	param.cblockw_init = c.cblk;
+	param.cblockh_init = c.cblk;
+	param.tcp_mct = c.mct;
+	param.irreversible = c.irreversible;
+	if (c.ht)
+		param.cblk_sty = GRK_CBLKSTY_HT;
+	if (c.rates) {
+		param.tcp_numlayers = 3;
+		param.cp_disto_alloc = 1;
+		param.tcp_rates[0] = 80;
+		param.tcp_rates[1] = 20;
+		param.tcp_rates[2] = 5;
+	}
+	if (c.precinct) {
+		param.csty |= 0x01;
+		param.res_spec = 1;
+		param.prcw_init[0] = c.precinct;
+		param.prch_init[0] = c.precinct;
+	}
+	auto stream = grk_stream_create_mem_stream(buf, len, false, false);
+	auto codec = grk_create_compress(GRK_CODEC_J2K, stream);
+	size_t rc = 0;
+	if (grk_init_compress(codec, &param, image) && grk_start_compress(codec)
+			&& (source ? grk_compress_strips(codec, read_strip, source) :
+					grk_compress(codec)) && grk_end_compress(codec))
+		rc = grk_stream_get_write_mem_stream_length(stream);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+
+	return rc;
+}
+
+static bool run(const StripCase &c, uint32_t caseno) {
+	auto image = create_image(c);
+	// smooth gradients with noise, so that all bit planes are coded
+	int32_t max_val = (int32_t) ((1U << c.prec) - 1);
+	int32_t offset = c.sgnd ? (int32_t) (1U << (c.prec - 1)) : 0;
+	std::vector<int32_t> original[4];
+	for (uint32_t compno = 0; compno < c.numcomps; ++compno) {
+		auto data = image->comps[compno].data;
+		for (uint32_t y = 0; y < c.h; ++y) {
+			for (uint32_t x = 0; x < c.w; ++x) {
+				int32_t v = (int32_t) (((x + compno * 37) * max_val) / c.w
+						+ ((y * max_val) / c.h)) / 2;
+				v += (int32_t) (next_rand() % 17) - 8;
+				v = std::min<int32_t>(std::max<int32_t>(v, 0), max_val);
+				data[y * c.w + x] = v - offset;
+			}
+		}
+		original[compno].assign(data, data + (size_t) c.w * c.h);
+	}
+	// strip compression does not need image data
+	auto strip_image = create_image(c);
+	for (uint32_t compno = 0; compno < c.numcomps; ++compno)
+		grk_image_single_component_data_free(strip_image->comps + compno);
+	StripSource source;
+	source.comps = original;
+	source.numcomps = c.numcomps;
+	source.w = c.w;
+	source.h = c.h;
+	source.next_row = 0;
+
+	size_t buf_len = (size_t) c.numcomps * c.w * c.h * 4 + 65536;
+	auto expected = new uint8_t[buf_len];
+	auto actual = new uint8_t[buf_len];
+	bool success = false;
+	size_t expected_len = compress(image, c, nullptr, expected, buf_len);
+	size_t actual_len = expected_len ?
+			compress(strip_image, c, &source, actual, buf_len) : 0;
+	if (!actual_len) {
+		printf("Case %u: failed to compress\n", caseno);
+	} else if (source.next_row != c.h) {
+		printf("Case %u: only %u of %u rows were read\n", caseno,
+				source.next_row, c.h);
+	} else if (actual_len != expected_len
+			|| memcmp(actual, expected, expected_len)) {
+		printf("Case %u: code streams differ, %zu and %zu bytes\n", caseno,
+				expected_len, actual_len);
+	} else {
+		success = true;
+		printf("Case %u: %zu bytes\n", caseno, actual_len);
+	}
+	delete[] actual;
+	delete[] expected;
+	grk_image_destroy(strip_image);
+	grk_image_destroy(image);
+
+	return success;
+}
+
+}
+
+using namespace grk;
+
+/**
+ * Compress images in strips, and check that the code streams are identical
+ * to those compressed from whole images.
+ */
+int main(void)
+{
+	grk_initialize(nullptr, 0);
+	uint32_t failures = 0;
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		if (!run(cases[i], i))
+			failures++;
+	}
+	grk_deinitialize();
+
+	return failures ? 1 : 0;
+}
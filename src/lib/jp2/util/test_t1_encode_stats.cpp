@@ -0,0 +1,191 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+
+namespace grk {
+
+#define CHECK(cond) \
+	if (!(cond)) { \
+		printf("line %d: check failed: %s\n", __LINE__, #cond); \
+		return false; \
+	}
+
+static uint32_t rand_state = 1;
+static uint32_t next_rand(void){
+	rand_state = rand_state * 1664525U + 1013904223U;
+	return rand_state >> 8;
+}
+
+const uint32_t dim = 512;
+const uint32_t cblk = 32;
+// code blocks of all resolutions together cover the image once
+const uint64_t num_blocks = (dim / cblk) * (dim / cblk);
+
+/**
+ * Create 8 bit image. If noisy_sampled is set, then only those code blocks
+ * that tier 1 samples to estimate rate control are noisy, and the rest
+ * are flat, so that the estimate is far too pessimistic.
+ */
+static grk_image* create_image(bool noisy_sampled) {
+	grk_image_cmptparm cmptparm;
+	memset(&cmptparm, 0, sizeof(cmptparm));
+	cmptparm.dx = 1;
+	cmptparm.dy = 1;
+	cmptparm.w = dim;
+	cmptparm.h = dim;
+	cmptparm.prec = 8;
+	auto image = grk_image_create(1, &cmptparm, GRK_CLRSPC_GRAY);
+	image->x1 = dim;
+	image->y1 = dim;
+	auto data = image->comps[0].data;
+	uint32_t blocks_wide = dim / cblk;
+	for (uint32_t y = 0; y < dim; ++y) {
+		for (uint32_t x = 0; x < dim; ++x) {
+			uint64_t i = (y / cblk) * blocks_wide + x / cblk;
+			bool noisy = !noisy_sampled
+					|| (uint32_t) (i * 2654435761U) < UINT_MAX / 8;
+			data[y * dim + x] = noisy ? (int32_t) (next_rand() & 0xFF) : 128;
+		}
+	}
+
+	return image;
+}
+
+static bool recoded = false;
+static void info_callback(const char *msg, void *client_data) {
+	(void) client_data;
+	if (strstr(msg, "coding all passes"))
+		recoded = true;
+}
+
+/**
+ * Compress image, and return code stream length together with the
+ * tier 1 statistics summed over all threads
+ */
+static size_t compress(grk_image *image, uint32_t numresolution, double rate,
+		grk_t1_thread_stats *total, uint8_t *buf, size_t len) {
+	grk_cparameters param;
+	grk_set_default_compress_params(&param);
+	param.numresolution = numresolution;
+	param.cblockw_init = cblk;
+	param.cblockh_init = cblk;
+	param.irreversible = false;
+	if (rate > 0) {
+		param.tcp_numlayers = 1;
+		param.cp_disto_alloc = 1;
+		param.tcp_rates[0] = rate;
+		param.early_termination = true;
+	}
+	memset(total, 0, sizeof(*total));
+	auto stream = grk_stream_create_mem_stream(buf, len, false, false);
+	auto codec = grk_create_compress(GRK_CODEC_J2K, stream);
+	size_t rc = 0;
+	uint32_t num_threads = 0;
+	if (grk_init_compress(codec, &param, image) && grk_start_compress(codec)
+			&& grk_compress(codec) && grk_end_compress(codec)
+			&& grk_get_t1_encode_stats(codec, nullptr, &num_threads)) {
+		std::vector<grk_t1_thread_stats> stats(num_threads);
+		if (grk_get_t1_encode_stats(codec, stats.data(), &num_threads)) {
+			for (auto &s : stats) {
+				total->blocks += s.blocks;
+				total->passes += s.passes;
+				total->bytes += s.bytes;
+				total->time_ns += s.time_ns;
+			}
+			rc = grk_stream_get_write_mem_stream_length(stream);
+		}
+	}
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+
+	return rc;
+}
+
+/**
+ * Lossless, single layer: every coded byte ends up in the code stream,
+ * which holds little else besides packet headers
+ */
+static bool check_lossless(uint32_t numresolution) {
+	auto image = create_image(false);
+	size_t buf_len = (size_t) dim * dim * 2 + 65536;
+	std::vector<uint8_t> buf(buf_len);
+	grk_t1_thread_stats total;
+	size_t len = compress(image, numresolution, 0, &total, buf.data(),
+			buf_len);
+	grk_image_destroy(image);
+	CHECK(len);
+	CHECK(total.blocks == num_blocks);
+	CHECK(total.passes >= total.blocks);
+	CHECK(total.bytes <= len);
+	CHECK(len - total.bytes < num_blocks * 8 + 1024);
+
+	return true;
+}
+
+/**
+ * Rate control needs passes that early termination skipped, so code blocks
+ * are coded a second time: they must only be counted once
+ */
+static bool check_recode(void) {
+	// compression may take over image data, so each compression gets
+	// its own image
+	rand_state = 1;
+	auto image = create_image(true);
+	size_t buf_len = (size_t) dim * dim * 2 + 65536;
+	std::vector<uint8_t> buf(buf_len);
+	grk_t1_thread_stats lossless;
+	size_t lossless_len = compress(image, 1, 0, &lossless, buf.data(),
+			buf_len);
+	grk_image_destroy(image);
+	CHECK(lossless_len);
+	// target holds the whole tile, so rate control keeps every pass
+	double rate = (double) dim * dim / ((double) lossless_len * 1.5);
+	grk_t1_thread_stats total;
+	recoded = false;
+	rand_state = 1;
+	image = create_image(true);
+	grk_set_info_handler(info_callback, nullptr);
+	size_t len = compress(image, 1, rate, &total, buf.data(), buf_len);
+	grk_set_info_handler(nullptr, nullptr);
+	grk_image_destroy(image);
+	CHECK(len);
+	CHECK(recoded);
+	CHECK(total.blocks == num_blocks);
+	CHECK(total.passes == lossless.passes);
+	CHECK(total.bytes == lossless.bytes);
+
+	return true;
+}
+
+}
+
+using namespace grk;
+
+/**
+ * Check that tier 1 encode statistics count every code block once,
+ * together with the bytes it was coded to
+ */
+int main(void)
+{
+	grk_initialize(nullptr, 0);
+	bool rc = check_lossless(1) && check_lossless(3) && check_recode();
+	grk_deinitialize();
+	printf("%s\n", rc ? "passed" : "failed");
+
+	return rc ? 0 : 1;
+}
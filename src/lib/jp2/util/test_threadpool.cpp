@@ -0,0 +1,219 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "grok_includes.h"
+#include <ctime>
+
+using namespace grk;
+
+#define CHECK(cond) \
+	if (!(cond)) { \
+		printf("line %d: check failed: %s\n", __LINE__, #cond); \
+		return false; \
+	}
+
+/* every index runs exactly once */
+static bool check_indices(ThreadPool *pool) {
+	for (size_t count : { 0, 1, 7, 1000 }) {
+		std::vector<std::atomic<uint32_t>> runs(count);
+		for (auto &r : runs)
+			r = 0;
+		pool->parallel_for(count, [&runs](size_t index) {
+			runs[index]++;
+		});
+		for (auto &r : runs)
+			CHECK(r == 1);
+	}
+
+	return true;
+}
+
+/* a single thread, or a concurrency cap of one, runs indices in order */
+static bool check_ordering(ThreadPool *pool) {
+	ThreadPool single(1);
+	std::vector<size_t> order;
+	single.parallel_for(100, [&order](size_t index) {
+		order.push_back(index);
+	});
+	CHECK(order.size() == 100);
+	for (size_t i = 0; i < order.size(); ++i)
+		CHECK(order[i] == i);
+
+	order.clear();
+	{
+		ThreadPoolScope scope(pool, 1);
+		CHECK(pool->concurrency() == 1);
+		pool->parallel_for(100, [&order](size_t index) {
+			order.push_back(index);
+		});
+	}
+	CHECK(order.size() == 100);
+	for (size_t i = 0; i < order.size(); ++i)
+		CHECK(order[i] == i);
+
+	return true;
+}
+
+/* parallel_for nests inside parallel_for and inside enqueued tasks */
+static bool check_nesting(ThreadPool *pool) {
+	const size_t outer = 16, inner = 64;
+	std::atomic<uint64_t> sum(0);
+	pool->parallel_for(outer, [pool, &sum](size_t i) {
+		pool->parallel_for(inner, [&sum, i](size_t j) {
+			sum += i * inner + j;
+		});
+	});
+	uint64_t n = outer * inner;
+	CHECK(sum == n * (n - 1) / 2);
+
+	std::vector<std::future<uint64_t>> results;
+	for (uint64_t i = 0; i < outer; ++i) {
+		results.push_back(pool->enqueue([pool, i] {
+			std::atomic<uint64_t> task_sum(0);
+			pool->parallel_for(inner, [&task_sum](size_t j) {
+				task_sum += j;
+			});
+			return task_sum + i;
+		}));
+	}
+	for (uint64_t i = 0; i < outer; ++i) {
+		pool->wait(results[i]);
+		CHECK(results[i].get() == inner * (inner - 1) / 2 + i);
+	}
+
+	return true;
+}
+
+/* the first exception reaches the caller, and the pool stays usable */
+static bool check_exceptions(ThreadPool *pool) {
+	std::atomic<uint32_t> runs(0);
+	bool caught = false;
+	try {
+		pool->parallel_for(1000, [&runs](size_t index) {
+			runs++;
+			if (index == 37)
+				throw std::runtime_error("index 37");
+		});
+	} catch (std::runtime_error &e) {
+		caught = strcmp(e.what(), "index 37") == 0;
+	}
+	CHECK(caught);
+	CHECK(runs >= 38 && runs <= 1000);
+
+	// exception thrown by a nested batch, on a worker thread
+	caught = false;
+	try {
+		pool->parallel_for(8, [pool](size_t i) {
+			pool->parallel_for(8, [i](size_t j) {
+				if (i == 3 && j == 5)
+					throw std::runtime_error("nested");
+			});
+		});
+	} catch (std::runtime_error &e) {
+		caught = strcmp(e.what(), "nested") == 0;
+	}
+	CHECK(caught);
+
+	// exception of a batch run from an enqueued task reaches its future
+	auto result = pool->enqueue([pool] {
+		pool->parallel_for(100, [](size_t index) {
+			if (index == 99)
+				throw std::runtime_error("task");
+		});
+	});
+	pool->wait(result);
+	caught = false;
+	try {
+		result.get();
+	} catch (std::runtime_error &e) {
+		caught = strcmp(e.what(), "task") == 0;
+	}
+	CHECK(caught);
+
+	return check_indices(pool);
+}
+
+/* a worker waiting on a future or a batch that runs elsewhere sleeps */
+static bool check_blocking_wait(void) {
+	ThreadPool pool(2);
+	std::atomic<bool> started(false);
+	auto sleep = [&started] {
+		started = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	};
+	auto start = std::clock();
+	// the awaited task must already run on the other worker
+	auto inner = pool.enqueue(sleep);
+	while (!started)
+		std::this_thread::yield();
+	auto result = pool.enqueue([&pool, &inner] {
+		pool.wait(inner);
+	});
+	pool.wait(result);
+	result = pool.enqueue([&pool, sleep] {
+		pool.parallel_for(2, [sleep](size_t index) {
+			if (index == 0)
+				sleep();
+		});
+	});
+	pool.wait(result);
+	// spinning would burn up to 600 ms of CPU time
+	double cpu_ms = 1000.0 * (double) (std::clock() - start) / CLOCKS_PER_SEC;
+	CHECK(cpu_ms < 100.0);
+
+	return true;
+}
+
+/* a pool may be deleted from one of its own tasks */
+static bool check_self_destroy(void) {
+	auto pool = new ThreadPool(2);
+	auto result = pool->enqueue([pool] {
+		ThreadPool::destroy(pool);
+	});
+	result.wait();
+
+	// the destructor detaches the calling worker instead of joining it
+	pool = new ThreadPool(2);
+	result = pool->enqueue([pool] {
+		delete pool;
+	});
+	result.wait();
+
+	return true;
+}
+
+/**
+ * Check that parallel_for runs every index once, in order when
+ * single threaded, that it nests, that it propagates exceptions,
+ * that waiting workers don't spin, and that a pool may delete itself
+ */
+int main(void) {
+	grk_initialize(nullptr, 4);
+	auto pool = ThreadPool::get();
+	bool rc = check_indices(pool);
+	rc = check_ordering(pool) && rc;
+	rc = check_nesting(pool) && rc;
+	rc = check_exceptions(pool) && rc;
+	ThreadPool codec_pool(3);
+	rc = check_nesting(&codec_pool) && rc;
+	rc = check_exceptions(&codec_pool) && rc;
+	rc = check_blocking_wait() && rc;
+	rc = check_self_destroy() && rc;
+	printf("%s\n", rc ? "passed" : "failed");
+	grk_deinitialize();
+
+	return rc ? 0 : 1;
+}
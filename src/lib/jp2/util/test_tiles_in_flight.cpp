@@ -0,0 +1,230 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+
+namespace grk {
+
+static uint32_t rand_state = 1;
+static uint32_t next_rand(void){
+	rand_state = rand_state * 1664525U + 1013904223U;
+	return rand_state >> 8;
+}
+
+struct TilesCase {
+	uint32_t numcomps;
+	uint32_t w, h;
+	uint32_t x0, y0;
+	uint32_t prec;
+	uint32_t tile_w, tile_h;
+	bool irreversible;
+	uint32_t numlayers;
+	bool ht;
+};
+
+static const TilesCase cases[] = {
+	{ 3, 523, 411, 0, 0, 8, 128, 96, false, 1, false },
+	{ 3, 400, 300, 5, 9, 8, 100, 100, true, 3, false },
+	{ 1, 300, 257, 0, 0, 12, 64, 64, false, 2, false },
+	{ 1, 333, 200, 0, 0, 8, 96, 64, true, 1, true },
+	{ 3, 256, 256, 0, 0, 8, 64, 64, false, 1, true },
+};
+
+/* number of tiles in flight of the concurrent runs */
+const uint32_t tiles_in_flight = 4;
+
+static grk_image* create_image(const TilesCase &c) {
+	grk_image_cmptparm cmptparms[3];
+	for (uint32_t i = 0; i < c.numcomps; ++i) {
+		auto p = cmptparms + i;
+		memset(p, 0, sizeof(*p));
+		p->dx = 1;
+		p->dy = 1;
+		p->w = c.w;
+		p->h = c.h;
+		p->x0 = c.x0;
+		p->y0 = c.y0;
+		p->prec = c.prec;
+	}
+	auto image = grk_image_create(c.numcomps, cmptparms,
+			c.numcomps == 3 ? GRK_CLRSPC_SRGB : GRK_CLRSPC_GRAY);
+	image->x0 = c.x0;
+	image->y0 = c.y0;
+	image->x1 = c.x0 + c.w;
+	image->y1 = c.y0 + c.h;
+	// smooth gradients with noise, so that all bit planes are coded
+	rand_state = 1;
+	int32_t max_val = (int32_t) ((1U << c.prec) - 1);
+	for (uint32_t compno = 0; compno < c.numcomps; ++compno) {
+		auto data = image->comps[compno].data;
+		for (uint32_t y = 0; y < c.h; ++y) {
+			for (uint32_t x = 0; x < c.w; ++x) {
+				int32_t v = (int32_t) (((x + compno * 37) * max_val) / c.w
+						+ ((y * max_val) / c.h)) / 2;
+				v += (int32_t) (next_rand() % 17) - 8;
+				data[y * c.w + x] = std::min<int32_t>(std::max<int32_t>(v, 0),
+						max_val);
+			}
+		}
+	}
+
+	return image;
+}
+
+/**
+ * Compress image to buffer with the given number of tiles in flight,
+ * and return code stream length
+ */
+static size_t compress(const TilesCase &c, uint32_t max_tiles_in_flight,
+		uint8_t *buf, size_t len) {
+	grk_cparameters param;
+	grk_set_default_compress_params(&param);
+	param.tcp_mct = c.numcomps == 3 ? 1 : 0;
+	param.irreversible = c.irreversible;
+	param.tile_size_on = true;
+	param.t_width = c.tile_w;
+	param.t_height = c.tile_h;
+	param.max_tiles_in_flight = max_tiles_in_flight;
+	param.tcp_numlayers = c.numlayers;
+	param.cp_disto_alloc = 1;
+	for (uint32_t i = 0; i < c.numlayers; ++i)
+		param.tcp_rates[i] = (float) (40 >> (2 * i));
+	if (!c.irreversible)
+		param.tcp_rates[c.numlayers - 1] = 0;
+	if (c.ht) {
+		param.cblk_sty = GRK_CBLKSTY_HT;
+		param.isHT = true;
+	}
+	auto image = create_image(c);
+	auto stream = grk_stream_create_mem_stream(buf, len, false, false);
+	auto codec = grk_create_compress(GRK_CODEC_J2K, stream);
+	size_t rc = 0;
+	if (grk_init_compress(codec, &param, image) && grk_start_compress(codec)
+			&& grk_compress(codec) && grk_end_compress(codec))
+		rc = grk_stream_get_write_mem_stream_length(stream);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	grk_image_destroy(image);
+
+	return rc;
+}
+
+/**
+ * Decompress code stream with the given number of tiles in flight
+ */
+static grk_image* decompress(uint32_t max_tiles_in_flight, uint8_t *buf,
+		size_t len) {
+	grk_dparameters dparam;
+	grk_set_default_decompress_params(&dparam);
+	dparam.max_tiles_in_flight = max_tiles_in_flight;
+	auto stream = grk_stream_create_mem_stream(buf, len, false, true);
+	auto codec = grk_create_decompress(GRK_CODEC_J2K, stream);
+	grk_image *image = nullptr;
+	bool rc = grk_init_decompress(codec, &dparam)
+			&& grk_read_header(codec, nullptr, &image)
+			&& grk_set_decompress_area(codec, image, 0, 0, 0, 0)
+			&& grk_decompress(codec, nullptr, image)
+			&& grk_end_decompress(codec);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	if (!rc) {
+		grk_image_destroy(image);
+		return nullptr;
+	}
+
+	return image;
+}
+
+static bool run(const TilesCase &c, uint32_t caseno) {
+	size_t buf_len = (size_t) c.numcomps * c.w * c.h * 4 + 65536;
+	auto serial = new uint8_t[buf_len];
+	auto concurrent = new uint8_t[buf_len];
+	bool success = false;
+	grk_image *serial_image = nullptr;
+	grk_image *concurrent_image = nullptr;
+	size_t serial_len = compress(c, 1, serial, buf_len);
+	size_t concurrent_len = compress(c, tiles_in_flight, concurrent, buf_len);
+	if (serial_len) {
+		serial_image = decompress(1, serial, serial_len);
+		concurrent_image = decompress(tiles_in_flight, serial, serial_len);
+	}
+	if (!serial_len || !concurrent_len || !serial_image || !concurrent_image) {
+		printf("Case %u: failed to compress or decompress\n", caseno);
+	} else if (concurrent_len != serial_len
+			|| memcmp(concurrent, serial, serial_len)) {
+		printf("Case %u: concurrent code stream differs from serial\n",
+				caseno);
+	} else {
+		success = true;
+		for (uint32_t compno = 0; compno < c.numcomps && success; ++compno) {
+			auto a = serial_image->comps[compno].data;
+			auto b = concurrent_image->comps[compno].data;
+			for (uint32_t i = 0; i < c.w * c.h; ++i) {
+				if (a[i] != b[i]) {
+					printf("Case %u: component %u mismatch at (%u,%u): "
+							"serial %d, concurrent %d\n", caseno, compno,
+							i % c.w, i / c.w, a[i], b[i]);
+					success = false;
+					break;
+				}
+			}
+		}
+		// lossless code streams must also reproduce the original
+		auto original = c.irreversible ? nullptr : create_image(c);
+		for (uint32_t compno = 0; original && compno < c.numcomps && success;
+				++compno) {
+			auto a = serial_image->comps[compno].data;
+			auto b = original->comps[compno].data;
+			if (memcmp(a, b, (size_t) c.w * c.h * sizeof(int32_t))) {
+				printf("Case %u: component %u is not lossless\n", caseno,
+						compno);
+				success = false;
+			}
+		}
+		grk_image_destroy(original);
+		printf("Case %u: %zu bytes%s\n", caseno, serial_len,
+				success ? "" : ", MISMATCH");
+	}
+	grk_image_destroy(concurrent_image);
+	grk_image_destroy(serial_image);
+	delete[] concurrent;
+	delete[] serial;
+
+	return success;
+}
+
+}
+
+using namespace grk;
+
+/**
+ * Compress and decompress multi-tile images with one tile and with
+ * several tiles in flight, and check that the code streams are
+ * byte identical and the decompressed samples are identical.
+ */
+int main(void)
+{
+	grk_initialize(nullptr, 4);
+	uint32_t failures = 0;
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		if (!run(cases[i], i))
+			failures++;
+	}
+	grk_deinitialize();
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,253 @@
+/*
+ *    Copyright (C) 2016-2020 Grok Image Compression Inc.
+ *
+ *    This source code is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This source code is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "grok_includes.h"
+
+namespace grk {
+
+static uint32_t rand_state = 1;
+static uint32_t next_rand(void){
+	rand_state = rand_state * 1664525U + 1013904223U;
+	return rand_state >> 8;
+}
+
+struct TranscodeCase {
+	uint32_t numcomps;
+	uint32_t w, h;
+	uint32_t x0, y0;
+	uint32_t prec;
+	bool sgnd;
+	uint32_t tile_w, tile_h;
+	uint32_t numresolution;
+	uint32_t cblk;
+	uint32_t precinct;
+	GRK_PROG_ORDER prog;
+	uint8_t mct;
+	GRK_CODEC_FORMAT format;
+};
+
+static const TranscodeCase cases[] = {
+	{ 3, 333, 217, 0, 0, 8, false, 0, 0, 6, 64, 0, GRK_LRCP, 1, GRK_CODEC_J2K },
+	{ 3, 300, 200, 7, 3, 8, false, 128, 96, 4, 32, 0, GRK_RPCL, 1, GRK_CODEC_JP2 },
+	{ 1, 257, 129, 0, 0, 12, false, 100, 100, 3, 16, 64, GRK_PCRL, 0, GRK_CODEC_J2K },
+	{ 2, 190, 61, 1, 0, 16, true, 0, 0, 5, 32, 0, GRK_CPRL, 0, GRK_CODEC_J2K },
+	{ 1, 64, 64, 0, 0, 1, false, 0, 0, 1, 64, 0, GRK_LRCP, 0, GRK_CODEC_J2K },
+};
+
+/**
+ * Compress image losslessly to buffer, and return code stream length
+ */
+static size_t compress(grk_image *image, const TranscodeCase &c, uint8_t *buf,
+		size_t len) {
+	grk_cparameters param;
+	grk_set_default_compress_params(&param);
+	param.numresolution = c.numresolution;
+	param.cblockw_init = c.cblk;
+	param.cblockh_init = c.cblk;
+	param.prog_order = c.prog;
+	param.tcp_mct = c.mct;
+	param.irreversible = false;
+	param.tcp_numlayers = 3;
+	param.cp_disto_alloc = 1;
+	param.tcp_rates[0] = 40;
+	param.tcp_rates[1] = 10;
+	param.tcp_rates[2] = 0;
+	if (c.tile_w) {
+		param.tile_size_on = true;
+		param.t_width = c.tile_w;
+		param.t_height = c.tile_h;
+	}
+	if (c.precinct) {
+		param.csty |= 0x01;
+		param.res_spec = 1;
+		param.prcw_init[0] = c.precinct;
+		param.prch_init[0] = c.precinct;
+	}
+	auto stream = grk_stream_create_mem_stream(buf, len, false, false);
+	auto codec = grk_create_compress(c.format, stream);
+	size_t rc = 0;
+	if (grk_init_compress(codec, &param, image) && grk_start_compress(codec)
+			&& grk_compress(codec) && grk_end_compress(codec))
+		rc = grk_stream_get_write_mem_stream_length(stream);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+
+	return rc;
+}
+
+/**
+ * Transcode code stream to HTJ2K, and return length of transcoded code stream
+ */
+static size_t transcode(const TranscodeCase &c, uint8_t *src, size_t src_len,
+		uint8_t *dest, size_t dest_len) {
+	grk_dparameters dparam;
+	grk_set_default_decompress_params(&dparam);
+	auto src_stream = grk_stream_create_mem_stream(src, src_len, false, true);
+	auto dest_stream = grk_stream_create_mem_stream(dest, dest_len, false, false);
+	auto decompressor = grk_create_decompress(c.format, src_stream);
+	auto compressor = grk_create_compress(c.format, dest_stream);
+	grk_image *image = nullptr;
+	size_t rc = 0;
+	if (grk_init_decompress(decompressor, &dparam)
+			&& grk_read_header(decompressor, nullptr, &image)
+			&& grk_transcode(decompressor, image, compressor))
+		rc = grk_stream_get_write_mem_stream_length(dest_stream);
+	grk_image_destroy(image);
+	grk_destroy_codec(compressor);
+	grk_destroy_codec(decompressor);
+	grk_stream_destroy(dest_stream);
+	grk_stream_destroy(src_stream);
+
+	return rc;
+}
+
+/**
+ * Decompress code stream, and optionally return its code block style
+ */
+static grk_image* decompress(const TranscodeCase &c, uint8_t *buf, size_t len,
+		uint8_t *cblk_sty) {
+	grk_dparameters dparam;
+	grk_set_default_decompress_params(&dparam);
+	grk_header_info header_info;
+	memset(&header_info, 0, sizeof(header_info));
+	auto stream = grk_stream_create_mem_stream(buf, len, false, true);
+	auto codec = grk_create_decompress(c.format, stream);
+	grk_image *image = nullptr;
+	bool rc = grk_init_decompress(codec, &dparam)
+			&& grk_read_header(codec, &header_info, &image)
+			&& grk_set_decompress_area(codec, image, 0, 0, 0, 0)
+			&& grk_decompress(codec, nullptr, image)
+			&& grk_end_decompress(codec);
+	grk_destroy_codec(codec);
+	grk_stream_destroy(stream);
+	if (!rc) {
+		grk_image_destroy(image);
+		return nullptr;
+	}
+	if (cblk_sty)
+		*cblk_sty = header_info.cblk_sty;
+
+	return image;
+}
+
+static bool run(const TranscodeCase &c, uint32_t caseno) {
+	grk_image_cmptparm cmptparms[4];
+	for (uint32_t i = 0; i < c.numcomps; ++i) {
+		auto p = cmptparms + i;
+		memset(p, 0, sizeof(*p));
+		p->dx = 1;
+		p->dy = 1;
+		p->w = c.w;
+		p->h = c.h;
+		p->x0 = c.x0;
+		p->y0 = c.y0;
+		p->prec = c.prec;
+		p->sgnd = c.sgnd;
+	}
+	auto image = grk_image_create(c.numcomps, cmptparms,
+			c.numcomps == 3 ? GRK_CLRSPC_SRGB : GRK_CLRSPC_GRAY);
+	image->x0 = c.x0;
+	image->y0 = c.y0;
+	image->x1 = c.x0 + c.w;
+	image->y1 = c.y0 + c.h;
+	// smooth gradients with noise, so that all bit planes are coded
+	int32_t max_val = (int32_t) ((1U << c.prec) - 1);
+	int32_t offset = c.sgnd ? (int32_t) (1U << (c.prec - 1)) : 0;
+	for (uint32_t compno = 0; compno < c.numcomps; ++compno) {
+		auto data = image->comps[compno].data;
+		for (uint32_t y = 0; y < c.h; ++y) {
+			for (uint32_t x = 0; x < c.w; ++x) {
+				int32_t v = (int32_t) (((x + compno * 37) * max_val) / c.w
+						+ ((y * max_val) / c.h)) / 2;
+				v += (int32_t) (next_rand() % 17) - 8;
+				v = std::min<int32_t>(std::max<int32_t>(v, 0), max_val);
+				data[y * c.w + x] = v - offset;
+			}
+		}
+	}
+	// compressor may take ownership of single tile image data,
+	// so keep a copy of the original samples
+	std::vector<int32_t> original[4];
+	for (uint32_t compno = 0; compno < c.numcomps; ++compno) {
+		auto data = image->comps[compno].data;
+		original[compno].assign(data, data + (size_t) c.w * c.h);
+	}
+	size_t buf_len = (size_t) c.numcomps * c.w * c.h * 4 + 65536;
+	auto part1 = new uint8_t[buf_len];
+	auto ht = new uint8_t[buf_len];
+	bool success = false;
+	grk_image *part1_image = nullptr;
+	grk_image *ht_image = nullptr;
+	uint8_t cblk_sty = 0;
+	size_t part1_len = compress(image, c, part1, buf_len);
+	size_t ht_len = part1_len ? transcode(c, part1, part1_len, ht, buf_len) : 0;
+	if (ht_len) {
+		part1_image = decompress(c, part1, part1_len, nullptr);
+		ht_image = decompress(c, ht, ht_len, &cblk_sty);
+	}
+	if (!part1_image || !ht_image) {
+		printf("Case %u: failed to compress, transcode or decompress\n", caseno);
+	} else if (!(cblk_sty & GRK_CBLKSTY_HT)) {
+		printf("Case %u: transcoded code stream is not HTJ2K\n", caseno);
+	} else {
+		success = true;
+		for (uint32_t compno = 0; compno < c.numcomps && success; ++compno) {
+			auto src = original[compno].data();
+			auto a = part1_image->comps[compno].data;
+			auto b = ht_image->comps[compno].data;
+			for (uint32_t i = 0; i < c.w * c.h; ++i) {
+				if (a[i] != src[i] || b[i] != src[i]) {
+					printf("Case %u: component %u mismatch at (%u,%u): "
+							"%d, Part-1 %d, HTJ2K %d\n", caseno, compno,
+							i % c.w, i / c.w, src[i], a[i], b[i]);
+					success = false;
+					break;
+				}
+			}
+		}
+		printf("Case %u: Part-1 %zu bytes, HTJ2K %zu bytes%s\n", caseno,
+				part1_len, ht_len, success ? "" : ", MISMATCH");
+	}
+	grk_image_destroy(ht_image);
+	grk_image_destroy(part1_image);
+	delete[] ht;
+	delete[] part1;
+	grk_image_destroy(image);
+
+	return success;
+}
+
+}
+
+using namespace grk;
+
+/**
+ * Compress lossless Part-1 code streams, transcode them to HTJ2K,
+ * and check that both decompress to the original image.
+ */
+int main(void)
+{
+	grk_initialize(nullptr, 0);
+	uint32_t failures = 0;
+	for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		if (!run(cases[i], i))
+			failures++;
+	}
+	grk_deinitialize();
+
+	return failures ? 1 : 0;
+}